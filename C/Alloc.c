@@ -8,6 +8,11 @@
 #endif
 #include <stdlib.h>
 
+#if !defined(_WIN32) && defined(Z7_HUGE_PAGES)
+#include <stdio.h>
+#include <sys/mman.h>
+#endif
+
 #include "Alloc.h"
 
 #if defined(Z7_LARGE_PAGES) && defined(_WIN32) && \
@@ -493,6 +498,66 @@ const ISzAlloc g_AlignedAlloc = { SzAlignedAlloc, SzAlignedFree };
 
 
 
+#if !defined(_WIN32) && defined(Z7_HUGE_PAGES)
+
+extern
+SIZE_T g_HugePageSize;
+SIZE_T g_HugePageSize = 0;
+
+void SetHugePageSize(void)
+{
+  /* we use the size of PMD-mapped page of transparent huge pages */
+  unsigned long size = 0;
+  FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+  if (!f)
+    return;
+  if (fscanf(f, "%lu", &size) != 1)
+    size = 0;
+  fclose(f);
+  if (size == 0 || (size & (size - 1)) != 0 || size > (1 << 30))
+    return;
+  g_HugePageSize = (SIZE_T)size;
+}
+
+void *BigAlloc(size_t size)
+{
+  if (size == 0)
+    return NULL;
+
+  #if defined(USE_posix_memalign) && defined(MADV_HUGEPAGE)
+  {
+    size_t ps = g_HugePageSize;
+    if (ps != 0 && size > (ps / 2))
+    {
+      size_t size2;
+      ps--;
+      size2 = (size + ps) & ~ps;
+      if (size2 >= size)
+      {
+        void *p;
+        /* the block aligned for huge page can be freed with free() in z7_AlignedFree() */
+        if (posix_memalign(&p, ps + 1, size2) == 0)
+        {
+          /* the kernel can ignore that advice, if huge pages are disabled */
+          madvise(p, size2, MADV_HUGEPAGE);
+          return p;
+        }
+      }
+    }
+  }
+  #endif
+
+  return z7_AlignedAlloc(size);
+}
+
+static void *SzBigAlloc(ISzAllocPtr p, size_t size) { UNUSED_VAR(p)  return BigAlloc(size); }
+static void SzBigFree(ISzAllocPtr p, void *address) { UNUSED_VAR(p)  BigFree(address); }
+const ISzAlloc g_BigAlloc = { SzBigAlloc, SzBigFree };
+
+#endif
+
+
+
 /* we align ptr to support cases where CAlignOffsetAlloc::offset is not multiply of sizeof(void *) */
 #ifndef Z7_ALLOC_NO_OFFSET_ALLOCATOR
 #if 1
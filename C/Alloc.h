@@ -42,8 +42,16 @@ void BigFree(void *address);
 
 #define MidAlloc(size)    z7_AlignedAlloc(size)
 #define MidFree(address)  z7_AlignedFree(address)
+
+#ifdef Z7_HUGE_PAGES
+/* if SetHugePageSize() was called, BigAlloc() uses transparent huge pages for big blocks */
+void SetHugePageSize(void);
+void *BigAlloc(size_t size);
+#define BigFree(address)  z7_AlignedFree(address)
+#else
 #define BigAlloc(size)    z7_AlignedAlloc(size)
 #define BigFree(address)  z7_AlignedFree(address)
+#endif
 
 #endif
 
@@ -53,7 +61,11 @@ extern const ISzAlloc g_Alloc;
 extern const ISzAlloc g_BigAlloc;
 extern const ISzAlloc g_MidAlloc;
 #else
+#ifdef Z7_HUGE_PAGES
+extern const ISzAlloc g_BigAlloc;
+#else
 #define g_BigAlloc g_AlignedAlloc
+#endif
 #define g_MidAlloc g_AlignedAlloc
 #endif
 
@@ -3,9 +3,16 @@
 
 #include "Precomp.h"
 
+#include <string.h>
+
 #include "BwtSort.h"
 #include "Sort.h"
 
+#if !defined(Z7_ST) && !defined(BLOCK_SORT_EXTERNAL_FLAGS)
+#define BLOCK_SORT_MT
+#include "Threads.h"
+#endif
+
 /* #define BLOCK_SORT_USE_HEAP_SORT */
 // #define BLOCK_SORT_USE_HEAP_SORT
 
@@ -20,7 +27,7 @@
     p[k] = p[s]; k = s; \
   } p[k] = temp; }
 
-void HeapSortRef(UInt32 *p, UInt32 *vals, size_t size)
+static void HeapSortRef(UInt32 *p, const UInt32 *vals, size_t size)
 {
   if (size <= 1)
     return;
@@ -94,6 +101,11 @@ static void SetGroupSize(UInt32 *p, size_t size)
 /*
 SortGroup - is recursive Range-Sort function with HeapSort optimization for small blocks
   "range" is not real range. It's only for optimization.
+  GroupsRead : group values that are used as sort keys.
+      Single-threaded BlockSort() uses (GroupsRead == Groups) and it updates keys in place.
+      BlockSortMt() uses copy of (Groups) from the start of pass,
+      so the threads don't read group values that are changed by another threads.
+  Temp : temp buffer for (1 << NumRefBits) items.
 returns: 1 - if there are groups, 0 - no more groups
 */
 
@@ -102,7 +114,8 @@ unsigned
 Z7_FASTCALL
 SortGroup(size_t BlockSize, size_t NumSortedBytes,
     size_t groupOffset, size_t groupSize,
-    unsigned NumRefBits, UInt32 *Indices
+    unsigned NumRefBits, UInt32 *Indices,
+    const UInt32 *GroupsRead, UInt32 *Temp
 #ifndef BLOCK_SORT_USE_HEAP_SORT
     , size_t left, size_t range
 #endif
@@ -126,7 +139,7 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
 #endif
       )
   {
-    UInt32 *temp = Indices + BlockSize;
+    UInt32 *temp = Temp;
     size_t j, group;
     UInt32 mask, cg;
     unsigned thereAreGroups;
@@ -137,7 +150,7 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
         size_t sp = ind2[0] + NumSortedBytes;
         if (sp >= BlockSize)
             sp -= BlockSize;
-        gPrev = Groups[sp];
+        gPrev = GroupsRead[sp];
         temp[0] = gPrev << NumRefBits;
       }
       
@@ -147,7 +160,7 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
         UInt32 g;
         if (sp >= BlockSize)
             sp -= BlockSize;
-        g = Groups[sp];
+        g = GroupsRead[sp];
         temp[j] = (g << NumRefBits) | (UInt32)j;
         gRes |= (gPrev ^ g);
       }
@@ -221,13 +234,13 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
     size_t sp = ind2[0] + NumSortedBytes;
     if (sp >= BlockSize)
         sp -= BlockSize;
-    group = Groups[sp];
+    group = GroupsRead[sp];
     for (j = 1; j < groupSize; j++)
     {
       sp = ind2[j] + NumSortedBytes;
       if (sp >= BlockSize)
           sp -= BlockSize;
-      if (Groups[sp] != group)
+      if (GroupsRead[sp] != group)
         break;
     }
     if (j == groupSize)
@@ -260,12 +273,12 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
     do
     {
       size_t sp = ind2[i] + NumSortedBytes; if (sp >= BlockSize) sp -= BlockSize;
-      if (Groups[sp] >= mid)
+      if (GroupsRead[sp] >= mid)
       {
         for (j--; j > i; j--)
         {
           sp = ind2[j] + NumSortedBytes; if (sp >= BlockSize) sp -= BlockSize;
-          if (Groups[sp] < mid)
+          if (GroupsRead[sp] < mid)
           {
             UInt32 temp = ind2[i]; ind2[i] = ind2[j]; ind2[j] = temp;
             break;
@@ -302,8 +315,8 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
   }
 
   {
-    unsigned res = SortGroup(BlockSize, NumSortedBytes, groupOffset, i, NumRefBits, Indices, left, mid - left);
-    return   res | SortGroup(BlockSize, NumSortedBytes, groupOffset + i, groupSize - i, NumRefBits, Indices, mid, range - (mid - left));
+    unsigned res = SortGroup(BlockSize, NumSortedBytes, groupOffset, i, NumRefBits, Indices, GroupsRead, Temp, left, mid - left);
+    return   res | SortGroup(BlockSize, NumSortedBytes, groupOffset + i, groupSize - i, NumRefBits, Indices, GroupsRead, Temp, mid, range - (mid - left));
   }
 
   }
@@ -322,12 +335,12 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
       ind2[j] = (UInt32)sp;
     }
 
-    HeapSortRef(ind2, Groups, groupSize);
+    HeapSortRef(ind2, GroupsRead, groupSize);
 
     /* Write Flags */
     {
     size_t sp = ind2[0];
-    UInt32 group = Groups[sp];
+    UInt32 group = GroupsRead[sp];
 
 #ifdef BLOCK_SORT_EXTERNAL_FLAGS
     UInt32 *Flags = Groups + BlockSize;
@@ -338,9 +351,9 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
     for (j = 1; j < groupSize; j++)
     {
       sp = ind2[j];
-      if (Groups[sp] != group)
+      if (GroupsRead[sp] != group)
       {
-        group = Groups[sp];
+        group = GroupsRead[sp];
 #ifdef BLOCK_SORT_EXTERNAL_FLAGS
         {
         const size_t t = groupOffset + j - 1;
@@ -406,8 +419,118 @@ SortGroup(size_t BlockSize, size_t NumSortedBytes,
 }
 
 
+#ifdef BLOCK_SORT_MT
+
+#if BLOCK_SORT_MT_TEMP_SIZE < (1 << kNumRefBitsMax)
+  #error Stop_Compiling_Bad_BLOCK_SORT_MT_TEMP_SIZE
+#endif
+
+/* the groups in pass are independent:
+   SortGroup() writes only to (Indices) items of its group and
+   to (Groups) items for indices of its group.
+   So the threads sort different groups of pass in parallel,
+   and they read group values of previous pass from (GroupsRead) copy. */
+
+typedef struct
+{
+  UInt32 *Indices;
+  const UInt32 *GroupsRead;
+  UInt32 *Temp;
+  const UInt32 *GroupList; // pairs (groupOffset, groupSize)
+  size_t NumGroups;
+  size_t BlockSize;
+  size_t NumSortedBytes;
+  unsigned NumRefBits;
+  unsigned ThereAreGroups;
+  CPoolThread Thread;
+} CBlockSortMtPart;
+
+static void BlockSortMtPart_Sort(CBlockSortMtPart *p)
+{
+  const UInt32 *list = p->GroupList;
+  size_t k;
+  unsigned res = 0;
+  for (k = 0; k < p->NumGroups; k++, list += 2)
+    res |= SortGroup(p->BlockSize, p->NumSortedBytes, list[0], list[1], p->NumRefBits,
+        p->Indices, p->GroupsRead, p->Temp
+      #ifndef BLOCK_SORT_USE_HEAP_SORT
+        , 0, p->BlockSize
+      #endif
+        );
+  p->ThereAreGroups = res;
+}
+
+static THREAD_FUNC_DECL BlockSortMtPart_ThreadFunc(void *p)
+{
+  BlockSortMtPart_Sort((CBlockSortMtPart *)p);
+  return THREAD_FUNC_RET_ZERO;
+}
+
+// we don't create threads, if the size of groups in pass is small
+#define BLOCK_SORT_MT_PART_SIZE_MIN  (1 << 14)
+
+/* it returns 1, if there are unsorted groups after pass */
+static unsigned BlockSortMt_SortGroups(CBlockSortMtPart *parts, unsigned numThreads,
+    const UInt32 *groupList, size_t numGroups, size_t totalSize)
+{
+  unsigned numParts = 0;
+  unsigned res = 0;
+  size_t k = 0;
+  size_t sum = 0;
+  unsigned t;
+
+  if (numThreads > totalSize / BLOCK_SORT_MT_PART_SIZE_MIN)
+    numThreads = (unsigned)(totalSize / BLOCK_SORT_MT_PART_SIZE_MIN);
+  if (numThreads == 0)
+    numThreads = 1;
+
+  /* we split the list of groups to contiguous parts with similar total size */
+  do
+  {
+    CBlockSortMtPart *part = &parts[numParts];
+    const size_t start = k;
+    const size_t lim = totalSize / numThreads * (numParts + 1);
+    numParts++;
+    if (numParts == numThreads)
+      k = numGroups;
+    else
+      do
+        sum += groupList[k++ * 2 + 1];
+      while (k != numGroups && sum < lim);
+    part->GroupList = groupList + start * 2;
+    part->NumGroups = k - start;
+  }
+  while (k != numGroups);
+
+  for (t = 1; t < numParts; t++)
+  {
+    CBlockSortMtPart *part = &parts[t];
+    PoolThread_CONSTRUCT(&part->Thread)
+    if (PoolThread_Create(&part->Thread, BlockSortMtPart_ThreadFunc, part) != 0)
+    {
+      // we sort this part in current thread, if we can't create new thread
+      PoolThread_CONSTRUCT(&part->Thread)
+      BlockSortMtPart_Sort(part);
+    }
+  }
+
+  BlockSortMtPart_Sort(&parts[0]);
+
+  for (t = 0; t < numParts; t++)
+  {
+    CBlockSortMtPart *part = &parts[t];
+    if (t != 0 && PoolThread_WasCreated(&part->Thread))
+      PoolThread_Wait_Close(&part->Thread);
+    res |= part->ThereAreGroups;
+  }
+  return res;
+}
+
+#endif // BLOCK_SORT_MT
+
+
 /* conditions: blockSize > 0 */
-UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
+static UInt32 BlockSort2(UInt32 *Indices, const Byte *data, size_t blockSize, unsigned numThreads)
 {
   UInt32 *counters = Indices + blockSize;
   size_t i;
@@ -415,6 +538,13 @@ UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
 #ifdef BLOCK_SORT_EXTERNAL_FLAGS
   UInt32 *Flags;
 #endif
+#ifdef BLOCK_SORT_MT
+  CBlockSortMtPart parts[BLOCK_SORT_MT_THREADS_MAX];
+  UInt32 *groupsRead = NULL;
+  UInt32 *groupList = NULL;
+#else
+  UNUSED_VAR(numThreads)
+#endif
 
 /* Radix-Sort for 2 bytes */
 // { UInt32 yyy; for (yyy = 0; yyy < 100; yyy++) {
@@ -535,12 +665,37 @@ UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
   if (NumRefBits > kNumRefBitsMax)
       NumRefBits = kNumRefBitsMax;
 
+#ifdef BLOCK_SORT_MT
+  if (numThreads > 1)
+  {
+    unsigned t;
+    groupsRead = Indices + BLOCK_SORT_BUF_SIZE(blockSize);
+    groupList = groupsRead + blockSize;
+    for (t = 0; t < numThreads; t++)
+    {
+      CBlockSortMtPart *part = &parts[t];
+      part->Indices = Indices;
+      part->GroupsRead = groupsRead;
+      part->Temp = (t == 0 ? counters :
+          groupList + blockSize + (size_t)(t - 1) * BLOCK_SORT_MT_TEMP_SIZE);
+      part->BlockSize = blockSize;
+      part->NumRefBits = NumRefBits;
+    }
+  }
+#endif
+
   for (NumSortedBytes = kNumHashBytes; ; NumSortedBytes <<= 1)
   {
 #ifndef BLOCK_SORT_EXTERNAL_FLAGS
     size_t finishedGroupSize = 0;
 #endif
     size_t newLimit = 0;
+#ifdef BLOCK_SORT_MT
+    size_t numGroups = 0;
+    size_t totalSize = 0;
+    if (groupList)
+      memcpy(groupsRead, Groups, blockSize * sizeof(UInt32));
+#endif
     for (i = 0; i < blockSize;)
     {
       size_t groupSize;
@@ -597,8 +752,17 @@ UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
           Groups[Indices[t]] = (UInt32)t;
         }
       }
+#ifdef BLOCK_SORT_MT
+      else if (groupList)
+      {
+        groupList[numGroups * 2    ] = (UInt32)i;
+        groupList[numGroups * 2 + 1] = (UInt32)groupSize;
+        numGroups++;
+        totalSize += groupSize;
+      }
+#endif
       else
-        if (SortGroup(blockSize, NumSortedBytes, i, groupSize, NumRefBits, Indices
+        if (SortGroup(blockSize, NumSortedBytes, i, groupSize, NumRefBits, Indices, Groups, counters
             #ifndef BLOCK_SORT_USE_HEAP_SORT
               , 0, blockSize
             #endif
@@ -606,6 +770,16 @@ UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
           newLimit = i + groupSize;
       i += groupSize;
     }
+#ifdef BLOCK_SORT_MT
+    if (numGroups != 0)
+    {
+      unsigned t;
+      for (t = 0; t < numThreads; t++)
+        parts[t].NumSortedBytes = NumSortedBytes;
+      if (BlockSortMt_SortGroups(parts, numThreads, groupList, numGroups, totalSize))
+        newLimit = blockSize;
+    }
+#endif
     if (newLimit == 0)
       break;
   }
@@ -626,3 +800,16 @@ UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
 #endif
   return Groups[0];
 }
+
+
+UInt32 BlockSort(UInt32 *Indices, const Byte *data, size_t blockSize)
+{
+  return BlockSort2(Indices, data, blockSize, 1);
+}
+
+UInt32 BlockSortMt(UInt32 *Indices, const Byte *data, size_t blockSize, unsigned numThreads)
+{
+  if (numThreads > BLOCK_SORT_MT_THREADS_MAX)
+    numThreads = BLOCK_SORT_MT_THREADS_MAX;
+  return BlockSort2(Indices, data, blockSize, numThreads);
+}
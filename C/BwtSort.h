@@ -22,6 +22,19 @@ EXTERN_C_BEGIN
 
 UInt32 BlockSort(UInt32 *indices, const Byte *data, size_t blockSize);
 
+#define BLOCK_SORT_MT_THREADS_MAX 64
+#define BLOCK_SORT_MT_TEMP_SIZE (1 << 12)
+
+#define BLOCK_SORT_MT_BUF_SIZE(blockSize, numThreads) \
+    (BLOCK_SORT_BUF_SIZE(blockSize) + (blockSize) * 2 + (size_t)(numThreads) * BLOCK_SORT_MT_TEMP_SIZE)
+
+/* BlockSortMt() is multithreaded version of BlockSort().
+   It sorts the groups of each sorting pass in (numThreads) threads including current thread.
+   (indices) must contain BLOCK_SORT_MT_BUF_SIZE(blockSize, numThreads) items.
+   The sorted order can differ from BlockSort() result only for equal rotations of periodic block.
+   If BLOCK_SORT_EXTERNAL_FLAGS is defined or Z7_ST is defined, it works as BlockSort(). */
+UInt32 BlockSortMt(UInt32 *indices, const Byte *data, size_t blockSize, unsigned numThreads);
+
 EXTERN_C_END
 
 #endif
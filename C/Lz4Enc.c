@@ -0,0 +1,850 @@
+/* Lz4Enc.c -- LZ4 Frame Encoder
+Igor Pavlov : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "LzFind.h"
+#include "Lz4Enc.h"
+#include "MtCoder.h"
+#include "RotateDefs.h"
+
+/*
+  The encoder writes one LZ4 frame (LZ4 Frame Format v1.6.x):
+    - all blocks in frame are independent (B.Indep flag is set).
+      So the blocks can be compressed in parallel threads with MtCoder.
+    - fast levels use greedy parser with small hash table.
+    - HC levels use LzFind match finders (hash chain or binary tree)
+      with (history = 64 KiB) and lazy parser.
+    - the block that can't be compressed is written as uncompressed block.
+*/
+
+#define kLz4Signature  0x184D2204
+
+#define kMinMatch       4
+#define kLastLiterals   5
+#define kMfLimit       12  /* the last match must start at least 12 bytes before the end of block */
+#define kMaxOffset  65535
+#define kFbMax        273
+#define kNumKeepBefore 16
+
+#define kBlockHeaderSize 4
+#define kChecksumSize    4
+#define kFrameHeaderSize 7
+
+#define kBlockFlag_Uncompressed  ((UInt32)1 << 31)
+
+#define LZ4_GET_MAX_BLOCK_PACK_SIZE(size)  ((size) + (size) / 255 + 16)
+
+#define kFastHashLog_Max  16
+
+/* ---------- XXH32 ---------- */
+
+#define Z7_XXH_PRIME32_1  0x9E3779B1
+#define Z7_XXH_PRIME32_2  0x85EBCA77
+#define Z7_XXH_PRIME32_3  0xC2B2AE3D
+#define Z7_XXH_PRIME32_4  0x27D4EB2F
+#define Z7_XXH_PRIME32_5  0x165667B1
+
+typedef struct
+{
+  UInt32 v[4];
+  UInt32 buf32[4];
+  UInt64 count;
+} CXxh32;
+
+static void Xxh32_Init(CXxh32 *p)
+{
+  p->v[0] = Z7_XXH_PRIME32_1 + Z7_XXH_PRIME32_2;
+  p->v[1] = Z7_XXH_PRIME32_2;
+  p->v[2] = 0;
+  p->v[3] = (UInt32)0 - Z7_XXH_PRIME32_1;
+  p->count = 0;
+}
+
+#define XXH32_ROUND(acc, input) \
+  { acc += (input) * Z7_XXH_PRIME32_2; \
+    acc = rotlFixed(acc, 13); \
+    acc *= Z7_XXH_PRIME32_1; }
+
+// end == data + 16 * numBlocks
+static void Xxh32_UpdateBlocks(UInt32 *v, const Byte *data, const Byte *end)
+{
+  UInt32 v0 = v[0];
+  UInt32 v1 = v[1];
+  UInt32 v2 = v[2];
+  UInt32 v3 = v[3];
+  for (; data != end; data += 16)
+  {
+    XXH32_ROUND(v0, GetUi32(data))
+    XXH32_ROUND(v1, GetUi32(data + 4))
+    XXH32_ROUND(v2, GetUi32(data + 8))
+    XXH32_ROUND(v3, GetUi32(data + 12))
+  }
+  v[0] = v0;
+  v[1] = v1;
+  v[2] = v2;
+  v[3] = v3;
+}
+
+static void Xxh32_Update(CXxh32 *p, const void *data, size_t size)
+{
+  const Byte *d = (const Byte *)data;
+  unsigned pos = (unsigned)p->count & 15;
+  p->count += size;
+  if (pos != 0)
+  {
+    for (; size != 0 && pos != 16; size--)
+      ((Byte *)p->buf32)[pos++] = *d++;
+    if (pos != 16)
+      return;
+    Xxh32_UpdateBlocks(p->v, (const Byte *)p->buf32, (const Byte *)p->buf32 + 16);
+  }
+  {
+    const size_t rem = size & 15;
+    if (size != rem)
+    {
+      Xxh32_UpdateBlocks(p->v, d, d + (size - rem));
+      d += size - rem;
+    }
+    memcpy(p->buf32, d, rem);
+  }
+}
+
+static UInt32 Xxh32_Digest(const CXxh32 *p)
+{
+  UInt32 h;
+  const Byte *d = (const Byte *)p->buf32;
+  unsigned rem = (unsigned)p->count & 15;
+  if (p->count >= 16)
+    h = rotlFixed(p->v[0], 1) + rotlFixed(p->v[1], 7)
+      + rotlFixed(p->v[2], 12) + rotlFixed(p->v[3], 18);
+  else
+    h = Z7_XXH_PRIME32_5;
+  h += (UInt32)p->count;
+  for (; rem >= 4; rem -= 4, d += 4)
+  {
+    h += GetUi32(d) * Z7_XXH_PRIME32_3;
+    h = rotlFixed(h, 17) * Z7_XXH_PRIME32_4;
+  }
+  for (; rem != 0; rem--)
+  {
+    h += (UInt32)*d++ * Z7_XXH_PRIME32_5;
+    h = rotlFixed(h, 11) * Z7_XXH_PRIME32_1;
+  }
+  h ^= h >> 15;
+  h *= Z7_XXH_PRIME32_2;
+  h ^= h >> 13;
+  h *= Z7_XXH_PRIME32_3;
+  h ^= h >> 16;
+  return h;
+}
+
+static UInt32 Xxh32_Calc(const void *data, size_t size)
+{
+  CXxh32 x;
+  Xxh32_Init(&x);
+  Xxh32_Update(&x, data, size);
+  return Xxh32_Digest(&x);
+}
+
+
+/* ---------- Props ---------- */
+
+typedef struct
+{
+  Byte btMode;
+  Byte lazy;    /* number of lazy steps */
+  UInt16 mc;
+  UInt16 fb;
+} CLz4EncHcLevel;
+
+/* parameters for levels (LZ4_ENC_LEVEL_FAST_MAX + 1) ... LZ4_ENC_LEVEL_MAX */
+static const CLz4EncHcLevel g_HcLevels[LZ4_ENC_LEVEL_MAX - LZ4_ENC_LEVEL_FAST_MAX] =
+{
+  { 0, 0,   4,  16 },
+  { 0, 1,   8,  32 },
+  { 0, 1,  16,  32 },
+  { 0, 1,  32,  64 },
+  { 0, 2,  64,  64 },
+  { 1, 1,  24,  64 },
+  { 1, 2,  48, 128 },
+  { 1, 2,  96, 192 },
+  { 1, 2, 192, 273 },
+  { 1, 2, 512, 273 }
+};
+
+void Lz4EncProps_Init(CLz4EncProps *p)
+{
+  p->level = LZ4_ENC_LEVEL_DEFAULT;
+  p->blockSize = 0;
+  p->btMode = -1;
+  p->mc = 0;
+  p->fb = 0;
+  p->blockChecksum = 0;
+  p->contentChecksum = 1;
+  p->numBlockThreads_Reduced = -1;
+  p->numBlockThreads_Max = -1;
+  p->numTotalThreads = -1;
+  p->numThreadGroups = 0;
+  p->reduceSize = (UInt64)(Int64)-1;
+}
+
+void Lz4EncProps_Normalize(CLz4EncProps *p)
+{
+  int level = p->level;
+  if (level <= 0)
+    level = LZ4_ENC_LEVEL_DEFAULT;
+  else if (level > LZ4_ENC_LEVEL_MAX)
+    level = LZ4_ENC_LEVEL_MAX;
+  p->level = level;
+
+  {
+    unsigned code;
+    for (code = LZ4_ENC_BLOCK_SIZE_CODE_MIN; code < LZ4_ENC_BLOCK_SIZE_CODE_MAX; code++)
+      if (p->blockSize != 0 && p->blockSize <= LZ4_ENC_GET_BLOCK_SIZE(code))
+        break;
+    p->blockSize = LZ4_ENC_GET_BLOCK_SIZE(code);
+  }
+
+  if (level > LZ4_ENC_LEVEL_FAST_MAX)
+  {
+    const CLz4EncHcLevel *hl = &g_HcLevels[(unsigned)level - LZ4_ENC_LEVEL_FAST_MAX - 1];
+    if (p->btMode < 0) p->btMode = hl->btMode;
+    if (p->mc == 0) p->mc = hl->mc;
+    if (p->fb == 0) p->fb = hl->fb;
+    if (p->fb < 8) p->fb = 8;
+    if (p->fb > kFbMax) p->fb = kFbMax;
+    p->btMode = (p->btMode != 0);
+  }
+
+  p->blockChecksum = (p->blockChecksum != 0);
+  p->contentChecksum = (p->contentChecksum != 0);
+
+  {
+    int t = p->numTotalThreads;
+    int t2 = t;
+    if (t <= 0)
+      t = t2 = 1;
+    if (t2 > MTCODER_THREADS_MAX)
+      t2 = MTCODER_THREADS_MAX;
+    if (t2 > 1 && p->reduceSize != (UInt64)(Int64)-1)
+    {
+      const UInt64 numBlocks = (p->reduceSize + p->blockSize - 1) / p->blockSize;
+      if (numBlocks < (unsigned)t2)
+        t2 = (numBlocks == 0 ? 1 : (int)numBlocks);
+    }
+    p->numTotalThreads = t;
+    p->numBlockThreads_Max = (t > MTCODER_THREADS_MAX ? MTCODER_THREADS_MAX : t);
+    p->numBlockThreads_Reduced = t2;
+  }
+}
+
+
+/* ---------- Block coder ---------- */
+
+typedef struct
+{
+  UInt32 *hashTable;    /* for fast levels */
+  BoolInt mfCreated;    /* for HC levels */
+  IMatchFinder2 matchFinder;
+  CMatchFinder mf;
+  UInt32 matches[kFbMax * 2 + 2];
+} CLz4EncCoder;
+
+
+static Byte *Lz4Enc_WriteLen(Byte *op, size_t len)
+{
+  for (; len >= 255; len -= 255)
+    *op++ = 255;
+  *op++ = (Byte)len;
+  return op;
+}
+
+// (matchLen == 0) means the last literals without match
+static Byte *Lz4Enc_WriteSeq(Byte *op, const Byte *lits, size_t litLen, size_t matchLen, UInt32 offset)
+{
+  Byte *token = op++;
+  unsigned t;
+  if (litLen >= 15)
+  {
+    t = 15 << 4;
+    op = Lz4Enc_WriteLen(op, litLen - 15);
+  }
+  else
+    t = (unsigned)litLen << 4;
+  memcpy(op, lits, litLen);
+  op += litLen;
+  if (matchLen != 0)
+  {
+    SetUi16(op, (UInt16)offset)
+    op += 2;
+    matchLen -= kMinMatch;
+    if (matchLen >= 15)
+    {
+      t |= 15;
+      op = Lz4Enc_WriteLen(op, matchLen - 15);
+    }
+    else
+      t |= (unsigned)matchLen;
+  }
+  *token = (Byte)t;
+  return op;
+}
+
+
+static size_t Lz4Enc_GetMatchLen(const Byte *p1, const Byte *p2, const Byte *lim)
+{
+  const Byte *start = p1;
+  while (p1 != lim && *p1 == *p2)
+  {
+    p1++;
+    p2++;
+  }
+  return (size_t)(p1 - start);
+}
+
+
+#define FAST_HASH(v, hashLog)  (((UInt32)(v) * Z7_XXH_PRIME32_1) >> (32 - (hashLog)))
+
+/* greedy parser with one-entry hash table.
+   (accelShift) controls the skipping speed in incompressible data. */
+
+static Byte *Lz4Enc_CompressFast(UInt32 *table, unsigned hashLog, unsigned accelShift,
+    const Byte *src, size_t srcSize, Byte *op)
+{
+  const Byte *ip = src;
+  const Byte *anchor = src;
+  const Byte *srcLim = src + srcSize;
+
+  if (srcSize > kMfLimit)
+  {
+    const Byte *mfLimit = srcLim - kMfLimit;
+    const Byte *matchLimit = srcLim - kLastLiterals;
+
+    memset(table, 0, sizeof(UInt32) << hashLog);
+
+    for (;;)
+    {
+      const Byte *match;
+      {
+        UInt32 searchCount = (UInt32)1 << accelShift;
+        size_t step = 1;
+        for (;;)
+        {
+          const UInt32 v = GetUi32(ip);
+          const UInt32 h = FAST_HASH(v, hashLog);
+          match = src + table[h];
+          table[h] = (UInt32)(ip - src);
+          if (match < ip && ip - match <= kMaxOffset && GetUi32(match) == v)
+            break;
+          ip += step;
+          step = searchCount++ >> accelShift;
+          if (ip > mfLimit)
+            goto last;
+        }
+      }
+      while (ip != anchor && match != src && ip[-1] == match[-1])
+      {
+        ip--;
+        match--;
+      }
+      {
+        const size_t len = kMinMatch + Lz4Enc_GetMatchLen(ip + kMinMatch, match + kMinMatch, matchLimit);
+        op = Lz4Enc_WriteSeq(op, anchor, (size_t)(ip - anchor), len, (UInt32)(ip - match));
+        ip += len;
+        anchor = ip;
+      }
+      if (ip > mfLimit)
+        break;
+      table[FAST_HASH(GetUi32(ip - 2), hashLog)] = (UInt32)(ip - 2 - src);
+    }
+  }
+last:
+  return Lz4Enc_WriteSeq(op, anchor, (size_t)(srcLim - anchor), 0, 0);
+}
+
+
+static SRes Lz4EncCoder_CreateMf(CLz4EncCoder *c, const CLz4EncProps *props, ISzAllocPtr allocBig)
+{
+  CMatchFinder *mf = &c->mf;
+  mf->btMode = (Byte)props->btMode;
+  mf->numHashBytes = 4;
+  mf->cutValue = props->mc;
+  mf->bigHash = 0;
+  mf->expectedDataSize = props->blockSize;
+  MatchFinder_SET_DIRECT_INPUT_BUF(mf, NULL, 0)
+  if (!MatchFinder_Create(mf, kMaxOffset, kNumKeepBefore, (UInt32)props->fb, kLastLiterals, allocBig))
+    return SZ_ERROR_MEM;
+  MatchFinder_CreateVTable(mf, &c->matchFinder);
+  c->mfCreated = True;
+  return SZ_OK;
+}
+
+
+// it returns the length of the longest match at current position of match finder, or 0.
+static UInt32 Lz4EncCoder_GetMatch(CLz4EncCoder *c, const Byte *cur, UInt32 fb, UInt32 lenLimit, UInt32 *dist)
+{
+  const UInt32 *d = c->matchFinder.GetMatches(&c->mf, c->matches);
+  UInt32 len;
+  if (d == c->matches)
+    return 0;
+  len = d[-2];
+  if (len < kMinMatch)
+    return 0;
+  *dist = d[-1] + 1;
+  if (len >= lenLimit)
+    return lenLimit;
+  if (len == fb)
+    len += (UInt32)Lz4Enc_GetMatchLen(cur + len, cur + len - *dist, cur + lenLimit);
+  return len;
+}
+
+
+static Byte *Lz4Enc_CompressHc(CLz4EncCoder *c, const CLz4EncProps *props,
+    const Byte *src, size_t srcSize, Byte *op)
+{
+  size_t anchor = 0;
+
+  if (srcSize > kMfLimit)
+  {
+    const size_t mfLimit = srcSize - kMfLimit;
+    const size_t matchLimit = srcSize - kLastLiterals;
+    const UInt32 fb = (UInt32)props->fb;
+    const unsigned numLazy = g_HcLevels[(unsigned)props->level - LZ4_ENC_LEVEL_FAST_MAX - 1].lazy;
+    size_t cur = 0;
+    size_t mfPos = 0;
+
+    MatchFinder_SET_DIRECT_INPUT_BUF(&c->mf, src, srcSize)
+    c->matchFinder.Init(&c->mf);
+
+    while (cur <= mfLimit)
+    {
+      UInt32 dist = 0;
+      UInt32 len = Lz4EncCoder_GetMatch(c, src + cur, fb, (UInt32)(matchLimit - cur), &dist);
+      unsigned i;
+      mfPos++;
+      if (len == 0)
+      {
+        cur++;
+        continue;
+      }
+      for (i = 0; i < numLazy && cur < mfLimit; i++)
+      {
+        UInt32 dist2 = 0;
+        const UInt32 len2 = Lz4EncCoder_GetMatch(c, src + cur + 1, fb, (UInt32)(matchLimit - cur - 1), &dist2);
+        mfPos++;
+        if (len2 <= len)
+          break;
+        cur++;
+        len = len2;
+        dist = dist2;
+      }
+      op = Lz4Enc_WriteSeq(op, src + anchor, cur - anchor, len, dist);
+      cur += len;
+      anchor = cur;
+      if (cur > mfLimit)
+        break;
+      c->matchFinder.Skip(&c->mf, (UInt32)(cur - mfPos));
+      mfPos = cur;
+    }
+  }
+  return Lz4Enc_WriteSeq(op, src + anchor, srcSize - anchor, 0, 0);
+}
+
+
+/* ---------- Encoder ---------- */
+
+typedef struct
+{
+  ISeqInStream vt;
+  ISeqInStreamPtr realStream;
+  UInt64 processed;
+  BoolInt calcChecksum;
+  CXxh32 xxh;
+} CLz4EncInStream;
+
+static SRes Lz4EncInStream_Read(ISeqInStreamPtr pp, void *data, size_t *size)
+{
+  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(CLz4EncInStream)
+  const SRes res = ISeqInStream_Read(p->realStream, data, size);
+  p->processed += *size;
+  if (p->calcChecksum)
+    Xxh32_Update(&p->xxh, data, *size);
+  return res;
+}
+
+
+struct CLz4Enc
+{
+  ISzAllocPtr alloc;
+  ISzAllocPtr allocBig;
+
+  CLz4EncProps props;
+  UInt64 expectedDataSize;
+
+  CLz4EncInStream inStream;
+
+  size_t outBufSize;       /* size of allocated outBufs[i] */
+  Byte *outBufs[MTCODER_BLOCKS_MAX];
+  Byte *inBuf;             /* for single-thread mode */
+  size_t inBufSize;
+
+  CLz4EncCoder *coders[MTCODER_THREADS_MAX];
+
+  #ifndef Z7_ST
+  ISeqOutStreamPtr outStream;
+  CLz4EncProps mtProps;    /* normalized props for current Lz4Enc_Encode() call */
+  BoolInt mtCoder_WasConstructed;
+  CMtCoder mtCoder;
+  size_t outBlockSizes[MTCODER_BLOCKS_MAX];
+  #endif
+};
+
+
+static void Lz4Enc_FreeCoders(CLz4Enc *p)
+{
+  unsigned i;
+  for (i = 0; i < MTCODER_THREADS_MAX; i++)
+  {
+    CLz4EncCoder *c = p->coders[i];
+    if (c)
+    {
+      ISzAlloc_Free(p->allocBig, c->hashTable);
+      MatchFinder_Free(&c->mf, p->allocBig);
+      ISzAlloc_Free(p->alloc, c);
+      p->coders[i] = NULL;
+    }
+  }
+}
+
+
+static void Lz4Enc_FreeOutBufs(CLz4Enc *p)
+{
+  unsigned i;
+  for (i = 0; i < MTCODER_BLOCKS_MAX; i++)
+    if (p->outBufs[i])
+    {
+      ISzAlloc_Free(p->alloc, p->outBufs[i]);
+      p->outBufs[i] = NULL;
+    }
+  p->outBufSize = 0;
+}
+
+
+CLz4EncHandle Lz4Enc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  unsigned i;
+  CLz4Enc *p = (CLz4Enc *)ISzAlloc_Alloc(alloc, sizeof(CLz4Enc));
+  if (!p)
+    return NULL;
+  p->alloc = alloc;
+  p->allocBig = allocBig;
+  Lz4EncProps_Init(&p->props);
+  Lz4EncProps_Normalize(&p->props);
+  p->expectedDataSize = (UInt64)(Int64)-1;
+  p->inStream.processed = 0;
+  for (i = 0; i < MTCODER_BLOCKS_MAX; i++)
+    p->outBufs[i] = NULL;
+  p->outBufSize = 0;
+  p->inBuf = NULL;
+  p->inBufSize = 0;
+  for (i = 0; i < MTCODER_THREADS_MAX; i++)
+    p->coders[i] = NULL;
+  #ifndef Z7_ST
+  p->mtCoder_WasConstructed = False;
+  #endif
+  return p;
+}
+
+
+void Lz4Enc_Destroy(CLz4EncHandle p)
+{
+  #ifndef Z7_ST
+  if (p->mtCoder_WasConstructed)
+  {
+    MtCoder_Destruct(&p->mtCoder);
+    p->mtCoder_WasConstructed = False;
+  }
+  #endif
+  Lz4Enc_FreeOutBufs(p);
+  ISzAlloc_Free(p->allocBig, p->inBuf);
+  Lz4Enc_FreeCoders(p);
+  ISzAlloc_Free(p->alloc, p);
+}
+
+
+SRes Lz4Enc_SetProps(CLz4EncHandle p, const CLz4EncProps *props)
+{
+  if (props->level > LZ4_ENC_LEVEL_MAX
+      || props->blockSize > LZ4_ENC_GET_BLOCK_SIZE(LZ4_ENC_BLOCK_SIZE_CODE_MAX)
+      || props->fb > kFbMax)
+    return SZ_ERROR_PARAM;
+  /* match finders and hash tables depend on props.
+     So we free them, and then we allocate them again with new props */
+  Lz4Enc_FreeCoders(p);
+  p->props = *props;
+  return SZ_OK;
+}
+
+
+void Lz4Enc_SetDataSize(CLz4EncHandle p, UInt64 expectedDataSiize)
+{
+  p->expectedDataSize = expectedDataSiize;
+}
+
+
+UInt64 Lz4Enc_GetInProcessed(const CLz4Enc *p)
+{
+  return p->inStream.processed;
+}
+
+
+static SRes Lz4Enc_GetCoder(CLz4Enc *p, unsigned coderIndex, const CLz4EncProps *props, CLz4EncCoder **res)
+{
+  CLz4EncCoder *c = p->coders[coderIndex];
+  if (!c)
+  {
+    c = (CLz4EncCoder *)ISzAlloc_Alloc(p->alloc, sizeof(CLz4EncCoder));
+    if (!c)
+      return SZ_ERROR_MEM;
+    c->hashTable = NULL;
+    c->mfCreated = False;
+    MatchFinder_Construct(&c->mf);
+    p->coders[coderIndex] = c;
+  }
+  if (props->level <= LZ4_ENC_LEVEL_FAST_MAX)
+  {
+    if (!c->hashTable)
+    {
+      c->hashTable = (UInt32 *)ISzAlloc_Alloc(p->allocBig, sizeof(UInt32) << kFastHashLog_Max);
+      if (!c->hashTable)
+        return SZ_ERROR_MEM;
+    }
+  }
+  else if (!c->mfCreated)
+  {
+    RINOK(Lz4EncCoder_CreateMf(c, props, p->allocBig))
+  }
+  *res = c;
+  return SZ_OK;
+}
+
+
+/* it writes block header, block data, and optional block checksum to (dest).
+   (dest) must have the size of (kBlockHeaderSize + LZ4_GET_MAX_BLOCK_PACK_SIZE(srcSize) + kChecksumSize) */
+
+static SRes Lz4Enc_EncodeBlock(CLz4Enc *p, unsigned coderIndex, const CLz4EncProps *props,
+    const Byte *src, size_t srcSize, Byte *dest, size_t *destSize)
+{
+  CLz4EncCoder *c;
+  Byte *op = dest + kBlockHeaderSize;
+  size_t packSize;
+  RINOK(Lz4Enc_GetCoder(p, coderIndex, props, &c))
+  if (props->level <= LZ4_ENC_LEVEL_FAST_MAX)
+  {
+    if (props->level == 1)
+      op = Lz4Enc_CompressFast(c->hashTable, 12, 6, src, srcSize, op);
+    else
+      op = Lz4Enc_CompressFast(c->hashTable, kFastHashLog_Max, 8, src, srcSize, op);
+  }
+  else
+  {
+    op = Lz4Enc_CompressHc(c, props, src, srcSize, op);
+    if (c->mf.result != SZ_OK)
+      return c->mf.result;
+  }
+  packSize = (size_t)(op - (dest + kBlockHeaderSize));
+  if (packSize >= srcSize)
+  {
+    memcpy(dest + kBlockHeaderSize, src, srcSize);
+    packSize = srcSize;
+    SetUi32(dest, (UInt32)packSize | kBlockFlag_Uncompressed)
+  }
+  else
+    SetUi32(dest, (UInt32)packSize)
+  packSize += kBlockHeaderSize;
+  if (props->blockChecksum)
+  {
+    SetUi32(dest + packSize, Xxh32_Calc(dest + kBlockHeaderSize, packSize - kBlockHeaderSize))
+    packSize += kChecksumSize;
+  }
+  *destSize = packSize;
+  return SZ_OK;
+}
+
+
+static SRes Lz4Enc_WriteBytes(ISeqOutStreamPtr s, const void *buf, size_t size)
+{
+  return (ISeqOutStream_Write(s, buf, size) == size) ? SZ_OK : SZ_ERROR_WRITE;
+}
+
+
+static SRes Lz4Enc_WriteFrameHeader(const CLz4EncProps *props, ISeqOutStreamPtr s)
+{
+  Byte header[kFrameHeaderSize];
+  unsigned code;
+  for (code = LZ4_ENC_BLOCK_SIZE_CODE_MIN; LZ4_ENC_GET_BLOCK_SIZE(code) < props->blockSize; code++)
+    {}
+  SetUi32(header, kLz4Signature)
+  header[4] = (Byte)((1 << 6) | (1 << 5)
+      | (props->blockChecksum ? (1 << 4) : 0)
+      | (props->contentChecksum ? (1 << 2) : 0));
+  header[5] = (Byte)(code << 4);
+  header[6] = (Byte)(Xxh32_Calc(header + 4, 2) >> 8);
+  return Lz4Enc_WriteBytes(s, header, kFrameHeaderSize);
+}
+
+
+static SRes Lz4Enc_AllocOutBuf(CLz4Enc *p, unsigned index)
+{
+  if (!p->outBufs[index])
+  {
+    p->outBufs[index] = (Byte *)ISzAlloc_Alloc(p->alloc, p->outBufSize);
+    if (!p->outBufs[index])
+      return SZ_ERROR_MEM;
+  }
+  return SZ_OK;
+}
+
+
+#ifndef Z7_ST
+
+static SRes Lz4Enc_MtCallback_Code(void *pp, unsigned coderIndex, unsigned outBufIndex,
+    const Byte *src, size_t srcSize, int finished)
+{
+  CLz4Enc *me = (CLz4Enc *)pp;
+  CMtProgressThunk progressThunk;
+  size_t destSize = 0;
+  UNUSED_VAR(finished)
+  me->outBlockSizes[outBufIndex] = 0;
+  // we don't write empty blocks
+  if (srcSize == 0)
+    return SZ_OK;
+  RINOK(Lz4Enc_AllocOutBuf(me, outBufIndex))
+  RINOK(Lz4Enc_EncodeBlock(me, coderIndex, &me->mtProps,
+      src, srcSize, me->outBufs[outBufIndex], &destSize))
+  me->outBlockSizes[outBufIndex] = destSize;
+
+  MtProgressThunk_CreateVTable(&progressThunk);
+  progressThunk.mtProgress = &me->mtCoder.mtProgress;
+  MtProgressThunk_INIT(&progressThunk)
+  return ICompressProgress_Progress(&progressThunk.vt, srcSize, destSize);
+}
+
+
+static SRes Lz4Enc_MtCallback_Write(void *pp, unsigned outBufIndex)
+{
+  CLz4Enc *me = (CLz4Enc *)pp;
+  const size_t size = me->outBlockSizes[outBufIndex];
+  if (size == 0)
+    return SZ_OK;
+  return Lz4Enc_WriteBytes(me->outStream, me->outBufs[outBufIndex], size);
+}
+
+#endif
+
+
+SRes Lz4Enc_Encode(CLz4EncHandle p, ISeqOutStreamPtr outStream, ISeqInStreamPtr inStream, ICompressProgressPtr progress)
+{
+  CLz4EncProps props = p->props;
+
+  if (props.reduceSize == (UInt64)(Int64)-1)
+    props.reduceSize = p->expectedDataSize;
+  Lz4EncProps_Normalize(&props);
+
+  p->inStream.vt.Read = Lz4EncInStream_Read;
+  p->inStream.realStream = inStream;
+  p->inStream.processed = 0;
+  p->inStream.calcChecksum = props.contentChecksum;
+  Xxh32_Init(&p->inStream.xxh);
+
+  {
+    const size_t outBufSize = kBlockHeaderSize + LZ4_GET_MAX_BLOCK_PACK_SIZE((size_t)props.blockSize) + kChecksumSize;
+    if (p->outBufSize != outBufSize)
+      Lz4Enc_FreeOutBufs(p);
+    p->outBufSize = outBufSize;
+  }
+
+  RINOK(Lz4Enc_WriteFrameHeader(&props, outStream))
+
+  #ifndef Z7_ST
+  if (props.numBlockThreads_Reduced > 1)
+  {
+    IMtCoderCallback2 vt;
+
+    if (!p->mtCoder_WasConstructed)
+    {
+      p->mtCoder_WasConstructed = True;
+      MtCoder_Construct(&p->mtCoder);
+    }
+
+    vt.Code = Lz4Enc_MtCallback_Code;
+    vt.Write = Lz4Enc_MtCallback_Write;
+
+    p->mtProps = props;
+    p->outStream = outStream;
+
+    p->mtCoder.allocBig = p->allocBig;
+    p->mtCoder.progress = progress;
+    p->mtCoder.inStream = &p->inStream.vt;
+    p->mtCoder.inData = NULL;
+    p->mtCoder.inDataSize = 0;
+    p->mtCoder.mtCallback = &vt;
+    p->mtCoder.mtCallbackObject = p;
+    p->mtCoder.blockSize = props.blockSize;
+    p->mtCoder.numThreadsMax = (unsigned)props.numBlockThreads_Max;
+    p->mtCoder.numThreadGroups = props.numThreadGroups;
+    p->mtCoder.expectedDataSize = p->expectedDataSize;
+
+    RINOK(MtCoder_Code(&p->mtCoder))
+  }
+  else
+  #endif
+  {
+    UInt64 outProcessed = kFrameHeaderSize;
+
+    RINOK(Lz4Enc_AllocOutBuf(p, 0))
+    if (!p->inBuf || p->inBufSize != props.blockSize)
+    {
+      ISzAlloc_Free(p->allocBig, p->inBuf);
+      p->inBufSize = 0;
+      p->inBuf = (Byte *)ISzAlloc_Alloc(p->allocBig, props.blockSize);
+      if (!p->inBuf)
+        return SZ_ERROR_MEM;
+      p->inBufSize = props.blockSize;
+    }
+
+    for (;;)
+    {
+      size_t size = props.blockSize;
+      size_t destSize;
+      RINOK(SeqInStream_ReadMax(&p->inStream.vt, p->inBuf, &size))
+      if (size == 0)
+        break;
+      RINOK(Lz4Enc_EncodeBlock(p, 0, &props, p->inBuf, size, p->outBufs[0], &destSize))
+      RINOK(Lz4Enc_WriteBytes(outStream, p->outBufs[0], destSize))
+      outProcessed += destSize;
+      if (progress)
+      {
+        RINOK(ICompressProgress_Progress(progress, p->inStream.processed, outProcessed))
+      }
+      if (size != props.blockSize)
+        break;
+    }
+  }
+
+  {
+    Byte buf[kBlockHeaderSize + kChecksumSize];
+    size_t size = kBlockHeaderSize;
+    SetUi32(buf, 0)
+    if (props.contentChecksum)
+    {
+      SetUi32(buf + kBlockHeaderSize, Xxh32_Digest(&p->inStream.xxh))
+      size += kChecksumSize;
+    }
+    return Lz4Enc_WriteBytes(outStream, buf, size);
+  }
+}
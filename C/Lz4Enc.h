@@ -0,0 +1,82 @@
+/* Lz4Enc.h -- LZ4 Frame Encoder interfaces
+Igor Pavlov : Public domain */
+
+#ifndef ZIP7_INC_LZ4_ENC_H
+#define ZIP7_INC_LZ4_ENC_H
+
+#include "7zTypes.h"
+
+EXTERN_C_BEGIN
+
+#define LZ4_ENC_LEVEL_MAX       12
+#define LZ4_ENC_LEVEL_DEFAULT    1
+
+/* levels (1 ... LZ4_ENC_LEVEL_FAST_MAX) use fast greedy parser with hash table.
+   higher levels (HC) use LzFind match finders (hash chain or binary tree) and lazy parser. */
+#define LZ4_ENC_LEVEL_FAST_MAX   2
+
+#define LZ4_ENC_BLOCK_SIZE_CODE_MIN  4  /* 64 KiB */
+#define LZ4_ENC_BLOCK_SIZE_CODE_MAX  7  /*  4 MiB */
+
+#define LZ4_ENC_GET_BLOCK_SIZE(code)  ((UInt32)1 << (8 + (code) * 2))
+
+typedef struct
+{
+  int level;              /* 1 <= level <= LZ4_ENC_LEVEL_MAX, default = LZ4_ENC_LEVEL_DEFAULT */
+  UInt32 blockSize;       /* (64 KiB, 256 KiB, 1 MiB, 4 MiB), 0 - default (4 MiB).
+                             other values are rounded up to the nearest allowed size. */
+  int btMode;             /* (HC levels) 0 - hashChain Mode, 1 - binTree mode, -1 - default for level */
+  UInt32 mc;              /* (HC levels) number of match finder cycles, 0 - default for level */
+  int fb;                 /* (HC levels) number of fast bytes: 8 <= fb <= 273, 0 - default for level */
+  int blockChecksum;      /* 0 - no block checksums (default), 1 - XXH32 checksum for each block */
+  int contentChecksum;    /* 0 - no content checksum, 1 - XXH32 content checksum (default) */
+  int numBlockThreads_Reduced;
+  int numBlockThreads_Max;
+  int numTotalThreads;    /* -1 - default (number of CPUs) */
+  unsigned numThreadGroups;
+  UInt64 reduceSize;      /* estimated size of data that will be compressed. default = (UInt64)(Int64)-1.
+                             Encoder uses this value to reduce the number of threads, if possible. */
+} CLz4EncProps;
+
+void Lz4EncProps_Init(CLz4EncProps *p);
+void Lz4EncProps_Normalize(CLz4EncProps *p);
+
+/* ---------- CLz4EncHandle Interface ---------- */
+
+/* Lz4Enc_* functions can return the following exit codes:
+SRes:
+  SZ_OK           - OK
+  SZ_ERROR_MEM    - Memory allocation error
+  SZ_ERROR_PARAM  - Incorrect paramater in props
+  SZ_ERROR_WRITE  - ISeqOutStream write callback error
+  SZ_ERROR_READ   - ISeqInStream read callback error
+  SZ_ERROR_PROGRESS - some break from progress callback
+  SZ_ERROR_THREAD - error in multithreading functions (only for Mt version)
+*/
+
+typedef struct CLz4Enc CLz4Enc;
+typedef CLz4Enc * CLz4EncHandle;
+
+CLz4EncHandle Lz4Enc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig);
+void Lz4Enc_Destroy(CLz4EncHandle p);
+SRes Lz4Enc_SetProps(CLz4EncHandle p, const CLz4EncProps *props);
+
+/* (expectedDataSize) is used to reduce the number of threads and the block buffers.
+   The encoder doesn't write content size to frame header. */
+void Lz4Enc_SetDataSize(CLz4EncHandle p, UInt64 expectedDataSiize);
+
+/*
+Lz4Enc_Encode() writes one LZ4 frame that contains all data from (inStream).
+The blocks in frame are independent. So the blocks can be compressed in parallel threads.
+*/
+SRes Lz4Enc_Encode(CLz4EncHandle p,
+    ISeqOutStreamPtr outStream,
+    ISeqInStreamPtr inStream,
+    ICompressProgressPtr progress);
+
+/* returns the total size of data that was read from (inStream) in last Lz4Enc_Encode() call */
+UInt64 Lz4Enc_GetInProcessed(const CLz4Enc *p);
+
+EXTERN_C_END
+
+#endif
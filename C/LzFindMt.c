@@ -88,7 +88,7 @@ static void MtSync_Construct(CMtSync *p)
   p->wasCreated = False;
   p->csWasInitialized = False;
   p->csWasEntered = False;
-  Thread_CONSTRUCT(&p->thread)
+  PoolThread_CONSTRUCT(&p->thread)
   Event_Construct(&p->canStart);
   Event_Construct(&p->wasStopped);
   Semaphore_Construct(&p->freeSemaphore);
@@ -152,7 +152,7 @@ static UInt32 MtSync_GetNextBlock(CMtSync *p)
 Z7_NO_INLINE
 static void MtSync_StopWriting(CMtSync *p)
 {
-  if (!Thread_WasCreated(&p->thread) || p->needStart)
+  if (!PoolThread_WasCreated(&p->thread) || p->needStart)
     return;
 
     PRF(printf("\nMtSync_StopWriting %p\n", p));
@@ -192,7 +192,7 @@ static void MtSync_Destruct(CMtSync *p)
 {
     PRF(printf("\nMtSync_Destruct %p\n", p));
   
-  if (Thread_WasCreated(&p->thread))
+  if (PoolThread_WasCreated(&p->thread))
   {
     /* we want thread to be in Stopped state before sending EXIT command.
        note: stop(btSync) will stop (htSync) also */
@@ -201,7 +201,7 @@ static void MtSync_Destruct(CMtSync *p)
     p->exit = True;
     // if (p->needStart)  // it's (true)
     Event_Set(&p->canStart);  // we send EXIT command to thread
-    Thread_Wait_Close(&p->thread);  // we wait thread finishing
+    PoolThread_Wait_Close(&p->thread);  // we wait thread finishing
   }
 
   if (p->csWasInitialized)
@@ -263,14 +263,14 @@ static WRes MtSync_Create_WRes(CMtSync *p, THREAD_FUNC_TYPE startAddress, void *
 
 #ifdef _WIN32
   if (p->affinityGroup >= 0)
-    wres = Thread_Create_With_Group(&p->thread, startAddress, obj,
+    wres = Thread_Create_With_Group(PoolThread_GetThread(&p->thread), startAddress, obj,
         (unsigned)(UInt32)p->affinityGroup, (CAffinityMask)p->affinityInGroup);
   else
 #endif
   if (p->affinity != 0)
-    wres = Thread_Create_With_Affinity(&p->thread, startAddress, obj, (CAffinityMask)p->affinity);
+    wres = Thread_Create_With_Affinity(PoolThread_GetThread(&p->thread), startAddress, obj, (CAffinityMask)p->affinity);
   else
-    wres = Thread_Create(&p->thread, startAddress, obj);
+    wres = PoolThread_Create(&p->thread, startAddress, obj);
 
   RINOK_THREAD(wres)
   p->wasCreated = True;
@@ -737,6 +737,403 @@ static void BtGetMatches(CMatchFinderMt *p, UInt32 *d)
 }
 
 
+// ---------- BT partitioned mode ----------
+
+/* In partitioned mode BT thread splits positions of hash block into rounds.
+   For each position BT thread selects the owner thread:
+     if the tree for position is not empty, it's the owner of previous node of that tree,
+     else it's next thread in round-robin order.
+   So all nodes of one tree are processed by one thread,
+   and the threads don't write to same (son) records.
+   Match search window is reduced by (kMtBtPartRoundMax),
+   so the thread doesn't read the (son) records that can be
+   rewritten by another thread in current round. */
+
+#define kMtBtPartRoundMax ((UInt32)1 << 12)
+#define kMtBtPartBufSize ((UInt32)1 << 16)
+// we don't use partitioned mode for small dictionaries, where window reduction is noticeable
+#define kMtBtPart_HistorySizeMin ((UInt32)1 << 20)
+
+/* Bt_GetMatches_Part() is GetMatchesSpec1() with additional (window) parameter:
+     (_cyclicBufferSize) : the size of (son) cyclic buffer,
+     (window)            : match distance limit (window <= _cyclicBufferSize) */
+
+static UInt32 * Bt_GetMatches_Part(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const Byte *cur, CLzRef *son,
+    size_t _cyclicBufferPos, UInt32 _cyclicBufferSize, UInt32 window, UInt32 cutValue,
+    UInt32 *d, UInt32 maxLen)
+{
+  CLzRef *ptr0 = son + ((size_t)_cyclicBufferPos << 1) + 1;
+  CLzRef *ptr1 = son + ((size_t)_cyclicBufferPos << 1);
+  unsigned len0 = 0, len1 = 0;
+
+  UInt32 cmCheck;
+
+  cmCheck = (UInt32)(pos - window);
+  if ((UInt32)pos < window)
+    cmCheck = 0;
+
+  if (cmCheck < curMatch)
+  do
+  {
+    const UInt32 delta = pos - curMatch;
+    {
+      CLzRef *pair = son + ((size_t)(_cyclicBufferPos - delta + (_cyclicBufferPos < delta ? _cyclicBufferSize : 0)) << 1);
+      const Byte *pb = cur - delta;
+      unsigned len = (len0 < len1 ? len0 : len1);
+      const UInt32 pair0 = pair[0];
+      if (pb[len] == cur[len])
+      {
+        if (++len != lenLimit && pb[len] == cur[len])
+          while (++len != lenLimit)
+            if (pb[len] != cur[len])
+              break;
+        if (maxLen < len)
+        {
+          maxLen = (UInt32)len;
+          *d++ = (UInt32)len;
+          *d++ = delta - 1;
+          if (len == lenLimit)
+          {
+            *ptr1 = pair0;
+            *ptr0 = pair[1];
+            return d;
+          }
+        }
+      }
+      if (pb[len] < cur[len])
+      {
+        *ptr1 = curMatch;
+        curMatch = pair[1];
+        ptr1 = pair + 1;
+        len1 = len;
+      }
+      else
+      {
+        *ptr0 = curMatch;
+        curMatch = pair[0];
+        ptr0 = pair;
+        len0 = len;
+      }
+    }
+  }
+  while(--cutValue && cmCheck < curMatch);
+
+  *ptr0 = *ptr1 = 0; // kEmptyHashValue
+  return d;
+}
+
+
+// it processes all positions of current round that belong to thread (index)
+
+static void BtPart_Process(CMatchFinderMt *p, unsigned index)
+{
+  const UInt32 num = p->btPartRoundNum;
+  const UInt32 cyclicBufferPos = p->btPartRound_CyclicBufferPos;
+  const Byte *owners = p->btPartOwners + cyclicBufferPos;
+  const UInt32 *heads = p->btPartRound_Heads;
+  const Byte *cur = p->btPartRound_Buffer;
+  const UInt32 pos = p->btPartRound_Pos;
+  UInt32 *d = p->btParts[index].buf;
+  UInt32 i;
+
+  for (i = 0; i < num; i++)
+  {
+    if (owners[i] == index)
+    {
+      UInt32 *d2 = Bt_GetMatches_Part(p->btPartRound_LenLimit, pos + i - heads[i], pos + i, cur + i, p->son,
+          cyclicBufferPos + i, p->cyclicBufferSize, p->btPartWindow, p->cutValue,
+          d + 1, p->numHashBytes - 1);
+      *d = (UInt32)(d2 - d) - 1;
+      d = d2;
+    }
+  }
+}
+
+
+static THREAD_FUNC_DECL BtPartThreadFunc2(void *pp)
+{
+  CMtBtPart *part = (CMtBtPart *)pp;
+  CMatchFinderMt *p = part->mt;
+  for (;;)
+  {
+    Event_Wait(&part->canStart);
+    if (p->btPartExit)
+      return 0;
+    BtPart_Process(p, part->index);
+    Semaphore_Release1(&p->btPartDone);
+  }
+}
+
+
+/* BtPart_Round() selects owners for up to (size) next positions and
+   processes these positions in all threads.
+   It returns the number of processed positions. */
+
+static UInt32 BtPart_Round(CMatchFinderMt *p, UInt32 size, UInt32 lenLimit)
+{
+  UInt32 counts[kMtBtPartThreadsMax];
+  const UInt32 numParts = p->btPartNum;
+  // the limit for the number of positions per thread, so match lists fit to thread's buffer
+  const UInt32 maxPerPart = kMtBtPartBufSize / (p->matchMaxLen * 2 + 1);
+  const UInt32 *heads = p->hashBuf + p->hashBufPos;
+  const UInt32 cyclicBufferPos = p->cyclicBufferPos;
+  Byte *owners = p->btPartOwners;
+  UInt32 i, k, numActive;
+
+  for (k = 0; k < numParts; k++)
+    counts[k] = 0;
+  if (size > kMtBtPartRoundMax)
+    size = kMtBtPartRoundMax;
+
+  for (i = 0; i < size; i++)
+  {
+    const UInt32 delta = heads[i];
+    UInt32 owner;
+    // it's same check as (cmCheck < curMatch) in Bt_GetMatches_Part()
+    if (delta < p->pos + i && delta < p->btPartWindow)
+    {
+      const UInt32 c = cyclicBufferPos + i;
+      owner = owners[c >= delta ? c - delta : c - delta + p->cyclicBufferSize];
+    }
+    else
+    {
+      owner = p->btPartNextOwner;
+      if (++p->btPartNextOwner == numParts)
+        p->btPartNextOwner = 0;
+    }
+    if (counts[owner] == maxPerPart)
+      break;
+    counts[owner]++;
+    owners[cyclicBufferPos + i] = (Byte)owner;
+  }
+
+  p->btPartRoundNum = i;
+  p->btPartMergeIndex = 0;
+  p->btPartRound_Buffer = p->buffer;
+  p->btPartRound_Heads = heads;
+  p->btPartRound_Pos = p->pos;
+  p->btPartRound_CyclicBufferPos = cyclicBufferPos;
+  p->btPartRound_LenLimit = lenLimit;
+
+  numActive = 0;
+  for (k = 1; k < numParts; k++)
+    if (counts[k] != 0)
+    {
+      numActive++;
+      Event_Set(&p->btParts[k].canStart);
+    }
+  if (counts[0] != 0)
+    BtPart_Process(p, 0);
+  for (; numActive != 0; numActive--)
+    Semaphore_Wait(&p->btPartDone);
+
+  for (k = 0; k < numParts; k++)
+    p->btParts[k].bufPos = p->btParts[k].buf;
+  return i;
+}
+
+
+/* BtGetMatches_Part() is BtGetMatches() for partitioned mode.
+   The match lists of last round can be merged to several BT blocks. */
+
+static void BtGetMatches_Part(CMatchFinderMt *p, UInt32 *d)
+{
+  UInt32 numMerged = 0;
+  UInt32 curPos = 2;
+  const UInt32 limit = kMtBtBlockSize - (p->matchMaxLen * 2);
+
+  {
+    // the positions of last round that were not merged are available too
+    UInt32 availSum = p->hashNumAvail + (p->btPartRoundNum - p->btPartMergeIndex);
+    if (availSum < p->hashNumAvail)
+      availSum = (UInt32)(Int32)-1;
+    d[1] = availSum;
+  }
+
+  if (p->failure_BT)
+  {
+    d[0] = 0;
+    return;
+  }
+  
+  while (curPos < limit)
+  {
+    if (p->btPartMergeIndex != p->btPartRoundNum)
+    {
+      CMtBtPart *part = &p->btParts[p->btPartOwners[p->btPartRound_CyclicBufferPos + p->btPartMergeIndex]];
+      const UInt32 *src = part->bufPos;
+      UInt32 *dest = d + curPos;
+      UInt32 num = *src + 1;
+      part->bufPos = src + num;
+      p->btPartMergeIndex++;
+      numMerged++;
+      curPos += num;
+      do
+        *dest++ = *src++;
+      while (--num);
+      continue;
+    }
+
+    if (p->hashBufPos == p->hashBufPosLimit)
+    {
+      UInt32 avail;
+      {
+        const UInt32 bi = MtSync_GetNextBlock(&p->hashSync);
+        const UInt32 k = GET_HASH_BLOCK_OFFSET(bi);
+        const UInt32 *h = p->hashBuf + k;
+        avail = h[1];
+        p->hashBufPosLimit = k + h[0];
+        p->hashNumAvail = avail;
+        p->hashBufPos = k + 2;
+      }
+
+      {
+        UInt32 availSum = numMerged + avail;
+        if (availSum < numMerged)
+          availSum = (UInt32)(Int32)-1;
+        d[1] = availSum;
+      }
+
+      if (avail >= p->numHashBytes)
+        continue;
+
+      // stream was finished. See BtGetMatches()
+      p->hashNumAvail = 0;
+      d[0] = curPos + avail;
+      d += curPos;
+      for (; avail != 0; avail--)
+        *d++ = 0;
+      return;
+    }
+    {
+      UInt32 size = p->hashBufPosLimit - p->hashBufPos;
+      UInt32 lenLimit = p->matchMaxLen;
+      if (lenLimit >= p->hashNumAvail)
+        lenLimit = p->hashNumAvail;
+      {
+        UInt32 size2 = p->hashNumAvail - lenLimit + 1;
+        if (size2 < size)
+          size = size2;
+        size2 = p->cyclicBufferSize - p->cyclicBufferPos;
+        if (size2 < size)
+          size = size2;
+      }
+      
+      if (p->pos > (UInt32)kMtMaxValForNormalize - size)
+      {
+        const UInt32 subValue = (p->pos - p->cyclicBufferSize);
+        p->pos -= subValue;
+        MatchFinder_Normalize3(subValue, p->son, (size_t)p->cyclicBufferSize * 2);
+      }
+
+      size = BtPart_Round(p, size, lenLimit);
+      
+      p->hashBufPos += size;
+      p->hashNumAvail -= size;
+      p->pos += size;
+      p->buffer += size;
+      p->cyclicBufferPos += size;
+      if (p->cyclicBufferPos == p->cyclicBufferSize)
+        p->cyclicBufferPos = 0;
+    }
+  }
+  
+  d[0] = curPos;
+}
+
+
+static void MtBtParts_Free(CMatchFinderMt *p, ISzAllocPtr alloc)
+{
+  if (p->btParts)
+  {
+    UInt32 k;
+    p->btPartExit = True;
+    for (k = 0; k < p->btPartNum; k++)
+    {
+      CMtBtPart *part = &p->btParts[k];
+      if (PoolThread_WasCreated(&part->thread))
+      {
+        Event_Set(&part->canStart);
+        PoolThread_Wait_Close(&part->thread);
+      }
+      Event_Close(&part->canStart);
+      ISzAlloc_Free(alloc, part->buf);
+    }
+    ISzAlloc_Free(alloc, p->btParts);
+    p->btParts = NULL;
+  }
+  Semaphore_Close(&p->btPartDone);
+  ISzAlloc_Free(alloc, p->btPartOwners);
+  p->btPartOwners = NULL;
+  p->btPartOwnersSize = 0;
+  p->btPartNum = 0;
+}
+
+
+#define RINOK_THREAD_SRES(x) { const WRes wres_ = (x); if (wres_ != 0) return MY_SRes_HRESULT_FROM_WRes(wres_); }
+
+static SRes MtBtParts_Alloc(CMatchFinderMt *p, UInt32 numParts, ISzAllocPtr alloc)
+{
+  const UInt32 cyclicBufferSize = MF(p)->cyclicBufferSize;
+  UInt32 k;
+
+  p->btPartOwners = (Byte *)ISzAlloc_Alloc(alloc, cyclicBufferSize);
+  if (!p->btPartOwners)
+    return SZ_ERROR_MEM;
+  p->btPartOwnersSize = cyclicBufferSize;
+  p->btParts = (CMtBtPart *)ISzAlloc_Alloc(alloc, numParts * sizeof(CMtBtPart));
+  if (!p->btParts)
+    return SZ_ERROR_MEM;
+  p->btPartNum = numParts;
+  p->btPartExit = False;
+  for (k = 0; k < numParts; k++)
+  {
+    CMtBtPart *part = &p->btParts[k];
+    PoolThread_CONSTRUCT(&part->thread)
+    Event_Construct(&part->canStart);
+    part->mt = p;
+    part->index = (unsigned)k;
+    part->buf = NULL;
+  }
+  RINOK_THREAD_SRES(Semaphore_Create(&p->btPartDone, 0, numParts))
+  for (k = 0; k < numParts; k++)
+  {
+    CMtBtPart *part = &p->btParts[k];
+    part->buf = (UInt32 *)ISzAlloc_Alloc(alloc, (size_t)kMtBtPartBufSize * sizeof(UInt32));
+    if (!part->buf)
+      return SZ_ERROR_MEM;
+    part->bufPos = part->buf;
+    // BT thread itself processes the positions of part 0
+    if (k == 0)
+      continue;
+    RINOK_THREAD_SRES(AutoResetEvent_CreateNotSignaled(&part->canStart))
+    RINOK_THREAD_SRES(PoolThread_Create(&part->thread, BtPartThreadFunc2, part))
+  }
+  return SZ_OK;
+}
+
+
+static SRes MtBtParts_Create(CMatchFinderMt *p, ISzAllocPtr alloc)
+{
+  SRes res;
+  UInt32 numParts = p->numBtThreads;
+  if (numParts > kMtBtPartThreadsMax)
+    numParts = kMtBtPartThreadsMax;
+  if (numParts < 2 || p->historySize < kMtBtPart_HistorySizeMin)
+    numParts = 0;
+  if (numParts == p->btPartNum
+      && (numParts == 0 || p->btPartOwnersSize == MF(p)->cyclicBufferSize))
+    return SZ_OK;
+  MtBtParts_Free(p, alloc);
+  if (numParts == 0)
+    return SZ_OK;
+  res = MtBtParts_Alloc(p, numParts, alloc);
+  if (res != SZ_OK)
+    MtBtParts_Free(p, alloc);
+  return res;
+}
+
+
 static void BtFillBlock(CMatchFinderMt *p, UInt32 globalBlockIndex)
 {
   CMtSync *sync = &p->hashSync;
@@ -748,7 +1145,10 @@ static void BtFillBlock(CMatchFinderMt *p, UInt32 globalBlockIndex)
     LOCK_BUFFER(sync)
   }
   
-  BtGetMatches(p, p->btBuf + GET_BT_BLOCK_OFFSET(globalBlockIndex));
+  if (p->btPartNum != 0)
+    BtGetMatches_Part(p, p->btBuf + GET_BT_BLOCK_OFFSET(globalBlockIndex));
+  else
+    BtGetMatches(p, p->btBuf + GET_BT_BLOCK_OFFSET(globalBlockIndex));
   
   /* We suppose that we have called GetNextBlock() from start.
      So buffer is LOCKED */
@@ -799,6 +1199,12 @@ void MatchFinderMt_Construct(CMatchFinderMt *p)
   p->hashBuf = NULL;
   MtSync_Construct(&p->hashSync);
   MtSync_Construct(&p->btSync);
+  p->numBtThreads = 1;
+  p->btPartNum = 0;
+  p->btPartOwnersSize = 0;
+  p->btPartOwners = NULL;
+  p->btParts = NULL;
+  Semaphore_Construct(&p->btPartDone);
 }
 
 static void MatchFinderMt_FreeMem(CMatchFinderMt *p, ISzAllocPtr alloc)
@@ -823,6 +1229,7 @@ void MatchFinderMt_Destruct(CMatchFinderMt *p, ISzAllocPtr alloc)
 
   MtSync_Destruct(&p->btSync);
   MtSync_Destruct(&p->hashSync);
+  MtBtParts_Free(p, alloc);
 
   LOG_ITER(
   printf("\nTree %9d * %7d iter = %9d = sum  :  bytes = %9d\n",
@@ -872,6 +1279,7 @@ SRes MatchFinderMt_Create(CMatchFinderMt *p, UInt32 historySize, UInt32 keepAddB
   if (!MatchFinder_Create(mf, historySize, keepAddBufferBefore, matchMaxLen, keepAddBufferAfter, alloc))
     return SZ_ERROR_MEM;
 
+  RINOK(MtBtParts_Create(p, alloc))
   RINOK(MtSync_Create(&p->hashSync, HashThreadFunc2, p))
   RINOK(MtSync_Create(&p->btSync, BtThreadFunc2, p))
   return SZ_OK;
@@ -936,6 +1344,10 @@ static void MatchFinderMt_Init(void *_p)
   p->cyclicBufferSize = mf->cyclicBufferSize;
   p->buffer = mf->buffer;
   p->cutValue = mf->cutValue;
+  p->btPartWindow = p->cyclicBufferSize - kMtBtPartRoundMax;
+  p->btPartNextOwner = 0;
+  p->btPartRoundNum = 0;
+  p->btPartMergeIndex = 0;
   // p->son[0] = p->son[1] = 0; // unused: to init skipped record for speculated accesses.
 }
 
@@ -1415,6 +1827,7 @@ void MatchFinderMt_CreateVTable(CMatchFinderMt *p, IMatchFinder2 *vTable)
 }
 
 #undef RINOK_THREAD
+#undef RINOK_THREAD_SRES
 #undef PRF
 #undef MF
 #undef GetUi24hi_from32
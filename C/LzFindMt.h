@@ -15,7 +15,7 @@ typedef struct
   Int32 affinityGroup;
   UInt64 affinityInGroup;
   UInt64 affinity;
-  CThread thread;
+  CPoolThread thread;
 
   BoolInt wasCreated;
   BoolInt needStart;
@@ -36,6 +36,25 @@ typedef struct
 
 struct CMatchFinderMt_;
 
+/* Partitioned BT mode:
+   BT thread and additional (numBtThreads - 1) worker threads search matches
+   for different positions of one hash block in parallel.
+   Binary trees for different hash values don't share nodes,
+   so each thread processes all positions of some set of trees.
+   BT thread then merges the match lists of all threads in position order. */
+
+#define kMtBtPartThreadsMax 64
+
+typedef struct
+{
+  CPoolThread thread;
+  CAutoResetEvent canStart;
+  UInt32 *buf;         // match lists of positions processed by this thread in current round
+  const UInt32 *bufPos;  // read position in (buf) for merging
+  struct CMatchFinderMt_ *mt;
+  unsigned index;
+} CMtBtPart;
+
 typedef UInt32 * (*Mf_Mix_Matches)(struct CMatchFinderMt_ *p, UInt32 matchMinPos, UInt32 *distances);
 
 /* kMtCacheLineDummy must be >= size_of_CPU_cache_line */
@@ -87,6 +106,25 @@ typedef struct CMatchFinderMt_
   UInt32 cyclicBufferSize; /* it must be = (historySize + 1) */
   UInt32 cutValue;
 
+  /* BT partitioned mode */
+  UInt32 numBtThreads;    /* caller sets it before MatchFinderMt_Create(). (numBtThreads > 1) enables partitioned mode */
+  UInt32 btPartNum;       /* number of threads in partitioned mode, including BT thread. (0) means normal mode */
+  UInt32 btPartWindow;    /* max match distance + 1. It's smaller than (cyclicBufferSize) by max round size */
+  UInt32 btPartOwnersSize;
+  UInt32 btPartNextOwner; /* the owner for next new tree */
+  UInt32 btPartRoundNum;  /* the number of positions in current round */
+  UInt32 btPartMergeIndex;
+  Byte *btPartOwners;     /* owner thread for each position in cyclic buffer */
+  CMtBtPart *btParts;
+  CSemaphore btPartDone;
+  BoolInt btPartExit;
+  /* current round parameters for worker threads */
+  const Byte *btPartRound_Buffer;
+  const UInt32 *btPartRound_Heads;
+  UInt32 btPartRound_Pos;
+  UInt32 btPartRound_CyclicBufferPos;
+  UInt32 btPartRound_LenLimit;
+
   /* BT + Hash */
   CMtSync hashSync;
   /* Byte hashDummy[kMtCacheLineDummy]; */
@@ -93,6 +93,16 @@ void Lzma2Dec_Init(CLzma2Dec *p)
   LzmaDec_Init(&p->decoder);
 }
 
+SRes Lzma2Dec_InitWithPresetDict(CLzma2Dec *p, const Byte *dict, SizeT size)
+{
+  Lzma2Dec_Init(p);
+  if (size == 0)
+    return SZ_OK;
+  RINOK(LzmaDec_InitWithPresetDict(&p->decoder, dict, size))
+  p->needInitLevel = 0xC0;
+  return SZ_OK;
+}
+
 // ELzma2State
 static unsigned Lzma2Dec_UpdateState(CLzma2Dec *p, Byte b)
 {
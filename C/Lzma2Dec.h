@@ -31,6 +31,11 @@ SRes Lzma2Dec_AllocateProbs(CLzma2Dec *p, Byte prop, ISzAllocPtr alloc);
 SRes Lzma2Dec_Allocate(CLzma2Dec *p, Byte prop, ISzAllocPtr alloc);
 void Lzma2Dec_Init(CLzma2Dec *p);
 
+/* Lzma2Dec_InitWithPresetDict() is similar to Lzma2Dec_Init(),
+   but the dictionary is prefilled with (size) bytes of preset data,
+   and first chunk of stream is allowed to use it without dictionary reset. */
+SRes Lzma2Dec_InitWithPresetDict(CLzma2Dec *p, const Byte *dict, SizeT size);
+
 /*
 finishMode:
   It has meaning only if the decoding reaches output limit (*destLen or dicLimit).
@@ -105,6 +105,8 @@ struct CLzma2DecMt
 
   Byte *inBuf;
   size_t inBufSize;
+  const Byte *presetDict;
+  size_t presetDictSize;
   Byte dec_created;
   CLzma2Dec dec;
 
@@ -137,6 +139,8 @@ CLzma2DecMtHandle Lzma2DecMt_Create(ISzAllocPtr alloc, ISzAllocPtr allocMid)
 
   p->inBuf = NULL;
   p->inBufSize = 0;
+  p->presetDict = NULL;
+  p->presetDictSize = 0;
   p->dec_created = False;
 
   // Lzma2DecMtProps_Init(&p->props);
@@ -628,9 +632,7 @@ static SRes Lzma2Dec_Prepare_ST(CLzma2DecMt *p)
     p->inBufSize = p->props.inBufSize_ST;
   }
 
-  Lzma2Dec_Init(&p->dec);
-  
-  return SZ_OK;
+  return Lzma2Dec_InitWithPresetDict(&p->dec, p->presetDict, p->presetDictSize);
 }
 
 
@@ -858,7 +860,8 @@ SRes Lzma2DecMt_Decode(CLzma2DecMtHandle p,
   // p->mtc.allocError_for_Read_BlockIndex = 0;
   // p->mtc.isAllocError = False;
 
-  if (p->props.numThreads > 1)
+  /* the chunks of stream with preset dictionary depend on previous data */
+  if (p->props.numThreads > 1 && p->presetDictSize == 0)
   {
     IMtDecCallback2 vt;
 
@@ -981,6 +984,14 @@ SRes Lzma2DecMt_Decode(CLzma2DecMtHandle p,
 
 /* ---------- Read from CLzma2DecMtHandle Interface ---------- */
 
+void Lzma2DecMt_SetPresetDict(CLzma2DecMtHandle p, const Byte *dict, size_t size)
+{
+  // GET_CLzma2DecMt_p
+  p->presetDict = dict;
+  p->presetDictSize = dict ? size : 0;
+}
+
+
 SRes Lzma2DecMt_Init(CLzma2DecMtHandle p,
     Byte prop,
     const CLzma2DecMtProps *props,
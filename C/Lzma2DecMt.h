@@ -63,6 +63,13 @@ SRes Lzma2DecMt_Decode(CLzma2DecMtHandle p,
     ICompressProgressPtr progress);
 
 
+/* Lzma2DecMt_SetPresetDict() sets preset dictionary for next decoding calls.
+   The stream with preset dictionary is decoded in single thread.
+   (dict) buffer must be available until the end of decoding.
+   (dict == NULL) disables preset dictionary. */
+void Lzma2DecMt_SetPresetDict(CLzma2DecMtHandle p, const Byte *dict, size_t size);
+
+
 /* ---------- Read from CLzma2DecMtHandle Interface ---------- */
 
 SRes Lzma2DecMt_Init(CLzma2DecMtHandle pp,
@@ -83,6 +83,7 @@ typedef struct
   CLzmaEncHandle enc;
   Byte propsAreSet;
   Byte propsByte;
+  Byte needInitDic;
   Byte needInitState;
   Byte needInitProp;
   UInt64 srcPos;
@@ -106,6 +107,7 @@ static SRes Lzma2EncInt_InitStream(CLzma2EncInt *p, const CLzma2EncProps *props)
 static void Lzma2EncInt_InitBlock(CLzma2EncInt *p)
 {
   p->srcPos = 0;
+  p->needInitDic = True;
   p->needInitState = True;
   p->needInitProp = True;
 }
@@ -115,6 +117,8 @@ SRes LzmaEnc_PrepareForLzma2(CLzmaEncHandle p, ISeqInStreamPtr inStream, UInt32
     ISzAllocPtr alloc, ISzAllocPtr allocBig);
 SRes LzmaEnc_MemPrepare(CLzmaEncHandle p, const Byte *src, SizeT srcLen,
     UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig);
+SRes LzmaEnc_MemPrepare_WithPrefix(CLzmaEncHandle p, const Byte *src, SizeT srcLen, SizeT prefixSize,
+    UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig);
 SRes LzmaEnc_CodeOneMemBlock(CLzmaEncHandle p, BoolInt reInit,
     Byte *dest, size_t *destLen, UInt32 desiredPackSize, UInt32 *unpackSize);
 const Byte *LzmaEnc_GetCurBuf(CLzmaEncHandle p);
@@ -170,13 +174,14 @@ static SRes Lzma2EncInt_EncodeSubblock(CLzma2EncInt *p, Byte *outBuf,
       const UInt32 u = (unpackSize < LZMA2_COPY_CHUNK_SIZE) ? unpackSize : LZMA2_COPY_CHUNK_SIZE;
       if (packSizeLimit - destPos < u + 3)
         return SZ_ERROR_OUTPUT_EOF;
-      outBuf[destPos++] = (Byte)(p->srcPos == 0 ? LZMA2_CONTROL_COPY_RESET_DIC : LZMA2_CONTROL_COPY_NO_RESET);
+      outBuf[destPos++] = (Byte)(p->needInitDic ? LZMA2_CONTROL_COPY_RESET_DIC : LZMA2_CONTROL_COPY_NO_RESET);
       outBuf[destPos++] = (Byte)((u - 1) >> 8);
       outBuf[destPos++] = (Byte)(u - 1);
       memcpy(outBuf + destPos, LzmaEnc_GetCurBuf(p->enc) - unpackSize, u);
       unpackSize -= u;
       destPos += u;
       p->srcPos += u;
+      p->needInitDic = False;
       
       if (outStream)
       {
@@ -198,7 +203,7 @@ static SRes Lzma2EncInt_EncodeSubblock(CLzma2EncInt *p, Byte *outBuf,
     size_t destPos = 0;
     const UInt32 u = unpackSize - 1;
     const UInt32 pm = (UInt32)(packSize - 1);
-    const unsigned mode = (p->srcPos == 0) ? 3 : (p->needInitState ? (p->needInitProp ? 2 : 1) : 0);
+    const unsigned mode = p->needInitDic ? 3 : (p->needInitState ? (p->needInitProp ? 2 : 1) : 0);
 
     PRF(printf("               "));
 
@@ -211,6 +216,7 @@ static SRes Lzma2EncInt_EncodeSubblock(CLzma2EncInt *p, Byte *outBuf,
     if (p->needInitProp)
       outBuf[destPos++] = p->propsByte;
     
+    p->needInitDic = False;
     p->needInitProp = False;
     p->needInitState = False;
     destPos += packSize;
@@ -232,6 +238,7 @@ void Lzma2EncProps_Init(CLzma2EncProps *p)
 {
   LzmaEncProps_Init(&p->lzmaProps);
   p->blockSize = LZMA2_ENC_PROPS_BLOCK_SIZE_AUTO;
+  p->blockPrefixSize = 0;
   p->numBlockThreads_Reduced = -1;
   p->numBlockThreads_Max = -1;
   p->numTotalThreads = -1;
@@ -339,6 +346,25 @@ void Lzma2EncProps_Normalize(CLzma2EncProps *p)
     }
   }
   
+  if (p->blockPrefixSize != 0)
+  {
+    /* the position of block in stream and the size of prefix
+       must be aligned for (1 << pb) and (1 << lp),
+       because the LZMA encoder and decoder use low bits of position */
+    const UInt32 kPrefixAlign = (UInt32)1 << 4;
+    if (p->blockSize == LZMA2_ENC_PROPS_BLOCK_SIZE_SOLID
+        || (p->blockSize & (kPrefixAlign - 1)) != 0)
+      p->blockPrefixSize = 0;
+    else
+    {
+      if (p->blockPrefixSize > p->lzmaProps.dictSize)
+        p->blockPrefixSize = p->lzmaProps.dictSize;
+      if (p->blockPrefixSize > p->blockSize)
+        p->blockPrefixSize = (UInt32)p->blockSize;
+      p->blockPrefixSize &= ~(kPrefixAlign - 1);
+    }
+  }
+
   p->numBlockThreads_Max = t2;
   p->numBlockThreads_Reduced = t2r;
   p->numTotalThreads = t3;
@@ -358,6 +384,9 @@ struct CLzma2Enc
   Byte propEncoded;
   CLzma2EncProps props;
   UInt64 expectedDataSize;
+  const Byte *presetDict;
+  UInt32 presetDictSize;
+  BoolInt priceStat_TimeMode;
   
   Byte *tempBufLzma;
 
@@ -391,6 +420,9 @@ CLzma2EncHandle Lzma2Enc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig)
   Lzma2EncProps_Init(&p->props);
   Lzma2EncProps_Normalize(&p->props);
   p->expectedDataSize = (UInt64)(Int64)-1;
+  p->presetDict = NULL;
+  p->presetDictSize = 0;
+  p->priceStat_TimeMode = False;
   p->tempBufLzma = NULL;
   p->alloc = alloc;
   p->allocBig = allocBig;
@@ -483,11 +515,58 @@ void Lzma2Enc_SetDataSize(CLzma2EncHandle p, UInt64 expectedDataSiize)
 }
 
 
+SRes Lzma2Enc_SetPresetDict(CLzma2EncHandle p, const Byte *dict, UInt32 size)
+{
+  // GET_CLzma2Enc_p
+  if (size > ((UInt32)1 << 30))
+    return SZ_ERROR_PARAM;
+  p->presetDict = dict;
+  p->presetDictSize = dict ? size : 0;
+  return SZ_OK;
+}
+
+
+void Lzma2Enc_SetPriceStatTimeMode(CLzma2EncHandle p, BoolInt timeMode)
+{
+  // GET_CLzma2Enc_p
+  unsigned i;
+  p->priceStat_TimeMode = timeMode;
+  for (i = 0; i < MTCODER_THREADS_MAX; i++)
+    if (p->coders[i].enc)
+      LzmaEnc_SetPriceStatTimeMode(p->coders[i].enc, timeMode);
+}
+
+
+void Lzma2Enc_GetPriceStat(CLzma2EncHandle p, CLzmaEncPriceStat *stat)
+{
+  // GET_CLzma2Enc_p
+  unsigned i;
+  memset(stat, 0, sizeof(*stat));
+  for (i = 0; i < MTCODER_THREADS_MAX; i++)
+  {
+    CLzmaEncPriceStat s;
+    if (!p->coders[i].enc)
+      continue;
+    LzmaEnc_GetPriceStat(p->coders[i].enc, &s);
+    stat->NumFull    += s.NumFull;
+    stat->NumRefresh += s.NumRefresh;
+    stat->NumRepLen  += s.NumRepLen;
+    stat->NumReused  += s.NumReused;
+    stat->Time       += s.Time;
+  }
+}
+
+
 Byte Lzma2Enc_WriteProperties(CLzma2EncHandle p)
 {
   // GET_CLzma2Enc_p
   unsigned i;
   UInt32 dicSize = LzmaEncProps_GetDictSize(&p->props.lzmaProps);
+  {
+    /* the dictionary of first block contains preset dictionary */
+    const UInt32 v = dicSize + p->presetDictSize;
+    dicSize = (v < dicSize) ? (UInt32)0xFFFFFFFF : v;
+  }
   for (i = 0; i < 40; i++)
     if (dicSize <= LZMA2_DIC_SIZE_FROM_PROP(i))
       break;
@@ -501,7 +580,7 @@ static SRes Lzma2Enc_EncodeMt1(
     ISeqOutStreamPtr outStream,
     Byte *outBuf, size_t *outBufSize,
     ISeqInStreamPtr inStream,
-    const Byte *inData, size_t inDataSize,
+    const Byte *inData, size_t inDataSize, size_t inDataPrefixSize,
     int finished,
     ICompressProgressPtr progress)
 {
@@ -522,6 +601,7 @@ static SRes Lzma2Enc_EncodeMt1(
     p->enc = LzmaEnc_Create(me->alloc);
     if (!p->enc)
       return SZ_ERROR_MEM;
+    LzmaEnc_SetPriceStatTimeMode(p->enc, me->priceStat_TimeMode);
   }
 
   limitedInStream.realStream = inStream;
@@ -566,6 +646,15 @@ static SRes Lzma2Enc_EncodeMt1(
 
       LzmaEnc_SetDataSize(p->enc, expected);
 
+      /* only first block starts with preset dictionary instead of dictionary reset */
+      if (unpackTotal == 0 && me->presetDictSize != 0)
+      {
+        RINOK(LzmaEnc_SetPresetDict(p->enc, me->presetDict, me->presetDictSize))
+        p->needInitDic = False;
+      }
+      else
+        LzmaEnc_SetPresetDict(p->enc, NULL, 0);
+
       RINOK(LzmaEnc_PrepareForLzma2(p->enc,
           &limitedInStream.vt,
           LZMA2_KEEP_WINDOW_SIZE,
@@ -581,11 +670,24 @@ static SRes Lzma2Enc_EncodeMt1(
     
       // LzmaEnc_SetDataSize(p->enc, inSizeCur);
       
-      RINOK(LzmaEnc_MemPrepare(p->enc,
-          inData + (size_t)unpackTotal, inSizeCur,
-          LZMA2_KEEP_WINDOW_SIZE,
-          me->alloc,
-          me->allocBig))
+      {
+        /* (inDataPrefixSize) bytes of preceding data are available before (inData).
+           We use preceding data as dictionary, if (blockPrefixSize) mode is enabled */
+        size_t prefix = 0;
+        if (me->props.blockPrefixSize != 0 && inSizeCur != 0)
+        {
+          prefix = inDataPrefixSize + (size_t)unpackTotal;
+          if (prefix > me->props.blockPrefixSize)
+            prefix = me->props.blockPrefixSize;
+          if (prefix != 0)
+            p->needInitDic = False;
+        }
+        RINOK(LzmaEnc_MemPrepare_WithPrefix(p->enc,
+            inData + (size_t)unpackTotal - prefix, prefix + inSizeCur, prefix,
+            LZMA2_KEEP_WINDOW_SIZE,
+            me->alloc,
+            me->allocBig))
+      }
     }
 
     for (;;)
@@ -683,7 +785,7 @@ static SRes Lzma2Enc_MtCallback_Code(void *p, unsigned coderIndex, unsigned outB
   res = Lzma2Enc_EncodeMt1(me,
       &me->coders[coderIndex],
       NULL, dest, &destSize,
-      NULL, src, srcSize,
+      NULL, src, srcSize, me->mtCoder.threads[coderIndex].inPrefixSize,
       finished,
       &progressThunk.vt);
 
@@ -729,6 +831,9 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
   if (outStream && outBuf)
     return SZ_ERROR_PARAM;
 
+  if (p->presetDictSize != 0 && !inStream)
+    return SZ_ERROR_UNSUPPORTED;
+
   {
     unsigned i;
     for (i = 0; i < MTCODER_THREADS_MAX; i++)
@@ -737,7 +842,9 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
 
   #ifndef Z7_ST
   
-  if (p->props.numBlockThreads_Reduced > 1)
+  /* the stream with preset dictionary is encoded in single block thread,
+     because only first block can use preset dictionary */
+  if (p->props.numBlockThreads_Reduced > 1 && p->presetDictSize == 0)
   {
     IMtCoderCallback2 vt;
 
@@ -771,6 +878,7 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
     p->mtCoder.blockSize = (size_t)p->props.blockSize;
     if (p->mtCoder.blockSize != p->props.blockSize)
       return SZ_ERROR_PARAM; /* SZ_ERROR_MEM */
+    p->mtCoder.blockPrefixSize = p->props.blockPrefixSize;
 
     {
       const size_t destBlockSize = p->mtCoder.blockSize + (p->mtCoder.blockSize >> 10) + 16;
@@ -799,7 +907,7 @@ SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
   return Lzma2Enc_EncodeMt1(p,
       &p->coders[0],
       outStream, outBuf, outBufSize,
-      inStream, inData, inDataSize,
+      inStream, inData, inDataSize, 0,
       True, /* finished */
       progress);
 }
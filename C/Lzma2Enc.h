@@ -15,6 +15,11 @@ typedef struct
 {
   CLzmaEncProps lzmaProps;
   UInt64 blockSize;
+  UInt32 blockPrefixSize; /* 0 : (default) each block starts with dictionary reset.
+                             Another value : each block encoder is seeded with up to (blockPrefixSize)
+                             bytes of preceding data, and block doesn't reset dictionary.
+                             It improves compression ratio in multi-block mode,
+                             but such stream can be decoded only in single thread. */
   int numBlockThreads_Reduced;
   int numBlockThreads_Max;
   int numTotalThreads;
@@ -45,6 +50,19 @@ CLzma2EncHandle Lzma2Enc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig);
 void Lzma2Enc_Destroy(CLzma2EncHandle p);
 SRes Lzma2Enc_SetProps(CLzma2EncHandle p, const CLzma2EncProps *props);
 void Lzma2Enc_SetDataSize(CLzma2EncHandle p, UInt64 expectedDataSiize);
+
+/* Lzma2Enc_SetPresetDict() sets preset dictionary that precedes the data of stream.
+   It's supported only for stream input in single block thread mode.
+   First block of stream starts without dictionary reset, and its encoder
+   uses preset dictionary (LzmaEnc_SetPresetDict()).
+   Lzma2Enc_WriteProperties() includes the size of preset dictionary to dictionary size.
+   (dict) buffer must be available until the end of encoding. */
+SRes Lzma2Enc_SetPresetDict(CLzma2EncHandle p, const Byte *dict, UInt32 size);
+
+/* the sum of price table counters of all LZMA encoders (see LzmaEnc_GetPriceStat()) */
+void Lzma2Enc_SetPriceStatTimeMode(CLzma2EncHandle p, BoolInt timeMode);
+void Lzma2Enc_GetPriceStat(CLzma2EncHandle p, CLzmaEncPriceStat *stat);
+
 Byte Lzma2Enc_WriteProperties(CLzma2EncHandle p);
 SRes Lzma2Enc_Encode2(CLzma2EncHandle p,
     ISeqOutStreamPtr outStream,
@@ -925,6 +925,21 @@ void LzmaDec_Init(CLzmaDec *p)
   LzmaDec_InitDicAndState(p, True, True);
 }
 
+SRes LzmaDec_InitWithPresetDict(CLzmaDec *p, const Byte *dict, SizeT size)
+{
+  LzmaDec_Init(p);
+  if (size == 0)
+    return SZ_OK;
+  if (size > p->prop.dicSize || size >= p->dicBufSize)
+    return SZ_ERROR_UNSUPPORTED;
+  memcpy(p->dic, dict, size);
+  p->dicPos = size;
+  p->processedPos = (UInt32)size;
+  if (size == p->prop.dicSize)
+    p->checkDicSize = p->prop.dicSize;
+  return SZ_OK;
+}
+
 
 /*
 LZMA supports optional end_marker.
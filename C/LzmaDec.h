@@ -78,6 +78,14 @@ typedef struct
 
 void LzmaDec_Init(CLzmaDec *p);
 
+/* LzmaDec_InitWithPresetDict() is similar to LzmaDec_Init(),
+   but it prefills the dictionary with (size) bytes of preset data that precede the stream.
+   The decoder must be allocated with LzmaDec_Allocate(), and (size) must be smaller than dictionary.
+   Returns:
+     SZ_OK
+     SZ_ERROR_UNSUPPORTED - preset dictionary is larger than dictionary of stream */
+SRes LzmaDec_InitWithPresetDict(CLzmaDec *p, const Byte *dict, SizeT size);
+
 /* There are two types of LZMA streams:
      - Stream with end mark. That end mark adds about 6 bytes to compressed size.
      - Stream without end mark. You must know exact uncompressed size to decompress such stream. */
@@ -12,6 +12,17 @@ Igor Pavlov : Public domain */
 #include <stdio.h>
 #endif
 
+#include <time.h>
+
+/* the counters of price table updates (CLzmaEncPriceStat).
+   clock() is called only if time mode was enabled by LzmaEnc_SetPriceStatTimeMode(). */
+#define PRICE_STAT_BEGIN(p) \
+  const clock_t priceStat_Start = (p)->priceStat_TimeMode ? clock() : 0;
+#define PRICE_STAT_END(p, counter) \
+  { (p)->priceStat.counter++; \
+    if ((p)->priceStat_TimeMode) (p)->priceStat.Time += (UInt64)(clock() - priceStat_Start); }
+#define PRICE_STAT_INC(p, counter)  (p)->priceStat.counter++;
+
 #include "CpuArch.h"
 #include "LzmaEnc.h"
 
@@ -26,6 +37,8 @@ SRes LzmaEnc_PrepareForLzma2(CLzmaEncHandle p, ISeqInStreamPtr inStream, UInt32
     ISzAllocPtr alloc, ISzAllocPtr allocBig);
 SRes LzmaEnc_MemPrepare(CLzmaEncHandle p, const Byte *src, SizeT srcLen,
     UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig);
+SRes LzmaEnc_MemPrepare_WithPrefix(CLzmaEncHandle p, const Byte *src, SizeT srcLen, SizeT prefixSize,
+    UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig);
 SRes LzmaEnc_CodeOneMemBlock(CLzmaEncHandle p, BoolInt reInit,
     Byte *dest, size_t *destLen, UInt32 desiredPackSize, UInt32 *unpackSize);
 const Byte *LzmaEnc_GetCurBuf(CLzmaEncHandle p);
@@ -383,6 +396,17 @@ typedef struct
 } CSaveState;
 
 
+/* the stream returns preset dictionary data and then the data of real stream */
+
+typedef struct
+{
+  ISeqInStream vt;
+  ISeqInStreamPtr realStream;
+  const Byte *data;
+  size_t rem;
+} CLzmaEnc_PresetDictInStream;
+
+
 typedef UInt32 CProbPrice;
 
 
@@ -416,6 +440,7 @@ struct CLzmaEnc
   BoolInt finished;
   BoolInt multiThread;
   BoolInt needInit;
+  BoolInt needInitPrices;
   // BoolInt _maxMode;
 
   UInt64 nowPos64;
@@ -427,8 +452,17 @@ struct CLzmaEnc
   unsigned distTableSize;
 
   UInt32 dictSize;
+  UInt32 dictSize_Props;   /* dictSize from props without preset dictionary */
+  UInt32 prefixSize;       /* the number of bytes that were inserted to match finder without encoding */
   SRes result;
 
+  CLzmaEnc_PresetDictInStream presetStream;
+  const Byte *presetDict;
+  UInt32 presetDictSize;
+
+  BoolInt priceStat_TimeMode;
+  CLzmaEncPriceStat priceStat;
+
   #ifndef Z7_ST
   BoolInt mtMode;
   // begin of CMatchFinderMt is used in LZ thread
@@ -528,6 +562,23 @@ void LzmaEnc_RestoreState(CLzmaEncHandle p)
   // GET_CLzmaEnc_p
   const CSaveState *v = &p->saveState;
   COPY_LZMA_ENC_STATE(p, v, p)
+  // price tables were calculated for the probabilities that are discarded now
+  p->needInitPrices = True;
+}
+
+
+/* the window must contain preset dictionary and the history of (dictSize_Props) bytes */
+
+static void LzmaEnc_UpdateDictSize(CLzmaEnc *p)
+{
+  UInt64 v = (UInt64)p->dictSize_Props + p->presetDictSize;
+  if (v > kLzmaMaxHistorySize)
+    v = kLzmaMaxHistorySize;
+  #ifndef LZMA_LOG_BSR
+  if (v > ((UInt64)1 << kDicLogSizeMaxCompress))
+    v = ((UInt64)1 << kDicLogSizeMaxCompress);
+  #endif
+  p->dictSize = (UInt32)v;
 }
 
 
@@ -555,7 +606,8 @@ SRes LzmaEnc_SetProps(CLzmaEncHandle p, const CLzmaEncProps *props2)
   }
   #endif
 
-  p->dictSize = props.dictSize;
+  p->dictSize_Props = props.dictSize;
+  LzmaEnc_UpdateDictSize(p);
   {
     unsigned fb = (unsigned)props.fb;
     if (fb < 5)
@@ -598,6 +650,8 @@ SRes LzmaEnc_SetProps(CLzmaEncHandle p, const CLzmaEncProps *props2)
   }
   */
   p->multiThread = (props.numThreads > 1);
+  /* (numThreads > 2) : the hash thread and (numThreads - 1) threads in partitioned BT mode */
+  p->matchFinderMt.numBtThreads = (props.numThreads > 2 ? (UInt32)props.numThreads - 1 : 1);
   p->matchFinderMt.btSync.affinity =
   p->matchFinderMt.hashSync.affinity = props.affinity;
   p->matchFinderMt.btSync.affinityGroup =
@@ -617,6 +671,32 @@ void LzmaEnc_SetDataSize(CLzmaEncHandle p, UInt64 expectedDataSiize)
 }
 
 
+SRes LzmaEnc_SetPresetDict(CLzmaEncHandle p, const Byte *dict, UInt32 size)
+{
+  // GET_CLzmaEnc_p
+  if (size > kLzmaMaxHistorySize / 2)
+    return SZ_ERROR_PARAM;
+  p->presetDict = dict;
+  p->presetDictSize = dict ? size : 0;
+  LzmaEnc_UpdateDictSize(p);
+  return SZ_OK;
+}
+
+
+void LzmaEnc_SetPriceStatTimeMode(CLzmaEncHandle p, BoolInt timeMode)
+{
+  // GET_CLzmaEnc_p
+  p->priceStat_TimeMode = timeMode;
+}
+
+
+void LzmaEnc_GetPriceStat(CLzmaEncHandle p, CLzmaEncPriceStat *stat)
+{
+  // GET_CLzmaEnc_p
+  *stat = p->priceStat;
+}
+
+
 #define kState_Start 0
 #define kState_LitAfterMatch 4
 #define kState_LitAfterRep   5
@@ -2326,6 +2406,9 @@ Z7_NO_INLINE static void FillDistancesPrices(CLzmaEnc *p)
 
 static void LzmaEnc_Construct(CLzmaEnc *p)
 {
+  p->presetDict = NULL;
+  p->presetDictSize = 0;
+  p->prefixSize = 0;
   RangeEnc_Construct(&p->rc);
   MatchFinder_Construct(&MFB);
   
@@ -2347,6 +2430,10 @@ static void LzmaEnc_Construct(CLzmaEnc *p)
   LzmaEnc_InitPriceTables(p->ProbPrices);
   p->litProbs = NULL;
   p->saveState.litProbs = NULL;
+  p->needInitPrices = True;
+
+  p->priceStat_TimeMode = False;
+  memset(&p->priceStat, 0, sizeof(p->priceStat));
 }
 
 CLzmaEncHandle LzmaEnc_Create(ISzAllocPtr alloc)
@@ -2650,16 +2737,20 @@ static SRes LzmaEnc_CodeOneBlock(CLzmaEnc *p, UInt32 maxPackSize, UInt32 maxUnpa
         */
         if (p->matchPriceCount >= 64)
         {
+          PRICE_STAT_BEGIN(p)
           FillAlignPrices(p);
           // { int y; for (y = 0; y < 100; y++) {
           FillDistancesPrices(p);
           // }}
           LenPriceEnc_UpdateTables(&p->lenEnc, (unsigned)1 << p->pb, &p->lenProbs, p->ProbPrices);
+          PRICE_STAT_END(p, NumRefresh)
         }
         if (p->repLenEncCounter <= 0)
         {
+          PRICE_STAT_BEGIN(p)
           p->repLenEncCounter = REP_LEN_COUNT;
           LenPriceEnc_UpdateTables(&p->repLenEnc, (unsigned)1 << p->pb, &p->repLenProbs, p->ProbPrices);
+          PRICE_STAT_END(p, NumRepLen)
         }
       }
     
@@ -2832,12 +2923,15 @@ static void LzmaEnc_Init(CLzmaEnc *p)
   p->pbMask = ((unsigned)1 << p->pb) - 1;
   p->lpMask = ((UInt32)0x100 << p->lp) - ((unsigned)0x100 >> p->lc);
 
+  p->needInitPrices = True;
   // p->mf_Failure = False;
 }
 
 
 static void LzmaEnc_InitPrices(CLzmaEnc *p)
 {
+  PRICE_STAT_BEGIN(p)
+  p->needInitPrices = False;
   if (!p->fastMode)
   {
     FillDistancesPrices(p);
@@ -2852,6 +2946,7 @@ static void LzmaEnc_InitPrices(CLzmaEnc *p)
 
   LenPriceEnc_UpdateTables(&p->lenEnc, (unsigned)1 << p->pb, &p->lenProbs, p->ProbPrices);
   LenPriceEnc_UpdateTables(&p->repLenEnc, (unsigned)1 << p->pb, &p->repLenProbs, p->ProbPrices);
+  PRICE_STAT_END(p, NumFull)
 }
 
 static SRes LzmaEnc_AllocAndInit(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig)
@@ -2865,6 +2960,7 @@ static SRes LzmaEnc_AllocAndInit(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr
   p->finished = False;
   p->result = SZ_OK;
   p->nowPos64 = 0;
+  p->prefixSize = 0;
   p->needInit = 1;
   RINOK(LzmaEnc_Alloc(p, keepWindowSize, alloc, allocBig))
   LzmaEnc_Init(p);
@@ -2872,15 +2968,77 @@ static SRes LzmaEnc_AllocAndInit(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr
   return SZ_OK;
 }
 
+/* it inserts (prefixSize) bytes from input to match finder without encoding.
+   The encoding position starts from (prefixSize) after that. */
+
+static SRes LzmaEnc_SkipPrefix(CLzmaEnc *p, UInt32 prefixSize)
+{
+  if (prefixSize == 0)
+    return SZ_OK;
+  #ifndef Z7_ST
+  if (p->mtMode)
+  {
+    RINOK(MatchFinderMt_InitMt(&p->matchFinderMt))
+  }
+  #endif
+  p->matchFinder.Init(p->matchFinderObj);
+  p->needInit = 0;
+  p->matchFinder.Skip(p->matchFinderObj, prefixSize);
+  p->nowPos64 = prefixSize;
+  p->prefixSize = prefixSize;
+  return CheckErrors(p);
+}
+
+
+static SRes LzmaEnc_PresetDictInStream_Read(ISeqInStreamPtr pp, void *data, size_t *size)
+{
+  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(CLzmaEnc_PresetDictInStream)
+  size_t rem = p->rem;
+  if (rem == 0)
+    return ISeqInStream_Read(p->realStream, data, size);
+  if (rem > *size)
+    rem = *size;
+  memcpy(data, p->data, rem);
+  p->data += rem;
+  p->rem -= rem;
+  *size = rem;
+  return SZ_OK;
+}
+
+
+/* stream versions of encoder use preset dictionary as data
+   that precedes the data from (inStream) */
+
+static SRes LzmaEnc_PrepareStream(CLzmaEnc *p,
+    ISeqInStreamPtr inStream, UInt32 keepWindowSize,
+    ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  const UInt32 presetSize = p->presetDictSize;
+  if (presetSize != 0)
+  {
+    p->presetStream.vt.Read = LzmaEnc_PresetDictInStream_Read;
+    p->presetStream.realStream = inStream;
+    p->presetStream.data = p->presetDict;
+    p->presetStream.rem = presetSize;
+    inStream = &p->presetStream.vt;
+    if (MFB.expectedDataSize != (UInt64)(Int64)-1)
+      MFB.expectedDataSize += presetSize;
+  }
+  MatchFinder_SET_STREAM(&MFB, inStream)
+  RINOK(LzmaEnc_AllocAndInit(p, keepWindowSize, alloc, allocBig))
+  if (presetSize != 0 && MFB.expectedDataSize != (UInt64)(Int64)-1)
+    MFB.expectedDataSize -= presetSize;
+  return LzmaEnc_SkipPrefix(p, presetSize);
+}
+
 static SRes LzmaEnc_Prepare(CLzmaEncHandle p,
     ISeqOutStreamPtr outStream,
     ISeqInStreamPtr inStream,
     ISzAllocPtr alloc, ISzAllocPtr allocBig)
 {
   // GET_CLzmaEnc_p
-  MatchFinder_SET_STREAM(&MFB, inStream)
   p->rc.outStream = outStream;
-  return LzmaEnc_AllocAndInit(p, 0, alloc, allocBig);
+  return LzmaEnc_PrepareStream(p, inStream, 0, alloc, allocBig);
 }
 
 SRes LzmaEnc_PrepareForLzma2(CLzmaEncHandle p,
@@ -2888,8 +3046,7 @@ SRes LzmaEnc_PrepareForLzma2(CLzmaEncHandle p,
     ISzAllocPtr alloc, ISzAllocPtr allocBig)
 {
   // GET_CLzmaEnc_p
-  MatchFinder_SET_STREAM(&MFB, inStream)
-  return LzmaEnc_AllocAndInit(p, keepWindowSize, alloc, allocBig);
+  return LzmaEnc_PrepareStream(p, inStream, keepWindowSize, alloc, allocBig);
 }
 
 SRes LzmaEnc_MemPrepare(CLzmaEncHandle p,
@@ -2903,6 +3060,23 @@ SRes LzmaEnc_MemPrepare(CLzmaEncHandle p,
   return LzmaEnc_AllocAndInit(p, keepWindowSize, alloc, allocBig);
 }
 
+/* LzmaEnc_MemPrepare_WithPrefix() is similar to LzmaEnc_MemPrepare(),
+   but (src) buffer starts with (prefixSize) bytes of preceding data.
+   The encoder inserts prefix data to match finder without encoding,
+   and then it can use prefix data as dictionary for data after prefix.
+   (prefixSize) must be aligned for (1 << pb) and (1 << lp),
+   because the encoder position starts from (prefixSize). */
+
+SRes LzmaEnc_MemPrepare_WithPrefix(CLzmaEncHandle p,
+    const Byte *src, SizeT srcLen, SizeT prefixSize,
+    UInt32 keepWindowSize,
+    ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  // GET_CLzmaEnc_p
+  RINOK(LzmaEnc_MemPrepare(p, src, srcLen, keepWindowSize, alloc, allocBig))
+  return LzmaEnc_SkipPrefix(p, (UInt32)prefixSize);
+}
+
 void LzmaEnc_Finish(CLzmaEncHandle p)
 {
   #ifndef Z7_ST
@@ -2976,7 +3150,17 @@ SRes LzmaEnc_CodeOneMemBlock(CLzmaEncHandle p, BoolInt reInit,
 
   if (reInit)
     LzmaEnc_Init(p);
-  LzmaEnc_InitPrices(p);
+  /* If probabilities were not reset, the price tables from previous chunk are still
+     in sync with probabilities, as in the middle of chunk:
+     (matchPriceCount) and (repLenEncCounter) count the symbols encoded
+     since the last update of tables, and the tables will be updated
+     by same rules as inside chunk. So we don't rebuild tables here. */
+  if (p->needInitPrices)
+    LzmaEnc_InitPrices(p);
+  else
+  {
+    PRICE_STAT_INC(p, NumReused)
+  }
   RangeEnc_Init(&p->rc);
   p->rc.outStream = &outStream.vt;
   nowPos64 = p->nowPos64;
@@ -3010,7 +3194,7 @@ static SRes LzmaEnc_Encode2(CLzmaEnc *p, ICompressProgressPtr progress)
       break;
     if (progress)
     {
-      res = ICompressProgress_Progress(progress, p->nowPos64, RangeEnc_GetProcessed(&p->rc));
+      res = ICompressProgress_Progress(progress, p->nowPos64 - p->prefixSize, RangeEnc_GetProcessed(&p->rc));
       if (res != SZ_OK)
       {
         res = SZ_ERROR_PROGRESS;
@@ -26,7 +26,7 @@ typedef struct
   unsigned numHashOutBits;  /* default = ? */
   UInt32 mc;       /* 1 <= mc <= (1 << 30), default = 32 */
   unsigned writeEndMark;  /* 0 - do not write EOPM, 1 - write EOPM, default = 0 */
-  int numThreads;  /* 1 or 2, default = 2 */
+  int numThreads;  /* 1 or more, default = 2. (numThreads > 2) uses partitioned BT match finder */
 
   // int _pad;
   Int32 affinityGroup;
@@ -65,6 +65,30 @@ void LzmaEnc_Destroy(CLzmaEncHandle p, ISzAllocPtr alloc, ISzAllocPtr allocBig);
 
 SRes LzmaEnc_SetProps(CLzmaEncHandle p, const CLzmaEncProps *props);
 void LzmaEnc_SetDataSize(CLzmaEncHandle p, UInt64 expectedDataSiize);
+
+/* LzmaEnc_SetPresetDict() sets preset dictionary for stream encoding functions.
+   The encoder inserts (dict) data to window before the data of stream,
+   and then it can use preset data as dictionary for stream data.
+   The window size is increased by (size) to keep the history of (dictSize) bytes.
+   The decoder must be initialized with same data (LzmaDec_InitWithPresetDict()).
+   (dict) buffer must be available until the end of encoding.
+   (dict == NULL) disables preset dictionary. */
+SRes LzmaEnc_SetPresetDict(CLzmaEncHandle p, const Byte *dict, UInt32 size);
+
+/* the counters of price table updates (for benchmark and tuning) */
+typedef struct
+{
+  UInt64 NumFull;    /* full update of all price tables */
+  UInt64 NumRefresh; /* update of dist, align and len price tables after 64 matches */
+  UInt64 NumRepLen;  /* update of rep len price table */
+  UInt64 NumReused;  /* chunks (LZMA2) that reuse price tables of previous chunk */
+  UInt64 Time;       /* clock() ticks spent in price updates, if time mode is enabled */
+} CLzmaEncPriceStat;
+
+/* the counters are cleared only in LzmaEnc_Create().
+   (timeMode != 0) enables clock() calls for (Time) field. */
+void LzmaEnc_SetPriceStatTimeMode(CLzmaEncHandle p, BoolInt timeMode);
+void LzmaEnc_GetPriceStat(CLzmaEncHandle p, CLzmaEncPriceStat *stat);
 SRes LzmaEnc_WriteProperties(CLzmaEncHandle p, Byte *properties, SizeT *size);
 unsigned LzmaEnc_IsWriteEndMark(CLzmaEncHandle p);
 
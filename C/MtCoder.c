@@ -3,6 +3,8 @@
 
 #include "Precomp.h"
 
+#include <string.h>
+
 #include "MtCoder.h"
 
 #ifndef Z7_ST
@@ -50,16 +52,16 @@ static SRes MtCoderThread_CreateAndStart(CMtCoderThread *t
   if (wres == 0)
   {
     t->stop = False;
-    if (!Thread_WasCreated(&t->thread))
+    if (!PoolThread_WasCreated(&t->thread))
     {
 #ifdef _WIN32
       if (mtc->numThreadGroups)
-        wres = Thread_Create_With_Group(&t->thread, ThreadFunc, t,
+        wres = Thread_Create_With_Group(PoolThread_GetThread(&t->thread), ThreadFunc, t,
             ThreadNextGroup_GetNext(&mtc->nextGroup), // group
             0); // affinityMask
       else
 #endif
-        wres = Thread_Create(&t->thread, ThreadFunc, t);
+        wres = PoolThread_Create(&t->thread, ThreadFunc, t);
     }
     if (wres == 0)
       wres = Event_Set(&t->startEvent);
@@ -73,11 +75,11 @@ static SRes MtCoderThread_CreateAndStart(CMtCoderThread *t
 Z7_FORCE_INLINE
 static void MtCoderThread_Destruct(CMtCoderThread *t)
 {
-  if (Thread_WasCreated(&t->thread))
+  if (PoolThread_WasCreated(&t->thread))
   {
     t->stop = 1;
     Event_Set(&t->startEvent);
-    Thread_Wait_Close(&t->thread);
+    PoolThread_Wait_Close(&t->thread);
   }
 
   Event_Close(&t->startEvent);
@@ -131,19 +133,40 @@ static SRes ThreadFunc2(CMtCoderThread *t)
     if (res == SZ_OK)
     {
       size = mtc->blockSize;
+      t->inPrefixSize = 0;
+      t->inPos = mtc->readProcessed;
       if (mtc->inStream)
       {
         if (!t->inBuf)
         {
-          t->inBuf = (Byte *)ISzAlloc_Alloc(mtc->allocBig, mtc->blockSize);
+          t->inBuf = (Byte *)ISzAlloc_Alloc(mtc->allocBig, mtc->blockPrefixSize + mtc->blockSize);
           if (!t->inBuf)
             res = SZ_ERROR_MEM;
         }
         if (res == SZ_OK)
         {
-          res = SeqInStream_ReadMax(mtc->inStream, t->inBuf, &size);
+          Byte *buf = t->inBuf + mtc->blockPrefixSize;
+          if (mtc->blockPrefixSize != 0)
+          {
+            /* we are in locked reading now. So the buffer of previous block
+               can not be reused by another thread while we copy its tail.
+               The previous block can be in own (t->inBuf), so we use memmove(). */
+            const size_t prefix = mtc->prefixAvail;
+            if (prefix != 0)
+              memmove(buf - prefix, mtc->prefixEnd - prefix, prefix);
+            t->inPrefixSize = prefix;
+          }
+          res = SeqInStream_ReadMax(mtc->inStream, buf, &size);
           readProcessed = mtc->readProcessed + size;
           mtc->readProcessed = readProcessed;
+          if (mtc->blockPrefixSize != 0)
+          {
+            size_t avail = t->inPrefixSize + size;
+            if (avail > mtc->blockPrefixSize)
+              avail = mtc->blockPrefixSize;
+            mtc->prefixAvail = avail;
+            mtc->prefixEnd = buf + size;
+          }
         }
         if (res != SZ_OK)
         {
@@ -162,6 +185,7 @@ static SRes ThreadFunc2(CMtCoderThread *t)
         if (size > rem)
           size = rem;
         inData = mtc->inData + (size_t)readProcessed;
+        t->inPrefixSize = (readProcessed < mtc->blockPrefixSize ? (size_t)readProcessed : mtc->blockPrefixSize);
         readProcessed += size;
         mtc->readProcessed = readProcessed;
         finished = (mtc->inDataSize == (size_t)readProcessed);
@@ -198,7 +222,8 @@ static SRes ThreadFunc2(CMtCoderThread *t)
     if (!finished)
     {
       if (mtc->numStartedThreads < mtc->numStartedThreadsLimit
-          && mtc->expectedDataSize != readProcessed)
+          && mtc->expectedDataSize != readProcessed
+          && !ThreadPool_IsFull())
       {
         res = MtCoderThread_CreateAndStart(&mtc->threads[mtc->numStartedThreads]
 #ifdef _WIN32
@@ -231,7 +256,7 @@ static SRes ThreadFunc2(CMtCoderThread *t)
       CriticalSection_Leave(&mtc->cs);
       
       res = mtc->mtCallback->Code(mtc->mtCallbackObject, t->index, bufIndex,
-          mtc->inStream ? t->inBuf : inData, size, finished);
+          mtc->inStream ? t->inBuf + mtc->blockPrefixSize : inData, size, finished);
       
       // MtProgress_Reinit(&mtc->mtProgress, t->index);
 
@@ -364,6 +389,7 @@ void MtCoder_Construct(CMtCoder *p)
   unsigned i;
   
   p->blockSize = 0;
+  p->blockPrefixSize = 0;
   p->numThreadsMax = 0;
   p->numThreadGroups = 0;
   p->expectedDataSize = (UInt64)(Int64)-1;
@@ -389,9 +415,10 @@ void MtCoder_Construct(CMtCoder *p)
     t->mtCoder = p;
     t->index = i;
     t->inBuf = NULL;
+    t->inPrefixSize = 0;
     t->stop = False;
     Event_Construct(&t->startEvent);
-    Thread_CONSTRUCT(&t->thread)
+    PoolThread_CONSTRUCT(&t->thread)
   }
 
   #ifdef MTCODER_USE_WRITE_THREAD
@@ -462,7 +489,7 @@ SRes MtCoder_Code(CMtCoder *p)
   if (numBlocksMax > MTCODER_BLOCKS_MAX)
       numBlocksMax = MTCODER_BLOCKS_MAX;
 
-  if (p->blockSize != p->allocatedBufsSize)
+  if (p->blockPrefixSize + p->blockSize != p->allocatedBufsSize)
   {
     for (i = 0; i < MTCODER_THREADS_MAX; i++)
     {
@@ -473,7 +500,7 @@ SRes MtCoder_Code(CMtCoder *p)
         t->inBuf = NULL;
       }
     }
-    p->allocatedBufsSize = p->blockSize;
+    p->allocatedBufsSize = p->blockPrefixSize + p->blockSize;
   }
 
   p->readRes = SZ_OK;
@@ -500,6 +527,8 @@ SRes MtCoder_Code(CMtCoder *p)
   p->freeBlockHead = 0;
 
   p->readProcessed = 0;
+  p->prefixEnd = NULL;
+  p->prefixAvail = 0;
   p->blockIndex = 0;
   p->numBlocksMax = numBlocksMax;
   p->stopReading = False;
@@ -49,9 +49,11 @@ typedef struct
   unsigned index;
   int stop;
   Byte *inBuf;
+  size_t inPrefixSize; /* the number of bytes of preceding data that are available before (src) in Code() call */
+  UInt64 inPos;        /* the position of (src) in input data in Code() call */
 
   CAutoResetEvent startEvent;
-  CThread thread;
+  CPoolThread thread;
 } CMtCoderThread;
 
 
@@ -76,6 +78,8 @@ typedef struct CMtCoder_
   /* input variables */
   
   size_t blockSize;        /* size of input block */
+  size_t blockPrefixSize;  /* (blockPrefixSize != 0) : up to (blockPrefixSize) bytes of preceding data
+                              are available in memory before (src) in Code() call */
   unsigned numThreadsMax;
   unsigned numThreadGroups;
   UInt64 expectedDataSize;
@@ -101,6 +105,9 @@ typedef struct CMtCoder_
   BoolInt stopReading;
   SRes readRes;
 
+  const Byte *prefixEnd;   /* end of data of previous block in stream mode */
+  size_t prefixAvail;      /* size of preceding data before (prefixEnd) */
+
   #ifdef MTCODER_USE_WRITE_THREAD
     CAutoResetEvent writeEvents[MTCODER_BLOCKS_MAX];
   #else
@@ -116,9 +116,9 @@ static SRes MtDecThread_CreateAndStart(CMtDecThread *t)
   // wres = 17; // for test
   if (wres == 0)
   {
-    if (Thread_WasCreated(&t->thread))
+    if (PoolThread_WasCreated(&t->thread))
       return SZ_OK;
-    wres = Thread_Create(&t->thread, MtDec_ThreadFunc, t);
+    wres = PoolThread_Create(&t->thread, MtDec_ThreadFunc, t);
     if (wres == 0)
       return SZ_OK;
   }
@@ -145,11 +145,11 @@ void MtDecThread_FreeInBufs(CMtDecThread *t)
 
 static void MtDecThread_CloseThread(CMtDecThread *t)
 {
-  if (Thread_WasCreated(&t->thread))
+  if (PoolThread_WasCreated(&t->thread))
   {
     Event_Set(&t->canWrite); /* we can disable it. There are no threads waiting canWrite in normal cases */
     Event_Set(&t->canRead);
-    Thread_Wait_Close(&t->thread);
+    PoolThread_Wait_Close(&t->thread);
   }
 
   Event_Close(&t->canRead);
@@ -551,7 +551,8 @@ static WRes MtDec_ThreadFunc2(CMtDecThread *t)
 
     if (!finish)
     {
-      if (p->numStartedThreads < p->numStartedThreads_Limit && canCreateNewThread)
+      if (p->numStartedThreads < p->numStartedThreads_Limit && canCreateNewThread
+          && !ThreadPool_IsFull())
       {
         SRes res2 = MtDecThread_CreateAndStart(&p->threads[p->numStartedThreads]);
         if (res2 == SZ_OK)
@@ -978,7 +979,7 @@ void MtDec_Construct(CMtDec *p)
     t->inBuf = NULL;
     Event_Construct(&t->canRead);
     Event_Construct(&t->canWrite);
-    Thread_CONSTRUCT(&t->thread)
+    PoolThread_CONSTRUCT(&t->thread)
   }
 
   // Event_Construct(&p->finishedEvent);
@@ -436,6 +436,37 @@ void Ppmd7_Init(CPpmd7 *p, unsigned maxOrder)
 }
 
 
+#ifdef PPMD7_COPY_MODEL_SUPPORTED
+
+#define PPMD7_REBASE(type, name) p->name = (type)(void *)(base + ((const Byte *)(const void *)src->name - srcBase));
+
+void Ppmd7_CopyModel(CPpmd7 *p, const CPpmd7 *src)
+{
+  Byte *base = p->Base;
+  const Byte *srcBase = src->Base;
+  const Byte *srcEnd = srcBase + src->AlignOffset + src->Size;
+  /* model memory contains offsets from (Base) only. So we copy the used parts of memory:
+       [Base,       Text)   : text area
+       [UnitsStart, LoUnit) : units allocated from low end
+       [HiUnit,     End)    : units allocated from high end
+     Free units are in lists that are stored in used units. */
+  memcpy(base, srcBase, (size_t)(src->Text - srcBase));
+  memcpy(base + (src->UnitsStart - srcBase), src->UnitsStart, (size_t)(src->LoUnit - src->UnitsStart));
+  memcpy(base + (src->HiUnit - srcBase), src->HiUnit, (size_t)(srcEnd - src->HiUnit));
+  *p = *src;
+  p->Base = base;
+  PPMD7_REBASE(CPpmd7_Context *, MinContext)
+  PPMD7_REBASE(CPpmd7_Context *, MaxContext)
+  PPMD7_REBASE(CPpmd_State *, FoundState)
+  PPMD7_REBASE(Byte *, LoUnit)
+  PPMD7_REBASE(Byte *, HiUnit)
+  PPMD7_REBASE(Byte *, Text)
+  PPMD7_REBASE(Byte *, UnitsStart)
+}
+
+#endif
+
+
 
 /*
   Ppmd7_CreateSuccessors()
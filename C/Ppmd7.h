@@ -109,6 +109,16 @@ void Ppmd7_Free(CPpmd7 *p, ISzAllocPtr alloc);
 void Ppmd7_Init(CPpmd7 *p, unsigned maxOrder);
 #define Ppmd7_WasAllocated(p) ((p)->Base != NULL)
 
+#ifndef PPMD_32BIT
+/* In PPMD_32BIT mode the model memory contains pointers, so we can't copy the model */
+#define PPMD7_COPY_MODEL_SUPPORTED
+/* Ppmd7_CopyModel() copies the state of model (src) to (p).
+   (p) must be allocated with the same size as (src).
+   The caller must initialize range encoder or range decoder after that call.
+   The copying of used memory is faster than the update of new model with same data. */
+void Ppmd7_CopyModel(CPpmd7 *p, const CPpmd7 *src);
+#endif
+
 
 /* ---------- Internal Functions ---------- */
 
@@ -176,6 +186,12 @@ void Ppmd7z_Flush_RangeEnc(CPpmd7 *p);
 // void Ppmd7z_EncodeSymbol(CPpmd7 *p, int symbol);
 void Ppmd7z_EncodeSymbols(CPpmd7 *p, const Byte *buf, const Byte *lim);
 
+/* Ppmd7z_UpdateWithSymbols() updates the model with symbols from (buf) without any output.
+   Both encoder and decoder can use it to prime the model with known data.
+   It uses (p->rc) as temporary range encoder.
+   So the caller must initialize range encoder or range decoder after that call. */
+void Ppmd7z_UpdateWithSymbols(CPpmd7 *p, const Byte *buf, const Byte *lim);
+
 EXTERN_C_END
  
 #endif
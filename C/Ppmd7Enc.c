@@ -321,6 +321,23 @@ void Ppmd7z_EncodeSymbols(CPpmd7 *p, const Byte *buf, const Byte *lim)
   }
 }
 
+
+static void NullByteOut_Write(IByteOutPtr pp, Byte b)
+{
+  UNUSED_VAR(pp)
+  UNUSED_VAR(b)
+}
+
+static const IByteOut g_NullByteOut = { NullByteOut_Write };
+
+void Ppmd7z_UpdateWithSymbols(CPpmd7 *p, const Byte *buf, const Byte *lim)
+{
+  // we use the range encoder without output. So the model is updated as in real encoding.
+  R->Stream = &g_NullByteOut;
+  Ppmd7z_Init_RangeEnc(p);
+  Ppmd7z_EncodeSymbols(p, buf, lim);
+}
+
 #undef kTopValue
 #undef WRITE_BYTE
 #undef RC_NORM_BASE
@@ -13,6 +13,7 @@
 
   this file can set the following macros:
     Z7_LARGE_PAGES 1
+    Z7_HUGE_PAGES 1  (linux)
     Z7_LONG_PATH 1
     Z7_WIN32_WINNT_MIN  0x0500 (or higher) : we require at least win2000+ for 7-Zip
     _WIN32_WINNT        0x0500 (or higher)
@@ -40,6 +41,15 @@
 #endif
 */
 
+#if defined(__linux__) && !defined(_WIN32)
+/* BigAlloc() can use transparent huge pages (madvise) in large pages mode */
+#ifndef Z7_HUGE_PAGES
+#ifndef Z7_NO_HUGE_PAGES
+#define Z7_HUGE_PAGES 1
+#endif
+#endif
+#endif
+
 #ifdef _WIN32
 /*
   this "Precomp.h" file must be included before <windows.h>,
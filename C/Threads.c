@@ -9,6 +9,8 @@
 #include <process.h>
 #endif
 
+#include <stdlib.h>
+
 #include "Threads.h"
 
 static WRes GetError(void)
@@ -421,6 +423,7 @@ Z7_DIAGNOSTIC_IGNORE_END_RESERVED_MACRO_IDENTIFIER
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #ifdef Z7_AFFINITY_SUPPORTED
 // #include <sched.h>
 #endif
@@ -808,5 +811,306 @@ UInt32 ThreadNextGroup_GetNext(CThreadNextGroup *p)
   return next;
 }
 
+
+/* ---------- Shared thread pool ---------- */
+
+#ifndef _WIN32
+#define ERROR_NOT_ENOUGH_MEMORY  ENOMEM
+#endif
+
+struct CThreadPoolWorker
+{
+  CThreadPoolWorker *next;
+  THREAD_FUNC_TYPE func;
+  LPVOID param;
+  volatile int exit; /* 0 - wait next task, 1 - exit, 2 - exit and free worker (detached) */
+  CAutoResetEvent startEvent;
+  CAutoResetEvent finishedEvent;
+  CThread thread;
+};
+
+static CThreadPoolWorker *g_ThreadPool_Idle;
+static unsigned g_ThreadPool_NumIdle;
+static unsigned g_ThreadPool_MaxIdle = THREAD_POOL_MAX_IDLE_DEFAULT;
+static unsigned g_ThreadPool_NumRunning;
+static unsigned g_ThreadPool_MaxRunning; // 0 : it will be set from process affinity
+
+#ifdef _WIN32
+
+static CCriticalSection g_ThreadPool_CS;
+static LONG volatile g_ThreadPool_CS_State; // 0 - not initialized, 1 - initializing, 2 - ready
+
+static void ThreadPool_Lock_Func(void)
+{
+  if (g_ThreadPool_CS_State != 2)
+  {
+    if (InterlockedCompareExchange(&g_ThreadPool_CS_State, 1, 0) == 0)
+    {
+      CriticalSection_Init(&g_ThreadPool_CS);
+      InterlockedExchange(&g_ThreadPool_CS_State, 2);
+    }
+    else
+      while (g_ThreadPool_CS_State != 2)
+        Sleep(0);
+  }
+  CriticalSection_Enter(&g_ThreadPool_CS);
+}
+
+#define ThreadPool_Lock()    ThreadPool_Lock_Func();
+#define ThreadPool_Unlock()  CriticalSection_Leave(&g_ThreadPool_CS);
+
+#else
+
+static pthread_mutex_t g_ThreadPool_Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define ThreadPool_Lock()    pthread_mutex_lock(&g_ThreadPool_Mutex);
+#define ThreadPool_Unlock()  pthread_mutex_unlock(&g_ThreadPool_Mutex);
+
+#endif
+
+
+static void ThreadPoolWorker_CloseEvents_Free(CThreadPoolWorker *w)
+{
+  Event_Close(&w->startEvent);
+  Event_Close(&w->finishedEvent);
+  free(w);
+}
+
+
+static THREAD_FUNC_DECL ThreadPoolWorker_Func(void *pp)
+{
+  CThreadPoolWorker *w = (CThreadPoolWorker *)pp;
+  for (;;)
+  {
+    if (Event_Wait(&w->startEvent) != 0)
+      break;
+    if (w->exit)
+    {
+      if (w->exit == 2)
+        ThreadPoolWorker_CloseEvents_Free(w);
+      break;
+    }
+    w->func(w->param);
+    ThreadPool_Lock()
+    g_ThreadPool_NumRunning--;
+    ThreadPool_Unlock()
+    Event_Set(&w->finishedEvent);
+  }
+  return THREAD_FUNC_RET_ZERO;
+}
+
+
+// it stops worker thread that is not running thread function
+static void ThreadPoolWorker_Stop_Free(CThreadPoolWorker *w)
+{
+  w->exit = 1;
+  Event_Set(&w->startEvent);
+  Thread_Wait_Close(&w->thread);
+  ThreadPoolWorker_CloseEvents_Free(w);
+}
+
+
+WRes PoolThread_Create(CPoolThread *p, THREAD_FUNC_TYPE func, LPVOID param)
+{
+  CThreadPoolWorker *w;
+  WRes wres;
+
+  if (PoolThread_WasCreated(p))
+    return ERROR_INVALID_PARAMETER;
+
+  ThreadPool_Lock()
+  w = g_ThreadPool_Idle;
+  if (w)
+  {
+    g_ThreadPool_Idle = w->next;
+    g_ThreadPool_NumIdle--;
+  }
+  ThreadPool_Unlock()
+
+  if (!w)
+  {
+    w = (CThreadPoolWorker *)malloc(sizeof(CThreadPoolWorker));
+    if (!w)
+      return ERROR_NOT_ENOUGH_MEMORY;
+    w->exit = 0;
+    Event_Construct(&w->startEvent);
+    Event_Construct(&w->finishedEvent);
+    Thread_CONSTRUCT(&w->thread)
+    wres = AutoResetEvent_CreateNotSignaled(&w->startEvent);
+    if (wres == 0)
+      wres = AutoResetEvent_CreateNotSignaled(&w->finishedEvent);
+    if (wres == 0)
+      wres = Thread_Create(&w->thread, ThreadPoolWorker_Func, w);
+    if (wres != 0)
+    {
+      ThreadPoolWorker_CloseEvents_Free(w);
+      return wres;
+    }
+  }
+
+  w->next = NULL;
+  w->func = func;
+  w->param = param;
+  ThreadPool_Lock()
+  g_ThreadPool_NumRunning++;
+  ThreadPool_Unlock()
+  wres = Event_Set(&w->startEvent);
+  if (wres != 0)
+  {
+    ThreadPool_Lock()
+    g_ThreadPool_NumRunning--;
+    ThreadPool_Unlock()
+    ThreadPoolWorker_Stop_Free(w);
+    return wres;
+  }
+  p->_worker = w;
+  return 0;
+}
+
+
+WRes PoolThread_Wait_Close(CPoolThread *p)
+{
+  CThreadPoolWorker *w = p->_worker;
+  WRes wres;
+  if (!w)
+    return Thread_Wait_Close(&p->_thread);
+  p->_worker = NULL;
+  wres = Event_Wait(&w->finishedEvent);
+  if (wres == 0)
+  {
+    ThreadPool_Lock()
+    if (g_ThreadPool_NumIdle < g_ThreadPool_MaxIdle)
+    {
+      w->next = g_ThreadPool_Idle;
+      g_ThreadPool_Idle = w;
+      g_ThreadPool_NumIdle++;
+      w = NULL;
+    }
+    ThreadPool_Unlock()
+    if (!w)
+      return 0;
+  }
+  ThreadPoolWorker_Stop_Free(w);
+  return wres;
+}
+
+
+WRes PoolThread_Close(CPoolThread *p)
+{
+  CThreadPoolWorker *w = p->_worker;
+  if (!w)
+    return Thread_Close(&p->_thread);
+  p->_worker = NULL;
+  /* we don't wait for thread function finishing here.
+     The worker will exit and free itself after thread function finishing. */
+  Thread_Close(&w->thread);
+  w->exit = 2;
+  return Event_Set(&w->startEvent);
+}
+
+
+static CThreadPoolWorker *ThreadPool_Trim(unsigned maxIdle)
+{
+  CThreadPoolWorker *list = NULL;
+  while (g_ThreadPool_NumIdle > maxIdle)
+  {
+    CThreadPoolWorker *w = g_ThreadPool_Idle;
+    g_ThreadPool_Idle = w->next;
+    g_ThreadPool_NumIdle--;
+    w->next = list;
+    list = w;
+  }
+  return list;
+}
+
+
+static void ThreadPool_StopList(CThreadPoolWorker *w)
+{
+  while (w)
+  {
+    CThreadPoolWorker *next = w->next;
+    ThreadPoolWorker_Stop_Free(w);
+    w = next;
+  }
+}
+
+
+void ThreadPool_SetMaxIdle(unsigned maxIdle)
+{
+  CThreadPoolWorker *list;
+  ThreadPool_Lock()
+  g_ThreadPool_MaxIdle = maxIdle;
+  list = ThreadPool_Trim(maxIdle);
+  ThreadPool_Unlock()
+  ThreadPool_StopList(list);
+}
+
+
+void ThreadPool_Free(void)
+{
+  CThreadPoolWorker *list;
+  ThreadPool_Lock()
+  list = ThreadPool_Trim(0);
+  ThreadPool_Unlock()
+  ThreadPool_StopList(list);
+}
+
+
+// it returns the number of CPUs in process affinity mask
+static unsigned ThreadPool_GetNumProcessCpus(void)
+{
+  unsigned num = 0;
+#ifdef _WIN32
+  DWORD_PTR processAffinityMask, systemAffinityMask;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+    for (; processAffinityMask != 0; processAffinityMask >>= 1)
+      num += (unsigned)(processAffinityMask & 1);
+  if (num == 0)
+  {
+    // the process can contain threads in multiple groups
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    num = (unsigned)si.dwNumberOfProcessors;
+  }
+#else
+#ifdef Z7_AFFINITY_SUPPORTED
+  {
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+      num = (unsigned)CPU_COUNT(&cpu_set);
+  }
+#endif
+  if (num == 0)
+  {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+      num = (unsigned)n;
+  }
+#endif
+  if (num == 0)
+    num = 1;
+  return num;
+}
+
+
+void ThreadPool_SetMaxRunning(unsigned maxRunning)
+{
+  ThreadPool_Lock()
+  g_ThreadPool_MaxRunning = maxRunning;
+  ThreadPool_Unlock()
+}
+
+
+BoolInt ThreadPool_IsFull(void)
+{
+  BoolInt res;
+  ThreadPool_Lock()
+  if (g_ThreadPool_MaxRunning == 0)
+    g_ThreadPool_MaxRunning = ThreadPool_GetNumProcessCpus();
+  res = (g_ThreadPool_NumRunning >= g_ThreadPool_MaxRunning);
+  ThreadPool_Unlock()
+  return res;
+}
+
 #undef PRF
 #undef Print
@@ -157,6 +157,55 @@ void ThreadNextGroup_Init(CThreadNextGroup *p, unsigned numGroups, unsigned star
 unsigned ThreadNextGroup_GetNext(CThreadNextGroup *p);
 
 
+/* ---------- Shared thread pool ----------
+CPoolThread runs a thread function in a worker thread from process-wide pool.
+The pool keeps idle workers after thread function returns,
+so next PoolThread_Create() call from any coder reuses existing OS thread
+instead of creating new one.
+  PoolThread_Create()     : it starts (func) in idle worker or in new worker.
+  PoolThread_Wait_Close() : it waits for (func) finishing and returns worker to pool.
+  PoolThread_Close()      : it releases worker without waiting (like Thread_Close()).
+Also caller can create non-pooled thread with specified affinity or group
+via Thread_Create_*(PoolThread_GetThread(p), ...) calls.
+The pool counts the workers that run thread functions.
+The callers that can work with any number of threads (MtCoder, MtDec)
+start additional workers only if ThreadPool_IsFull() returns False.
+So the total number of running workers in process is about the limit
+from ThreadPool_SetMaxRunning(), if several MT coders work at same time.
+The threads that are required for progress are started even if the pool is full.
+*/
+
+typedef struct CThreadPoolWorker CThreadPoolWorker;
+
+typedef struct
+{
+  CThreadPoolWorker *_worker;
+  CThread _thread;
+} CPoolThread;
+
+#define PoolThread_CONSTRUCT(p)   { (p)->_worker = NULL;  Thread_CONSTRUCT(&(p)->_thread) }
+#define PoolThread_WasCreated(p)  ((p)->_worker != NULL || Thread_WasCreated(&(p)->_thread))
+#define PoolThread_GetThread(p)   (&(p)->_thread)
+
+WRes PoolThread_Create(CPoolThread *p, THREAD_FUNC_TYPE func, LPVOID param);
+WRes PoolThread_Wait_Close(CPoolThread *p);
+WRes PoolThread_Close(CPoolThread *p);
+
+#define THREAD_POOL_MAX_IDLE_DEFAULT  64
+
+/* ThreadPool_SetMaxIdle() sets the maximum number of idle workers that are kept in pool */
+void ThreadPool_SetMaxIdle(unsigned maxIdle);
+/* ThreadPool_Free() stops all idle workers.
+   Call it only when there are no running pool threads that can be returned to pool. */
+void ThreadPool_Free(void);
+
+/* ThreadPool_SetMaxRunning() sets the limit for the number of running pool workers.
+   (maxRunning == 0) : the limit is the number of CPUs in process affinity mask. */
+void ThreadPool_SetMaxRunning(unsigned maxRunning);
+/* ThreadPool_IsFull() returns True, if the number of running pool workers has reached the limit */
+BoolInt ThreadPool_IsFull(void);
+
+
 #ifdef _WIN32
 
 typedef HANDLE CEvent;
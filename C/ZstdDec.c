@@ -1356,8 +1356,9 @@ typedef struct
   
   Byte *literalsBase;
 
-  size_t winSize;        // from header
+  size_t winSize;        // from header (+ dictSize)
   size_t totalOutCheck;  // totalOutCheck <= winSize
+  size_t dictSize;       // size of dictionary content that precedes frame data in window
 
   #ifdef Z7_ZSTD_DEC_USE_BASES_IN_OBJECT
   SEQ_EXTRA_TABLES(m_)
@@ -1369,7 +1370,8 @@ typedef struct
 CZstdDec1;
 
 #define ZstdDec1_GET_BLOCK_SIZE_LIMIT(p) \
-  ((p)->winSize < kBlockSizeMax ? (UInt32)(p)->winSize : kBlockSizeMax)
+  ((p)->winSize - (p)->dictSize < kBlockSizeMax ? \
+    (UInt32)((p)->winSize - (p)->dictSize) : kBlockSizeMax)
 
 #define SEQ_TABLES_WERE_NOT_SET_ml_accuracy  1  // accuracy=1 is not used by zstd
 #define IS_SEQ_TABLES_WERE_SET(p)  (((p)->ml_accuracy != SEQ_TABLES_WERE_NOT_SET_ml_accuracy))
@@ -1402,6 +1404,111 @@ static void ZstdDec1_Init(CZstdDec1 *p)
   p->ml_accuracy = SEQ_TABLES_WERE_NOT_SET_ml_accuracy;
   p->litHuf_wasSet = False;
   p->totalOutCheck = 0;
+  p->dictSize = 0;
+}
+
+
+/* ---------- Dictionary ----------
+The dictionary that starts with ZSTD_DICT_MAGIC is formatted dictionary:
+  Dictionary_ID, entropy tables (Huffman table for literals, FSE tables for
+  offsets, match lengths and literal lengths), 3 repeat offsets and content.
+Another data is raw content dictionary.
+The content of dictionary precedes the data of frame in window,
+so matches can reference it. Entropy tables and repeat offsets of
+formatted dictionary are initial state of decoder for frame.
+The decoder parses the dictionary once, and it keeps the digested dictionaries
+in small cache keyed by Dictionary_ID. So the frames that use the same
+dictionary copy ready tables instead of parsing of dictionary for each frame.
+*/
+
+#define ZSTD_DICT_MAGIC  0xec30a437
+#define ZSTD_DEC_NUM_DICTS_MAX  4
+/* original-zstd doesn't limit the dictionary size,
+   but we don't want too big content in front of window */
+#define ZSTD_DEC_DICT_SIZE_MAX  ((size_t)1 << 30)
+
+typedef struct
+{
+  UInt32 id;          // Dictionary_ID. It's 0 for raw content dictionary
+  UInt32 useStamp;    // for replacement of least recently used dictionary in cache
+  Byte isFormatted;
+  Byte ll_accuracy;
+  Byte of_accuracy;
+  Byte ml_accuracy;
+  CZstdDecOffset reps[3];
+  Byte *data;         // copy of full dictionary data
+  size_t dataSize;
+  const Byte *content;
+  size_t contentSize;
+  CZstdDecFseTables fse;
+  CZstdDecHufTable huf;
+}
+CZstdDecDict;
+
+
+static SRes ZstdDecDict_Parse(CZstdDecDict *d)
+{
+  const Byte *data = d->data;
+  const size_t size = d->dataSize;
+  d->id = 0;
+  d->isFormatted = False;
+  d->content = data;
+  d->contentSize = size;
+  if (size < 8 || GetUi32(data) != ZSTD_DICT_MAGIC)
+    return SZ_OK; // raw content dictionary
+  {
+    CInBufPair in;
+    unsigned i;
+    d->id = GetUi32(data + 4);
+    in.ptr = data + 8;
+    in.len = size - 8;
+    if (in.len == 0)
+      return SZ_ERROR_DATA;
+    // (in.ptr[-3]) access is allowed here, because (in.ptr) is after Dictionary_ID
+    RINOK(Huf_DecodeTable(&d->huf, &in))
+    RINOK(FSE_Decode_SeqTable(d->fse.of, &in, 5, &d->of_accuracy,
+        NUM_OFFSET_SYMBOLS_MAX, k_PredefRecords_OF, k_SeqMode_FSE))
+    RINOK(FSE_Decode_SeqTable(d->fse.ml, &in, 6, &d->ml_accuracy,
+        NUM_ML_SYMBOLS, k_PredefRecords_ML, k_SeqMode_FSE))
+    RINOK(FSE_Decode_SeqTable(d->fse.ll, &in, 6, &d->ll_accuracy,
+        NUM_LL_SYMBOLS, k_PredefRecords_LL, k_SeqMode_FSE))
+    if (in.len < 3 * 4)
+      return SZ_ERROR_DATA;
+    d->content = in.ptr + 3 * 4;
+    d->contentSize = in.len - 3 * 4;
+    for (i = 0; i < 3; i++)
+    {
+      const UInt32 rep = GetUi32(in.ptr + i * 4);
+      // the condition from original-zstd decoder:
+      if (rep == 0 || rep > d->contentSize)
+        return SZ_ERROR_DATA;
+      d->reps[i] = (CZstdDecOffset)rep;
+    }
+    d->isFormatted = True;
+  }
+  return SZ_OK;
+}
+
+
+// it's called after ZstdDec1_Init()
+static void ZstdDec1_InitFromDict(CZstdDec1 *p, const CZstdDecDict *d)
+{
+  p->dictSize = d->contentSize;
+  p->winSize += d->contentSize;
+  p->totalOutCheck = d->contentSize;
+  if (!d->isFormatted)
+    return;
+  p->reps[0] = d->reps[0];
+  p->reps[1] = d->reps[1];
+  p->reps[2] = d->reps[2];
+  p->ll_accuracy = d->ll_accuracy;
+  p->of_accuracy = d->of_accuracy;
+  p->ml_accuracy = d->ml_accuracy;
+  memcpy(p->fse.ll, d->fse.ll, sizeof(CFseRecord) << d->ll_accuracy);
+  memcpy(p->fse.of, d->fse.of, sizeof(CFseRecord) << d->of_accuracy);
+  memcpy(p->fse.ml, d->fse.ml, sizeof(CFseRecord) << d->ml_accuracy);
+  p->huf = d->huf;
+  p->litHuf_wasSet = True;
 }
 
 
@@ -2772,6 +2879,10 @@ struct CZstdDec
   ISzAllocPtr alloc_Small;
   ISzAllocPtr alloc_Big;
 
+  CZstdDecDict *dict_Default; // for frames without Dictionary_ID
+  UInt32 dictUseStamp;
+  CZstdDecDict *dicts[ZSTD_DEC_NUM_DICTS_MAX];
+
   CZstdDec1 decoder;
 };
 
@@ -2805,10 +2916,119 @@ CZstdDecHandle ZstdDec_Create(ISzAllocPtr alloc_Small, ISzAllocPtr alloc_Big)
   p->win_Base = NULL;
   p->winBufSize_Allocated = 0;
   p->disableHash = False;
+  p->dict_Default = NULL;
+  p->dictUseStamp = 0;
+  {
+    unsigned i;
+    for (i = 0; i < ZSTD_DEC_NUM_DICTS_MAX; i++)
+      p->dicts[i] = NULL;
+  }
   ZstdDec1_Construct(&p->decoder);
   return p;
 }
 
+
+static void ZstdDec_FreeDict(CZstdDec *p, unsigned index)
+{
+  CZstdDecDict *d = p->dicts[index];
+  if (d)
+  {
+    if (p->dict_Default == d)
+      p->dict_Default = NULL;
+    ISzAlloc_Free(p->alloc_Big, d->data);
+    ISzAlloc_Free(p->alloc_Small, d);
+    p->dicts[index] = NULL;
+  }
+}
+
+
+SRes ZstdDec_SetDict(CZstdDecHandle p, const Byte *data, size_t size)
+{
+  CZstdDecDict *d;
+  unsigned i, k;
+  p->dict_Default = NULL;
+  if (!data || size == 0)
+    return SZ_OK;
+  if (size > ZSTD_DEC_DICT_SIZE_MAX)
+    return SZ_ERROR_UNSUPPORTED;
+
+  // we look for digested copy of same dictionary in cache
+  for (i = 0; i < ZSTD_DEC_NUM_DICTS_MAX; i++)
+  {
+    d = p->dicts[i];
+    if (d && d->dataSize == size && memcmp(d->data, data, size) == 0)
+    {
+      d->useStamp = ++p->dictUseStamp;
+      p->dict_Default = d;
+      return SZ_OK;
+    }
+  }
+
+  // we use free item or we replace least recently used dictionary
+  k = 0;
+  for (i = 0; i < ZSTD_DEC_NUM_DICTS_MAX; i++)
+  {
+    if (!p->dicts[i])
+    {
+      k = i;
+      break;
+    }
+    if (p->dicts[i]->useStamp < p->dicts[k]->useStamp)
+      k = i;
+  }
+  ZstdDec_FreeDict(p, k);
+  d = (CZstdDecDict *)ISzAlloc_Alloc(p->alloc_Small, sizeof(CZstdDecDict));
+  if (!d)
+    return SZ_ERROR_MEM;
+  d->data = (Byte *)ISzAlloc_Alloc(p->alloc_Big, size);
+  if (!d->data)
+  {
+    ISzAlloc_Free(p->alloc_Small, d);
+    return SZ_ERROR_MEM;
+  }
+  memcpy(d->data, data, size);
+  d->dataSize = size;
+  p->dicts[k] = d;
+  {
+    const SRes res = ZstdDecDict_Parse(d);
+    if (res != SZ_OK)
+    {
+      ZstdDec_FreeDict(p, k);
+      return res;
+    }
+  }
+  d->useStamp = ++p->dictUseStamp;
+  p->dict_Default = d;
+  return SZ_OK;
+}
+
+
+/* it returns the dictionary for frame:
+     (id == 0) : default dictionary, or NULL, if no default dictionary.
+     (id != 0) : formatted dictionary with same Dictionary_ID, or NULL, if there is no such dictionary.
+*/
+static CZstdDecDict *ZstdDec_FindDict(CZstdDec *p, UInt32 id)
+{
+  CZstdDecDict *d = p->dict_Default;
+  if (id != 0 && (!d || d->id != id))
+  {
+    unsigned i;
+    d = NULL;
+    for (i = 0; i < ZSTD_DEC_NUM_DICTS_MAX; i++)
+    {
+      CZstdDecDict *d2 = p->dicts[i];
+      if (d2 && d2->isFormatted && d2->id == id)
+      {
+        d = d2;
+        break;
+      }
+    }
+  }
+  if (d)
+    d->useStamp = ++p->dictUseStamp;
+  return d;
+}
+
 void ZstdDec_Destroy(CZstdDecHandle p)
 {
   #ifdef SHOW_STAT
@@ -2846,6 +3066,11 @@ void ZstdDec_Destroy(CZstdDecHandle p)
   // p->->decoder.literalsBase = NULL;
   ISzAlloc_Free(p->alloc_Small, p->inTemp);
   // p->inTemp = NULL;
+  {
+    unsigned i;
+    for (i = 0; i < ZSTD_DEC_NUM_DICTS_MAX; i++)
+      ZstdDec_FreeDict(p, i);
+  }
   ZstdDec_FreeWindow(p);
   ISzAlloc_Free(p->alloc_Small, p);
 }
@@ -3792,15 +4017,30 @@ SRes ZstdDec_Decode(CZstdDecHandle dec, CZstdDecState *p)
     {
       BoolInt useCyclic = False;
       size_t cycSize;
+      size_t dictPos = 0;
+      const CZstdDecDict *dict;
 
       // p->status = ZSTD_STATUS_NOT_FINISHED;
-      if (dec->dictionaryId != 0)
+      dict = ZstdDec_FindDict(dec, dec->dictionaryId);
+      if (!dict && dec->dictionaryId != 0)
       {
         /* actually we can try to decode some data,
            because it's possible that some data doesn't use dictionary */
         // p->status = ZSTD_STATUS_NOT_SPECIFIED;
         return SZ_ERROR_UNSUPPORTED;
       }
+      if (dict)
+      {
+        // there is no space for dictionary content before data in buffer of caller
+        if (p->outBuf_fromCaller)
+          return SZ_ERROR_UNSUPPORTED;
+        /* dictionary content is placed before (dictPos) in window.
+           (dictPos) is aligned for Z7_XXH64_BLOCK_SIZE, because
+           xxh code and wrapping in cyclic buffer require
+           the same alignment for (winPos) and (contentProcessed). */
+        dictPos = (dict->contentSize + (Z7_XXH64_BLOCK_SIZE - 1))
+            & ~(size_t)(Z7_XXH64_BLOCK_SIZE - 1);
+      }
 
       {
         UInt64 winSize = dec->contentSize;
@@ -3858,6 +4098,16 @@ SRes ZstdDec_Decode(CZstdDecHandle dec, CZstdDecState *p)
         */
         dec->decoder.winSize = (winSize < kBlockSizeMax) ? (size_t)winSize: cycSize;
         // note: (CZstdDec1::winSize > cycSize) is possible, if (!useCyclic)
+        if (dict)
+        {
+          /* matches can reference the dictionary content while frame data
+             is not larger than window size. We allow offsets up to (winSize + dictSize).
+             So we need additional (dictPos) space in buffer for dictionary content. */
+          ZstdDec1_InitFromDict(&dec->decoder, dict);
+          cycSize += dictPos;
+          if (cycSize < dictPos)
+            return SZ_ERROR_MEM;
+        }
       }
 
       RINOK(ZstdDec_AllocateMisc(dec))
@@ -4001,6 +4251,16 @@ SRes ZstdDec_Decode(CZstdDecHandle dec, CZstdDecState *p)
         p->win = dec->decoder.win;
         // p->cycSize = dec->decoder.cycSize;
         dec->isCyclicMode = (Byte)useCyclic;
+
+        if (dict)
+        {
+          // the dictionary content is not written to output stream
+          const size_t size = dict->contentSize;
+          memcpy(dec->decoder.win + dictPos - size, dict->content, size);
+          dec->decoder.winPos = dictPos;
+          p->wrPos = dictPos;
+          p->winPos = dictPos;
+        }
       } // (!p->outBuf_fromCaller) end
       
       // p->winPos = dec->decoder.winPos;
@@ -33,6 +33,25 @@ typedef Byte enum_ZstdStatus;
 
 void ZstdDec_Init(CZstdDecHandle p);
 
+/*
+ZstdDec_SetDict() sets the dictionary that is used for frames without Dictionary_ID.
+  Also the frames with Dictionary_ID can use that dictionary
+  or any other formatted dictionary from cache of decoder with same Dictionary_ID.
+  The data that starts with zstd dictionary magic is formatted dictionary,
+  and another data is raw content dictionary.
+  The decoder keeps the copy of data, and it keeps up to 4 digested
+  dictionaries in cache, so the caller can call ZstdDec_SetDict() for each
+  stream with same dictionary without parsing of dictionary again.
+  (size == 0) : no dictionary for frames without Dictionary_ID.
+  Frames that use dictionary can't be decoded in (outBuf_fromCaller) mode.
+return:
+  SZ_OK
+  SZ_ERROR_DATA        - incorrect formatted dictionary
+  SZ_ERROR_UNSUPPORTED - dictionary is too big
+  SZ_ERROR_MEM         - memory allocation error
+*/
+SRes ZstdDec_SetDict(CZstdDecHandle p, const Byte *data, size_t size);
+
 typedef struct
 {
   UInt64 num_Blocks;
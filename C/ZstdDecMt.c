@@ -0,0 +1,684 @@
+/* ZstdDecMt.c -- Zstd Decoder Multi-thread
+Igor Pavlov : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "Alloc.h"
+#include "CpuArch.h"
+#include "ZstdDecMt.h"
+
+#ifndef Z7_ST
+
+#include "MtDec.h"
+
+#define ZSTDDECMT_OUT_BLOCK_MIN_DEFAULT (1 << 20)
+#define ZSTDDECMT_OUT_BLOCK_MAX_DEFAULT (1 << 28)
+
+#define ZSTDDECMT_OUT_BUF_SIZE_MIN (1 << 16)
+#define ZSTDDECMT_STREAM_WRITE_STEP (1 << 24)
+
+#define kZstd_Signature          0xfd2fb528
+#define kZstd_SkipFrame_Sig      0x184d2a50
+#define kZstd_SkipFrame_SigMask  0xfffffff0
+
+#define kZstd_BlockSizeMax       (1 << 17)
+
+#define kBlockType_Raw   0
+#define kBlockType_RLE   1
+#define kBlockType_Bad   3
+
+
+void ZstdDecMtProps_Init(CZstdDecMtProps *p)
+{
+  p->numThreads = 1;
+  p->inBufSize_MT = 1 << 18;
+  p->outBlockMin = ZSTDDECMT_OUT_BLOCK_MIN_DEFAULT;
+  p->outBlockMax = ZSTDDECMT_OUT_BLOCK_MAX_DEFAULT;
+  p->disableHash = False;
+}
+
+
+/* states of frame parser */
+#define ZSTDDECMT_PARSE_SIG         0
+#define ZSTDDECMT_PARSE_SKIP_SIZE   1
+#define ZSTDDECMT_PARSE_DESCRIPTOR  2
+#define ZSTDDECMT_PARSE_HEADER      3
+#define ZSTDDECMT_PARSE_BLOCK       4
+#define ZSTDDECMT_PARSE_FRAME_END   5
+
+
+/* ---------- CZstdDecMtThread ---------- */
+
+typedef struct
+{
+  CZstdDecHandle dec;
+  CZstdDecState state;
+
+  Byte *outBuf;
+  size_t outBufSize;
+
+  EMtDecParseState parseState;
+
+  Byte ps;            /* state of frame parser */
+  Byte descriptor;
+  Byte contentSize_Defined;
+  unsigned tempSize;
+  unsigned tempNeed;
+  UInt32 blockSizeMax;
+  UInt32 numFrames;
+  UInt64 skipRem;
+  UInt64 contentSize;
+  UInt64 frameOutMax;  /* upper bound of output size for current frame from block headers */
+  Byte temp[16];
+
+  size_t inPreSize;
+  size_t outPreSize;
+
+  size_t inCodeSize;
+  size_t outCodeSize;
+  SRes codeRes;
+
+  Byte mtPad[1 << 7];
+} CZstdDecMtThread;
+
+
+/* ---------- CZstdDecMt ---------- */
+
+struct CZstdDecMt
+{
+  ISzAllocPtr alloc_Small;
+  ISzAllocPtr alloc_Big;
+  ISzAllocPtr allocMid;
+
+  CZstdDecMtProps props;
+
+  ISeqOutStreamPtr outStream;
+  BoolInt outSize_Defined;
+  UInt64 outSize;
+  CZstdDecMtRes *res;
+
+  BoolInt readMode;
+  size_t readLim;
+
+  BoolInt mtc_WasConstructed;
+  CMtDec mtc;
+  CZstdDecMtThread coders[MTDEC_THREADS_MAX];
+};
+
+
+CZstdDecMtHandle ZstdDecMt_Create(ISzAllocPtr alloc_Small, ISzAllocPtr alloc_Big, ISzAllocPtr allocMid)
+{
+  CZstdDecMt *p = (CZstdDecMt *)ISzAlloc_Alloc(alloc_Small, sizeof(CZstdDecMt));
+  if (!p)
+    return NULL;
+
+  p->alloc_Small = alloc_Small;
+  p->alloc_Big = alloc_Big;
+  p->allocMid = allocMid;
+
+  p->readMode = False;
+  p->readLim = 0;
+  p->mtc_WasConstructed = False;
+  {
+    unsigned i;
+    for (i = 0; i < MTDEC_THREADS_MAX; i++)
+    {
+      CZstdDecMtThread *t = &p->coders[i];
+      t->dec = NULL;
+      t->outBuf = NULL;
+      t->outBufSize = 0;
+    }
+  }
+  return p;
+}
+
+
+static void ZstdDecMt_FreeOutBufs(CZstdDecMt *p)
+{
+  unsigned i;
+  for (i = 0; i < MTDEC_THREADS_MAX; i++)
+  {
+    CZstdDecMtThread *t = &p->coders[i];
+    if (t->outBuf)
+    {
+      ISzAlloc_Free(p->allocMid, t->outBuf);
+      t->outBuf = NULL;
+      t->outBufSize = 0;
+    }
+  }
+}
+
+
+void ZstdDecMt_Destroy(CZstdDecMtHandle p)
+{
+  if (p->mtc_WasConstructed)
+  {
+    MtDec_Destruct(&p->mtc);
+    p->mtc_WasConstructed = False;
+  }
+  {
+    unsigned i;
+    for (i = 0; i < MTDEC_THREADS_MAX; i++)
+    {
+      CZstdDecMtThread *t = &p->coders[i];
+      if (t->dec)
+      {
+        ZstdDec_Destroy(t->dec);
+        t->dec = NULL;
+      }
+    }
+  }
+  ZstdDecMt_FreeOutBufs(p);
+  ISzAlloc_Free(p->alloc_Small, p);
+}
+
+
+static void ZstdDecInfo_Add(CZstdDecInfo *p, const CZstdDecInfo *a)
+{
+  p->num_Blocks += a->num_Blocks;
+  p->descriptor_OR     = (Byte)(p->descriptor_OR     | a->descriptor_OR);
+  p->descriptor_NOT_OR = (Byte)(p->descriptor_NOT_OR | a->descriptor_NOT_OR);
+  p->are_ContentSize_Unknown |= a->are_ContentSize_Unknown;
+  if (p->windowDescriptor_MAX < a->windowDescriptor_MAX)
+      p->windowDescriptor_MAX = a->windowDescriptor_MAX;
+  if (a->num_DataFrames != 0)
+  {
+    p->checksum_Defined = a->checksum_Defined;
+    p->checksum = a->checksum;
+  }
+  p->are_DictionaryId_Different |= a->are_DictionaryId_Different;
+  if (a->dictionaryId != 0)
+  {
+    if (p->dictionaryId == 0)
+      p->dictionaryId = a->dictionaryId;
+    else if (p->dictionaryId != a->dictionaryId)
+      p->are_DictionaryId_Different = True;
+  }
+  p->num_DataFrames += a->num_DataFrames;
+  p->num_SkipFrames += a->num_SkipFrames;
+  p->skipFrames_Size += a->skipFrames_Size;
+  p->contentSize_Total += a->contentSize_Total;
+  if (p->contentSize_MAX < a->contentSize_MAX)
+      p->contentSize_MAX = a->contentSize_MAX;
+  if (p->windowSize_MAX < a->windowSize_MAX)
+      p->windowSize_MAX = a->windowSize_MAX;
+  if (p->windowSize_Allocate_MAX < a->windowSize_Allocate_MAX)
+      p->windowSize_Allocate_MAX = a->windowSize_Allocate_MAX;
+}
+
+
+/*
+  ZstdDecMt_ParseHeaders() parses frame headers and block headers.
+  It returns:
+    0 : (need more input) or (frame end) or (block end was reached)
+    1 : the data can't be decoded in multi-thread mode
+*/
+
+static int ZstdDecMt_ParseHeaders(CZstdDecMtThread *t, size_t limit,
+    const Byte *src, size_t size, size_t *pos, size_t blockMin)
+{
+  size_t i = *pos;
+
+  for (;;)
+  {
+    if (t->skipRem != 0)
+    {
+      size_t rem = size - i;
+      if (rem > t->skipRem)
+        rem = (size_t)t->skipRem;
+      i += rem;
+      t->skipRem -= rem;
+      if (t->skipRem != 0)
+        break;
+    }
+
+    if (t->ps == ZSTDDECMT_PARSE_FRAME_END)
+    {
+      UInt64 frameOut = t->frameOutMax;
+      if (t->contentSize_Defined)
+      {
+        if (t->contentSize > frameOut)
+          return 1;
+        frameOut = t->contentSize;
+      }
+      /* (frameOut <= limit - outPreSize) was checked already */
+      t->outPreSize += (size_t)frameOut;
+      t->numFrames++;
+      t->ps = ZSTDDECMT_PARSE_SIG;
+      t->tempNeed = 4;
+      if (t->outPreSize >= blockMin)
+        break;
+      continue;
+    }
+
+    while (t->tempSize < t->tempNeed)
+    {
+      if (i == size)
+      {
+        *pos = i;
+        return 0;
+      }
+      t->temp[t->tempSize++] = src[i++];
+    }
+    t->tempSize = 0;
+
+    switch (t->ps)
+    {
+      case ZSTDDECMT_PARSE_SIG:
+      {
+        const UInt32 sig = GetUi32(t->temp);
+        t->frameOutMax = 0;
+        t->contentSize = 0;
+        t->contentSize_Defined = False;
+        if (sig == kZstd_Signature)
+        {
+          t->ps = ZSTDDECMT_PARSE_DESCRIPTOR;
+          t->tempNeed = 1;
+          break;
+        }
+        if ((sig & kZstd_SkipFrame_SigMask) != kZstd_SkipFrame_Sig)
+          return 1;
+        t->ps = ZSTDDECMT_PARSE_SKIP_SIZE;
+        t->tempNeed = 4;
+        break;
+      }
+
+      case ZSTDDECMT_PARSE_SKIP_SIZE:
+        t->skipRem = GetUi32(t->temp);
+        t->contentSize_Defined = True;
+        t->ps = ZSTDDECMT_PARSE_FRAME_END;
+        break;
+
+      case ZSTDDECMT_PARSE_DESCRIPTOR:
+      {
+        const unsigned d = t->temp[0];
+        const unsigned fcsFlag = d >> 6;
+        const unsigned single = (d >> 5) & 1;
+        if (d & 8) // reserved bit
+          return 1;
+        t->descriptor = (Byte)d;
+        t->tempNeed = (1 - single)
+            + ((0x4210u >> ((d & 3) * 4)) & 0xf)
+            + (fcsFlag ? (1u << fcsFlag) : single);
+        t->ps = ZSTDDECMT_PARSE_HEADER;
+        break;
+      }
+
+      case ZSTDDECMT_PARSE_HEADER:
+      {
+        const unsigned d = t->descriptor;
+        const unsigned fcsFlag = d >> 6;
+        const Byte *p = t->temp;
+        UInt32 blockSizeMax = kZstd_BlockSizeMax;
+        if ((d & 0x20) == 0)
+        {
+          const unsigned wd = *p++;
+          if ((wd >> 3) < 17 - 10)
+            blockSizeMax = (UInt32)(8 + (wd & 7)) << ((wd >> 3) + 10 - 3);
+        }
+        {
+          // frames with dictionary are decoded in single-thread mode
+          unsigned dictSize = (0x4210u >> ((d & 3) * 4)) & 0xf;
+          for (; dictSize != 0; dictSize--)
+            if (*p++ != 0)
+              return 1;
+        }
+        if (fcsFlag != 0 || (d & 0x20))
+        {
+          UInt64 v;
+          if (fcsFlag == 0)
+            v = *p;
+          else if (fcsFlag == 1)
+            v = (UInt64)GetUi16(p) + 0x100;
+          else if (fcsFlag == 2)
+            v = GetUi32(p);
+          else
+            v = GetUi64(p);
+          if (v > limit - t->outPreSize)
+            return 1;
+          t->contentSize = v;
+          t->contentSize_Defined = True;
+          if ((d & 0x20) && blockSizeMax > v)
+            blockSizeMax = (UInt32)v;
+        }
+        t->blockSizeMax = blockSizeMax;
+        t->ps = ZSTDDECMT_PARSE_BLOCK;
+        t->tempNeed = 3;
+        break;
+      }
+
+      default: // ZSTDDECMT_PARSE_BLOCK
+      {
+        const UInt32 v = GetUi16(t->temp) | ((UInt32)t->temp[2] << 16);
+        const unsigned type = (v >> 1) & 3;
+        const UInt32 blockSize = v >> 3;
+        if (type == kBlockType_Bad || blockSize > t->blockSizeMax)
+          return 1;
+        t->frameOutMax += (type == kBlockType_Raw || type == kBlockType_RLE) ?
+            blockSize : t->blockSizeMax;
+        if (!t->contentSize_Defined
+            && t->frameOutMax > limit - t->outPreSize)
+          return 1;
+        t->skipRem = (type == kBlockType_RLE) ? 1 : blockSize;
+        if (v & 1)
+        {
+          if (t->descriptor & 4)
+            t->skipRem += 4; // content checksum
+          t->ps = ZSTDDECMT_PARSE_FRAME_END;
+        }
+        break;
+      }
+    }
+  }
+
+  *pos = i;
+  return 0;
+}
+
+
+static void ZstdDecMt_MtCallback_Parse(void *obj, unsigned coderIndex, CMtDecCallbackInfo *cc)
+{
+  CZstdDecMt *me = (CZstdDecMt *)obj;
+  CZstdDecMtThread *t = &me->coders[coderIndex];
+  size_t pos = 0;
+
+  if (cc->startCall)
+  {
+    t->ps = ZSTDDECMT_PARSE_SIG;
+    t->tempSize = 0;
+    t->tempNeed = 4;
+    t->skipRem = 0;
+    t->numFrames = 0;
+
+    t->inPreSize = 0;
+    t->outPreSize = 0;
+
+    t->inCodeSize = 0;
+    t->outCodeSize = 0;
+    t->codeRes = SZ_OK;
+  }
+
+  cc->state = MTDEC_PARSE_CONTINUE;
+
+  if (ZstdDecMt_ParseHeaders(t, me->props.outBlockMax,
+      cc->src, cc->srcSize, &pos, me->props.outBlockMin))
+    cc->state = MTDEC_PARSE_OVERFLOW;
+  else
+  {
+    const BoolInt isFrameStart =
+        (t->ps == ZSTDDECMT_PARSE_SIG && t->tempSize == 0);
+    if (isFrameStart && t->numFrames != 0 && t->outPreSize >= me->props.outBlockMin)
+      cc->state = MTDEC_PARSE_NEW;
+    if (cc->srcFinished && pos == cc->srcSize)
+    {
+      /* if input stream is finished inside of frame,
+         or if there are no frames,
+         we switch to single-thread mode that will report the error */
+      if (!isFrameStart || t->numFrames == 0)
+        cc->state = MTDEC_PARSE_OVERFLOW;
+      else
+        cc->state = MTDEC_PARSE_END;
+    }
+  }
+
+  cc->srcSize = pos;
+  cc->outPos = t->outPreSize;
+  t->inPreSize += pos;
+  t->parseState = cc->state;
+}
+
+
+static SRes ZstdDecMt_MtCallback_PreCode(void *pp, unsigned coderIndex)
+{
+  CZstdDecMt *me = (CZstdDecMt *)pp;
+  CZstdDecMtThread *t = &me->coders[coderIndex];
+  Byte *dest = t->outBuf;
+
+  if (!t->dec)
+  {
+    t->dec = ZstdDec_Create(me->alloc_Small, me->alloc_Big);
+    if (!t->dec)
+      return SZ_ERROR_MEM;
+  }
+
+  if (!dest || t->outBufSize < t->outPreSize)
+  {
+    size_t size = t->outPreSize;
+    if (dest)
+    {
+      ISzAlloc_Free(me->allocMid, dest);
+      t->outBuf = NULL;
+      t->outBufSize = 0;
+    }
+    if (size < ZSTDDECMT_OUT_BUF_SIZE_MIN)
+      size = ZSTDDECMT_OUT_BUF_SIZE_MIN;
+    dest = (Byte *)ISzAlloc_Alloc(me->allocMid, size);
+    if (!dest)
+      return SZ_ERROR_MEM;
+    t->outBuf = dest;
+    t->outBufSize = size;
+  }
+
+  ZstdDecState_Clear(&t->state);
+  t->state.disableHash = (Byte)(me->props.disableHash ? 1 : 0);
+  t->state.outBuf_fromCaller = dest;
+  t->state.outBufSize_fromCaller = t->outPreSize;
+  ZstdDec_Init(t->dec);
+  return SZ_OK;
+}
+
+
+static SRes ZstdDecMt_MtCallback_Code(void *pp, unsigned coderIndex,
+    const Byte *src, size_t srcSize, int srcFinished,
+    UInt64 *inCodePos, UInt64 *outCodePos, int *stop)
+{
+  CZstdDecMt *me = (CZstdDecMt *)pp;
+  CZstdDecMtThread *t = &me->coders[coderIndex];
+  CZstdDecState *ds = &t->state;
+  SRes res;
+
+  *stop = True;
+
+  ds->inBuf = src;
+  ds->inPos = 0;
+  ds->inLim = srcSize;
+
+  for (;;)
+  {
+    const size_t inPos = ds->inPos;
+    const size_t winPos = ds->winPos;
+    res = ZstdDec_Decode(t->dec, ds);
+    if (res != SZ_OK)
+      break;
+    if (ds->inPos == ds->inLim
+        && ZstdDecState_DOES_NEED_MORE_INPUT_OR_FINISHED_FRAME(ds))
+      break;
+    if (inPos == ds->inPos && winPos == ds->winPos)
+    {
+      // no progress : it's possible, if output buffer is too small for data
+      res = SZ_ERROR_DATA;
+      break;
+    }
+  }
+
+  t->inCodeSize += ds->inPos;
+  t->outCodeSize = ds->winPos;
+  *inCodePos = t->inCodeSize;
+  *outCodePos = t->outCodeSize;
+
+  if (res == SZ_OK && srcFinished)
+  {
+    CZstdDecResInfo resInfo;
+    ZstdDec_GetResInfo(t->dec, ds, res, &resInfo);
+    if (resInfo.decode_SRes != SZ_OK
+        || resInfo.is_NonFinishedFrame
+        || resInfo.extraSize != 0
+        || t->inCodeSize != t->inPreSize)
+      res = SZ_ERROR_DATA;
+  }
+
+  t->codeRes = res;
+  if (res != SZ_OK)
+  {
+    /* the block will be decoded again in single-thread mode,
+       and single-thread decoder will report exact error */
+    return res;
+  }
+  if (!srcFinished)
+    *stop = False;
+  return SZ_OK;
+}
+
+
+static SRes ZstdDecMt_MtCallback_Write(void *pp, unsigned coderIndex,
+    BoolInt needWriteToStream,
+    const Byte *src, size_t srcSize, BoolInt isCross,
+    BoolInt *needContinue, BoolInt *canRecode)
+{
+  CZstdDecMt *me = (CZstdDecMt *)pp;
+  const CZstdDecMtThread *t = &me->coders[coderIndex];
+  CZstdDecMtRes *res = me->res;
+  size_t size = t->outCodeSize;
+  const Byte *data = t->outBuf;
+  BoolInt needContinue2 = (t->parseState == MTDEC_PARSE_NEW);
+
+  UNUSED_VAR(src)
+  UNUSED_VAR(srcSize)
+  UNUSED_VAR(isCross)
+
+  *needContinue = False;
+  *canRecode = True;
+
+  if (!needWriteToStream || t->codeRes != SZ_OK)
+    return SZ_OK;
+
+  *canRecode = False;
+
+  me->mtc.inProcessed += t->inCodeSize;
+  ZstdDecInfo_Add(&res->info, &t->state.info);
+
+  if (me->outSize_Defined)
+  {
+    const UInt64 rem = me->outSize - res->outProcessed;
+    if (size > rem)
+    {
+      size = (size_t)rem;
+      res->outSize_Reached = True;
+      needContinue2 = False;
+    }
+  }
+
+  for (;;)
+  {
+    size_t cur = size;
+    size_t written;
+    if (cur == 0)
+    {
+      *needContinue = needContinue2;
+      return SZ_OK;
+    }
+    if (cur > ZSTDDECMT_STREAM_WRITE_STEP)
+      cur = ZSTDDECMT_STREAM_WRITE_STEP;
+    written = ISeqOutStream_Write(me->outStream, data, cur);
+    res->outProcessed += written;
+    if (written != cur)
+      return SZ_ERROR_WRITE;
+    data += cur;
+    size -= cur;
+    if (size != 0)
+    {
+      RINOK(MtProgress_ProgressAdd(&me->mtc.mtProgress, 0, 0))
+    }
+  }
+}
+
+
+SRes ZstdDecMt_Decode(CZstdDecMtHandle p,
+    const CZstdDecMtProps *props,
+    ISeqOutStreamPtr outStream,
+    const UInt64 *outDataSize,
+    ISeqInStreamPtr inStream,
+    CZstdDecMtRes *res,
+    ICompressProgressPtr progress)
+{
+  IMtDecCallback2 vt;
+  SRes sres;
+
+  p->props = *props;
+  p->outStream = outStream;
+  p->outSize_Defined = False;
+  p->outSize = 0;
+  if (outDataSize)
+  {
+    p->outSize_Defined = True;
+    p->outSize = *outDataSize;
+  }
+  p->res = res;
+  p->readMode = False;
+  p->readLim = 0;
+
+  res->inProcessed = 0;
+  res->outProcessed = 0;
+  ZstdDecInfo_CLEAR(&res->info)
+  res->readRes = SZ_OK;
+  res->readWasFinished = False;
+  res->outSize_Reached = False;
+
+  if (!p->mtc_WasConstructed)
+  {
+    p->mtc_WasConstructed = True;
+    MtDec_Construct(&p->mtc);
+  }
+
+  p->mtc.progress = progress;
+  p->mtc.inStream = inStream;
+  p->mtc.alloc = p->alloc_Small;
+  p->mtc.mtCallback = &vt;
+  p->mtc.mtCallbackObject = p;
+  p->mtc.inBufSize = p->props.inBufSize_MT;
+  p->mtc.numThreadsMax = p->props.numThreads;
+
+  vt.Parse = ZstdDecMt_MtCallback_Parse;
+  vt.PreCode = ZstdDecMt_MtCallback_PreCode;
+  vt.Code = ZstdDecMt_MtCallback_Code;
+  vt.Write = ZstdDecMt_MtCallback_Write;
+
+  sres = MtDec_Code(&p->mtc);
+
+  res->inProcessed = p->mtc.inProcessed;
+  res->readRes = p->mtc.readRes;
+  res->readWasFinished = p->mtc.readWasFinished;
+
+  if (sres == SZ_OK)
+    sres = p->mtc.mtProgress.res;
+  if (sres != SZ_OK)
+    return sres;
+  if (res->outSize_Reached)
+    return SZ_OK;
+
+  /* we free big output buffers before single-thread decoding */
+  ZstdDecMt_FreeOutBufs(p);
+  p->readMode = MtDec_PrepareRead(&p->mtc);
+  return SZ_OK;
+}
+
+
+const Byte *ZstdDecMt_Read(CZstdDecMtHandle p, size_t *inLim)
+{
+  const Byte *data = NULL;
+  if (p->readMode)
+  {
+    data = MtDec_Read(&p->mtc, &p->readLim);
+    if (!data)
+    {
+      p->readMode = False;
+      p->readLim = 0;
+    }
+  }
+  *inLim = data ? p->readLim : 0;
+  return data;
+}
+
+#endif
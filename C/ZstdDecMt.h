@@ -0,0 +1,91 @@
+/* ZstdDecMt.h -- Zstd Decoder Multi-thread
+Igor Pavlov : Public domain */
+
+#ifndef ZIP7_INC_ZSTD_DEC_MT_H
+#define ZIP7_INC_ZSTD_DEC_MT_H
+
+#include "7zTypes.h"
+#include "ZstdDec.h"
+
+EXTERN_C_BEGIN
+
+#ifndef Z7_ST
+
+/*
+  Multi-thread zstd decoder decodes independent zstd frames in parallel.
+  The parser scans frame headers and block headers without decoding,
+  and it groups whole frames into blocks for decoding threads:
+    - output size of block is taken from (Frame_Content_Size) fields, if they are defined.
+    - otherwise it's calculated as upper bound from block headers.
+  Decoded blocks are written to output stream in original order.
+
+  If some data can't be decoded in multi-thread mode
+  (single big frame, unsupported features, data errors, junk data after frames),
+  the decoder stops multi-thread decoding at the start of such block,
+  and the caller must decode remaining data in single-thread mode:
+    - at first the caller reads buffered input data with ZstdDecMt_Read(),
+    - and then the caller continues to read data from input stream,
+      if (CZstdDecMtRes::readWasFinished == 0).
+*/
+
+typedef struct
+{
+  unsigned numThreads;
+  size_t inBufSize_MT;
+  size_t outBlockMin;   /* small frames are grouped to one block up to that size */
+  size_t outBlockMax;   /* frames with bigger output size are decoded in single-thread mode */
+  BoolInt disableHash;
+} CZstdDecMtProps;
+
+void ZstdDecMtProps_Init(CZstdDecMtProps *p);
+
+typedef struct
+{
+  UInt64 inProcessed;   /* size of input data of frames that were decoded in multi-thread mode */
+  UInt64 outProcessed;  /* size of data that was written to output stream */
+  CZstdDecInfo info;    /* info for frames that were decoded in multi-thread mode */
+  SRes readRes;
+  BoolInt readWasFinished;
+  BoolInt outSize_Reached; /* (outDataSize) was reached, and there is more data to decode */
+} CZstdDecMtRes;
+
+
+/* ---------- CZstdDecMtHandle Interface ---------- */
+
+/* ZstdDecMt_Decode() can return the following exit codes:
+SRes:
+  SZ_OK           - OK. Multi-thread decoding was finished or stopped.
+                    The caller must check remaining data with single-thread decoder.
+  SZ_ERROR_MEM    - Memory allocation error
+  SZ_ERROR_WRITE  - ISeqOutStream write callback error
+  SZ_ERROR_PROGRESS - some break from progress callback
+  SZ_ERROR_THREAD - error in multithreading functions
+*/
+
+typedef struct CZstdDecMt CZstdDecMt;
+typedef CZstdDecMt * CZstdDecMtHandle;
+
+CZstdDecMtHandle ZstdDecMt_Create(ISzAllocPtr alloc_Small, ISzAllocPtr alloc_Big, ISzAllocPtr allocMid);
+void ZstdDecMt_Destroy(CZstdDecMtHandle p);
+
+SRes ZstdDecMt_Decode(CZstdDecMtHandle p,
+    const CZstdDecMtProps *props,
+    ISeqOutStreamPtr outStream,
+    const UInt64 *outDataSize, // NULL means undefined
+    ISeqInStreamPtr inStream,
+    CZstdDecMtRes *res,
+    ICompressProgressPtr progress);
+
+/*
+ZstdDecMt_Read() returns the pointer to next chunk of input data that was read from
+input stream in ZstdDecMt_Decode(), but was not decoded in multi-thread mode.
+It returns NULL, if there is no more such data.
+The data is available until next ZstdDecMt_Read() or ZstdDecMt_Decode() call.
+*/
+const Byte *ZstdDecMt_Read(CZstdDecMtHandle p, size_t *inLim);
+
+#endif
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,2227 @@
+/* ZstdEnc.c -- Zstd Encoder
+Igor Pavlov : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "CpuArch.h"
+#include "HuffEnc.h"
+#include "LzFind.h"
+#ifndef Z7_ST
+#include "LzFindMt.h"
+#endif
+#include "Xxh64.h"
+#include "ZstdEnc.h"
+
+/*
+  The encoder writes one zstd frame (RFC 8878):
+    - LZ parsing uses LzFind (hash chain or binary tree) match finders.
+      There is no separate long-distance matcher (like "zstd --long"):
+      "long" mode is just a large window (ZSTD_ENC_WINDOW_LOG_LONG and more)
+      for same BT4 match finder, that can be multithreaded (LzFindMt).
+    - the parser is greedy / lazy / lazy2 with check of 3 repeat offsets,
+      or optimal parser (algo = 3) that selects the path with minimal price
+      in the window of (kNumOpts) bytes.
+      The prices are estimated from symbol statistics of previous sequences.
+    - literals are coded with Huffman code (1 or 4 streams) with
+      direct or FSE-compressed weights, or as RAW / RLE literals.
+    - sequences are coded with FSE: predefined, RLE or FSE_Compressed modes.
+    - blocks that can't be compressed are written as RAW or RLE blocks.
+*/
+
+#define kZstdSignature  0xFD2FB528
+
+#define kBlockSizeMax   (1u << 17)
+#define kMatchLenMin    3
+#define kMatchLenMax    (1u << 12)
+#define kFbMax          273
+#define kNumKeepBefore  16
+
+#define kBlockType_Raw         0
+#define kBlockType_RLE         1
+#define kBlockType_Compressed  2
+
+#define kLitType_Raw         0
+#define kLitType_RLE         1
+#define kLitType_Compressed  2
+
+#define kSeqMode_Predef  0
+#define kSeqMode_RLE     1
+#define kSeqMode_FSE     2
+
+#define kHufLog_Max        11
+#define kHufWeightsLog_Max  6
+
+#define FSE_LOG_MIN  5
+#define FSE_LOG_MAX  9
+#define FSE_SYMBOLS_MAX  64
+
+#define kNumLL  36
+#define kNumML  53
+#define kNumOF  32
+
+#define kLL_LogMax  9
+#define kML_LogMax  9
+#define kOF_LogMax  8
+
+#define kLL_PredefLog  6
+#define kML_PredefLog  6
+#define kOF_PredefLog  5
+
+#define kOF_PredefNum  29
+
+#define kNumReps  3
+
+#define kAlgo_Opt  3
+#define kNumOpts   (1u << 12)
+#define kInfinityPrice  ((UInt32)1 << 30)
+
+
+#if defined(MY_CPU_ARM_OR_ARM64) || defined(MY_CPU_X86_OR_AMD64)
+  #if (defined(__clang__) && (__clang_major__ >= 6)) \
+   || (defined(__GNUC__) && (__GNUC__ >= 6))
+    #define MY_clz(x)  ((unsigned)__builtin_clz((UInt32)x))
+  #elif defined(_MSC_VER) && (_MSC_VER >= 1300)
+    #if (_MSC_VER >= 1600)
+      #include <intrin.h>
+    #endif
+    #define Z7_ZSTD_ENC_USE_BSR
+  #endif
+#endif
+
+static
+Z7_FORCE_INLINE
+unsigned GetHighBit32(UInt32 num)
+{
+  // (num != 0)
+  #ifdef MY_clz
+    return 31 - MY_clz(num);
+  #elif defined(Z7_ZSTD_ENC_USE_BSR)
+  {
+    unsigned long zz;
+    _BitScanReverse(&zz, num);
+    return zz;
+  }
+  #else
+  {
+    unsigned i = 0;
+    while (num >>= 1)
+      i++;
+    return i;
+  }
+  #endif
+}
+
+
+static const Byte LL_Bits[kNumLL] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9,10,11,12,
+  13,14,15,16
+};
+
+static const UInt32 LL_Base[kNumLL] =
+{
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+  16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 0x80, 0x100, 0x200, 0x400, 0x800, 0x1000,
+  0x2000, 0x4000, 0x8000, 0x10000
+};
+
+static const Byte LL_Code[64] =
+{
+   0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,
+  16,16,17,17,18,18,19,19,20,20,20,20,21,21,21,21,
+  22,22,22,22,22,22,22,22,23,23,23,23,23,23,23,23,
+  24,24,24,24,24,24,24,24,24,24,24,24,24,24,24,24
+};
+
+static const Byte ML_Bits[kNumML] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9,10,11,
+  12,13,14,15,16
+};
+
+// (ML_Base[i] + kMatchLenMin) is base match length for code (i)
+static const UInt32 ML_Base[kNumML] =
+{
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+  16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+  32, 34, 36, 38, 40, 44, 48, 56, 64, 80, 96, 0x80, 0x100, 0x200, 0x400, 0x800,
+  0x1000, 0x2000, 0x4000, 0x8000, 0x10000
+};
+
+static const Byte ML_Code[128] =
+{
+   0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,
+  16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,
+  32,32,33,33,34,34,35,35,36,36,36,36,37,37,37,37,
+  38,38,38,38,38,38,38,38,39,39,39,39,39,39,39,39,
+  40,40,40,40,40,40,40,40,40,40,40,40,40,40,40,40,
+  41,41,41,41,41,41,41,41,41,41,41,41,41,41,41,41,
+  42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+  42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42
+};
+
+static const Int16 LL_PredefNorm[kNumLL] =
+{
+  4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+  -1,-1,-1,-1
+};
+
+static const Int16 ML_PredefNorm[kNumML] =
+{
+  1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,-1,-1,
+  -1,-1,-1,-1,-1
+};
+
+static const Int16 OF_PredefNorm[kOF_PredefNum] =
+{
+  1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,-1,-1,-1,-1,-1
+};
+
+#define GET_LL_CODE(v)  ((v) < 64  ? (unsigned)LL_Code[v] : GetHighBit32(v) + 19)
+#define GET_ML_CODE(v)  ((v) < 128 ? (unsigned)ML_Code[v] : GetHighBit32(v) + 36)
+
+
+typedef struct
+{
+  UInt32 level;
+  Byte windowLog;
+  Byte btMode;
+  Byte numHashBytes;
+  Byte algo;
+  UInt16 mc;
+  UInt16 fb;
+} CZstdEncLevel;
+
+static const CZstdEncLevel g_ZstdEncLevels[ZSTD_ENC_LEVEL_MAX] =
+{
+  /* lvl wlog bt hb algo mc  fb */
+  {  1, 19, 0, 5, 0,   2,  16 },
+  {  2, 20, 0, 5, 0,   4,  24 },
+  {  3, 21, 0, 5, 1,   6,  32 },
+  {  4, 21, 0, 4, 1,   8,  32 },
+  {  5, 21, 0, 4, 2,  12,  48 },
+  {  6, 22, 0, 4, 2,  16,  64 },
+  {  7, 22, 1, 4, 2,  16,  64 },
+  {  8, 22, 1, 4, 2,  24,  96 },
+  {  9, 23, 1, 4, 2,  32, 128 },
+  // lazy parser gives almost same ratio for bigger (mc) and (fb) values.
+  // So higher levels use optimal parser.
+  { 10, 23, 1, 4, 3,   8,  24 },
+  { 11, 23, 1, 4, 3,  12,  32 },
+  { 12, 23, 1, 4, 3,  16,  40 },
+  { 13, 24, 1, 4, 3,  24,  48 },
+  { 14, 24, 1, 4, 3,  32,  64 },
+  { 15, 24, 1, 4, 3,  48,  96 },
+  { 16, 25, 1, 4, 3,  64, 128 },
+  { 17, 25, 1, 4, 3,  96, 160 },
+  { 18, 25, 1, 4, 3, 128, 192 },
+  { 19, 26, 1, 4, 3, 192, 273 },
+  { 20, 26, 1, 3, 3, 256, 273 },
+  { 21, 27, 1, 3, 3, 384, 273 },
+  { 22, 27, 1, 3, 3, 512, 273 }
+};
+
+
+void ZstdEncProps_Init(CZstdEncProps *p)
+{
+  p->level = ZSTD_ENC_LEVEL_DEFAULT;
+  p->windowSize = 0;
+  p->btMode = -1;
+  p->numHashBytes = 0;
+  p->mc = 0;
+  p->fb = 0;
+  p->algo = -1;
+  p->checksum = 1;
+  p->numThreads = -1;
+  p->reduceSize = (UInt64)(Int64)-1;
+  p->affinity = 0;
+  p->affinityInGroup = 0;
+  p->affinityGroup = -1;
+}
+
+static unsigned GetWindowLog(UInt32 windowSize)
+{
+  unsigned i;
+  for (i = ZSTD_ENC_WINDOW_LOG_MIN; i < ZSTD_ENC_WINDOW_LOG_MAX; i++)
+    if (windowSize <= ((UInt32)1 << i))
+      break;
+  return i;
+}
+
+void ZstdEncProps_Normalize(CZstdEncProps *p)
+{
+  int level = p->level;
+  const CZstdEncLevel *lp;
+  if (level <= 0)
+    level = ZSTD_ENC_LEVEL_DEFAULT;
+  if (level > ZSTD_ENC_LEVEL_MAX)
+    level = ZSTD_ENC_LEVEL_MAX;
+  p->level = level;
+  lp = &g_ZstdEncLevels[(unsigned)level - 1];
+
+  if (p->windowSize == 0)
+    p->windowSize = (UInt32)1 << lp->windowLog;
+  else
+    p->windowSize = (UInt32)1 << GetWindowLog(p->windowSize);
+
+  if (p->reduceSize != (UInt64)(Int64)-1)
+  {
+    unsigned i;
+    for (i = ZSTD_ENC_WINDOW_LOG_MIN; i < ZSTD_ENC_WINDOW_LOG_MAX; i++)
+      if (p->reduceSize <= ((UInt32)1 << i))
+        break;
+    if (p->windowSize > ((UInt32)1 << i))
+      p->windowSize = ((UInt32)1 << i);
+  }
+
+  if (p->btMode < 0)
+    p->btMode = (p->windowSize >= ((UInt32)1 << ZSTD_ENC_WINDOW_LOG_LONG) ? 1 : lp->btMode);
+  if (p->numHashBytes == 0)
+    p->numHashBytes = lp->numHashBytes;
+  if (p->btMode)
+  {
+    if (p->numHashBytes < 2) p->numHashBytes = 2;
+    if (p->numHashBytes > 5) p->numHashBytes = 5;
+  }
+  else
+  {
+    if (p->numHashBytes < 4) p->numHashBytes = 4;
+    if (p->numHashBytes > 5) p->numHashBytes = 5;
+  }
+  if (p->mc == 0)
+    p->mc = lp->mc;
+  if (p->fb <= 0)
+    p->fb = lp->fb;
+  if (p->fb < 8)
+    p->fb = 8;
+  if (p->fb > kFbMax)
+    p->fb = kFbMax;
+  if (p->algo < 0)
+    p->algo = lp->algo;
+  if (p->algo > kAlgo_Opt)
+    p->algo = kAlgo_Opt;
+  if (p->numThreads < 0)
+  {
+    p->numThreads =
+      #ifndef Z7_ST
+        (p->btMode ? 2 : 1);
+      #else
+        1;
+      #endif
+  }
+}
+
+UInt32 ZstdEncProps_GetWindowSize(const CZstdEncProps *props2)
+{
+  CZstdEncProps props = *props2;
+  ZstdEncProps_Normalize(&props);
+  return props.windowSize;
+}
+
+
+/* ---------- FSE and Huffman coding ---------- */
+
+typedef struct
+{
+  Int32 deltaFindState;
+  UInt32 deltaNbBits;
+} CFseSymbolTT;
+
+typedef struct
+{
+  unsigned tableLog;
+  UInt16 stateTable[1 << FSE_LOG_MAX];
+  CFseSymbolTT symbolTT[FSE_SYMBOLS_MAX];
+} CFseCTable;
+
+typedef struct
+{
+  UInt64 bits;
+  unsigned num;
+  BoolInt overflow;
+  Byte *cur;
+  Byte *lim; // (lim - 8) is last position for 8-bytes write
+} CBitOut;
+
+static void BitOut_Init(CBitOut *p, Byte *buf, Byte *lim)
+{
+  p->bits = 0;
+  p->num = 0;
+  p->overflow = False;
+  p->cur = buf;
+  p->lim = lim;
+}
+
+#define BITOUT_ADD(p, v, n) { \
+  (p)->bits |= (UInt64)((v) & (((UInt32)1 << (n)) - 1)) << (p)->num; \
+  (p)->num += (n); }
+
+static
+Z7_FORCE_INLINE
+void BitOut_Flush(CBitOut *p)
+{
+  const unsigned nb = p->num >> 3;
+  if ((size_t)(p->lim - p->cur) < 8)
+  {
+    p->overflow = True;
+    p->cur = p->lim - 8;
+  }
+  SetUi64(p->cur, p->bits)
+  p->cur += nb;
+  p->bits >>= nb * 8;
+  p->num &= 7;
+}
+
+// returns the pointer after last written byte or NULL
+static Byte *BitOut_Close(CBitOut *p)
+{
+  BITOUT_ADD(p, 1, 1)
+  BitOut_Flush(p);
+  if (p->overflow)
+    return NULL;
+  return p->cur + (p->num != 0);
+}
+
+
+#define FSE_INIT_STATE(ct, state, sym) { \
+  const CFseSymbolTT tt = (ct)->symbolTT[sym]; \
+  const unsigned nbOut = (unsigned)((tt.deltaNbBits + (1u << 15)) >> 16); \
+  state = (nbOut << 16) - tt.deltaNbBits; \
+  state = (ct)->stateTable[(Int32)(state >> nbOut) + tt.deltaFindState]; }
+
+#define FSE_ENCODE(bo, ct, state, sym) { \
+  const CFseSymbolTT tt = (ct)->symbolTT[sym]; \
+  const unsigned nbOut = (unsigned)((state + tt.deltaNbBits) >> 16); \
+  BITOUT_ADD(bo, state, nbOut) \
+  state = (ct)->stateTable[(Int32)(state >> nbOut) + tt.deltaFindState]; }
+
+#define FSE_FLUSH_STATE(bo, ct, state)  BITOUT_ADD(bo, state, (ct)->tableLog)
+
+
+static void Fse_BuildCTable(CFseCTable *ct, const Int16 *norm, unsigned maxSymbol, unsigned tableLog)
+{
+  const unsigned tableSize = (unsigned)1 << tableLog;
+  const unsigned tableMask = tableSize - 1;
+  const unsigned step = (tableSize >> 1) + (tableSize >> 3) + 3;
+  unsigned highThreshold = tableSize - 1;
+  unsigned cumul[FSE_SYMBOLS_MAX + 1];
+  Byte tableSymbol[1 << FSE_LOG_MAX];
+  unsigned s, u;
+
+  ct->tableLog = tableLog;
+  cumul[0] = 0;
+  for (u = 1; u <= maxSymbol + 1; u++)
+  {
+    if (norm[u - 1] == -1)
+    {
+      cumul[u] = cumul[u - 1] + 1;
+      tableSymbol[highThreshold--] = (Byte)(u - 1);
+    }
+    else
+      cumul[u] = cumul[u - 1] + (unsigned)norm[u - 1];
+  }
+  {
+    unsigned pos = 0;
+    for (s = 0; s <= maxSymbol; s++)
+    {
+      int n;
+      for (n = 0; n < norm[s]; n++)
+      {
+        tableSymbol[pos] = (Byte)s;
+        do
+          pos = (pos + step) & tableMask;
+        while (pos > highThreshold);
+      }
+    }
+  }
+  for (u = 0; u < tableSize; u++)
+  {
+    const unsigned sym = tableSymbol[u];
+    ct->stateTable[cumul[sym]++] = (UInt16)(tableSize + u);
+  }
+  {
+    unsigned total = 0;
+    for (s = 0; s <= maxSymbol; s++)
+    {
+      CFseSymbolTT *tt = &ct->symbolTT[s];
+      const int n = norm[s];
+      if (n == 0)
+      {
+        tt->deltaNbBits = ((tableLog + 1) << 16) - tableSize;
+        tt->deltaFindState = 0;
+      }
+      else if (n == -1 || n == 1)
+      {
+        tt->deltaNbBits = (tableLog << 16) - tableSize;
+        tt->deltaFindState = (Int32)total - 1;
+        total++;
+      }
+      else
+      {
+        const unsigned maxBitsOut = tableLog - GetHighBit32((UInt32)n - 1);
+        const UInt32 minStatePlus = (UInt32)n << maxBitsOut;
+        tt->deltaNbBits = ((UInt32)maxBitsOut << 16) - minStatePlus;
+        tt->deltaFindState = (Int32)total - n;
+        total += (unsigned)n;
+      }
+    }
+  }
+}
+
+
+static void Fse_BuildCTable_RLE(CFseCTable *ct, unsigned symbol)
+{
+  ct->tableLog = 0;
+  ct->stateTable[0] = 0;
+  ct->stateTable[1] = 0;
+  ct->symbolTT[symbol].deltaNbBits = 0;
+  ct->symbolTT[symbol].deltaFindState = 0;
+}
+
+
+static unsigned Fse_OptimalTableLog(unsigned maxLog, UInt32 total, unsigned maxSymbol)
+{
+  unsigned tableLog = maxLog;
+  if (total > 4)
+  {
+    const unsigned maxBitsSrc = GetHighBit32(total - 1) - 2;
+    if (tableLog > maxBitsSrc)
+      tableLog = maxBitsSrc;
+  }
+  {
+    const unsigned minBitsSrc = GetHighBit32(total) + 1;
+    const unsigned minBitsSymbols = GetHighBit32(maxSymbol | 1) + 2;
+    const unsigned minBits = minBitsSrc < minBitsSymbols ? minBitsSrc : minBitsSymbols;
+    if (tableLog < minBits)
+      tableLog = minBits;
+  }
+  if (tableLog < FSE_LOG_MIN)
+    tableLog = FSE_LOG_MIN;
+  if (tableLog > maxLog)
+    tableLog = maxLog;
+  return tableLog;
+}
+
+
+/*
+  Fse_Normalize() scales (counts) to the sum (1 << tableLog).
+  Each used symbol gets at least one state.
+  Rounding difference is corrected by symbols with minimal cost change.
+*/
+static void Fse_Normalize(Int16 *norm, unsigned tableLog,
+    const UInt32 *counts, UInt32 total, unsigned maxSymbol)
+{
+  const UInt32 tableSize = (UInt32)1 << tableLog;
+  UInt32 sum = 0;
+  unsigned s;
+  for (s = 0; s <= maxSymbol; s++)
+  {
+    const UInt32 c = counts[s];
+    UInt32 v = 0;
+    if (c != 0)
+    {
+      v = (UInt32)((((UInt64)c << tableLog) + (total >> 1)) / total);
+      if (v == 0)
+        v = 1;
+    }
+    norm[s] = (Int16)v;
+    sum += v;
+  }
+  while (sum > tableSize)
+  {
+    // we reduce the symbol, where (count / (norm - 1)) is minimal
+    unsigned best = 0;
+    UInt32 bestC = 0, bestN = 0;
+    for (s = 0; s <= maxSymbol; s++)
+    {
+      const UInt32 n = (UInt32)norm[s];
+      if ((Int32)n > 1)
+      {
+        const UInt32 c = counts[s];
+        if (bestN == 0 || (UInt64)c * bestN < (UInt64)bestC * (n - 1))
+        {
+          best = s;
+          bestC = c;
+          bestN = n - 1;
+        }
+      }
+    }
+    norm[best]--;
+    sum--;
+  }
+  while (sum < tableSize)
+  {
+    // we increase the symbol, where (count / norm) is maximal
+    unsigned best = 0;
+    UInt32 bestC = 0, bestN = 0;
+    for (s = 0; s <= maxSymbol; s++)
+    {
+      const UInt32 n = (UInt32)norm[s];
+      if (n != 0)
+      {
+        const UInt32 c = counts[s];
+        if (bestN == 0 || (UInt64)c * bestN > (UInt64)bestC * n)
+        {
+          best = s;
+          bestC = c;
+          bestN = n;
+        }
+      }
+    }
+    norm[best]++;
+    sum++;
+  }
+}
+
+
+// returns the size of written header or 0, if there is no space in (dest)
+static size_t Fse_WriteNCount(Byte *dest, size_t destSize,
+    const Int16 *norm, unsigned maxSymbol, unsigned tableLog)
+{
+  const int tableSize = 1 << tableLog;
+  Byte *out = dest;
+  const Byte *lim = dest + destSize;
+  UInt32 bitStream = (UInt32)(tableLog - FSE_LOG_MIN);
+  unsigned bitCount = 4;
+  int remaining = tableSize + 1;
+  int threshold = tableSize;
+  unsigned nbBits = tableLog + 1;
+  unsigned symbol = 0;
+  BoolInt previousIs0 = False;
+
+  #define NCOUNT_FLUSH16 \
+    if (bitCount >= 16) { \
+      if (lim - out < 2) return 0; \
+      out[0] = (Byte)bitStream; \
+      out[1] = (Byte)(bitStream >> 8); \
+      out += 2; \
+      bitStream >>= 16; \
+      bitCount -= 16; }
+
+  while (symbol <= maxSymbol && remaining > 1)
+  {
+    if (previousIs0)
+    {
+      unsigned start = symbol;
+      while (symbol <= maxSymbol && norm[symbol] == 0)
+        symbol++;
+      if (symbol > maxSymbol)
+        break;
+      while (symbol >= start + 24)
+      {
+        start += 24;
+        bitStream += (UInt32)0xFFFF << bitCount;
+        if (lim - out < 2)
+          return 0;
+        out[0] = (Byte)bitStream;
+        out[1] = (Byte)(bitStream >> 8);
+        out += 2;
+        bitStream >>= 16;
+      }
+      while (symbol >= start + 3)
+      {
+        start += 3;
+        bitStream += (UInt32)3 << bitCount;
+        bitCount += 2;
+      }
+      bitStream += (UInt32)(symbol - start) << bitCount;
+      bitCount += 2;
+      NCOUNT_FLUSH16
+    }
+    {
+      int count = norm[symbol++];
+      const int max = (2 * threshold - 1) - remaining;
+      remaining -= count < 0 ? -count : count;
+      count++;
+      if (count >= threshold)
+        count += max;
+      bitStream += (UInt32)count << bitCount;
+      bitCount += nbBits;
+      bitCount -= (count < max);
+      previousIs0 = (count == 1);
+      if (remaining < 1)
+        return 0;
+      while (remaining < threshold)
+      {
+        nbBits--;
+        threshold >>= 1;
+      }
+    }
+    NCOUNT_FLUSH16
+  }
+  if (remaining != 1)
+    return 0;
+  if (lim - out < 2)
+    return 0;
+  out[0] = (Byte)bitStream;
+  out[1] = (Byte)(bitStream >> 8);
+  out += (bitCount + 7) / 8;
+  return (size_t)(out - dest);
+}
+
+
+// returns (log2(v) * 256) approximation
+static UInt32 Log2_Fixed8(UInt32 v)
+{
+  const unsigned hb = GetHighBit32(v);
+  UInt32 frac;
+  if (hb >= 8)
+    frac = (v >> (hb - 8)) & 0xFF;
+  else
+    frac = (v << (8 - hb)) & 0xFF;
+  return ((UInt32)hb << 8) + frac;
+}
+
+// returns the cost (in 1/256 bits) of symbols for (norm) table
+static UInt64 Fse_GetCost(const UInt32 *counts, unsigned maxSymbol,
+    const Int16 *norm, unsigned tableLog)
+{
+  UInt64 cost = 0;
+  unsigned s;
+  for (s = 0; s <= maxSymbol; s++)
+  {
+    const UInt32 c = counts[s];
+    if (c != 0)
+    {
+      int n = norm[s];
+      if (n == 0)
+        return (UInt64)(Int64)-1;
+      if (n < 0)
+        n = 1;
+      cost += (UInt64)c * (((UInt32)tableLog << 8) - Log2_Fixed8((UInt32)n));
+    }
+  }
+  return cost;
+}
+
+
+/* ---------- CZstdEnc ---------- */
+
+typedef struct
+{
+  UInt32 litLen;
+  UInt32 matchLen;
+  UInt32 offBase; // (offset + kNumReps) or repeat code (1 ... 3)
+} CZstdEncSeq;
+
+typedef struct
+{
+  UInt32 len;
+  UInt32 dist;
+} CZstdEncCand;
+
+typedef struct
+{
+  UInt32 len;
+  UInt32 offBase;
+  Int32 gain;
+} CZstdEncMatch;
+
+// the node of optimal parser
+typedef struct
+{
+  UInt32 price;   // (1/256 bits). After backtracking it's the index of next node in path
+  UInt32 litLen;  // the number of literals after last match
+  UInt32 len;     // the length of last match, or 0 for literal
+  UInt32 offBase;
+  UInt32 reps[kNumReps];
+} CZstdEncOpt;
+
+// the statistics and prices (in 1/256 bits) for optimal parser
+typedef struct
+{
+  UInt32 litSum;
+  UInt32 llSum;
+  UInt32 mlSum;
+  UInt32 ofSum;
+  BoolInt pricesAreValid;
+  UInt32 litFreqs[256];
+  UInt32 llFreqs[kNumLL];
+  UInt32 mlFreqs[kNumML];
+  UInt32 ofFreqs[kNumOF];
+  UInt32 litPrices[256];
+  UInt32 llPrices[kNumLL];
+  UInt32 mlPrices[kNumML];
+  UInt32 ofPrices[kNumOF];
+} CZstdEncOptStat;
+
+#define kNumSeqsMax  (kBlockSizeMax / kMatchLenMin + 1)
+#define kOutBufSize  (kBlockSizeMax + (1 << 10))
+
+struct CZstdEnc
+{
+  void *matchFinderObj;
+  IMatchFinder2 matchFinder;
+
+  unsigned ahead; // the number of positions that match finder was moved after current position
+  CZstdEncCand cands[2];
+  UInt32 reps[kNumReps];
+
+  UInt64 pos64;   // position of current byte in frame
+  UInt64 inProcessed;
+  UInt64 outProcessed;
+  BoolInt finished;
+
+  UInt32 windowSize;
+  UInt32 blockSizeMax;
+  unsigned fb;
+  unsigned algo;
+  unsigned minMatchLen;
+  BoolInt checksum;
+
+  UInt32 numLits;
+  UInt32 numSeqs;
+
+  Byte *lits;
+  Byte *raw;
+  Byte *outBuf;
+  CZstdEncSeq *seqs;
+  Byte *llCodes;
+  Byte *mlCodes;
+  Byte *ofCodes;
+  CZstdEncOpt *opt;
+  BoolInt optStatIsInited;
+
+  ISzAllocPtr alloc;
+  ISzAllocPtr allocBig;
+  ISeqOutStreamPtr outStream;
+
+  CZstdEncProps props;
+  CXxh64 xxh;
+
+  CFseCTable fseTables[3];
+  CZstdEncOptStat optStat;
+  UInt32 matches[kFbMax * 2 + 2];
+
+  #ifndef Z7_ST
+  BoolInt mtMode;
+  // begin of CMatchFinderMt is used in LZ thread
+  CMatchFinderMt matchFinderMt;
+  // end of CMatchFinderMt is used in BT and HASH threads
+  #endif
+
+  CMatchFinder matchFinderBase;
+};
+
+#define MFB (p->matchFinderBase)
+
+#define MF_AVAIL(p)  (p)->matchFinder.GetNumAvailableBytes((p)->matchFinderObj)
+#define MF_CUR(p)    (p)->matchFinder.GetPointerToCurrentPos((p)->matchFinderObj)
+
+
+CZstdEncHandle ZstdEnc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  CZstdEnc *p = (CZstdEnc *)ISzAlloc_Alloc(alloc, sizeof(CZstdEnc));
+  if (!p)
+    return NULL;
+  p->alloc = alloc;
+  p->allocBig = allocBig;
+  p->lits = NULL;
+  p->raw = NULL;
+  p->outBuf = NULL;
+  p->seqs = NULL;
+  p->llCodes = NULL;
+  p->opt = NULL;
+  p->inProcessed = 0;
+  MatchFinder_Construct(&MFB);
+  #ifndef Z7_ST
+  p->mtMode = False;
+  p->matchFinderMt.MatchFinder = &MFB;
+  MatchFinderMt_Construct(&p->matchFinderMt);
+  #endif
+  ZstdEncProps_Init(&p->props);
+  ZstdEncProps_Normalize(&p->props);
+  return p;
+}
+
+
+static void ZstdEnc_FreeBufs(CZstdEnc *p)
+{
+  ISzAlloc_Free(p->allocBig, p->lits);
+  ISzAlloc_Free(p->allocBig, p->seqs);
+  ISzAlloc_Free(p->allocBig, p->llCodes);
+  ISzAlloc_Free(p->allocBig, p->opt);
+  p->lits = NULL;
+  p->raw = NULL;
+  p->outBuf = NULL;
+  p->seqs = NULL;
+  p->llCodes = NULL;
+  p->mlCodes = NULL;
+  p->ofCodes = NULL;
+  p->opt = NULL;
+}
+
+
+void ZstdEnc_Destroy(CZstdEncHandle p)
+{
+  #ifndef Z7_ST
+  MatchFinderMt_Destruct(&p->matchFinderMt, p->allocBig);
+  #endif
+  MatchFinder_Free(&MFB, p->allocBig);
+  ZstdEnc_FreeBufs(p);
+  ISzAlloc_Free(p->alloc, p);
+}
+
+
+SRes ZstdEnc_SetProps(CZstdEncHandle p, const CZstdEncProps *props2)
+{
+  CZstdEncProps props = *props2;
+  if (props.level > ZSTD_ENC_LEVEL_MAX
+      || props.windowSize > ((UInt32)1 << ZSTD_ENC_WINDOW_LOG_MAX)
+      || props.numHashBytes > 5
+      || props.algo > kAlgo_Opt)
+    return SZ_ERROR_PARAM;
+  p->props = props;
+  return SZ_OK;
+}
+
+
+void ZstdEnc_SetDataSize(CZstdEncHandle p, UInt64 expectedDataSiize)
+{
+  MFB.expectedDataSize = expectedDataSiize;
+}
+
+
+UInt64 ZstdEnc_GetInProcessed(const CZstdEnc *p)
+{
+  return p->inProcessed;
+}
+
+
+static SRes ZstdEnc_Alloc(CZstdEnc *p, const CZstdEncProps *props)
+{
+  // optimal parser reads the data of full window of nodes behind current position
+  const UInt32 keepBefore = (props->algo == kAlgo_Opt) ?
+      kNumOpts + kMatchLenMax : kNumKeepBefore;
+
+  if (props->algo == kAlgo_Opt && !p->opt)
+  {
+    p->opt = (CZstdEncOpt *)ISzAlloc_Alloc(p->allocBig,
+        (kNumOpts + kMatchLenMax + 1) * sizeof(CZstdEncOpt));
+    if (!p->opt)
+      return SZ_ERROR_MEM;
+  }
+
+  if (!p->lits)
+  {
+    p->lits = (Byte *)ISzAlloc_Alloc(p->allocBig, kBlockSizeMax * 2 + kOutBufSize);
+    p->seqs = (CZstdEncSeq *)ISzAlloc_Alloc(p->allocBig, kNumSeqsMax * sizeof(CZstdEncSeq));
+    p->llCodes = (Byte *)ISzAlloc_Alloc(p->allocBig, kNumSeqsMax * 3);
+    if (!p->lits || !p->seqs || !p->llCodes)
+    {
+      ZstdEnc_FreeBufs(p);
+      return SZ_ERROR_MEM;
+    }
+    p->raw = p->lits + kBlockSizeMax;
+    p->outBuf = p->raw + kBlockSizeMax;
+    p->mlCodes = p->llCodes + kNumSeqsMax;
+    p->ofCodes = p->mlCodes + kNumSeqsMax;
+  }
+
+  MFB.btMode = (Byte)(props->btMode ? 1 : 0);
+  MFB.numHashBytes = (UInt32)props->numHashBytes;
+  MFB.cutValue = props->mc;
+  MFB.bigHash = (Byte)(props->windowSize > ((UInt32)1 << 24) ? 1 : 0);
+
+  #ifndef Z7_ST
+  p->mtMode = (props->numThreads > 1 && MFB.btMode);
+  p->matchFinderMt.btSync.affinity =
+  p->matchFinderMt.hashSync.affinity = props->affinity;
+  p->matchFinderMt.btSync.affinityGroup =
+  p->matchFinderMt.hashSync.affinityGroup = props->affinityGroup;
+  p->matchFinderMt.btSync.affinityInGroup =
+  p->matchFinderMt.hashSync.affinityInGroup = props->affinityInGroup;
+  if (p->mtMode)
+  {
+    RINOK(MatchFinderMt_Create(&p->matchFinderMt, props->windowSize, keepBefore,
+        (UInt32)props->fb, kMatchLenMax + 1, p->allocBig))
+    p->matchFinderObj = &p->matchFinderMt;
+    MFB.bigHash = (Byte)(MFB.hashMask >= 0xFFFFFF ? 1 : 0);
+    MatchFinderMt_CreateVTable(&p->matchFinderMt, &p->matchFinder);
+  }
+  else
+  #endif
+  {
+    if (!MatchFinder_Create(&MFB, props->windowSize, keepBefore,
+        (UInt32)props->fb, kMatchLenMax + 1, p->allocBig))
+      return SZ_ERROR_MEM;
+    p->matchFinderObj = &MFB;
+    MatchFinder_CreateVTable(&MFB, &p->matchFinder);
+  }
+  return SZ_OK;
+}
+
+
+static SRes ZstdEnc_CheckErrors(CZstdEnc *p)
+{
+  #ifndef Z7_ST
+  if (p->mtMode && p->matchFinderMt.failure_LZ_BT)
+    return SZ_ERROR_FAIL;
+  #endif
+  if (MFB.result != SZ_OK)
+    return SZ_ERROR_READ;
+  return SZ_OK;
+}
+
+
+/* ---------- LZ parsing ---------- */
+
+// it reads matches for the position of match finder and moves match finder to next position
+static void ZstdEnc_ReadMatch(CZstdEnc *p, CZstdEncCand *cand)
+{
+  const UInt32 numAvail = MF_AVAIL(p);
+  const UInt32 *d = p->matchFinder.GetMatches(p->matchFinderObj, p->matches);
+  const unsigned numPairs = (unsigned)(d - p->matches);
+  unsigned i;
+  UInt32 bestLen = 0, bestDist = 0;
+  Int32 bestGain = 0;
+
+  p->ahead++;
+  for (i = 0; i < numPairs; i += 2)
+  {
+    const UInt32 len = p->matches[i];
+    const UInt32 dist = p->matches[(size_t)i + 1] + 1;
+    Int32 gain;
+    if (len < p->minMatchLen)
+      continue;
+    if (len == kMatchLenMin && dist >= (1u << 12))
+      continue;
+    gain = (Int32)(len * 4) - (Int32)GetHighBit32(dist + kNumReps);
+    if (gain >= bestGain)
+    {
+      bestGain = gain;
+      bestLen = len;
+      bestDist = dist;
+    }
+  }
+  if (bestLen == p->fb && i != 0 && bestLen == p->matches[(size_t)numPairs - 2])
+  {
+    UInt32 lim = numAvail;
+    if (lim > kMatchLenMax)
+      lim = kMatchLenMax;
+    {
+      const Byte *p1 = MF_CUR(p) - 1;
+      const Byte *p2 = p1 + bestLen;
+      const Byte *pLim = p1 + lim;
+      const ptrdiff_t dif = -(ptrdiff_t)bestDist;
+      for (; p2 != pLim && *p2 == p2[dif]; p2++)
+      {}
+      bestLen = (UInt32)(p2 - p1);
+    }
+  }
+  cand->len = bestLen;
+  cand->dist = bestDist;
+}
+
+
+/*
+  ZstdEnc_Evaluate() selects the best match for position (cur + index),
+  where (cur) is current position of parser.
+  (cands[index]) must contain the match from match finder for that position.
+*/
+static void ZstdEnc_Evaluate(CZstdEnc *p, unsigned index, UInt32 litLen, UInt32 rem, CZstdEncMatch *m)
+{
+  const Byte *data = MF_CUR(p) - p->ahead + index;
+  UInt32 lim = MF_AVAIL(p) + p->ahead - index;
+  const UInt64 pos = p->pos64 + index;
+  unsigned k;
+
+  if (lim > rem)
+    lim = rem;
+  if (lim > kMatchLenMax)
+    lim = kMatchLenMax;
+
+  m->len = 0;
+  m->offBase = 0;
+  m->gain = 0;
+  {
+    const CZstdEncCand *cand = &p->cands[index];
+    UInt32 len = cand->len;
+    if (len > lim)
+      len = lim;
+    if (len >= p->minMatchLen)
+    {
+      m->len = len;
+      m->offBase = cand->dist + kNumReps;
+      m->gain = (Int32)(len * 4) - (Int32)GetHighBit32(m->offBase);
+    }
+  }
+
+  if (lim < kMatchLenMin)
+    return;
+
+  for (k = 0; k < kNumReps; k++)
+  {
+    const unsigned repCode = k + (litLen == 0);
+    const UInt32 off = (repCode == kNumReps) ? p->reps[0] - 1 : p->reps[repCode];
+    const Byte *p2;
+    UInt32 len;
+    Int32 gain;
+    if (off == 0 || off > pos || off > p->windowSize)
+      continue;
+    p2 = data - off;
+    if (data[0] != p2[0] || data[1] != p2[1] || data[2] != p2[2])
+      continue;
+    for (len = kMatchLenMin; len < lim && data[len] == p2[len]; len++)
+    {}
+    gain = (Int32)(len * 4) - (Int32)GetHighBit32(k + 1) + 1;
+    if (gain > m->gain)
+    {
+      m->len = len;
+      m->offBase = k + 1;
+      m->gain = gain;
+    }
+  }
+}
+
+
+static void ZstdEnc_UpdateReps(UInt32 *reps, UInt32 litLen, UInt32 offBase)
+{
+  if (offBase > kNumReps)
+  {
+    reps[2] = reps[1];
+    reps[1] = reps[0];
+    reps[0] = offBase - kNumReps;
+  }
+  else
+  {
+    const unsigned repCode = (unsigned)offBase - 1 + (litLen == 0);
+    if (repCode != 0)
+    {
+      const UInt32 cur = (repCode == kNumReps) ? reps[0] - 1 : reps[repCode];
+      if (repCode >= 2)
+        reps[2] = reps[1];
+      reps[1] = reps[0];
+      reps[0] = cur;
+    }
+  }
+}
+
+
+static void ZstdEnc_AddSeq(CZstdEnc *p, UInt32 litLen, UInt32 matchLen, UInt32 offBase)
+{
+  CZstdEncSeq *seq = &p->seqs[p->numSeqs++];
+  seq->litLen = litLen;
+  seq->matchLen = matchLen;
+  seq->offBase = offBase;
+  ZstdEnc_UpdateReps(p->reps, litLen, offBase);
+}
+
+
+/*
+  ZstdEnc_ParseBlock() fills literals and sequences for one block.
+  returns the size of block.
+*/
+static UInt32 ZstdEnc_ParseBlock(CZstdEnc *p)
+{
+  const UInt32 blockSizeMax = p->blockSizeMax;
+  UInt32 blockPos = 0;
+  UInt32 litLen = 0;
+
+  p->numLits = 0;
+  p->numSeqs = 0;
+
+  for (;;)
+  {
+    CZstdEncMatch m;
+    UInt32 rem = blockSizeMax - blockPos;
+    if (rem == 0)
+      break;
+    if (p->ahead == 0)
+    {
+      if (MF_AVAIL(p) == 0)
+      {
+        p->finished = True;
+        break;
+      }
+      ZstdEnc_ReadMatch(p, &p->cands[0]);
+    }
+
+    ZstdEnc_Evaluate(p, 0, litLen, rem, &m);
+
+    if (m.len != 0)
+    {
+      unsigned depth = 0;
+      while (depth < p->algo && m.len < p->fb && rem > 1)
+      {
+        CZstdEncMatch m2;
+        if (p->ahead == 1)
+        {
+          if (MF_AVAIL(p) == 0)
+            break;
+          ZstdEnc_ReadMatch(p, &p->cands[1]);
+        }
+        ZstdEnc_Evaluate(p, 1, litLen + 1, rem - 1, &m2);
+        if (m2.len == 0 || m2.gain <= m.gain + (depth == 0 ? 4 : 7))
+          break;
+        {
+          const Byte b = *(MF_CUR(p) - p->ahead);
+          p->lits[p->numLits++] = b;
+          p->raw[blockPos++] = b;
+        }
+        litLen++;
+        rem--;
+        p->pos64++;
+        p->cands[0] = p->cands[1];
+        p->ahead--;
+        m = m2;
+        depth++;
+      }
+    }
+
+    if (m.len == 0)
+    {
+      const Byte b = *(MF_CUR(p) - p->ahead);
+      p->lits[p->numLits++] = b;
+      p->raw[blockPos++] = b;
+      litLen++;
+      p->pos64++;
+      p->ahead = 0;
+      continue;
+    }
+
+    memcpy(p->raw + blockPos, MF_CUR(p) - p->ahead, m.len);
+    blockPos += m.len;
+    p->pos64 += m.len;
+    ZstdEnc_AddSeq(p, litLen, m.len, m.offBase);
+    litLen = 0;
+    {
+      const UInt32 skip = m.len - p->ahead;
+      p->ahead = 0;
+      if (skip != 0)
+        p->matchFinder.Skip(p->matchFinderObj, skip);
+    }
+  }
+  return blockPos;
+}
+
+
+/* ---------- Optimal parser ---------- */
+
+static const Byte k_Opt_LL_BaseFreqs[kNumLL] =
+{
+  4, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1
+};
+
+static const Byte k_Opt_OF_BaseFreqs[kNumOF] =
+{
+  6, 2, 1, 1, 2, 3, 4, 4, 4, 3, 2, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+// it reduces the frequencies to the sum of about (1 << logTarget). It returns new sum.
+static UInt32 Opt_ScaleFreqs(UInt32 *freqs, unsigned num, unsigned logTarget)
+{
+  UInt32 sum = 0;
+  unsigned i, shift = 0;
+  for (i = 0; i < num; i++)
+    sum += freqs[i];
+  if (sum > ((UInt32)2 << logTarget))
+    shift = GetHighBit32(sum) - logTarget;
+  sum = 0;
+  for (i = 0; i < num; i++)
+  {
+    const UInt32 v = 1 + (freqs[i] >> shift);
+    freqs[i] = v;
+    sum += v;
+  }
+  return sum;
+}
+
+
+/*
+  ZstdEnc_Opt_InitBlock() prepares the statistics at the start of block.
+  The statistics of first block are initialized from the data of block.
+  Next blocks use reduced statistics of previous blocks.
+*/
+static void ZstdEnc_Opt_InitBlock(CZstdEnc *p)
+{
+  CZstdEncOptStat *s = &p->optStat;
+  unsigned i;
+  if (!p->optStatIsInited)
+  {
+    const Byte *data = MF_CUR(p);
+    UInt32 size = MF_AVAIL(p);
+    UInt32 k;
+    if (size > p->blockSizeMax)
+      size = p->blockSizeMax;
+    for (i = 0; i < 256; i++)
+      s->litFreqs[i] = 0;
+    for (k = 0; k < size; k++)
+      s->litFreqs[data[k]]++;
+    for (i = 0; i < 256; i++)
+      s->litFreqs[i] >>= 4;
+    for (i = 0; i < kNumLL; i++)
+      s->llFreqs[i] = k_Opt_LL_BaseFreqs[i];
+    for (i = 0; i < kNumML; i++)
+      s->mlFreqs[i] = 1;
+    for (i = 0; i < kNumOF; i++)
+      s->ofFreqs[i] = k_Opt_OF_BaseFreqs[i];
+    p->optStatIsInited = True;
+  }
+  s->litSum = Opt_ScaleFreqs(s->litFreqs, 256, 12);
+  s->llSum = Opt_ScaleFreqs(s->llFreqs, kNumLL, 10);
+  s->mlSum = Opt_ScaleFreqs(s->mlFreqs, kNumML, 10);
+  s->ofSum = Opt_ScaleFreqs(s->ofFreqs, kNumOF, 10);
+  s->pricesAreValid = False;
+}
+
+
+static void Opt_SetPrices(UInt32 *prices, const UInt32 *freqs, unsigned num,
+    UInt32 sum, const Byte *extraBits, UInt32 maxPrice)
+{
+  const UInt32 sumLog = Log2_Fixed8(sum);
+  unsigned i;
+  for (i = 0; i < num; i++)
+  {
+    UInt32 price = sumLog - Log2_Fixed8(freqs[i]);
+    if (price > maxPrice)
+      price = maxPrice;
+    if (extraBits)
+      price += (UInt32)extraBits[i] << 8;
+    prices[i] = price;
+  }
+}
+
+
+static void ZstdEnc_Opt_SetPrices(CZstdEncOptStat *s)
+{
+  unsigned i;
+  Opt_SetPrices(s->litPrices, s->litFreqs, 256, s->litSum, NULL, kHufLog_Max << 8);
+  Opt_SetPrices(s->llPrices, s->llFreqs, kNumLL, s->llSum, LL_Bits, kLL_LogMax << 8);
+  Opt_SetPrices(s->mlPrices, s->mlFreqs, kNumML, s->mlSum, ML_Bits, kML_LogMax << 8);
+  Opt_SetPrices(s->ofPrices, s->ofFreqs, kNumOF, s->ofSum, NULL, kOF_LogMax << 8);
+  // the number of extra bits of offset code is equal to code
+  for (i = 0; i < kNumOF; i++)
+    s->ofPrices[i] += (UInt32)i << 8;
+  s->pricesAreValid = True;
+}
+
+
+#define OPT_LL_PRICE(s, litLen)  ((s)->llPrices[GET_LL_CODE(litLen)])
+#define OPT_MATCH_PRICE(s, offBase, len) \
+  ((s)->ofPrices[GetHighBit32(offBase)] + (s)->mlPrices[GET_ML_CODE((len) - kMatchLenMin)])
+
+
+/*
+  it reads all matches for current position of match finder
+  and moves match finder to next position.
+  Match finder returns the pairs (len, dist - 1) with increasing lengths.
+  Longest match is extended up to (lim), if it reaches (fb) limit of match finder.
+  It returns the number of UInt32 values in (p->matches).
+*/
+static unsigned ZstdEnc_Opt_ReadMatches(CZstdEnc *p, UInt32 lim)
+{
+  const UInt32 numAvail = MF_AVAIL(p);
+  const UInt32 *d = p->matchFinder.GetMatches(p->matchFinderObj, p->matches);
+  const unsigned numPairs = (unsigned)(d - p->matches);
+  if (numPairs != 0)
+  {
+    UInt32 len = p->matches[(size_t)numPairs - 2];
+    if (len == p->fb)
+    {
+      if (lim > numAvail)
+        lim = numAvail;
+      if (lim > kMatchLenMax)
+        lim = kMatchLenMax;
+      if (len < lim)
+      {
+        const Byte *p1 = MF_CUR(p) - 1;
+        const Byte *p2 = p1 + len;
+        const Byte *pLim = p1 + lim;
+        const ptrdiff_t dif = -(ptrdiff_t)p->matches[(size_t)numPairs - 1] - 1;
+        for (; p2 != pLim && *p2 == p2[dif]; p2++)
+        {}
+        p->matches[(size_t)numPairs - 2] = (UInt32)(p2 - p1);
+      }
+    }
+  }
+  return numPairs;
+}
+
+
+/*
+  ZstdEnc_Opt_GetPath() finds the path with minimal price for the data
+  from current position of parser (pos64).
+  It moves match finder to the end of path and returns the index of last node.
+  The path can be read with (opt[i].price) links after this call.
+*/
+static UInt32 ZstdEnc_Opt_GetPath(CZstdEnc *p, UInt32 litLen, UInt32 lim)
+{
+  CZstdEncOpt *opt = p->opt;
+  CZstdEncOptStat *s = &p->optStat;
+  UInt32 last = 0;
+  UInt32 cur;
+
+  if (!s->pricesAreValid)
+    ZstdEnc_Opt_SetPrices(s);
+
+  opt[0].price = OPT_LL_PRICE(s, litLen);
+  opt[0].litLen = litLen;
+  opt[0].len = 0;
+  opt[0].offBase = 0;
+  opt[0].reps[0] = p->reps[0];
+  opt[0].reps[1] = p->reps[1];
+  opt[0].reps[2] = p->reps[2];
+
+  for (cur = 0;; cur++)
+  {
+    CZstdEncOpt *o = &opt[cur];
+    const Byte *data;
+    UInt32 lenLim, nodeLim, basePrice, price0, longest;
+    unsigned numPairs, i, k;
+    UInt32 repLens[kNumReps];
+
+    if (cur != 0)
+    {
+      // MF position is (cur) here
+      {
+        const CZstdEncOpt *prev = o - 1;
+        const UInt32 price = prev->price - OPT_LL_PRICE(s, prev->litLen)
+            + s->litPrices[*(MF_CUR(p) - 1)]
+            + OPT_LL_PRICE(s, prev->litLen + 1);
+        if (price <= o->price)
+        {
+          o->price = price;
+          o->litLen = prev->litLen + 1;
+          o->len = 0;
+          o->reps[0] = prev->reps[0];
+          o->reps[1] = prev->reps[1];
+          o->reps[2] = prev->reps[2];
+        }
+        else
+        {
+          const CZstdEncOpt *start = o - o->len;
+          o->reps[0] = start->reps[0];
+          o->reps[1] = start->reps[1];
+          o->reps[2] = start->reps[2];
+          ZstdEnc_UpdateReps(o->reps, start->litLen, o->offBase);
+        }
+      }
+      if (cur == last)
+        break;
+    }
+
+    data = MF_CUR(p);
+    numPairs = ZstdEnc_Opt_ReadMatches(p, lim - cur);
+
+    lenLim = lim - cur;
+    if (lenLim > kMatchLenMax)
+      lenLim = kMatchLenMax;
+    longest = 0;
+
+    {
+      const UInt64 pos = p->pos64 + cur;
+      for (k = 0; k < kNumReps; k++)
+      {
+        const unsigned repCode = k + (o->litLen == 0);
+        const UInt32 off = (repCode == kNumReps) ? o->reps[0] - 1 : o->reps[repCode];
+        const Byte *p2;
+        UInt32 len = 0;
+        if (off != 0 && off <= pos && off <= p->windowSize && lenLim >= kMatchLenMin)
+        {
+          p2 = data - off;
+          if (data[0] == p2[0] && data[1] == p2[1] && data[2] == p2[2])
+            for (len = kMatchLenMin; len < lenLim && data[len] == p2[len]; len++)
+            {}
+        }
+        repLens[k] = len;
+        if (longest < len)
+          longest = len;
+      }
+    }
+    if (numPairs != 0)
+    {
+      UInt32 len = p->matches[(size_t)numPairs - 2];
+      if (len > lenLim)
+        len = lenLim;
+      if (longest < len)
+        longest = len;
+    }
+
+    if (longest >= p->fb)
+    {
+      // long match is encoded immediately
+      UInt32 offBase = 0;
+      for (k = 0; k < kNumReps; k++)
+        if (repLens[k] == longest)
+        {
+          offBase = k + 1;
+          break;
+        }
+      if (offBase == 0)
+        offBase = p->matches[(size_t)numPairs - 1] + 1 + kNumReps;
+      last = cur + longest;
+      opt[last].len = longest;
+      opt[last].offBase = offBase;
+      p->matchFinder.Skip(p->matchFinderObj, longest - 1);
+      break;
+    }
+
+    // the nodes after (kNumOpts) are used only for long match
+    nodeLim = kNumOpts - cur;
+    if (lenLim > nodeLim)
+      lenLim = nodeLim;
+    basePrice = o->price + OPT_LL_PRICE(s, 0);
+
+    #define OPT_SET_NODE(_len_, _offBase_) { \
+      CZstdEncOpt *n = &o[_len_]; \
+      const UInt32 price = price0 + OPT_MATCH_PRICE(s, _offBase_, _len_); \
+      if (cur + (_len_) > last) { \
+        do opt[++last].price = kInfinityPrice; \
+        while (last < cur + (_len_)); } \
+      if (price < n->price) { \
+        n->price = price; n->len = (_len_); n->offBase = (_offBase_); n->litLen = 0; } }
+
+    price0 = basePrice;
+    for (k = 0; k < kNumReps; k++)
+    {
+      UInt32 len = repLens[k];
+      if (len > lenLim)
+        len = lenLim;
+      for (; len >= p->minMatchLen; len--)
+        OPT_SET_NODE(len, k + 1)
+    }
+
+    {
+      UInt32 len = p->minMatchLen;
+      for (i = 0; i < numPairs; i += 2)
+      {
+        const UInt32 offBase = p->matches[(size_t)i + 1] + 1 + kNumReps;
+        UInt32 lenEnd = p->matches[i];
+        if (lenEnd > lenLim)
+          lenEnd = lenLim;
+        for (; len <= lenEnd; len++)
+          OPT_SET_NODE(len, offBase)
+      }
+    }
+
+    if (last == 0)
+    {
+      // no matches at start position
+      opt[1].price = kInfinityPrice;
+      last = 1;
+    }
+  }
+
+  // backtracking: we write the index of next node to (price) field
+  {
+    UInt32 i = last;
+    while (i != 0)
+    {
+      const UInt32 len = opt[i].len;
+      const UInt32 prev = i - (len != 0 ? len : 1);
+      opt[prev].price = i;
+      i = prev;
+    }
+  }
+  return last;
+}
+
+
+/*
+  ZstdEnc_ParseBlock_Opt() is optimal parser version of ZstdEnc_ParseBlock().
+  It doesn't use (ahead) and (cands[]).
+*/
+static UInt32 ZstdEnc_ParseBlock_Opt(CZstdEnc *p)
+{
+  const UInt32 blockSizeMax = p->blockSizeMax;
+  CZstdEncOptStat *s = &p->optStat;
+  UInt32 blockPos = 0;
+  UInt32 litLen = 0;
+
+  p->numLits = 0;
+  p->numSeqs = 0;
+  ZstdEnc_Opt_InitBlock(p);
+
+  for (;;)
+  {
+    const UInt32 rem = blockSizeMax - blockPos;
+    UInt32 lim, last, i;
+    const Byte *data;
+    if (rem == 0)
+      break;
+    lim = MF_AVAIL(p);
+    if (lim == 0)
+    {
+      p->finished = True;
+      break;
+    }
+    if (lim > rem)
+      lim = rem;
+
+    last = ZstdEnc_Opt_GetPath(p, litLen, lim);
+    data = MF_CUR(p) - last;
+
+    for (i = 0; i != last;)
+    {
+      const UInt32 next = p->opt[i].price;
+      const CZstdEncOpt *n = &p->opt[next];
+      if (n->len == 0)
+      {
+        const Byte b = data[i];
+        p->lits[p->numLits++] = b;
+        s->litFreqs[b] += 2;
+        s->litSum += 2;
+        litLen++;
+      }
+      else
+      {
+        ZstdEnc_AddSeq(p, litLen, n->len, n->offBase);
+        s->llFreqs[GET_LL_CODE(litLen)]++;
+        s->mlFreqs[GET_ML_CODE(n->len - kMatchLenMin)]++;
+        s->ofFreqs[GetHighBit32(n->offBase)]++;
+        s->llSum++;
+        s->mlSum++;
+        s->ofSum++;
+        litLen = 0;
+      }
+      i = next;
+    }
+    s->pricesAreValid = False;
+
+    memcpy(p->raw + blockPos, data, last);
+    blockPos += last;
+    p->pos64 += last;
+  }
+  return blockPos;
+}
+
+
+/* ---------- Block coding ---------- */
+
+static Byte *ZstdEnc_WriteRawLits(Byte *op, const Byte *lits, UInt32 num, unsigned type)
+{
+  if (num < 32)
+    *op++ = (Byte)(type | (num << 3));
+  else if (num < (1 << 12))
+  {
+    *op++ = (Byte)(type | (1 << 2) | (num << 4));
+    *op++ = (Byte)(num >> 4);
+  }
+  else
+  {
+    *op++ = (Byte)(type | (3 << 2) | (num << 4));
+    *op++ = (Byte)(num >> 4);
+    *op++ = (Byte)(num >> 12);
+  }
+  if (type == kLitType_RLE)
+    *op++ = lits[0];
+  else
+  {
+    memcpy(op, lits, num);
+    op += num;
+  }
+  return op;
+}
+
+
+// it writes FSE-compressed Huffman weights. returns the size of written data or 0
+static size_t Huf_WriteWeightsFse(CZstdEnc *p, Byte *dest, size_t destSize, const Byte *weights, unsigned numWeights)
+{
+  UInt32 counts[kHufLog_Max + 1];
+  Int16 norm[kHufLog_Max + 1];
+  unsigned maxW = 0, numUsed = 0, i;
+  unsigned tableLog;
+  size_t headerSize;
+  CFseCTable *ct = &p->fseTables[0];
+
+  for (i = 0; i <= kHufLog_Max; i++)
+    counts[i] = 0;
+  for (i = 0; i < numWeights; i++)
+    counts[weights[i]]++;
+  for (i = 0; i <= kHufLog_Max; i++)
+    if (counts[i] != 0)
+    {
+      maxW = i;
+      numUsed++;
+    }
+  if (numUsed <= 1 || numWeights < 2)
+    return 0;
+  tableLog = Fse_OptimalTableLog(kHufWeightsLog_Max, numWeights, maxW);
+  Fse_Normalize(norm, tableLog, counts, numWeights, maxW);
+  headerSize = Fse_WriteNCount(dest, destSize, norm, maxW, tableLog);
+  if (headerSize == 0)
+    return 0;
+  Fse_BuildCTable(ct, norm, maxW, tableLog);
+  {
+    CBitOut bo;
+    UInt32 state1 = 0, state2 = 0;
+    BoolInt init1 = False, init2 = False;
+    Byte *end;
+    BitOut_Init(&bo, dest + headerSize, dest + destSize);
+    /* symbol (i) is decoded by state1 for even (i) and by state2 for odd (i) */
+    for (i = numWeights; i != 0;)
+    {
+      const unsigned w = weights[--i];
+      if (i & 1)
+      {
+        if (init2)
+          FSE_ENCODE(&bo, ct, state2, w)
+        else
+        {
+          FSE_INIT_STATE(ct, state2, w)
+          init2 = True;
+        }
+      }
+      else
+      {
+        if (init1)
+          FSE_ENCODE(&bo, ct, state1, w)
+        else
+        {
+          FSE_INIT_STATE(ct, state1, w)
+          init1 = True;
+        }
+      }
+      BitOut_Flush(&bo);
+    }
+    FSE_FLUSH_STATE(&bo, ct, state2)
+    FSE_FLUSH_STATE(&bo, ct, state1)
+    end = BitOut_Close(&bo);
+    if (!end)
+      return 0;
+    return (size_t)(end - dest);
+  }
+}
+
+
+static Byte *Huf_EncodeStream(const Byte *src, size_t size,
+    const UInt16 *codes, const Byte *lens, Byte *op, Byte *lim)
+{
+  CBitOut bo;
+  BitOut_Init(&bo, op, lim);
+  while (size & 3)
+  {
+    const unsigned sym = src[--size];
+    BITOUT_ADD(&bo, codes[sym], lens[sym])
+  }
+  BitOut_Flush(&bo);
+  while (size != 0)
+  {
+    unsigned sym;
+    size -= 4;
+    sym = src[size + 3];  BITOUT_ADD(&bo, codes[sym], lens[sym])
+    sym = src[size + 2];  BITOUT_ADD(&bo, codes[sym], lens[sym])
+    sym = src[size + 1];  BITOUT_ADD(&bo, codes[sym], lens[sym])
+    sym = src[size    ];  BITOUT_ADD(&bo, codes[sym], lens[sym])
+    BitOut_Flush(&bo);
+  }
+  return BitOut_Close(&bo);
+}
+
+
+#define kLitsMinForHuffman  32
+
+/* returns the pointer after written literals section or NULL, if there is no space */
+static Byte *ZstdEnc_WriteLits(CZstdEnc *p, Byte *op, Byte *lim)
+{
+  const UInt32 numLits = p->numLits;
+  const Byte *lits = p->lits;
+  UInt32 freqs[256];
+  UInt32 huffTemp[256];
+  Byte lens[256];
+  UInt16 codes[256];
+  Byte weights[256];
+  unsigned maxSym = 0, numUsed = 0, maxBits = 0;
+  unsigned i;
+
+  if ((size_t)(lim - op) < numLits + 8)
+    return NULL;
+
+  if (numLits < kLitsMinForHuffman)
+    return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_Raw);
+
+  memset(freqs, 0, sizeof(freqs));
+  for (i = 0; i < numLits; i++)
+    freqs[lits[i]]++;
+  for (i = 0; i < 256; i++)
+    if (freqs[i] != 0)
+    {
+      maxSym = i;
+      numUsed++;
+    }
+  if (numUsed == 1)
+    return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_RLE);
+
+  Huffman_Generate(freqs, huffTemp, lens, maxSym + 1, kHufLog_Max);
+  {
+    UInt32 kraft = 0;
+    UInt64 numBits = 0;
+    for (i = 0; i <= maxSym; i++)
+    {
+      const unsigned len = lens[i];
+      if (len == 0)
+        continue;
+      if (freqs[i] == 0)
+      {
+        // Huffman_Generate() can assign code to unused symbol
+        lens[i] = 0;
+        continue;
+      }
+      if (maxBits < len)
+        maxBits = len;
+      numBits += (UInt64)freqs[i] * len;
+    }
+    for (i = 0; i <= maxSym; i++)
+      if (lens[i] != 0)
+        kraft += (UInt32)1 << (kHufLog_Max - lens[i]);
+    if (kraft != ((UInt32)1 << kHufLog_Max))
+      return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_Raw);
+    // fast check for compression ratio
+    if ((numBits >> 3) + 16 >= numLits - (numLits >> 6))
+      return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_Raw);
+  }
+
+  {
+    // prefix codes: the codes of longest length have the smallest values
+    unsigned numPerLen[kHufLog_Max + 2];
+    unsigned startCode[kHufLog_Max + 2];
+    unsigned code = 0;
+    int len;
+    for (i = 0; i <= kHufLog_Max + 1; i++)
+      numPerLen[i] = 0;
+    for (i = 0; i <= maxSym; i++)
+      numPerLen[lens[i]]++;
+    for (len = (int)maxBits; len >= 1; len--)
+    {
+      startCode[len] = code;
+      code += numPerLen[len];
+      code >>= 1;
+    }
+    for (i = 0; i <= maxSym; i++)
+    {
+      const unsigned l = lens[i];
+      codes[i] = 0;
+      weights[i] = 0;
+      if (l != 0)
+      {
+        codes[i] = (UInt16)startCode[l]++;
+        weights[i] = (Byte)(maxBits + 1 - l);
+      }
+    }
+  }
+
+  {
+    const BoolInt singleStream = (numLits < 256);
+    const unsigned headerSize = (singleStream || numLits < (1 << 10)) ? 3 : (numLits < (1 << 14) ? 4 : 5);
+    Byte *start = op + headerSize;
+    Byte *cur = start;
+    size_t compSize;
+
+    /* the weight of last symbol (maxSym) is not written */
+    {
+      size_t treeSize = Huf_WriteWeightsFse(p, cur + 1, 127, weights, maxSym);
+      if (treeSize != 0 && (maxSym > 128 || treeSize < (maxSym + 1) / 2))
+      {
+        cur[0] = (Byte)treeSize;
+        cur += 1 + treeSize;
+      }
+      else if (maxSym <= 128)
+      {
+        cur[0] = (Byte)(127 + maxSym);
+        cur++;
+        for (i = 0; i < maxSym; i += 2)
+          *cur++ = (Byte)((weights[i] << 4) | (i + 1 < maxSym ? weights[i + 1] : 0));
+      }
+      else
+        return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_Raw);
+    }
+
+    if (singleStream)
+    {
+      cur = Huf_EncodeStream(lits, numLits, codes, lens, cur, lim);
+      if (!cur)
+        return NULL;
+    }
+    else
+    {
+      const size_t segSize = (numLits + 3) / 4;
+      Byte *jumpTable = cur;
+      unsigned k;
+      cur += 6;
+      for (k = 0; k < 4; k++)
+      {
+        const size_t offset = segSize * k;
+        const size_t size = (k == 3) ? numLits - offset : segSize;
+        Byte *streamStart = cur;
+        cur = Huf_EncodeStream(lits + offset, size, codes, lens, cur, lim);
+        if (!cur)
+          return NULL;
+        if (k != 3)
+          SetUi16(jumpTable + k * 2, (UInt16)(cur - streamStart))
+      }
+    }
+
+    compSize = (size_t)(cur - start);
+    if (compSize + headerSize + 1 >= numLits - (numLits >> 6))
+      return ZstdEnc_WriteRawLits(op, lits, numLits, kLitType_Raw);
+
+    {
+      const UInt32 sizeFormat = singleStream ? 0 : (UInt32)(headerSize - 2);
+      const UInt32 v = kLitType_Compressed | (sizeFormat << 2);
+      if (headerSize == 3)
+      {
+        const UInt32 h = v | (numLits << 4) | ((UInt32)compSize << 14);
+        op[0] = (Byte)h;
+        op[1] = (Byte)(h >> 8);
+        op[2] = (Byte)(h >> 16);
+      }
+      else if (headerSize == 4)
+      {
+        const UInt32 h = v | (numLits << 4) | ((UInt32)compSize << 18);
+        SetUi32(op, h)
+      }
+      else
+      {
+        const UInt64 h = v | ((UInt64)numLits << 4) | ((UInt64)compSize << 22);
+        SetUi32(op, (UInt32)h)
+        op[4] = (Byte)(h >> 32);
+      }
+    }
+    return cur;
+  }
+}
+
+
+/*
+  ZstdEnc_SelectTable() selects coding mode for one sequence symbol type and
+  writes the table description. It returns the pointer after written data or NULL.
+*/
+static Byte *ZstdEnc_SelectTable(CFseCTable *ct, unsigned *mode,
+    const Byte *codes, UInt32 numSeqs, unsigned numCodes,
+    const Int16 *predefNorm, unsigned predefNum, unsigned predefLog, unsigned maxLog,
+    Byte *op, Byte *lim)
+{
+  UInt32 counts[FSE_SYMBOLS_MAX];
+  unsigned maxSym = 0, numUsed = 0, i;
+  UInt64 costPredef = (UInt64)(Int64)-1;
+
+  for (i = 0; i < numCodes; i++)
+    counts[i] = 0;
+  for (i = 0; i < numSeqs; i++)
+    counts[codes[i]]++;
+  for (i = 0; i < numCodes; i++)
+    if (counts[i] != 0)
+    {
+      maxSym = i;
+      numUsed++;
+    }
+
+  if (numUsed == 1)
+  {
+    if (lim == op)
+      return NULL;
+    *mode = kSeqMode_RLE;
+    *op++ = (Byte)maxSym;
+    Fse_BuildCTable_RLE(ct, maxSym);
+    return op;
+  }
+
+  if (maxSym < predefNum)
+    costPredef = Fse_GetCost(counts, maxSym, predefNorm, predefLog);
+
+  if (numSeqs > 8)
+  {
+    Int16 norm[FSE_SYMBOLS_MAX];
+    const unsigned tableLog = Fse_OptimalTableLog(maxLog, numSeqs, maxSym);
+    Fse_Normalize(norm, tableLog, counts, numSeqs, maxSym);
+    {
+      const size_t headerSize = Fse_WriteNCount(op, (size_t)(lim - op), norm, maxSym, tableLog);
+      if (headerSize != 0)
+      {
+        const UInt64 cost = Fse_GetCost(counts, maxSym, norm, tableLog) + ((UInt64)headerSize << 11);
+        if (cost < costPredef)
+        {
+          *mode = kSeqMode_FSE;
+          Fse_BuildCTable(ct, norm, maxSym, tableLog);
+          return op + headerSize;
+        }
+      }
+    }
+  }
+
+  if (costPredef == (UInt64)(Int64)-1)
+    return NULL;
+  *mode = kSeqMode_Predef;
+  Fse_BuildCTable(ct, predefNorm, predefNum - 1, predefLog);
+  return op;
+}
+
+
+static Byte *ZstdEnc_WriteSeqs(CZstdEnc *p, Byte *op, Byte *lim)
+{
+  const UInt32 numSeqs = p->numSeqs;
+  const CZstdEncSeq *seqs = p->seqs;
+  Byte *llCodes = p->llCodes;
+  Byte *mlCodes = p->mlCodes;
+  Byte *ofCodes = p->ofCodes;
+  unsigned modeLL, modeOF, modeML;
+  UInt32 i;
+
+  if ((size_t)(lim - op) < 4)
+    return NULL;
+  if (numSeqs < 128)
+    *op++ = (Byte)numSeqs;
+  else if (numSeqs < 0x7F00)
+  {
+    *op++ = (Byte)((numSeqs >> 8) + 0x80);
+    *op++ = (Byte)numSeqs;
+  }
+  else
+  {
+    *op++ = 0xFF;
+    SetUi16(op, (UInt16)(numSeqs - 0x7F00))
+    op += 2;
+  }
+  if (numSeqs == 0)
+    return op;
+
+  for (i = 0; i < numSeqs; i++)
+  {
+    const CZstdEncSeq *seq = &seqs[i];
+    const UInt32 mlBase = seq->matchLen - kMatchLenMin;
+    llCodes[i] = (Byte)GET_LL_CODE(seq->litLen);
+    mlCodes[i] = (Byte)GET_ML_CODE(mlBase);
+    ofCodes[i] = (Byte)GetHighBit32(seq->offBase);
+  }
+
+  {
+    Byte *modes = op++;
+    op = ZstdEnc_SelectTable(&p->fseTables[0], &modeLL, llCodes, numSeqs, kNumLL,
+        LL_PredefNorm, kNumLL, kLL_PredefLog, kLL_LogMax, op, lim);
+    if (!op)
+      return NULL;
+    op = ZstdEnc_SelectTable(&p->fseTables[1], &modeOF, ofCodes, numSeqs, kNumOF,
+        OF_PredefNorm, kOF_PredefNum, kOF_PredefLog, kOF_LogMax, op, lim);
+    if (!op)
+      return NULL;
+    op = ZstdEnc_SelectTable(&p->fseTables[2], &modeML, mlCodes, numSeqs, kNumML,
+        ML_PredefNorm, kNumML, kML_PredefLog, kML_LogMax, op, lim);
+    if (!op)
+      return NULL;
+    *modes = (Byte)((modeLL << 6) | (modeOF << 4) | (modeML << 2));
+  }
+
+  {
+    const CFseCTable *ctLL = &p->fseTables[0];
+    const CFseCTable *ctOF = &p->fseTables[1];
+    const CFseCTable *ctML = &p->fseTables[2];
+    UInt32 stateLL, stateOF, stateML;
+    CBitOut bo;
+
+    BitOut_Init(&bo, op, lim);
+    i = numSeqs - 1;
+    FSE_INIT_STATE(ctML, stateML, mlCodes[i])
+    FSE_INIT_STATE(ctOF, stateOF, ofCodes[i])
+    FSE_INIT_STATE(ctLL, stateLL, llCodes[i])
+
+    for (;;)
+    {
+      const CZstdEncSeq *seq = &seqs[i];
+      {
+        const unsigned llCode = llCodes[i];
+        const unsigned mlCode = mlCodes[i];
+        BITOUT_ADD(&bo, seq->litLen - LL_Base[llCode], LL_Bits[llCode])
+        BITOUT_ADD(&bo, seq->matchLen - kMatchLenMin - ML_Base[mlCode], ML_Bits[mlCode])
+      }
+      BitOut_Flush(&bo);
+      {
+        const unsigned ofCode = ofCodes[i];
+        BITOUT_ADD(&bo, seq->offBase, ofCode)
+      }
+      BitOut_Flush(&bo);
+      if (i == 0)
+        break;
+      i--;
+      FSE_ENCODE(&bo, ctOF, stateOF, ofCodes[i])
+      FSE_ENCODE(&bo, ctML, stateML, mlCodes[i])
+      FSE_ENCODE(&bo, ctLL, stateLL, llCodes[i])
+      BitOut_Flush(&bo);
+    }
+
+    FSE_FLUSH_STATE(&bo, ctML, stateML)
+    FSE_FLUSH_STATE(&bo, ctOF, stateOF)
+    FSE_FLUSH_STATE(&bo, ctLL, stateLL)
+    return BitOut_Close(&bo);
+  }
+}
+
+
+static SRes ZstdEnc_Write(CZstdEnc *p, const void *data, size_t size)
+{
+  if (size == 0)
+    return SZ_OK;
+  if (ISeqOutStream_Write(p->outStream, data, size) != size)
+    return SZ_ERROR_WRITE;
+  p->outProcessed += size;
+  return SZ_OK;
+}
+
+
+static SRes ZstdEnc_WriteBlock(CZstdEnc *p, UInt32 blockSize, BoolInt isLast, const UInt32 *repsPrev)
+{
+  Byte *out = p->outBuf;
+  unsigned type = kBlockType_Raw;
+  size_t size = blockSize;
+
+  if (blockSize != 0)
+  {
+    const Byte *raw = p->raw;
+    const Byte b = raw[0];
+    UInt32 i;
+    for (i = 1; i < blockSize; i++)
+      if (raw[i] != b)
+        break;
+    if (i == blockSize && blockSize > 1)
+    {
+      type = kBlockType_RLE;
+      out[3] = b;
+      size = 1;
+    }
+    else
+    {
+      Byte *lim = out + kOutBufSize;
+      Byte *op = ZstdEnc_WriteLits(p, out + 3, lim);
+      if (op)
+        op = ZstdEnc_WriteSeqs(p, op, lim);
+      if (op && op < out + 3 + blockSize)
+      {
+        type = kBlockType_Compressed;
+        size = (size_t)(op - (out + 3));
+      }
+    }
+  }
+
+  if (type != kBlockType_Compressed)
+  {
+    // decoder doesn't update repeat offsets for RAW and RLE blocks
+    unsigned k;
+    for (k = 0; k < kNumReps; k++)
+      p->reps[k] = repsPrev[k];
+  }
+
+  {
+    const UInt32 h = (UInt32)(isLast ? 1 : 0) | ((UInt32)type << 1) | ((UInt32)(type == kBlockType_RLE ? blockSize : size) << 3);
+    out[0] = (Byte)h;
+    out[1] = (Byte)(h >> 8);
+    out[2] = (Byte)(h >> 16);
+  }
+  if (type == kBlockType_Raw)
+  {
+    RINOK(ZstdEnc_Write(p, out, 3))
+    return ZstdEnc_Write(p, p->raw, blockSize);
+  }
+  return ZstdEnc_Write(p, out, 3 + size);
+}
+
+
+static SRes ZstdEnc_WriteFrameHeader(CZstdEnc *p)
+{
+  Byte buf[6];
+  SetUi32(buf, kZstdSignature)
+  buf[4] = (Byte)(p->checksum ? (1 << 2) : 0);
+  buf[5] = (Byte)((GetWindowLog(p->windowSize) - 10) << 3);
+  return ZstdEnc_Write(p, buf, 6);
+}
+
+
+SRes ZstdEnc_Encode(CZstdEncHandle p,
+    ISeqOutStreamPtr outStream,
+    ISeqInStreamPtr inStream,
+    ICompressProgressPtr progress)
+{
+  CZstdEncProps props = p->props;
+  SRes res;
+
+  if (props.reduceSize == (UInt64)(Int64)-1)
+    props.reduceSize = MFB.expectedDataSize;
+  ZstdEncProps_Normalize(&props);
+
+  p->windowSize = props.windowSize;
+  p->blockSizeMax = props.windowSize < kBlockSizeMax ? props.windowSize : kBlockSizeMax;
+  p->fb = (unsigned)props.fb;
+  p->algo = (unsigned)props.algo;
+  p->minMatchLen = (props.level <= 2) ? 4 : kMatchLenMin;
+  p->checksum = (props.checksum != 0);
+  p->outStream = outStream;
+  p->inProcessed = 0;
+  p->outProcessed = 0;
+  p->pos64 = 0;
+  p->ahead = 0;
+  p->finished = False;
+  p->optStatIsInited = False;
+  p->reps[0] = 1;
+  p->reps[1] = 4;
+  p->reps[2] = 8;
+  Xxh64_Init(&p->xxh);
+
+  MatchFinder_SET_STREAM(&MFB, inStream)
+  RINOK(ZstdEnc_Alloc(p, &props))
+
+  #ifndef Z7_ST
+  if (p->mtMode)
+  {
+    RINOK(MatchFinderMt_InitMt(&p->matchFinderMt))
+  }
+  #endif
+  p->matchFinder.Init(p->matchFinderObj);
+
+  res = ZstdEnc_WriteFrameHeader(p);
+
+  while (res == SZ_OK)
+  {
+    UInt32 repsPrev[kNumReps];
+    UInt32 blockSize;
+    repsPrev[0] = p->reps[0];
+    repsPrev[1] = p->reps[1];
+    repsPrev[2] = p->reps[2];
+
+    blockSize = (p->algo == kAlgo_Opt) ?
+        ZstdEnc_ParseBlock_Opt(p) :
+        ZstdEnc_ParseBlock(p);
+    res = ZstdEnc_CheckErrors(p);
+    if (res != SZ_OK)
+      break;
+    // we don't want additional empty block, if stream was finished at the end of block
+    if (!p->finished && MF_AVAIL(p) == 0)
+      p->finished = True;
+    if (p->checksum && blockSize != 0)
+      Xxh64_Update(&p->xxh, p->raw, blockSize);
+    p->inProcessed += blockSize;
+    res = ZstdEnc_WriteBlock(p, blockSize, p->finished, repsPrev);
+    if (res != SZ_OK || p->finished)
+      break;
+    if (progress)
+    {
+      res = ICompressProgress_Progress(progress, p->inProcessed, p->outProcessed);
+      if (res != SZ_OK)
+        res = SZ_ERROR_PROGRESS;
+    }
+  }
+
+  if (res == SZ_OK && p->checksum)
+  {
+    Byte buf[4];
+    SetUi32(buf, (UInt32)Xxh64_Digest(&p->xxh))
+    res = ZstdEnc_Write(p, buf, 4);
+  }
+
+  #ifndef Z7_ST
+  if (p->mtMode)
+    MatchFinderMt_ReleaseStream(&p->matchFinderMt);
+  #endif
+
+  return res;
+}
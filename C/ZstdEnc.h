@@ -0,0 +1,78 @@
+/* ZstdEnc.h -- Zstd Encoder interfaces
+Igor Pavlov : Public domain */
+
+#ifndef ZIP7_INC_ZSTD_ENC_H
+#define ZIP7_INC_ZSTD_ENC_H
+
+#include "7zTypes.h"
+
+EXTERN_C_BEGIN
+
+#define ZSTD_ENC_LEVEL_MAX       22
+#define ZSTD_ENC_LEVEL_DEFAULT    3
+
+#define ZSTD_ENC_WINDOW_LOG_MIN  10
+#define ZSTD_ENC_WINDOW_LOG_MAX  30
+
+/* window sizes above that limit are "long" windows.
+   It's not separate long-distance matcher (LDM) of original zstd:
+   it's just a large window, and the encoder uses BT4 match finder with big hash for such windows */
+#define ZSTD_ENC_WINDOW_LOG_LONG  27
+
+typedef struct
+{
+  int level;          /* 1 <= level <= ZSTD_ENC_LEVEL_MAX, default = ZSTD_ENC_LEVEL_DEFAULT */
+  UInt32 windowSize;  /* (1 << 10) <= windowSize <= (1 << 30), 0 - default for level */
+  int btMode;         /* 0 - hashChain Mode, 1 - binTree mode, -1 - default for level */
+  int numHashBytes;   /* 4 or 5 for hashChain, 2 ... 5 for binTree mode, 0 - default */
+  UInt32 mc;          /* number of match finder cycles, 0 - default for level */
+  int fb;             /* number of fast bytes (nice match length): 8 <= fb <= 273, 0 - default */
+  int algo;           /* 0 - greedy, 1 - lazy, 2 - lazy2, 3 - optimal parser, -1 - default for level */
+  int checksum;       /* 0 - no content checksum, 1 - XXH64 content checksum (default) */
+  int numThreads;     /* 1 or 2, default = 2 : (2) uses multithreaded match finder in binTree mode */
+  UInt64 reduceSize;  /* estimated size of data that will be compressed. default = (UInt64)(Int64)-1.
+                         Encoder uses this value to reduce window size, if possible. */
+  UInt64 affinity;
+  UInt64 affinityInGroup;
+  Int32 affinityGroup;
+} CZstdEncProps;
+
+void ZstdEncProps_Init(CZstdEncProps *p);
+void ZstdEncProps_Normalize(CZstdEncProps *p);
+UInt32 ZstdEncProps_GetWindowSize(const CZstdEncProps *p);
+
+/* ---------- CZstdEncHandle Interface ---------- */
+
+/* ZstdEnc_* functions can return the following exit codes:
+SRes:
+  SZ_OK           - OK
+  SZ_ERROR_MEM    - Memory allocation error
+  SZ_ERROR_PARAM  - Incorrect paramater in props
+  SZ_ERROR_WRITE  - ISeqOutStream write callback error
+  SZ_ERROR_READ   - ISeqInStream read callback error
+  SZ_ERROR_PROGRESS - some break from progress callback
+  SZ_ERROR_THREAD - error in multithreading functions (only for Mt version)
+*/
+
+typedef struct CZstdEnc CZstdEnc;
+typedef CZstdEnc * CZstdEncHandle;
+
+CZstdEncHandle ZstdEnc_Create(ISzAllocPtr alloc, ISzAllocPtr allocBig);
+void ZstdEnc_Destroy(CZstdEncHandle p);
+SRes ZstdEnc_SetProps(CZstdEncHandle p, const CZstdEncProps *props);
+void ZstdEnc_SetDataSize(CZstdEncHandle p, UInt64 expectedDataSiize);
+
+/*
+ZstdEnc_Encode() writes one zstd frame that contains all data from (inStream).
+*/
+SRes ZstdEnc_Encode(CZstdEncHandle p,
+    ISeqOutStreamPtr outStream,
+    ISeqInStreamPtr inStream,
+    ICompressProgressPtr progress);
+
+/* returns the total size of data that was read from (inStream) in last ZstdEnc_Encode() call */
+UInt64 ZstdEnc_GetInProcessed(const CZstdEnc *p);
+
+EXTERN_C_END
+
+#endif
@@ -369,6 +369,8 @@ $O/DLL.o: ../../../Windows/DLL.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/ErrorMsg.o: ../../../Windows/ErrorMsg.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/FileAsyncIO.o: ../../../Windows/FileAsyncIO.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/FileDir.o: ../../../Windows/FileDir.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/FileFind.o: ../../../Windows/FileFind.cpp
@@ -763,6 +765,12 @@ $O/ImplodeDecoder.o: ../../Compress/ImplodeDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/ImplodeHuffmanDecoder.o: ../../Compress/ImplodeHuffmanDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/Lz4Decoder.o: ../../Compress/Lz4Decoder.cpp
+	$(CXX) $(CXXFLAGS) $<
+$O/Lz4Encoder.o: ../../Compress/Lz4Encoder.cpp
+	$(CXX) $(CXXFLAGS) $<
+$O/Lz4Register.o: ../../Compress/Lz4Register.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/LzfseDecoder.o: ../../Compress/LzfseDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/LzhDecoder.o: ../../Compress/LzhDecoder.cpp
@@ -791,6 +799,12 @@ $O/PpmdEncoder.o: ../../Compress/PpmdEncoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/PpmdRegister.o: ../../Compress/PpmdRegister.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/PpmdMtDecoder.o: ../../Compress/PpmdMtDecoder.cpp
+	$(CXX) $(CXXFLAGS) $<
+$O/PpmdMtEncoder.o: ../../Compress/PpmdMtEncoder.cpp
+	$(CXX) $(CXXFLAGS) $<
+$O/PpmdMtRegister.o: ../../Compress/PpmdMtRegister.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/PpmdZip.o: ../../Compress/PpmdZip.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/QuantumDecoder.o: ../../Compress/QuantumDecoder.cpp
@@ -823,6 +837,8 @@ $O/ZlibEncoder.o: ../../Compress/ZlibEncoder.cpp
 	$(CXX) $(CXXFLAGS) $<
 $O/ZstdDecoder.o: ../../Compress/ZstdDecoder.cpp
 	$(CXX) $(CXXFLAGS) $<
+$O/ZstdEncoder.o: ../../Compress/ZstdEncoder.cpp
+	$(CXX) $(CXXFLAGS) $<
 $O/ZstdRegister.o: ../../Compress/ZstdRegister.cpp
 	$(CXX) $(CXXFLAGS) $<
 
@@ -1198,6 +1214,8 @@ $O/LzFind.o: ../../../../C/LzFind.c
 	$(CC) $(CFLAGS) $<
 $O/Lz4Dec.o: ../../../../C/Lz4Dec.c
 	$(CC) $(CFLAGS) $<
+$O/Lz4Enc.o: ../../../../C/Lz4Enc.c
+	$(CC) $(CFLAGS) $<
 
 # ifdef MT_FILES
 $O/LzFindMt.o: ../../../../C/LzFindMt.c
@@ -1267,6 +1285,10 @@ $O/XzIn.o: ../../../../C/XzIn.c
 	$(CC) $(CFLAGS) $<
 $O/ZstdDec.o: ../../../../C/ZstdDec.c
 	$(CC) $(CFLAGS) $<
+$O/ZstdDecMt.o: ../../../../C/ZstdDecMt.c
+	$(CC) $(CFLAGS) $<
+$O/ZstdEnc.o: ../../../../C/ZstdEnc.c
+	$(CC) $(CFLAGS) $<
 
 
 ifdef USE_ASM
@@ -421,6 +421,18 @@ HRESULT CDecoder::Decode(
       }
     }
 
+    {
+      Z7_DECL_CMyComPtr_QI_FROM(
+          ICompressSetPresetDictionary,
+          setPresetDict, decoder)
+      if (setPresetDict)
+      {
+        // the decoder uses preset dictionary only if coder properties require it
+        const CByteBuffer &dict = folders.PresetDict;
+        RINOK(setPresetDict->SetPresetDictionary(dict, (UInt32)dict.Size()))
+      }
+    }
+
     #ifndef Z7_NO_CRYPTO
     {
       Z7_DECL_CMyComPtr_QI_FROM(
@@ -421,6 +421,17 @@ HRESULT CEncoder::Encode1(
         RINOK(resetInitVector->ResetInitVector())
       }
     }
+    {
+      Z7_DECL_CMyComPtr_QI_FROM(
+          ICompressSetPresetDictionary,
+          setPresetDict, coder)
+      if (setPresetDict)
+      {
+        RINOK(setPresetDict->SetPresetDictionary(_presetDict, (UInt32)_presetDict.Size()))
+        if (_presetDict.Size() != 0)
+          PresetDictWasUsed = true;
+      }
+    }
     {
       Z7_DECL_CMyComPtr_QI_FROM(
           ICompressSetCoderPropertiesOpt,
@@ -530,7 +541,8 @@ void CEncoder::Encode_Post(
 
 
 CEncoder::CEncoder(const CCompressionMethodMode &options):
-    _constructed(false)
+    _constructed(false),
+    PresetDictWasUsed(false)
 {
   if (options.IsEmpty())
     throw 1;
@@ -59,6 +59,8 @@ class CEncoder Z7_final MY_UNCOPYABLE
   // CRecordVector<UInt32> DestIn_to_SrcOut;
   CRecordVector<UInt32> DestOut_to_SrcIn;
 
+  CByteBuffer _presetDict;
+
   void InitBindConv();
   void SetFolder(CFolder &folder);
 
@@ -68,9 +70,13 @@ class CEncoder Z7_final MY_UNCOPYABLE
   bool _constructed;
 public:
 
+  bool PresetDictWasUsed; // Encode1() sets it, if some coder of folder used preset dictionary
+
   CEncoder(const CCompressionMethodMode &options);
   ~CEncoder();
   HRESULT EncoderConstr();
+  // the coders that support ICompressSetPresetDictionary will use (dict) in next Encode1() calls
+  void SetPresetDict(const CByteBuffer &dict) { _presetDict = dict; }
   HRESULT Encode1(
       DECL_EXTERNAL_CODECS_LOC_VARS
       ISequentialInStream *inStream,
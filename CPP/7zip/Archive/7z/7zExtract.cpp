@@ -4,13 +4,22 @@
 
 #include "../../../../C/7zCrc.h"
 
+#include "../../../Common/AutoPtr.h"
 #include "../../../Common/ComTry.h"
 
 #include "../../Common/ProgressUtils.h"
+#include "../../Common/StreamObjects.h"
+#include "../../Common/StreamUtils.h"
 
 #include "7zDecode.h"
 #include "7zHandler.h"
 
+#ifdef Z7_7Z_EXTRACT_MT
+#include "../../../Windows/Thread.h"
+
+#include "../../Common/LockedStream.h"
+#endif
+
 // EXTERN_g_ExternalCodecs
 
 namespace NArchive {
@@ -226,6 +235,305 @@ Z7_COM7F_IMF(CFolderOutStream::GetSubStreamSize(UInt64 subStream, UInt64 *value)
 */
 
 
+struct CExtractFolderJob
+{
+  UInt32 ItemIndex;     // index of first item in (indices) list
+  UInt32 NumSolidFiles; // number of items from (indices) list in this job
+  UInt32 StartFile;     // first file in folder or (fileIndex) for file without folder
+  CNum FolderIndex;
+  UInt64 UnpackSize;    // required unpack size for folder
+  UInt64 PackSize;
+};
+
+
+static void GetExtractFolderJob(const CDbEx &db, const UInt32 *indices, UInt32 numItems, UInt32 i,
+    CExtractFolderJob &job)
+{
+  UInt32 fileIndex = indices ? indices[i] : i;
+  const CNum folderIndex = db.FileIndexToFolderIndexMap[fileIndex];
+  
+  job.ItemIndex = i;
+  job.NumSolidFiles = 1;
+  job.FolderIndex = folderIndex;
+  job.UnpackSize = 0;
+  job.PackSize = 0;
+
+  if (folderIndex != kNumNoIndex)
+  {
+    job.PackSize = db.GetFolderFullPackSize(folderIndex);
+    UInt32 nextFile = fileIndex + 1;
+    fileIndex = db.FolderStartFileIndex[folderIndex];
+    UInt32 k;
+
+    for (k = i + 1; k < numItems; k++)
+    {
+      const UInt32 fileIndex2 = indices ? indices[k] : k;
+      if (db.FileIndexToFolderIndexMap[fileIndex2] != folderIndex
+          || fileIndex2 < nextFile)
+        break;
+      nextFile = fileIndex2 + 1;
+    }
+    
+    job.NumSolidFiles = k - i;
+    
+    for (k = fileIndex; k < nextFile; k++)
+      job.UnpackSize += db.Files[k].Size;
+  }
+  
+  job.StartFile = fileIndex;
+}
+
+
+#ifdef Z7_7Z_EXTRACT_MT
+
+/*
+  CFolderDecoderMt decodes small independent folders in worker threads to memory buffers.
+  The main thread calls WaitJob() for each folder in original order,
+  and it writes decoded data to CFolderOutStream.
+  So extract callback is called only from main thread, and in original order of files.
+*/
+
+// max unpack size of folder that can be decoded in worker thread
+static const UInt32 kMtFolder_MaxUnpackSize = (UInt32)1 << 26;
+
+// returns true, if some requested file of job has data.
+// We don't decode the folder in worker thread, if all requested files are empty.
+static bool ExtractFolderJob_HasData(const CDbEx &db, const UInt32 *indices, const CExtractFolderJob &job)
+{
+  for (UInt32 k = 0; k < job.NumSolidFiles; k++)
+  {
+    const UInt32 fileIndex = indices ? indices[job.ItemIndex + k] : job.ItemIndex + k;
+    if (db.Files[fileIndex].Size != 0)
+      return true;
+  }
+  return false;
+}
+
+struct CMtFolderJob
+{
+  CNum FolderIndex;
+  UInt64 UnpackSize;
+  CByteBuffer Buf;
+  size_t OutSize;
+  HRESULT Result;
+  bool DataAfterEnd_Error;
+  bool Finished;
+};
+
+class CFolderDecoderMt;
+
+Z7_CLASS_IMP_COM_1(
+  CMtFolderProgress
+  , ICompressProgressInfo
+)
+public:
+  const CFolderDecoderMt *Parent;
+};
+
+class CFolderDecoderMt
+{
+  struct CThreadInfo
+  {
+    NWindows::CPoolThread Thread;
+    CFolderDecoderMt *Parent;
+  };
+
+  CObjectVector<CThreadInfo> _threads;
+  NWindows::NSynchronization::CCriticalSection _cs;
+  NWindows::NSynchronization::CSemaphore _canStart;
+  NWindows::NSynchronization::CAutoResetEvent _jobFinished;
+  unsigned _nextJob;      // next submitted job that will be decoded by worker thread
+  unsigned _numSubmitted;
+  unsigned _numReleased;  // the jobs that were freed by main thread
+  size_t _inFlightSize;
+  size_t _maxInFlightSize;
+  unsigned _maxInFlightJobs;
+
+  void DecodeJob(CDecoder &decoder, CLockedInStreamReader *inStream, CBufPtrSeqOutStream *outStream,
+      ICompressProgressInfo *progress, CMtFolderJob &job);
+  static THREAD_FUNC_DECL ThreadFunc(void *p);
+  void ThreadFunc2();
+public:
+  DECL_EXTERNAL_CODECS_LOC_VARS_DECL
+  const CDbEx *Db;
+  CLockedInStreamBase InStream;
+  UInt64 MemUsage;
+  CObjectVector<CMtFolderJob> Jobs;
+  volatile bool Exit;
+
+  CFolderDecoderMt():
+      _nextJob(0),
+      _numSubmitted(0),
+      _numReleased(0),
+      _inFlightSize(0),
+      Exit(false)
+      {}
+  ~CFolderDecoderMt() { StopThreads(); }
+
+  HRESULT Create(UInt32 numThreads, size_t maxInFlightSize);
+  void StopThreads();
+  void SubmitJobs();
+  HRESULT WaitJob(unsigned index);
+  void ReleaseJob(unsigned index);
+};
+
+
+Z7_COM7F_IMF(CMtFolderProgress::SetRatioInfo(const UInt64 * /* inSize */, const UInt64 * /* outSize */))
+{
+  // it breaks decoding in worker thread, if main thread was stopped
+  return Parent->Exit ? E_ABORT : S_OK;
+}
+
+
+void CFolderDecoderMt::DecodeJob(CDecoder &decoder, CLockedInStreamReader *inStream, CBufPtrSeqOutStream *outStream,
+    ICompressProgressInfo *progress, CMtFolderJob &job)
+{
+  job.OutSize = 0;
+  job.DataAfterEnd_Error = false;
+  try
+  {
+    job.Buf.Alloc((size_t)job.UnpackSize);
+    outStream->Init(job.Buf, (size_t)job.UnpackSize);
+    
+    #ifndef Z7_NO_CRYPTO
+      // encrypted folders are decoded in main thread
+      ICryptoGetTextPassword *getTextPassword = NULL;
+      bool isEncrypted = false;
+      bool passwordIsDefined = false;
+      UString_Wipe password;
+    #endif
+    
+    job.Result = decoder.Decode(
+        EXTERNAL_CODECS_LOC_VARS
+        inStream,
+        Db->ArcInfo.DataStartPosition,
+        *Db, job.FolderIndex,
+        &job.UnpackSize,
+        outStream,
+        progress,
+        NULL // *inStreamMainRes
+        , job.DataAfterEnd_Error
+        Z7_7Z_DECODER_CRYPRO_VARS
+        , true, 1, MemUsage
+        );
+    job.OutSize = outStream->GetPos();
+  }
+  catch(...) { job.Result = E_OUTOFMEMORY; }
+}
+
+
+THREAD_FUNC_DECL CFolderDecoderMt::ThreadFunc(void *p)
+{
+  ((CThreadInfo *)p)->Parent->ThreadFunc2();
+  return THREAD_FUNC_RET_ZERO;
+}
+
+
+void CFolderDecoderMt::ThreadFunc2()
+{
+  CDecoder decoder(false);
+  CMyComPtr2_Create<IInStream, CLockedInStreamReader> inStream;
+  CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> outStream;
+  CMyComPtr2_Create<ICompressProgressInfo, CMtFolderProgress> progress;
+  inStream->Base = &InStream;
+  progress->Parent = this;
+
+  for (;;)
+  {
+    if (_canStart.Lock() != 0 || Exit)
+      return;
+    CMtFolderJob *job;
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      job = &Jobs[_nextJob++];
+    }
+    DecodeJob(decoder, inStream.ClsPtr(), outStream.ClsPtr(), progress, *job);
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      job->Finished = true;
+    }
+    _jobFinished.Set();
+  }
+}
+
+
+HRESULT CFolderDecoderMt::Create(UInt32 numThreads, size_t maxInFlightSize)
+{
+  _maxInFlightSize = maxInFlightSize;
+  _maxInFlightJobs = numThreads * 2;
+  RINOK_WRes(_canStart.Create(0, (UInt32)Jobs.Size() + numThreads))
+  RINOK_WRes(_jobFinished.CreateIfNotCreated_Reset())
+  for (UInt32 i = 0; i < numThreads; i++)
+  {
+    // we don't start additional threads, if other coders use all threads in pool
+    if (i != 0 && ThreadPool_IsFull())
+      break;
+    CThreadInfo &t = _threads.AddNew();
+    t.Parent = this;
+    RINOK_WRes(t.Thread.Create(ThreadFunc, &t))
+  }
+  return S_OK;
+}
+
+
+void CFolderDecoderMt::StopThreads()
+{
+  Exit = true;
+  if (_threads.IsEmpty())
+    return;
+  _canStart.Release(_threads.Size());
+  FOR_VECTOR (i, _threads)
+  {
+    CThreadInfo &t = _threads[i];
+    if (t.Thread.IsCreated())
+      t.Thread.Wait_Close();
+  }
+  _threads.Clear();
+}
+
+
+void CFolderDecoderMt::SubmitJobs()
+{
+  while (_numSubmitted < Jobs.Size())
+  {
+    const size_t size = (size_t)Jobs[_numSubmitted].UnpackSize;
+    if (_numSubmitted != _numReleased)
+      if (_numSubmitted - _numReleased >= _maxInFlightJobs
+          || _inFlightSize + size > _maxInFlightSize)
+        break;
+    _inFlightSize += size;
+    _numSubmitted++;
+    _canStart.Release();
+  }
+}
+
+
+HRESULT CFolderDecoderMt::WaitJob(unsigned index)
+{
+  for (;;)
+  {
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      if (Jobs[index].Finished)
+        return S_OK;
+    }
+    RINOK_WRes(_jobFinished.Lock())
+  }
+}
+
+
+void CFolderDecoderMt::ReleaseJob(unsigned index)
+{
+  CMtFolderJob &job = Jobs[index];
+  job.Buf.Free();
+  _inFlightSize -= (size_t)job.UnpackSize;
+  _numReleased++;
+  SubmitJobs();
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testModeSpec, IArchiveExtractCallback *extractCallbackSpec))
 {
@@ -290,8 +598,6 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     #endif
     );
 
-  UInt64 curPacked, curUnpacked;
-
   CMyComPtr<IArchiveExtractCallbackMessage2> callbackMessage;
   extractCallback.QueryInterface(IID_IArchiveExtractCallbackMessage2, &callbackMessage);
 
@@ -303,55 +609,126 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   folderOutStream->TestMode = (testModeSpec != 0);
   folderOutStream->CheckCrc = (_crcSize != 0);
 
-  for (UInt32 i = 0;; lps->OutSize += curUnpacked, lps->InSize += curPacked)
+  const UInt32 *indices2 = allFilesMode ? NULL : indices;
+  
+  CRecordVector<CExtractFolderJob> jobs;
   {
-    RINOK(lps->SetCur())
-
-    if (i >= numItems)
-      break;
+    for (UInt32 i = 0; i < numItems;)
+    {
+      CExtractFolderJob job;
+      GetExtractFolderJob(_db, indices2, numItems, i, job);
+      i += job.NumSolidFiles;
+      jobs.Add(job);
+    }
+  }
 
-    curUnpacked = 0;
-    curPacked = 0;
+  IInStream *inStream = _inStream;
 
-    UInt32 fileIndex = allFilesMode ? i : indices[i];
-    const CNum folderIndex = _db.FileIndexToFolderIndexMap[fileIndex];
+  // the packed streams of folder are read sequentially, so we can tune read-ahead
+  CMyComPtr<IStreamSetAccessHint> accessHint;
+  _inStream.QueryInterface(IID_IStreamSetAccessHint, &accessHint);
 
-    UInt32 numSolidFiles = 1;
+  #ifdef Z7_7Z_EXTRACT_MT
 
-    if (folderIndex != kNumNoIndex)
+  // (mtJobIndexes[i] >= 0) : job (i) is decoded by CFolderDecoderMt
+  CIntVector mtJobIndexes;
+  CMyUniquePtr<CFolderDecoderMt> mtDecoder;
+  CMyComPtr2<IInStream, CLockedInStreamReader> mtInStream;
+  
+  if (_useMtFolders && _numThreads > 1)
+  {
+    size_t maxInFlightSize = (size_t)1 << (sizeof(size_t) >= 8 ? 30 : 27);
+    if (maxInFlightSize > _memUsage_Decompress / 4)
+      maxInFlightSize = (size_t)(_memUsage_Decompress / 4);
+    UInt64 maxFolderSize = kMtFolder_MaxUnpackSize;
+    if (maxFolderSize > maxInFlightSize / 2)
+      maxFolderSize = maxInFlightSize / 2;
+
+    unsigned numMtJobs = 0;
+    FOR_VECTOR (i, jobs)
     {
-      curPacked = _db.GetFolderFullPackSize(folderIndex);
-      UInt32 nextFile = fileIndex + 1;
-      fileIndex = _db.FolderStartFileIndex[folderIndex];
-      UInt32 k;
+      const CExtractFolderJob &job = jobs[i];
+      int mtIndex = -1;
+      if (job.FolderIndex != kNumNoIndex
+          && job.UnpackSize != 0
+          && job.UnpackSize <= maxFolderSize
+          && !IsFolderEncrypted(job.FolderIndex)
+          && ExtractFolderJob_HasData(_db, indices2, job))
+        mtIndex = (int)numMtJobs++;
+      mtJobIndexes.Add(mtIndex);
+    }
 
-      for (k = i + 1; k < numItems; k++)
+    if (numMtJobs >= 2)
+    {
+      mtDecoder.Create_if_Empty();
+      CFolderDecoderMt &mt = *mtDecoder;
+      #ifdef Z7_EXTERNAL_CODECS
+      mt._externalCodecs = EXTERNAL_CODECS_VARS2;
+      #endif
+      mt.Db = &_db;
+      mt.InStream.Init(_inStream);
+      mt.MemUsage = _memUsage_Decompress;
+      FOR_VECTOR (k, jobs)
       {
-        const UInt32 fileIndex2 = allFilesMode ? k : indices[k];
-        if (_db.FileIndexToFolderIndexMap[fileIndex2] != folderIndex
-            || fileIndex2 < nextFile)
-          break;
-        nextFile = fileIndex2 + 1;
+        if (mtJobIndexes[k] < 0)
+          continue;
+        CMtFolderJob &mj = mt.Jobs.AddNew();
+        mj.FolderIndex = jobs[k].FolderIndex;
+        mj.UnpackSize = jobs[k].UnpackSize;
+        mj.OutSize = 0;
+        mj.Result = S_OK;
+        mj.DataAfterEnd_Error = false;
+        mj.Finished = false;
       }
+      UInt32 numThreads = _numThreads;
+      if (numThreads > numMtJobs)
+        numThreads = numMtJobs;
+      RINOK(mt.Create(numThreads, maxInFlightSize))
+      mt.SubmitJobs();
       
-      numSolidFiles = k - i;
-      
-      for (k = fileIndex; k < nextFile; k++)
-        curUnpacked += _db.Files[k].Size;
+      // main thread and worker threads read the same archive stream
+      mtInStream.Create_if_Empty();
+      mtInStream->Base = &mt.InStream;
+      inStream = mtInStream;
     }
+    else
+      mtJobIndexes.Clear();
+  }
+  
+  #endif
 
-    {
-      const HRESULT result = folderOutStream->Init(fileIndex,
-          allFilesMode ? NULL : indices + i,
-          numSolidFiles);
+  UInt64 curPacked = 0, curUnpacked = 0;
 
-      i += numSolidFiles;
+  for (unsigned jobIndex = 0;; jobIndex++, lps->OutSize += curUnpacked, lps->InSize += curPacked)
+  {
+    RINOK(lps->SetCur())
 
-      RINOK(result)
-    }
+    if (jobIndex >= jobs.Size())
+      break;
+
+    const CExtractFolderJob &job = jobs[jobIndex];
+    const CNum folderIndex = job.FolderIndex;
+    curUnpacked = job.UnpackSize;
+    curPacked = job.PackSize;
+
+    RINOK(folderOutStream->Init(job.StartFile,
+        indices2 ? indices2 + job.ItemIndex : NULL,
+        job.NumSolidFiles))
 
     if (folderOutStream->WasWritingFinished())
     {
+      #ifdef Z7_7Z_EXTRACT_MT
+      /* the folder could be submitted to worker thread already.
+         We must release its job, even if we don't need the data of folder.
+         Otherwise (_inFlightSize) and the number of jobs in flight are not reduced,
+         and SubmitJobs() can stop submitting of next jobs that we wait later. */
+      if (!mtJobIndexes.IsEmpty() && mtJobIndexes[jobIndex] >= 0)
+      {
+        const unsigned mtIndex = (unsigned)mtJobIndexes[jobIndex];
+        RINOK(mtDecoder->WaitJob(mtIndex))
+        mtDecoder->ReleaseJob(mtIndex);
+      }
+      #endif
       // for debug: to test zero size stream unpacking
       // if (folderIndex == kNumNoIndex)  // enable this check for debug
       continue;
@@ -368,17 +745,42 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     try
     {
+      bool dataAfterEnd_Error = false;
+      HRESULT result;
+
+      #ifdef Z7_7Z_EXTRACT_MT
+      if (!mtJobIndexes.IsEmpty() && mtJobIndexes[jobIndex] >= 0)
+      {
+        const unsigned mtIndex = (unsigned)mtJobIndexes[jobIndex];
+        RINOK(mtDecoder->WaitJob(mtIndex))
+        const CMtFolderJob &mj = mtDecoder->Jobs[mtIndex];
+        result = mj.Result;
+        dataAfterEnd_Error = mj.DataAfterEnd_Error;
+        if (mj.OutSize != 0)
+        {
+          const HRESULT res2 = WriteStream(outStream, mj.Buf, mj.OutSize);
+          if (res2 != S_OK && res2 != k_My_HRESULT_WritingWasCut)
+            return res2;
+        }
+        mtDecoder->ReleaseJob(mtIndex);
+      }
+      else
+      #endif
+      {
       #ifndef Z7_NO_CRYPTO
         bool isEncrypted = false;
         bool passwordIsDefined = false;
         UString_Wipe password;
       #endif
 
-      bool dataAfterEnd_Error = false;
+      if (accessHint && job.PackSize != 0)
+        accessHint->SetAccessHint(
+            _db.ArcInfo.DataStartPosition + _db.GetFolderStreamPos(folderIndex, 0),
+            job.PackSize, NStreamAccessHint::kSequential);
 
-      const HRESULT result = decoder.Decode(
+      result = decoder.Decode(
           EXTERNAL_CODECS_VARS
-          _inStream,
+          inStream,
           _db.ArcInfo.DataStartPosition,
           _db, folderIndex,
           &curUnpacked,
@@ -393,6 +795,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
             , true, _numThreads, _memUsage_Decompress
           #endif
           );
+      }
 
       if (result == S_FALSE || result == E_NOTIMPL || dataAfterEnd_Error)
       {
@@ -41,6 +41,7 @@ CHandler::CHandler()
   
   #ifdef Z7_7Z_SET_PROPERTIES
   _useMultiThreadMixer = true;
+  _useMtFolders = true;
   #endif
   
   #endif
@@ -462,13 +463,18 @@ HRESULT CHandler::SetMethodToProp(CNum folderIndex, PROPVARIANT *prop) const
       else if (id == k_LZMA2)
       {
         name = "LZMA2";
-        if (propsSize == 1)
+        if (propsSize == 1 || propsSize == 2)
+        {
           GetLzma2String(s, props[0]);
+          if (propsSize == 2 && (props[1] & 1) != 0)
+            MyStpCpy(s + MyStringLen(s), ":pd");
+        }
       }
-      else if (id == k_PPMD)
+      else if (id == k_PPMD || id == k_PPMD_MT)
       {
-        name = "PPMD";
-        if (propsSize == 5)
+        const bool isMt = (id == k_PPMD_MT);
+        name = isMt ? "PPMD-MT" : "PPMD";
+        if (isMt ? (propsSize == 13 || propsSize == 14) : (propsSize == 5))
         {
           char *dest = s;
           *dest++ = 'o';
@@ -755,6 +761,7 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
   
   InitCommon();
   _useMultiThreadMixer = true;
+  _useMtFolders = true;
 
   for (UInt32 i = 0; i < numProps; i++)
   {
@@ -772,6 +779,11 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
         RINOK(PROPVARIANT_to_bool(value, _useMultiThreadMixer))
         continue;
       }
+      if (name.IsEqualTo("mtb"))
+      {
+        RINOK(PROPVARIANT_to_bool(value, _useMtFolders))
+        continue;
+      }
       {
         HRESULT hres;
         if (SetCommonProperty(name, value, hres))
@@ -20,6 +20,12 @@
 
 #endif
 
+/* Z7_7Z_EXTRACT_MT : Extract() can decode independent folders (solid blocks)
+   in parallel threads. The files are reported to extract callback in original order. */
+#if !defined(Z7_ST) && !defined(Z7_SFX) && defined(Z7_7Z_SET_PROPERTIES)
+  #define Z7_7Z_EXTRACT_MT
+#endif
+
 // #ifdef Z7_7Z_SET_PROPERTIES
 #include "../Common/HandlerOut.h"
 // #endif
@@ -43,6 +49,7 @@ public:
   bool _numSolidBytesDefined;
   bool _solidExtension;
   bool _useTypeSorting;
+  UInt32 _presetDictSize;
 
   bool _compressHeaders;
   bool _encryptHeadersSpecified;
@@ -54,6 +61,7 @@ public:
   CBoolPair Write_Attrib;
 
   bool _useMultiThreadMixer;
+  bool _useMtFolders;   // parallel decoding of folders in Extract()
   bool _removeSfxBlock;
   // bool _volumeMode;
 
@@ -139,6 +147,7 @@ private:
   
   #ifdef Z7_7Z_SET_PROPERTIES
   bool _useMultiThreadMixer;
+  bool _useMtFolders;
   #endif
 
   UInt32 _crcSize;
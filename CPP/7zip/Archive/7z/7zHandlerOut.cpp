@@ -136,6 +136,12 @@ HRESULT CHandler::SetMainMethod(CCompressionMethodMode &methodMode)
     CMethodFull &methodFull = methodMode.Methods.AddNew();
     RINOK(PropsMethod_To_FullMethod(methodFull, oneMethodInfo))
 
+    /* LZMA decoders of old versions accept the properties with flags byte,
+       and they can't report that preset dictionary is required.
+       So preset dictionary is supported only for LZMA2. */
+    if (_presetDictSize != 0 && methodFull.Id == k_LZMA)
+      return E_INVALIDARG;
+
 #ifndef Z7_ST
     methodFull.Set_NumThreads = true;
     methodFull.NumThreads = methodMode.NumThreads;
@@ -149,7 +155,8 @@ HRESULT CHandler::SetMainMethod(CCompressionMethodMode &methodMode)
     {
       case k_LZMA:
       case k_LZMA2: dicSize = oneMethodInfo.Get_Lzma_DicSize(); break;
-      case k_PPMD: dicSize = oneMethodInfo.Get_Ppmd_MemSize(); break;
+      case k_PPMD:
+      case k_PPMD_MT: dicSize = oneMethodInfo.Get_Ppmd_MemSize(); break;
       case k_Deflate: dicSize = (UInt32)1 << 15; break;
       case k_Deflate64: dicSize = (UInt32)1 << 16; break;
       case k_BZip2: dicSize = oneMethodInfo.Get_BZip2_BlockSize(); break;
@@ -232,7 +239,7 @@ HRESULT CHandler::SetMainMethod(CCompressionMethodMode &methodMode)
           && !methodMode.NumThreads_WasForced
           && methodMode.MemoryUsageLimit_WasSet)
       {
-        const UInt32 lzmaThreads = oneMethodInfo.Get_Lzma_NumThreads();
+        const UInt32 lzmaThreads = oneMethodInfo.Get_Lzma_NumThreads(true);
         const UInt32 numBlockThreads_Original = methodMode.NumThreads / lzmaThreads;
 
         if (numBlockThreads_Original > 1)
@@ -244,7 +251,7 @@ HRESULT CHandler::SetMainMethod(CCompressionMethodMode &methodMode)
           */
 
           UInt32 numBlockThreads = numBlockThreads_Original;
-          const UInt64 lzmaMemUsage = oneMethodInfo.Get_Lzma_MemUsage(false); // solid
+          const UInt64 lzmaMemUsage = oneMethodInfo.Get_Lzma_MemUsage(false, true); // solid
           
           for (; numBlockThreads > 1; numBlockThreads--)
           {
@@ -798,6 +805,7 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   options.NumSolidBytes = _numSolidBytes;
   options.SolidExtension = _solidExtension;
   options.UseTypeSorting = _useTypeSorting;
+  options.PresetDictSize = _presetDictSize;
 
   options.RemoveSfxBlock = _removeSfxBlock;
   // options.VolumeMode = _volumeMode;
@@ -865,11 +873,13 @@ void COutHandler::InitProps7z()
   Write_Attrib.Init();
 
   _useMultiThreadMixer = true;
+  _useMtFolders = true;
 
   // _volumeMode = false;
 
   InitSolid();
   _useTypeSorting = false;
+  _presetDictSize = 0;
 
   _decoderCompatibilityVersion = k_decoderCompatibilityVersion;
   _enabledFilters.Clear();
@@ -1041,8 +1051,23 @@ HRESULT COutHandler::SetProperty(const wchar_t *nameSpec, const PROPVARIANT &val
     
     if (name.IsEqualTo("mtf")) return PROPVARIANT_to_bool(value, _useMultiThreadMixer);
 
+    if (name.IsEqualTo("mtb")) return PROPVARIANT_to_bool(value, _useMtFolders);
+
     if (name.IsEqualTo("qs")) return PROPVARIANT_to_bool(value, _useTypeSorting);
 
+    if (name.IsEqualTo("pd"))
+    {
+      // the size of preset dictionary for LZMA / LZMA2 coders
+      UInt64 v;
+      if (!ParseSizeString(L"", value, 0, v))
+        return E_INVALIDARG;
+      const UInt32 kPresetDictSizeMax = (UInt32)1 << 24;
+      if (v > kPresetDictSizeMax)
+        return E_INVALIDARG;
+      _presetDictSize = (UInt32)v;
+      return S_OK;
+    }
+
     if (name.IsPrefixedBy_Ascii_NoCase("yv"))
     {
       name.Delete(0, 2);
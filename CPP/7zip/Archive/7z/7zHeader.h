@@ -96,6 +96,13 @@ namespace NID
   };
 }
 
+// the types of properties in NID::kArchiveProperties record
+
+namespace NArcPropID
+{
+  const UInt64 kPresetDict = 1; // preset dictionary for LZMA2 coders of folders
+}
+
 
 const UInt32 k_Copy = 0;
 const UInt32 k_Delta = 3;
@@ -109,6 +116,7 @@ const UInt32 k_SWAP4 = 0x20304;
 
 const UInt32 k_LZMA  = 0x30101;
 const UInt32 k_PPMD  = 0x30401;
+const UInt32 k_PPMD_MT = 0x30402;
 
 const UInt32 k_Deflate   = 0x40108;
 const UInt32 k_Deflate64 = 0x40109;
@@ -420,12 +420,22 @@ void CInArchive::Close()
   ThereIsHeaderError = false;
 }
 
-void CInArchive::ReadArchiveProperties(CInArchiveInfo & /* archiveInfo */)
+void CInArchive::ReadArchiveProperties(CDbEx &db)
 {
   for (;;)
   {
-    if (ReadID() == NID::kEnd)
+    const UInt64 type = ReadID();
+    if (type == NID::kEnd)
       break;
+    if (type == NArcPropID::kPresetDict)
+    {
+      const UInt64 size = ReadNumber();
+      if (size > _inByteBack->GetRem() || size > ((UInt32)1 << 30))
+        ThrowIncorrect();
+      db.PresetDict.Alloc((size_t)size);
+      ReadBytes(db.PresetDict, (size_t)size);
+      continue;
+    }
     SkipData();
   }
 }
@@ -802,7 +812,8 @@ void CInArchive::ReadUnpackInfo(
           const CNum propsSize = inByte->ReadNum();
           if (propsSize > inByte->GetRem())
             ThrowEndOfData();
-          if (id == k_LZMA2 && propsSize == 1)
+          // LZMA2 properties can contain additional byte of flags (preset dictionary)
+          if (id == k_LZMA2 && (propsSize == 1 || propsSize == 2))
           {
             const Byte v = *_inByteBack->GetPtr();
             if (folders.ParsedMethods.Lzma2Prop < v)
@@ -1239,7 +1250,7 @@ HRESULT CInArchive::ReadHeader(
 
   if (type == NID::kArchiveProperties)
   {
-    ReadArchiveProperties(db.ArcInfo);
+    ReadArchiveProperties(db);
     type = ReadID();
   }
  
@@ -1681,18 +1692,42 @@ HRESULT CInArchive::ReadDatabase2(
   const size_t nextHeaderSize_t = (size_t)nextHeaderSize;
   if (nextHeaderSize_t != nextHeaderSize)
     return E_OUTOFMEMORY;
-  CByteBuffer buffer2(nextHeaderSize_t);
-
-  RINOK(ReadStream_FALSE(_stream, buffer2, nextHeaderSize_t))
+  CByteBuffer buffer2;
+  const Byte *header = NULL;
+  {
+    /* if the archive stream is memory mapped,
+       we parse the header directly from stream memory without copying */
+    CMyComPtr<IStreamGetRangePtr> getRangePtr;
+    _stream.QueryInterface(IID_IStreamGetRangePtr, &getRangePtr);
+    if (getRangePtr && (UInt32)nextHeaderSize_t == nextHeaderSize_t)
+    {
+      UInt64 pos;
+      RINOK(_stream->Seek(0, STREAM_SEEK_CUR, &pos))
+      const Byte *data;
+      UInt32 avail;
+      if (getRangePtr->GetRangePtr(pos, (UInt32)nextHeaderSize_t, &data, &avail) == S_OK
+          && avail == nextHeaderSize_t)
+      {
+        RINOK(_stream->Seek((Int64)nextHeaderSize_t, STREAM_SEEK_CUR, NULL))
+        header = data;
+      }
+    }
+  }
+  if (!header)
+  {
+    buffer2.Alloc(nextHeaderSize_t);
+    RINOK(ReadStream_FALSE(_stream, buffer2, nextHeaderSize_t))
+    header = buffer2;
+  }
 
-  if (CrcCalc(buffer2, nextHeaderSize_t) != nextHeaderCRC)
+  if (CrcCalc(header, nextHeaderSize_t) != nextHeaderCRC)
     ThrowIncorrect();
 
   if (!db.StartHeaderWasRecovered)
     db.PhySizeWasConfirmed = true;
   
   CStreamSwitch streamSwitch;
-  streamSwitch.Set(this, buffer2);
+  streamSwitch.Set(this, header, nextHeaderSize_t, false);
   
   CObjectVector<CByteBuffer> dataVector;
   
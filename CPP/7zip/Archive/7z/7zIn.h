@@ -63,6 +63,8 @@ struct CFolders
   CObjArray<size_t> FoCodersDataOffset;    // NumFolders + 1
   CByteBuffer CodersData;
 
+  CByteBuffer PresetDict; // preset dictionary for LZMA / LZMA2 coders (NArcPropID::kPresetDict)
+
   CParsedMethods ParsedMethods;
 
   void ParseFolderInfo(unsigned folderIndex, CFolder &folder) const;
@@ -104,6 +106,7 @@ struct CFolders
     FoToMainUnpackSizeIndex.Free();
     FoCodersDataOffset.Free();
     CodersData.Free();
+    PresetDict.Free();
   }
 };
 
@@ -392,7 +395,7 @@ class CInArchive
 
   void Read_UInt32_Vector(CUInt32DefVector &v);
 
-  void ReadArchiveProperties(CInArchiveInfo &archiveInfo);
+  void ReadArchiveProperties(CDbEx &db);
   void ReadHashDigests(unsigned numItems, CUInt32DefVector &crcs);
   
   void ReadPackInfo(CFolders &f);
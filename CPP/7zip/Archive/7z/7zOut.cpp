@@ -633,6 +633,15 @@ void COutArchive::WriteHeader(
   }
   */
 
+  if (db.PresetDict.Size() != 0)
+  {
+    WriteByte(NID::kArchiveProperties);
+    WriteNumber(NArcPropID::kPresetDict);
+    WriteNumber(db.PresetDict.Size());
+    WriteBytes(db.PresetDict, db.PresetDict.Size());
+    WriteByte(NID::kEnd);
+  }
+
   if (db.Folders.Size() > 0)
   {
     WriteByte(NID::kMainStreamsInfo);
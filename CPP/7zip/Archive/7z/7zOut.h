@@ -146,6 +146,8 @@ struct CArchiveDatabaseOut: public COutFolders
   CUInt32DefVector Attrib;
   CBoolVector IsAnti;
 
+  CByteBuffer PresetDict; // it's written to NID::kArchiveProperties record
+
   /*
   CBoolVector IsAux;
 
@@ -177,6 +179,7 @@ struct CArchiveDatabaseOut: public COutFolders
     StartPos.Clear();
     Attrib.Clear();
     IsAnti.Clear();
+    PresetDict.Free();
 
     /*
     IsAux.Clear();
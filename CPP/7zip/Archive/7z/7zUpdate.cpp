@@ -1877,6 +1877,56 @@ Z7_COM7F_IMF(CCryptoGetTextPassword::CryptoGetTextPassword(BSTR *password))
 #endif
 
 
+/* CPresetDictSampleStream passes the data of solid block to encoder,
+   and it keeps the copy of first (maxSize) bytes of that data.
+   That sample is used as preset dictionary for next solid blocks. */
+
+Z7_CLASS_IMP_COM_2(
+  CPresetDictSampleStream
+  , ISequentialInStream
+  , ICompressGetSubStreamSize
+)
+  CMyComPtr<ISequentialInStream> _stream;
+  CMyComPtr<ICompressGetSubStreamSize> _getSubStreamSize;
+  CByteBuffer _buf;
+  size_t _size;
+public:
+  void Init(ISequentialInStream *stream, size_t maxSize)
+  {
+    _stream = stream;
+    _getSubStreamSize.Release();
+    stream->QueryInterface(IID_ICompressGetSubStreamSize, (void **)&_getSubStreamSize);
+    _buf.Alloc(maxSize);
+    _size = 0;
+  }
+  void GetSample(CByteBuffer &dest) const { dest.CopyFrom(_buf, _size); }
+};
+
+Z7_COM7F_IMF(CPresetDictSampleStream::Read(void *data, UInt32 size, UInt32 *processedSize))
+{
+  UInt32 realProcessed = 0;
+  const HRESULT res = _stream->Read(data, size, &realProcessed);
+  size_t cur = _buf.Size() - _size;
+  if (cur > realProcessed)
+    cur = realProcessed;
+  if (cur != 0)
+  {
+    memcpy(_buf + _size, data, cur);
+    _size += cur;
+  }
+  if (processedSize)
+    *processedSize = realProcessed;
+  return res;
+}
+
+Z7_COM7F_IMF(CPresetDictSampleStream::GetSubStreamSize(UInt64 subStream, UInt64 *value))
+{
+  if (!_getSubStreamSize)
+    return E_NOTIMPL;
+  return _getSubStreamSize->GetSubStreamSize(subStream, value);
+}
+
+
 static void GetFile(const CDatabase &inDb, unsigned index, CFileItem &file, CFileItem2 &file2)
 {
   file = inDb.Files[index];
@@ -2322,6 +2372,16 @@ HRESULT Update(
     filters.Sort2();
   }
 
+  /* the folders of old archive can require preset dictionary.
+     So we keep it, and we use it for new folders also. */
+  CByteBuffer presetDict;
+  bool presetDictIsUsed = false;
+  if (db && db->PresetDict.Size() != 0)
+  {
+    presetDict = db->PresetDict;
+    presetDictIsUsed = true;
+  }
+
   for (unsigned groupIndex = 0; groupIndex < filters.Size(); groupIndex++)
   {
     const CFilterMode2 &filterMode = filters[groupIndex];
@@ -2358,6 +2418,7 @@ HRESULT Update(
     }
 
     CEncoder encoder(method);
+    encoder.SetPresetDict(presetDict);
 
     // ---------- Repack and copy old solid blocks ----------
 
@@ -2589,6 +2650,8 @@ HRESULT Update(
           if (encodeRes == S_OK)
           {
             encoder.Encode_Post(curUnpackSize, newDatabase.CoderUnpackSizes);
+            if (encoder.PresetDictWasUsed)
+              presetDictIsUsed = true;
           }
 
           #ifndef Z7_ST
@@ -2796,10 +2859,19 @@ HRESULT Update(
       const UInt64 expectedDataSize = totalSize;
 
       // const unsigned folderIndex_New = newDatabase.Folders.Size();
+
+      /* if there is no preset dictionary yet, we sample it from the head of this solid block.
+         This block is encoded without preset dictionary, and next blocks use that sample. */
+      CMyComPtr2<ISequentialInStream, CPresetDictSampleStream> sampleStream;
+      if (options.PresetDictSize != 0 && presetDict.Size() == 0)
+      {
+        sampleStream.Create_if_Empty();
+        sampleStream->Init(inStreamSpec, options.PresetDictSize);
+      }
       
       RINOK(encoder.Encode1(
           EXTERNAL_CODECS_LOC_VARS
-          inStreamSpec,
+          sampleStream.IsDefined() ? sampleStream.Interface() : inStreamSpec.Interface(),
           // NULL,
           &inSizeForReduce,
           expectedDataSize, // expected size
@@ -2807,6 +2879,14 @@ HRESULT Update(
           // newDatabase.CoderUnpackSizes, curFolderUnpackSize,
           archive.SeqStream, newDatabase.PackSizes, lps))
 
+      if (encoder.PresetDictWasUsed)
+        presetDictIsUsed = true;
+      if (sampleStream.IsDefined())
+      {
+        sampleStream->GetSample(presetDict);
+        encoder.SetPresetDict(presetDict);
+      }
+
       if (!inStreamSpec->WasFinished())
         return E_FAIL;
 
@@ -3070,6 +3150,9 @@ HRESULT Update(
     newDatabase.FolderUnpackCRCs.if_NonEmpty_FillResidue_with_false(numFolders);
   }
   
+  if (presetDictIsUsed)
+    newDatabase.PresetDict = presetDict;
+
   updateItems.ClearAndFree();
   newDatabase.ReserveDown();
 
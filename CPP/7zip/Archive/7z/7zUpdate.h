@@ -99,6 +99,9 @@ struct CUpdateOptions
   bool SolidExtension;
   
   bool UseTypeSorting;
+
+  UInt32 PresetDictSize; // 0 : no preset dictionary. Another value : the size of preset dictionary
+                         // that is sampled from first new solid block for LZMA / LZMA2 coders of next blocks
   
   bool RemoveSfxBlock;
   bool MultiThreadMixer;
@@ -140,6 +143,7 @@ struct CUpdateOptions
       NumSolidBytes((UInt64)(Int64)(-1)),
       SolidExtension(false),
       UseTypeSorting(true),
+      PresetDictSize(0),
       RemoveSfxBlock(false),
       MultiThreadMixer(true),
       Need_CTime(false),
@@ -209,6 +209,25 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
   #ifndef Z7_ST
   RINOK(decoder->SetNumberOfThreads(_props._numThreads))
+  {
+    /* multithreaded decoder uses additional memory for each thread.
+       The callback can replace default limit by (-smemx) limit. */
+    UInt64 memUsage = _props._memUsage_Decompress;
+    CMyComPtr<IArchiveRequestMemoryUseCallback> requestMem;
+    extractCallback->QueryInterface(IID_IArchiveRequestMemoryUseCallback, (void **)&requestMem);
+    if (requestMem)
+    {
+      UInt32 answerFlags = NRequestMemoryAnswerFlags::k_Allow;
+      RINOK(requestMem->RequestMemoryUse(
+          0, // flags
+          NEventIndexType::kNoIndex,
+          0,    // index
+          NULL, // path
+          0,    // requiredSize : single-thread decoding doesn't need additional memory
+          &memUsage, &answerFlags))
+    }
+    RINOK(decoder->SetMemLimit(memUsage))
+  }
   #endif
 
   CMyComPtr2_Create<ISequentialOutStream, CDummyOutStream> outStream;
@@ -360,6 +379,17 @@ static HRESULT UpdateArchive(
     {
       CMyComPtr2_Create<ICompressCoder, NCompress::NBZip2::CEncoder> encoder;
       RINOK(props.SetCoderProps(encoder.ClsPtr(), NULL))
+      {
+        Z7_DECL_CMyComPtr_QI_FROM(
+            ICompressSetCoderPropertiesOpt,
+            optProps, encoder.Interface())
+        if (optProps)
+        {
+          const PROPID propID = NCoderPropID::kExpectedDataSize;
+          NWindows::NCOM::CPropVariant prop = unpackSize;
+          RINOK(optProps->SetCoderPropertiesOpt(&propID, &prop, 1))
+        }
+      }
       RINOK(encoder.Interface()->Code(fileInStream, outStream, NULL, NULL, lps))
       /*
       if (reportArcProp)
@@ -5,10 +5,14 @@
 #include "../../Common/MyWindows.h"
 #include "../../Common/MyInitGuid.h"
 
-#if defined(Z7_LARGE_PAGES)
+#if defined(Z7_LARGE_PAGES) || defined(Z7_HUGE_PAGES)
 #include "../../../C/Alloc.h"
 #endif
 
+#ifndef Z7_ST
+#include "../../../C/Threads.h"
+#endif
+
 #include "../../Common/ComTry.h"
 
 #include "../../Windows/NtCheck.h"
@@ -54,6 +58,11 @@ BOOL WINAPI DllMain(
     // OutputDebugStringA("7z.dll DLL_PROCESS_ATTACH");
     g_hInstance = (HINSTANCE)hInstance;
     NT_CHECK
+    #ifndef Z7_ST
+    /* we can't stop idle workers of thread pool in DllMain(DLL_PROCESS_DETACH),
+       because thread exit waits for loader lock. So the DLL doesn't keep idle workers. */
+    ThreadPool_SetMaxIdle(0);
+    #endif
   }
   /*
   if (dwReason == DLL_PROCESS_DETACH)
@@ -77,6 +86,15 @@ static __attribute__((constructor)) void Init_ForceToUTF8()
   // printf("\nDLLExports2.cpp::Init_ForceToUTF8 =%d\n", g_ForceToUTF8 ? 1 : 0);
 }
 
+#ifndef Z7_ST
+// it stops idle workers of thread pool, when library is unloaded or at process exit
+static __attribute__((destructor)) void Free_ThreadPool();
+static __attribute__((destructor)) void Free_ThreadPool()
+{
+  ThreadPool_Free();
+}
+#endif
+
 #endif // _WIN32
 
 
@@ -113,6 +131,9 @@ STDAPI SetLargePageMode()
   SetLargePageSize();
   #endif
   #endif
+  #ifdef Z7_HUGE_PAGES
+  SetHugePageSize();
+  #endif
   return S_OK;
 }
 
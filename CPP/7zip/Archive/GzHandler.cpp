@@ -21,6 +21,7 @@
 #include "../Compress/DeflateDecoder.h"
 #include "../Compress/DeflateEncoder.h"
 
+#include "Common/DummyOutStream.h"
 #include "Common/HandlerOut.h"
 #include "Common/InStreamWithCRC.h"
 #include "Common/OutStreamWithCRC.h"
@@ -446,7 +447,8 @@ HRESULT CItem::WriteFooter(ISequentialOutStream *stream)
   return WriteStream(stream, buf, 8);
 }
 
-Z7_CLASS_IMP_CHandler_IInArchive_3(
+Z7_CLASS_IMP_CHandler_IInArchive_4(
+  IInArchiveGetStream,
   IArchiveOpenSeq,
   IOutArchive,
   ISetProperties
@@ -473,9 +475,18 @@ Z7_CLASS_IMP_CHandler_IInArchive_3(
   CSingleMethodProps _props;
   CHandlerTimeOptions _timeOptions;
 
+  // index of access points for random access in GetStream()
+  bool _index_Defined;
+  UInt64 _index_UnpackSize;
+  NDecoder::CAccessPoints _accessPoints;
+
+  HRESULT CreateIndex();
+  friend class CInStream;
+
 public:
   CHandler():
-      _isArc(false)
+      _isArc(false),
+      _index_Defined(false)
       {}
   
   void CreateDecoder()
@@ -662,6 +673,9 @@ Z7_COM7F_IMF(CHandler::Close())
 
   _packSize = 0;
   _headerSize = 0;
+
+  _index_Defined = false;
+  _accessPoints.Points.Clear();
   
   _stream.Release();
   if (_decoder)
@@ -695,6 +709,10 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   RINOK(extractCallback->PrepareOperation(askMode))
 
   CreateDecoder();
+ #ifndef Z7_ST
+  // speculative multi-thread decoding is used only if number of threads was specified
+  _decoder->SetNumberOfThreads(_props._numThreads_WasForced ? _props._numThreads : 1);
+ #endif
 
   CMyComPtr2_Create<ISequentialOutStream, COutStreamWithCRC> outStream;
   outStream->SetStream(realOutStream);
@@ -860,6 +878,251 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   COM_TRY_END
 }
 
+/* The index contains access points in deflate streams.
+   The decoder adds access points in first pass of decoding, and CInStream
+   uses nearest access point to continue decoding from required position. */
+
+static const UInt64 k_Index_Spacing = (UInt64)1 << 20;
+static const unsigned k_Index_NumPointsMax = 1 << 10;
+
+HRESULT CHandler::CreateIndex()
+{
+  if (!_stream)
+    return E_FAIL;
+  _index_Defined = false;
+  _accessPoints.Init(k_Index_Spacing, k_Index_NumPointsMax);
+
+  CreateDecoder();
+  RINOK(InStream_SeekToBegin(_stream))
+  _needSeekToStart = true;
+  _decoder->SetInStream(_stream);
+  _decoder->InitInStream(true);
+
+  CMyComPtr2_Create<ISequentialOutStream, CDummyOutStream> outStream;
+  outStream->Init();
+
+  HRESULT res = S_OK;
+
+  try {
+
+  for (bool firstItem = true;; firstItem = false)
+  {
+    CItem item;
+    res = item.ReadHeader(_decoder.ClsPtr());
+    if (res == S_OK && _decoder->InputEofError())
+      res = S_FALSE;
+    if (res != S_OK)
+    {
+      if (res == S_FALSE && !firstItem)
+        res = S_OK;
+      break;
+    }
+
+    _accessPoints.OutOffset = outStream->GetSize();
+    _decoder->Set_AccessPoints(&_accessPoints);
+    res = _decoder->CodeResume(outStream, NULL, NULL);
+    _decoder->Set_AccessPoints(NULL);
+    if (res == S_OK && _decoder->InputEofError())
+      res = S_FALSE;
+    if (res != S_OK)
+      break;
+
+    _decoder->AlignToByte();
+    res = item.ReadFooter1(_decoder.ClsPtr());
+    if (res != S_OK)
+      break;
+  }
+
+  } catch(const CInBufferException &e) { res = e.ErrorCode; }
+
+  _decoder->Set_AccessPoints(NULL);
+  RINOK(res)
+  _index_UnpackSize = outStream->GetSize();
+  _index_Defined = true;
+  return S_OK;
+}
+
+
+Z7_CLASS_IMP_IInStream(
+  CInStream
+)
+  UInt64 _virtPos;
+  UInt64 _outPos;
+  bool _needRestart;
+  CByteBuffer _skipBuf;
+  CMyComPtr2<ICompressCoder, NDecoder::CCOMCoder> _decoder;
+
+  HRESULT Restart(UInt64 pos);
+  HRESULT ReadDecoded(void *data, UInt32 size, UInt32 &processed);
+public:
+  UInt64 Size;
+  CMyComPtr2<IInArchive, CHandler> _handlerSpec;
+
+  void InitAndSeek()
+  {
+    _virtPos = 0;
+    _outPos = 0;
+    _needRestart = true;
+  }
+};
+
+
+HRESULT CInStream::Restart(UInt64 pos)
+{
+  _needRestart = true;
+  _decoder.Create_if_Empty();
+  const NDecoder::CAccessPoints &ap = _handlerSpec->_accessPoints;
+  IInStream *stream = _handlerSpec->_stream;
+  const int index = ap.Find(pos);
+  if (index < 0)
+  {
+    RINOK(InStream_SeekToBegin(stream))
+    _decoder->SetInStream(stream);
+    _decoder->InitInStream(true);
+    CItem item;
+    RINOK(item.ReadHeader(_decoder.ClsPtr()))
+    _decoder->SetOutStreamSizeResume(NULL);
+    _outPos = 0;
+  }
+  else
+  {
+    const NDecoder::CAccessPoint &point = ap.Points[(unsigned)index];
+    RINOK(InStream_SeekSet(stream, point.InBitPos >> 3))
+    _decoder->SetInStream(stream);
+    RINOK(_decoder->InitFromAccessPoint(point))
+    _outPos = point.OutPos;
+  }
+  _needRestart = false;
+  return S_OK;
+}
+
+
+HRESULT CInStream::ReadDecoded(void *data, UInt32 size, UInt32 &processed)
+{
+  processed = 0;
+  for (;;)
+  {
+    if (_decoder->IsFinished())
+    {
+      // we go to next gzip stream
+      CItem item;
+      _decoder->AlignToByte();
+      RINOK(item.ReadFooter1(_decoder.ClsPtr()))
+      RINOK(item.ReadHeader(_decoder.ClsPtr()))
+      _decoder->SetOutStreamSizeResume(NULL);
+    }
+    UInt32 cur = 0;
+    const HRESULT res = ((ISequentialInStream *)_decoder.ClsPtr())->Read(data, size, &cur);
+    _outPos += cur;
+    processed = cur;
+    RINOK(res)
+    if (cur != 0)
+      return S_OK;
+    if (!_decoder->IsFinished())
+      return S_FALSE;
+  }
+}
+
+
+Z7_COM7F_IMF(CInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
+{
+  COM_TRY_BEGIN
+
+  if (processedSize)
+    *processedSize = 0;
+  if (_virtPos >= Size)
+    return S_OK;
+  {
+    const UInt64 rem = Size - _virtPos;
+    if (size > rem)
+      size = (UInt32)rem;
+  }
+  if (size == 0)
+    return S_OK;
+
+  try {
+
+  if (!_needRestart)
+  {
+    const int index = _handlerSpec->_accessPoints.Find(_virtPos);
+    if (_virtPos < _outPos
+        || (index >= 0 && _handlerSpec->_accessPoints.Points[(unsigned)index].OutPos > _outPos))
+      _needRestart = true;
+  }
+  if (_needRestart)
+    RINOK(Restart(_virtPos))
+
+  while (_outPos < _virtPos)
+  {
+    const size_t kSkipBufSize = 1 << 16;
+    _skipBuf.Alloc(kSkipBufSize);
+    UInt32 cur = kSkipBufSize;
+    if (cur > _virtPos - _outPos)
+      cur = (UInt32)(_virtPos - _outPos);
+    UInt32 processed;
+    const HRESULT res = ReadDecoded(_skipBuf, cur, processed);
+    if (res != S_OK)
+    {
+      _needRestart = true;
+      return res;
+    }
+  }
+
+  UInt32 processed;
+  const HRESULT res = ReadDecoded(data, size, processed);
+  _virtPos += processed;
+  if (processedSize)
+    *processedSize = processed;
+  if (res != S_OK)
+    _needRestart = true;
+  return res;
+
+  } catch(const CInBufferException &e) { _needRestart = true; return e.ErrorCode; }
+
+  COM_TRY_END
+}
+
+
+Z7_COM7F_IMF(CInStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition))
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _virtPos; break;
+    case STREAM_SEEK_END: offset += Size; break;
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _virtPos = (UInt64)offset;
+  if (newPosition)
+    *newPosition = (UInt64)offset;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CHandler::GetStream(UInt32 index, ISequentialInStream **stream))
+{
+  COM_TRY_BEGIN
+  *stream = NULL;
+  if (index != 0)
+    return E_INVALIDARG;
+  if (!_stream)
+    return S_FALSE;
+  if (!_index_Defined)
+    RINOK(CreateIndex())
+
+  CMyComPtr2<ISequentialInStream, CInStream> spec;
+  spec.Create_if_Empty();
+  spec->_handlerSpec.SetFromCls(this);
+  spec->Size = _index_UnpackSize;
+  spec->InitAndSeek();
+  *stream = spec.Detach();
+  return S_OK;
+  COM_TRY_END
+}
+
+
 static const Byte kHostOS =
   #ifdef _WIN32
   NHostOS::kFAT;
@@ -1108,7 +1371,11 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
         return E_INVALIDARG;
       size = prop.uhVal.QuadPart;
     }
-    return UpdateArchive(outStream, size, newItem, _props, _timeOptions, updateCallback);
+    CSingleMethodProps props2 = _props;
+#ifndef Z7_ST
+    props2.AddProp_NumThreads(_props._numThreads);
+#endif
+    return UpdateArchive(outStream, size, newItem, props2, _timeOptions, updateCallback);
   }
 
   if (indexInArchive != 0)
@@ -2,153 +2,37 @@
 
 #include "StdAfx.h"
 
+#ifndef Z7_EXTRACT_ONLY
+#define Z7_USE_LZ4_COMPRESSION
+#endif
+
 #include "../../Common/ComTry.h"
 
 #include "../../Windows/PropVariant.h"
 
+#include "../Common/MethodProps.h"
 #include "../Common/ProgressUtils.h"
 #include "../Common/RegisterArc.h"
 #include "../Common/StreamUtils.h"
 
 #include "../Compress/CopyCoder.h"
+#include "../Compress/Lz4Decoder.h"
+
+#ifdef Z7_USE_LZ4_COMPRESSION
+#include "../Compress/Lz4Encoder.h"
+#include "Common/HandlerOut.h"
+#endif
 
 #include "Common/DummyOutStream.h"
 
 #include "../../../C/CpuArch.h"
-#include "../../../C/Alloc.h"
-#include "../../../C/Lz4Dec.h"
 
 using namespace NWindows;
 
 namespace NArchive {
 namespace NLz4 {
 
-/*
-LZ4 Frame format:
-  Magic: 4 bytes (0x184D2204 little-endian)
-  Frame Descriptor:
-    FLG byte:
-      bits 7-6: Version (must be 01)
-      bit 5: Block Independence
-      bit 4: Block Checksum flag
-      bit 3: Content Size flag
-      bit 2: Content Checksum flag
-      bit 1: Reserved (0)
-      bit 0: DictID flag
-    BD byte:
-      bit 7: Reserved (0)
-      bits 6-4: Block Max Size (4=64KB, 5=256KB, 6=1MB, 7=4MB)
-      bits 3-0: Reserved (0)
-    [Content Size: 8 bytes if Content Size flag set]
-    [DictID: 4 bytes if DictID flag set]
-    Header Checksum: 1 byte (XXH32 >> 8)
-  Data Blocks:
-    Block Size: 4 bytes (bit 31: 1=uncompressed, bits 30-0: size)
-    Block Data: size bytes
-    [Block Checksum: 4 bytes if Block Checksum flag set]
-    ... repeat until Block Size == 0
-  End Mark: 4 bytes (0x00000000)
-  [Content Checksum: 4 bytes if Content Checksum flag set]
-*/
-
-static const UInt32 kMagic = 0x184D2204;
-static const unsigned kMagicSize = 4;
-static const unsigned kMinHeaderSize = 7;  // magic + FLG + BD + HC
-static const unsigned kMaxHeaderSize = 19; // magic + FLG + BD + content_size(8) + dictid(4) + HC
-
-static const unsigned kBlockSizes[] = {
-  0,         // 0: reserved
-  0,         // 1: reserved
-  0,         // 2: reserved
-  0,         // 3: reserved
-  64 << 10,  // 4: 64 KB
-  256 << 10, // 5: 256 KB
-  1 << 20,   // 6: 1 MB
-  4 << 20    // 7: 4 MB
-};
-
-struct CFrameInfo
-{
-  bool BlockIndependence;
-  bool BlockChecksum;
-  bool ContentSizePresent;
-  bool ContentChecksum;
-  bool DictIdPresent;
-  UInt32 BlockMaxSize;
-  UInt64 ContentSize;
-  UInt32 DictId;
-
-  unsigned GetHeaderSize() const
-  {
-    return kMagicSize + 2 + (ContentSizePresent ? 8 : 0) + (DictIdPresent ? 4 : 0) + 1;
-  }
-
-  bool Parse(const Byte *p, size_t size)
-  {
-    if (size < kMinHeaderSize)
-      return false;
-
-    // Check magic
-    if (GetUi32(p) != kMagic)
-      return false;
-    p += 4;
-
-    Byte flg = p[0];
-    Byte bd = p[1];
-    p += 2;
-
-    // Version must be 01
-    if ((flg >> 6) != 1)
-      return false;
-
-    // Reserved bit in FLG must be 0
-    if (flg & 2)
-      return false;
-
-    // Reserved bits in BD must be 0
-    if (bd & 0x8F)
-      return false;
-
-    BlockIndependence = (flg & 0x20) != 0;
-    BlockChecksum = (flg & 0x10) != 0;
-    ContentSizePresent = (flg & 0x08) != 0;
-    ContentChecksum = (flg & 0x04) != 0;
-    DictIdPresent = (flg & 0x01) != 0;
-
-    unsigned blockMaxSizeCode = (bd >> 4) & 7;
-    if (blockMaxSizeCode < 4)
-      return false; // Reserved values
-    BlockMaxSize = kBlockSizes[blockMaxSizeCode];
-
-    ContentSize = 0;
-    DictId = 0;
-
-    unsigned headerSize = kMagicSize + 2;
-
-    if (ContentSizePresent)
-    {
-      headerSize += 8;
-      if (size < headerSize + 1)
-        return false;
-      ContentSize = GetUi64(p);
-      p += 8;
-    }
-
-    if (DictIdPresent)
-    {
-      headerSize += 4;
-      if (size < headerSize + 1)
-        return false;
-      DictId = GetUi32(p);
-      p += 4;
-    }
-
-    // Header checksum (we don't verify it, just skip)
-    headerSize += 1;
-
-    return true;
-  }
-};
+using namespace NCompress::NLz4;
 
 API_FUNC_static_IsArc IsArc_Lz4(const Byte *p, size_t size)
 {
@@ -183,9 +67,31 @@ API_FUNC_static_IsArc IsArc_Lz4(const Byte *p, size_t size)
 }
 }
 
-Z7_CLASS_IMP_CHandler_IInArchive_1(
-  IArchiveOpenSeq
-)
+class CHandler Z7_final:
+  public IInArchive,
+  public IArchiveOpenSeq,
+#ifdef Z7_USE_LZ4_COMPRESSION
+  public ISetProperties,
+  public IOutArchive,
+#endif
+  public CMyUnknownImp
+{
+  Z7_COM_QI_BEGIN2(IInArchive)
+  Z7_COM_QI_ENTRY(IArchiveOpenSeq)
+#ifdef Z7_USE_LZ4_COMPRESSION
+  Z7_COM_QI_ENTRY(ISetProperties)
+  Z7_COM_QI_ENTRY(IOutArchive)
+#endif
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
+
+  Z7_IFACE_COM7_IMP(IInArchive)
+  Z7_IFACE_COM7_IMP(IArchiveOpenSeq)
+#ifdef Z7_USE_LZ4_COMPRESSION
+  Z7_IFACE_COM7_IMP(ISetProperties)
+  Z7_IFACE_COM7_IMP(IOutArchive)
+#endif
+
   CMyComPtr<IInStream> _stream;
   CMyComPtr<ISequentialInStream> _seqStream;
 
@@ -202,6 +108,14 @@ Z7_CLASS_IMP_CHandler_IInArchive_1(
   UInt64 _unpackSize;
 
   CFrameInfo _frameInfo;
+
+#ifdef Z7_USE_LZ4_COMPRESSION
+  bool _disableHash;
+  CSingleMethodProps _props;
+
+public:
+  CHandler(): _disableHash(false) {}
+#endif
 };
 
 static const Byte kProps[] =
@@ -362,185 +276,211 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   else
     _needSeekToStart = true;
 
-  // Read and parse header
-  Byte header[kMaxHeaderSize];
-  RINOK(ReadStream_FALSE(_seqStream, header, kMinHeaderSize))
+  CMyComPtr2_Create<ISequentialOutStream, CDummyOutStream> outStream;
+  outStream->SetStream(realOutStream);
+  outStream->Init();
 
-  CFrameInfo frameInfo;
-  if (!frameInfo.Parse(header, kMinHeaderSize))
+  CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
+  lps->Init(extractCallback, true);
+
+  CMyComPtr2_Create<ICompressCoder, CDecoder> decoder;
+  RINOK(decoder->Decode(_seqStream, outStream, lps))
+
+  _dataAfterEnd = false;
+  _needMoreInput = decoder->NeedMoreInput;
+  _dataError = decoder->DataError;
+
+  if (!decoder->IsArc)
   {
     _isArc = false;
     opRes = NExtract::NOperationResult::kIsNotArc;
   }
   else
   {
-    unsigned headerSize = frameInfo.GetHeaderSize();
-    if (headerSize > kMinHeaderSize)
+    _packSize = decoder->InProcessed;
+    _packSize_Defined = true;
+    if (_needMoreInput)
+      opRes = NExtract::NOperationResult::kUnexpectedEnd;
+    else if (_dataError)
+      opRes = NExtract::NOperationResult::kDataError;
+    else
     {
-      RINOK(ReadStream_FALSE(_seqStream, header + kMinHeaderSize, headerSize - kMinHeaderSize))
+      opRes = NExtract::NOperationResult::kOK;
+      _unpackSize = decoder->OutProcessed;
+      _unpackSize_Defined = true;
     }
+  }
+ }
+  return extractCallback->SetOperationResult(opRes);
 
-    CMyComPtr2_Create<ISequentialOutStream, CDummyOutStream> outStream;
-    outStream->SetStream(realOutStream);
-    outStream->Init();
-
-    CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
-    lps->Init(extractCallback, true);
-
-    _dataAfterEnd = false;
-    _needMoreInput = false;
-    _dataError = false;
+  COM_TRY_END
+}
 
-    UInt64 inProcessed = headerSize;
-    UInt64 outProcessed = 0;
-    bool finished = false;
 
-    // Allocate buffers
-    Byte *compBuf = NULL;
-    Byte *decompBuf = NULL;
-    UInt32 blockMaxSize = frameInfo.BlockMaxSize;
+#ifdef Z7_USE_LZ4_COMPRESSION
 
-    compBuf = (Byte *)MyAlloc(blockMaxSize);
-    decompBuf = (Byte *)MyAlloc(blockMaxSize);
+Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVARIANT *values, UInt32 numProps))
+{
+  _disableHash = false;
+  _props.Init();
 
-    if (!compBuf || !decompBuf)
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    UString name = names[i];
+    const PROPVARIANT &value = values[i];
+    if (name.IsPrefixedBy_Ascii_NoCase("crc"))
     {
-      MyFree(compBuf);
-      MyFree(decompBuf);
-      return E_OUTOFMEMORY;
+      name.Delete(0, 3);
+      UInt32 crcSize = 4;
+      RINOK(ParsePropToUInt32(name, value, crcSize))
+      if (crcSize == 0)
+        _disableHash = true;
+      else if (crcSize == 4)
+        _disableHash = false;
+      else
+        return E_INVALIDARG;
+      continue;
     }
+    RINOK(_props.SetProperty(names[i], value))
+  }
+  return S_OK;
+}
 
-    opRes = NExtract::NOperationResult::kOK;
 
-    // Process blocks
-    while (!finished)
-    {
-      // Read block size
-      Byte blockHeader[4];
-      HRESULT res = ReadStream_FALSE(_seqStream, blockHeader, 4);
-      if (res != S_OK)
-      {
-        _needMoreInput = true;
-        opRes = NExtract::NOperationResult::kUnexpectedEnd;
-        break;
-      }
-      inProcessed += 4;
+Z7_COM7F_IMF(CHandler::GetFileTimeType(UInt32 *timeType))
+{
+  *timeType = GET_FileTimeType_NotDefined_for_GetFileTimeType;
+  return S_OK;
+}
 
-      UInt32 blockSize = GetUi32(blockHeader);
 
-      // End mark
-      if (blockSize == 0)
-      {
-        finished = true;
-        // Skip content checksum if present
-        if (frameInfo.ContentChecksum)
-        {
-          Byte checksum[4];
-          res = ReadStream_FALSE(_seqStream, checksum, 4);
-          if (res == S_OK)
-            inProcessed += 4;
-        }
-        break;
-      }
+Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numItems,
+    IArchiveUpdateCallback *updateCallback))
+{
+  COM_TRY_BEGIN
 
-      bool uncompressed = (blockSize & 0x80000000) != 0;
-      blockSize &= 0x7FFFFFFF;
+  if (numItems != 1)
+    return E_INVALIDARG;
+  {
+    CMyComPtr<IStreamSetRestriction> setRestriction;
+    outStream->QueryInterface(IID_IStreamSetRestriction, (void **)&setRestriction);
+    if (setRestriction)
+      RINOK(setRestriction->SetRestriction(0, 0))
+  }
+  Int32 newData, newProps;
+  UInt32 indexInArchive;
+  if (!updateCallback)
+    return E_FAIL;
+  RINOK(updateCallback->GetUpdateItemInfo(0, &newData, &newProps, &indexInArchive))
+ 
+  if (IntToBool(newProps))
+  {
+    {
+      NCOM::CPropVariant prop;
+      RINOK(updateCallback->GetProperty(0, kpidIsDir, &prop))
+      if (prop.vt != VT_EMPTY)
+        if (prop.vt != VT_BOOL || prop.boolVal != VARIANT_FALSE)
+          return E_INVALIDARG;
+    }
+  }
 
-      if (blockSize > blockMaxSize)
-      {
-        _dataError = true;
-        opRes = NExtract::NOperationResult::kDataError;
-        break;
-      }
+  if (IntToBool(newData))
+  {
+    UInt64 size;
+    {
+      NCOM::CPropVariant prop;
+      RINOK(updateCallback->GetProperty(0, kpidSize, &prop))
+      if (prop.vt != VT_UI8)
+        return E_INVALIDARG;
+      size = prop.uhVal.QuadPart;
+    }
 
-      // Read block data
-      res = ReadStream_FALSE(_seqStream, compBuf, blockSize);
-      if (res != S_OK)
-      {
-        _needMoreInput = true;
-        opRes = NExtract::NOperationResult::kUnexpectedEnd;
-        break;
-      }
-      inProcessed += blockSize;
+    if (!_props.MethodName.IsEmpty()
+        && !_props.MethodName.IsEqualTo_Ascii_NoCase("lz4"))
+      return E_INVALIDARG;
 
-      // Skip block checksum if present
-      if (frameInfo.BlockChecksum)
+    {
+      CMyComPtr<ISequentialInStream> fileInStream;
+      RINOK(updateCallback->GetStream(0, &fileInStream))
+      if (!fileInStream)
+        return S_FALSE;
       {
-        Byte checksum[4];
-        res = ReadStream_FALSE(_seqStream, checksum, 4);
-        if (res != S_OK)
+        CMyComPtr<IStreamGetSize> streamGetSize;
+        fileInStream.QueryInterface(IID_IStreamGetSize, &streamGetSize);
+        if (streamGetSize)
         {
-          _needMoreInput = true;
-          opRes = NExtract::NOperationResult::kUnexpectedEnd;
-          break;
+          UInt64 size2;
+          if (streamGetSize->GetSize(&size2) == S_OK)
+            size = size2;
         }
-        inProcessed += 4;
       }
+      RINOK(updateCallback->SetTotal(size))
 
-      // Decompress or copy
-      const Byte *outData;
-      SizeT outLen;
-
-      if (uncompressed)
-      {
-        // Uncompressed block - write directly from compBuf
-        outData = compBuf;
-        outLen = blockSize;
-      }
-      else
-      {
-        // Decompress
-        outLen = blockMaxSize;
-        SizeT srcConsumed;
-        SRes sres = Lz4Dec_DecodeBlock(compBuf, blockSize, decompBuf, &outLen, &srcConsumed);
-        if (sres != SZ_OK)
-        {
-          _dataError = true;
-          opRes = NExtract::NOperationResult::kDataError;
-          break;
-        }
-        outData = decompBuf;
-      }
+      CMethodProps props2 = _props;
+#ifndef Z7_ST
+      props2.AddProp_NumThreads(_props._numThreads);
+#endif
+      if (_disableHash)
+        props2.AddProp32(NCoderPropID::kCheckSize, 0);
 
-      // Write output
-      if (outLen > 0)
+      CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
+      lps->Init(updateCallback, true);
       {
-        const HRESULT writeRes = WriteStream(outStream, outData, outLen);
-        if (writeRes != S_OK)
+        CMyComPtr2_Create<ICompressCoder, NCompress::NLz4::CEncoder> encoder;
+        RINOK(props2.SetCoderProps(encoder.ClsPtr(), size != (UInt64)(Int64)-1 ? &size : NULL))
+        // we must set kExpectedDataSize just before Code().
         {
-          MyFree(compBuf);
-          MyFree(decompBuf);
-          return writeRes;
+          const PROPID propID = NCoderPropID::kExpectedDataSize;
+          NWindows::NCOM::CPropVariant prop = (UInt64)size;
+          RINOK(encoder->SetCoderPropertiesOpt(&propID, &prop, 1))
         }
-        outProcessed += outLen;
+        RINOK(encoder.Interface()->Code(fileInStream, outStream, NULL, NULL, lps))
       }
-
-      // Progress
-      lps.Interface()->SetRatioInfo(&inProcessed, &outProcessed);
     }
+    return updateCallback->SetOperationResult(NArchive::NUpdate::NOperationResult::kOK);
+  }
+
+  if (indexInArchive != 0)
+    return E_INVALIDARG;
 
-    MyFree(compBuf);
-    MyFree(decompBuf);
+  CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
+  lps->Init(updateCallback, true);
 
-    _packSize = inProcessed;
-    _unpackSize = outProcessed;
-    _packSize_Defined = true;
-    _unpackSize_Defined = true;
+  CMyComPtr<IArchiveUpdateCallbackFile> opCallback;
+  updateCallback->QueryInterface(IID_IArchiveUpdateCallbackFile, (void **)&opCallback);
+  if (opCallback)
+  {
+    RINOK(opCallback->ReportOperation(
+        NEventIndexType::kInArcIndex, 0,
+        NUpdateNotifyOp::kReplicate))
   }
- }
-  return extractCallback->SetOperationResult(opRes);
+
+  if (_stream)
+    RINOK(_stream->Seek(0, STREAM_SEEK_SET, NULL))
+
+  return NCompress::CopyStream(_stream, outStream, lps);
 
   COM_TRY_END
 }
 
+#endif
+
 
 static const Byte k_Signature[] = { 0x04, 0x22, 0x4D, 0x18 };
 
-REGISTER_ARC_I(
+#ifndef Z7_USE_LZ4_COMPRESSION
+#undef  IMP_CreateArcOut
+#define IMP_CreateArcOut
+#undef  CreateArcOut
+#define CreateArcOut NULL
+#endif
+
+REGISTER_ARC_IO(
   "lz4", "lz4 tlz4", "* .tar", 0x11,
   k_Signature,
   0,
   NArcInfoFlags::kKeepName
+  , 0
   , IsArc_Lz4)
 
 }}
@@ -355,7 +355,8 @@ HRESULT CArchive::GetNextItemReal(CItemEx &item)
       item.SparseBlocks.Add(sb);
       if (sb.Offset < min || sb.Offset > item.Size)
         return S_OK;
-      if ((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0)
+      // GNU TAR writes unaligned last data region and empty block at the end of file
+      if (((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0) && sb.Offset + sb.Size != item.Size)
         return S_OK;
       min = sb.Offset + sb.Size;
       if (min < sb.Offset)
@@ -399,7 +400,7 @@ HRESULT CArchive::GetNextItemReal(CItemEx &item)
         item.SparseBlocks.Add(sb);
         if (sb.Offset < min || sb.Offset > item.Size)
           return S_OK;
-        if ((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0)
+        if (((sb.Offset & 0x1FF) != 0 || (sb.Size & 0x1FF) != 0) && sb.Offset + sb.Size != item.Size)
           return S_OK;
         min = sb.Offset + sb.Size;
         if (min < sb.Offset)
@@ -27,6 +27,63 @@ static void FILETIME_To_PaxTime(const FILETIME &ft, CPaxTime &pt)
 }
 
 
+/* GetSparseBlocks() creates the map of data regions of sparse file for GNU sparse header.
+   The regions are aligned for 512 bytes, except of the end of last region at the end of file.
+   If the file ends with hole, the map contains last empty block (Offset == size) as GNU TAR.
+   it returns S_FALSE, if the stream doesn't support hole detection or if there are no holes. */
+
+static HRESULT GetSparseBlocks(IStreamGetDataRange *getDataRange, UInt64 size,
+    CRecordVector<CSparseBlock> &blocks)
+{
+  const UInt64 kAlignMask = NFileHeader::kRecordSize - 1;
+  blocks.Clear();
+  UInt64 pos = 0;
+  while (pos < size)
+  {
+    UInt64 dataPos, dataEnd;
+    RINOK(getDataRange->GetDataRange(pos, &dataPos, &dataEnd))
+    if (dataPos >= size)
+      break;
+    if (dataEnd > size || dataEnd <= dataPos)
+      dataEnd = size;
+    dataPos &= ~kAlignMask;
+    if (dataPos < pos)
+      dataPos = pos;
+    dataEnd = (dataEnd + kAlignMask) & ~kAlignMask;
+    if (dataEnd > size)
+      dataEnd = size;
+    if (!blocks.IsEmpty())
+    {
+      CSparseBlock &last = blocks.Back();
+      if (last.Offset + last.Size == dataPos)
+      {
+        last.Size += dataEnd - dataPos;
+        pos = dataEnd;
+        continue;
+      }
+    }
+    CSparseBlock sb;
+    sb.Offset = dataPos;
+    sb.Size = dataEnd - dataPos;
+    blocks.Add(sb);
+    pos = dataEnd;
+  }
+  if (blocks.Size() == 1 && blocks[0].Offset == 0 && blocks[0].Size == size)
+  {
+    blocks.Clear();
+    return S_FALSE;
+  }
+  if (blocks.IsEmpty() || blocks.Back().Offset + blocks.Back().Size != size)
+  {
+    CSparseBlock sb;
+    sb.Offset = size;
+    sb.Size = 0;
+    blocks.Add(sb);
+  }
+  return S_OK;
+}
+
+
 HRESULT Prop_To_PaxTime(const NWindows::NCOM::CPropVariant &prop, CPaxTime &pt)
 {
   pt.Clear();
@@ -419,11 +476,72 @@ HRESULT UpdateArchive(IInStream *inStream, ISequentialOutStream *outStream,
         const UInt64 headerPos = outArchive.Pos;
         // item.PackSize = ((UInt64)1 << 33); // for debug
 
+        CMyComPtr<IInStream> sparseSeekStream;
+        if (fileInStream
+            && !options.PosixMode
+            && item.LinkFlag == NFileHeader::NLinkFlag::kNormal
+            && item.Size > NFileHeader::kRecordSize)
+        {
+          // the stream supports IStreamGetDataRange, if sparse files mode was requested by caller
+          Z7_DECL_CMyComPtr_QI_FROM(IStreamGetDataRange, getDataRange, fileInStream)
+          if (getDataRange)
+          {
+            fileInStream.QueryInterface(IID_IInStream, &sparseSeekStream);
+            if (sparseSeekStream)
+            {
+              const HRESULT res = GetSparseBlocks(getDataRange, item.Size, item.SparseBlocks);
+              if (res == S_OK)
+              {
+                item.LinkFlag = NFileHeader::NLinkFlag::kSparse;
+                item.PackSize = 0;
+                FOR_VECTOR (i, item.SparseBlocks)
+                  item.PackSize += item.SparseBlocks[i].Size;
+              }
+              else
+              {
+                item.SparseBlocks.Clear();
+                if (res != S_FALSE)
+                  return res;
+              }
+            }
+          }
+        }
+
         if (outSeekStream && setRestriction)
           RINOK(setRestriction->SetRestriction(outArchive.Pos, (UInt64)(Int64)-1))
 
         RINOK(outArchive.WriteHeader(item))
-        if (fileInStream)
+        if (fileInStream && item.Is_Sparse())
+        {
+          // we read only data regions of sparse file. Holes are not stored.
+          UInt64 packSize = 0;
+          FOR_VECTOR (i, item.SparseBlocks)
+          {
+            const CSparseBlock &sb = item.SparseBlocks[i];
+            if (sb.Size == 0)
+              continue;
+            RINOK(sparseSeekStream->Seek((Int64)sb.Offset, STREAM_SEEK_SET, NULL))
+            lps->InSize = lps->OutSize = complexity + sb.Offset;
+            RINOK(copyCoder.Interface()->Code(fileInStream, outStream, NULL, &sb.Size, lps))
+            outArchive.Pos += copyCoder->TotalSize;
+            packSize += copyCoder->TotalSize;
+            if (copyCoder->TotalSize != sb.Size)
+            {
+              // the file was truncated after creation of sparse map
+              if (opCallback)
+              {
+                RINOK(opCallback->ReportOperation(
+                    NEventIndexType::kOutArcIndex, (UInt32)ui.IndexInClient,
+                    NUpdateNotifyOp::kInFileChanged))
+              }
+              return E_FAIL;
+            }
+          }
+          RINOK(outArchive.Write_AfterDataResidual(packSize))
+          // progress for sparse file includes the size of holes
+          complexity += item.Size - item.PackSize;
+        }
+        else if (fileInStream)
         {
           for (unsigned numPasses = 0;; numPasses++)
           {
@@ -1203,14 +1203,14 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
       if (cs != XZ_PROPS_BLOCK_SIZE_AUTO &&
           cs != XZ_PROPS_BLOCK_SIZE_SOLID)
       {
-        const UInt32 lzmaThreads = oneMethodInfo.Get_Lzma_NumThreads();
+        const UInt32 lzmaThreads = oneMethodInfo.Get_Lzma_NumThreads(true);
         const UInt32 numBlockThreads_Original = numThreads / lzmaThreads;
 
         if (numBlockThreads_Original > 1)
         {
           UInt32 numBlockThreads = numBlockThreads_Original;
           {
-            const UInt64 lzmaMemUsage = oneMethodInfo.Get_Lzma_MemUsage(false);
+            const UInt64 lzmaMemUsage = oneMethodInfo.Get_Lzma_MemUsage(false, true);
             for (; numBlockThreads > 1; numBlockThreads--)
             {
               UInt64 size = numBlockThreads * (lzmaMemUsage + cs);
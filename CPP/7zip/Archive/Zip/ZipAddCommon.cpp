@@ -18,6 +18,7 @@
 #include "../../Compress/LzmaEncoder.h"
 #include "../../Compress/PpmdZip.h"
 #include "../../Compress/XzEncoder.h"
+#include "../../Compress/ZstdEncoder.h"
 
 #include "../Common/InStreamWithCRC.h"
 
@@ -166,6 +167,7 @@ HRESULT CAddCommon::Set_Pre_CompressionResult(bool inSeqMode, bool outSeqMode, U
     case NCompressionMethod::kXz   : ver = NCompressionMethod::kExtractVersion_Xz; break;
     case NCompressionMethod::kPPMd : ver = NCompressionMethod::kExtractVersion_PPMd; break;
     case NCompressionMethod::kBZip2: ver = NCompressionMethod::kExtractVersion_BZip2; break;
+    case NCompressionMethod::kZstdWz: ver = NCompressionMethod::kExtractVersion_Zstd; break;
     case NCompressionMethod::kLZMA :
     {
       ver = NCompressionMethod::kExtractVersion_LZMA;
@@ -366,6 +368,12 @@ HRESULT CAddCommon::Compress(
             NCompress::NPpmdZip::CEncoder *encoder = new NCompress::NPpmdZip::CEncoder();
             _compressEncoder = encoder;
           }
+          else if (method == NCompressionMethod::kZstdWz)
+          {
+            _compressExtractVersion = NCompressionMethod::kExtractVersion_Zstd;
+            NCompress::NZstd::CEncoder *encoder = new NCompress::NZstd::CEncoder();
+            _compressEncoder = encoder;
+          }
           else
           {
           CMethodId methodId;
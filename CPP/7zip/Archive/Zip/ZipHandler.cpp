@@ -2,6 +2,7 @@
 
 #include "StdAfx.h"
 
+#include "../../../Common/AutoPtr.h"
 #include "../../../Common/ComTry.h"
 #include "../../../Common/StringConvert.h"
 
@@ -35,6 +36,12 @@
 #include "../Common/ItemNameUtils.h"
 #include "../Common/OutStreamWithCRC.h"
 
+#ifndef Z7_ST
+#include "../../../Windows/Synchronization.h"
+#include "../../../Windows/Thread.h"
+
+#include "../../Common/LockedStream.h"
+#endif
 
 #include "ZipHandler.h"
 
@@ -852,6 +859,9 @@ struct CMethodItem
 };
 
 
+#ifndef Z7_ST
+static const UInt64 kDeflateMt_PackSizeMin = (UInt64)1 << 22;
+#endif
 
 class CZipDecoder
 {
@@ -865,13 +875,21 @@ class CZipDecoder
 
   CLzmaDecoder *lzmaDecoderSpec;
 public:
+ #ifndef Z7_ST
+  bool NumThreads_WasForced;
+ #endif
+
   CZipDecoder():
       lzmaDecoderSpec(NULL)
+     #ifndef Z7_ST
+      , NumThreads_WasForced(false)
+     #endif
     {}
 
   HRESULT Decode(
     DECL_EXTERNAL_CODECS_LOC_VARS
     CInArchive &archive, const CItemEx &item,
+    ISequentialInStream *itemPackStream,
     ISequentialOutStream *realOutStream,
     IArchiveExtractCallback *extractCallback,
     ICompressProgressInfo *compressProgress,
@@ -972,6 +990,7 @@ Z7_COM7F_IMF(COutStreamWithPadPKCS7::Write(const void *data, UInt32 size, UInt32
 HRESULT CZipDecoder::Decode(
     DECL_EXTERNAL_CODECS_LOC_VARS
     CInArchive &archive, const CItemEx &item,
+    ISequentialInStream *itemPackStream,
     ISequentialOutStream *realOutStream,
     IArchiveExtractCallback *extractCallback,
     ICompressProgressInfo *compressProgress,
@@ -1043,7 +1062,13 @@ HRESULT CZipDecoder::Decode(
         return S_OK;
       packSize -= NCrypto::NWzAes::kMacSize;
     }
-    RINOK(archive.GetItemStream(item, true, packStream))
+    // (itemPackStream != NULL) : caller provides the stream that is set to packed data of item
+    if (itemPackStream)
+      packStream = itemPackStream;
+    else
+    {
+      RINOK(archive.GetItemStream(item, true, packStream))
+    }
     if (!packStream)
     {
       res = NExtract::NOperationResult::kUnavailable;
@@ -1208,7 +1233,13 @@ HRESULT CZipDecoder::Decode(
     coder->QueryInterface(IID_ICompressSetCoderMt, (void **)&setCoderMt);
     if (setCoderMt)
     {
-      RINOK(setCoderMt->SetNumberOfThreads(numThreads))
+      UInt32 numThreads2 = numThreads;
+      // speculative multi-thread deflate decoding is used only for big items,
+      // if number of threads was specified
+      if (id == NFileHeader::NCompressionMethod::kDeflate
+          && (!NumThreads_WasForced || item.PackSize < kDeflateMt_PackSizeMin))
+        numThreads2 = 1;
+      RINOK(setCoderMt->SetNumberOfThreads(numThreads2))
     }
   }
   // if (memUsage != 0)
@@ -1558,6 +1589,288 @@ HRESULT CZipDecoder::Decode(
 }
 
 
+#ifndef Z7_ST
+
+/* Multithreaded extraction of independent items:
+   worker threads decode small items to memory buffers in parallel,
+   and main thread writes decoded items in original order via extractCallback.
+   Worker threads and main thread read archive stream via CLockedInStreamReader objects.
+   Encrypted items and big items are decoded in main thread. */
+
+static const UInt32 kMtItem_MaxUnpackSize = (UInt32)1 << 26;
+
+struct CMtItemJob
+{
+  UInt32 ItemIndex;
+  size_t UnpackSize;
+  
+  // these fields are set by main thread, when job is submitted
+  CItemEx Item;       // item with data from local header
+  UInt64 PackPos;     // position of packed data in base stream
+  bool HeadersError;
+  bool MtMode;        // (MtMode == false) : item will be decoded in main thread
+
+  // these fields are set by worker thread
+  CByteBuffer Buf;
+  size_t OutSize;
+  HRESULT Result;
+  Int32 OpRes;
+  bool Finished;
+};
+
+class CItemDecoderMt;
+
+Z7_CLASS_IMP_COM_1(
+  CMtItemProgress
+  , ICompressProgressInfo
+)
+public:
+  const CItemDecoderMt *Parent;
+};
+
+class CItemDecoderMt
+{
+  struct CThreadInfo
+  {
+    NWindows::CPoolThread Thread;
+    CItemDecoderMt *Parent;
+  };
+
+  CObjectVector<CThreadInfo> _threads;
+  NWindows::NSynchronization::CCriticalSection _cs;
+  NWindows::NSynchronization::CSemaphore _canStart;
+  NWindows::NSynchronization::CAutoResetEvent _jobFinished;
+  unsigned _nextJob;      // next submitted job that will be processed by worker thread
+  unsigned _numSubmitted;
+  unsigned _numReleased;  // the jobs that were freed by main thread
+  size_t _inFlightSize;
+  size_t _maxInFlightSize;
+  unsigned _maxInFlightJobs;
+
+  void DecodeJob(CZipDecoder &decoder, CLockedInStreamReader *inStream, CBufPtrSeqOutStream *outStream,
+      ICompressProgressInfo *progress, CMtItemJob &job);
+  static THREAD_FUNC_DECL ThreadFunc(void *p);
+  void ThreadFunc2();
+public:
+  DECL_EXTERNAL_CODECS_LOC_VARS_DECL
+  CInArchive *Archive;
+  CLockedInStreamBase InStream;
+  UInt64 MemUsage;
+  CObjectVector<CMtItemJob> Jobs;
+  volatile bool Exit;
+
+  CItemDecoderMt():
+      _nextJob(0),
+      _numSubmitted(0),
+      _numReleased(0),
+      _inFlightSize(0),
+      Exit(false)
+      {}
+  ~CItemDecoderMt() { StopThreads(); }
+
+  HRESULT Create(UInt32 numThreads, size_t maxInFlightSize);
+  void StopThreads();
+  // SubmitJobs() reads local headers of next jobs and submits jobs to worker threads
+  void SubmitJobs(const CObjectVector<CItemEx> &items);
+  HRESULT WaitJob(unsigned index);
+  void ReleaseJob(unsigned index);
+};
+
+
+Z7_COM7F_IMF(CMtItemProgress::SetRatioInfo(const UInt64 * /* inSize */, const UInt64 * /* outSize */))
+{
+  // it breaks decoding in worker thread, if main thread was stopped
+  return Parent->Exit ? E_ABORT : S_OK;
+}
+
+
+void CItemDecoderMt::DecodeJob(CZipDecoder &decoder, CLockedInStreamReader *inStream, CBufPtrSeqOutStream *outStream,
+    ICompressProgressInfo *progress, CMtItemJob &job)
+{
+  job.OutSize = 0;
+  job.OpRes = NExtract::NOperationResult::kDataError;
+  try
+  {
+    job.Buf.Alloc(job.UnpackSize);
+    outStream->Init(job.Buf, job.UnpackSize);
+    job.Result = InStream_SeekSet(inStream, job.PackPos);
+    if (job.Result == S_OK)
+      job.Result = decoder.Decode(
+          EXTERNAL_CODECS_LOC_VARS
+          *Archive, job.Item, inStream, outStream,
+          NULL, // extractCallback is not used for unencrypted items
+          progress,
+          1, MemUsage,
+          job.OpRes);
+    job.OutSize = outStream->GetPos();
+  }
+  catch(...) { job.Result = E_OUTOFMEMORY; }
+}
+
+
+THREAD_FUNC_DECL CItemDecoderMt::ThreadFunc(void *p)
+{
+  ((CThreadInfo *)p)->Parent->ThreadFunc2();
+  return THREAD_FUNC_RET_ZERO;
+}
+
+
+void CItemDecoderMt::ThreadFunc2()
+{
+  CZipDecoder decoder;
+  CMyComPtr2_Create<IInStream, CLockedInStreamReader> inStream;
+  CMyComPtr2_Create<ISequentialOutStream, CBufPtrSeqOutStream> outStream;
+  CMyComPtr2_Create<ICompressProgressInfo, CMtItemProgress> progress;
+  inStream->Base = &InStream;
+  progress->Parent = this;
+
+  for (;;)
+  {
+    if (_canStart.Lock() != 0 || Exit)
+      return;
+    CMtItemJob *job;
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      job = &Jobs[_nextJob++];
+    }
+    if (job->MtMode)
+      DecodeJob(decoder, inStream.ClsPtr(), outStream.ClsPtr(), progress, *job);
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      job->Finished = true;
+    }
+    _jobFinished.Set();
+  }
+}
+
+
+HRESULT CItemDecoderMt::Create(UInt32 numThreads, size_t maxInFlightSize)
+{
+  _maxInFlightSize = maxInFlightSize;
+  // small items are decoded quickly, so we keep more jobs in flight than in 7z folder decoder
+  _maxInFlightJobs = numThreads * 4;
+  RINOK_WRes(_canStart.Create(0, (UInt32)Jobs.Size() + numThreads))
+  RINOK_WRes(_jobFinished.CreateIfNotCreated_Reset())
+  for (UInt32 i = 0; i < numThreads; i++)
+  {
+    CThreadInfo &t = _threads.AddNew();
+    t.Parent = this;
+    RINOK_WRes(t.Thread.Create(ThreadFunc, &t))
+  }
+  return S_OK;
+}
+
+
+void CItemDecoderMt::StopThreads()
+{
+  Exit = true;
+  if (_threads.IsEmpty())
+    return;
+  _canStart.Release(_threads.Size());
+  FOR_VECTOR (i, _threads)
+  {
+    CThreadInfo &t = _threads[i];
+    if (t.Thread.IsCreated())
+      t.Thread.Wait_Close();
+  }
+  _threads.Clear();
+}
+
+
+void CItemDecoderMt::SubmitJobs(const CObjectVector<CItemEx> &items)
+{
+  while (_numSubmitted < Jobs.Size())
+  {
+    CMtItemJob &job = Jobs[_numSubmitted];
+    if (_numSubmitted != _numReleased)
+      if (_numSubmitted - _numReleased >= _maxInFlightJobs
+          || _inFlightSize + job.UnpackSize > _maxInFlightSize)
+        break;
+    
+    // main thread reads local header here, because CInArchive is not thread-safe
+    job.Item = items[job.ItemIndex];
+    bool isAvail = true;
+    job.MtMode = (Archive->Read_LocalItem_After_CdItem(job.Item, isAvail, job.HeadersError) == S_OK
+        && !job.Item.IsEncrypted());
+    if (job.MtMode)
+      job.PackPos = (UInt64)((Int64)(job.Item.LocalHeaderPos + job.Item.LocalFullHeaderSize) + Archive->ArcInfo.Base);
+    
+    _inFlightSize += job.UnpackSize;
+    _numSubmitted++;
+    _canStart.Release();
+  }
+}
+
+
+HRESULT CItemDecoderMt::WaitJob(unsigned index)
+{
+  for (;;)
+  {
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      if (Jobs[index].Finished)
+        return S_OK;
+    }
+    RINOK_WRes(_jobFinished.Lock())
+  }
+}
+
+
+void CItemDecoderMt::ReleaseJob(unsigned index)
+{
+  CMtItemJob &job = Jobs[index];
+  job.Buf.Free();
+  _inFlightSize -= job.UnpackSize;
+  _numReleased++;
+}
+
+
+// it returns the job to CItemDecoderMt at the end of item processing in main thread
+class CMtJobReleaser
+{
+  CItemDecoderMt *_decoder;
+  unsigned _index;
+public:
+  CMtJobReleaser(): _decoder(NULL), _index(0) {}
+  ~CMtJobReleaser()
+  {
+    if (_decoder)
+    {
+      // worker thread can still use the job buffer, if main thread didn't wait for it
+      _decoder->WaitJob(_index);
+      _decoder->ReleaseJob(_index);
+    }
+  }
+  void Set(CItemDecoderMt *decoder, unsigned index)
+  {
+    _decoder = decoder;
+    _index = index;
+  }
+};
+
+
+// it restores original archive stream after multithreaded extraction
+class CArcBaseStreamRestorer
+{
+  CInArchive &_archive;
+  CMyComPtr<IInStream> _stream;
+public:
+  CArcBaseStreamRestorer(CInArchive &archive): _archive(archive) {}
+  ~CArcBaseStreamRestorer()
+  {
+    if (_stream)
+      _archive.SetBaseStream(_stream);
+  }
+  void Set(IInStream *newStream)
+  {
+    _stream = _archive.GetBaseStream();
+    _archive.SetBaseStream(newStream);
+  }
+};
+
+#endif
+
+
 Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     Int32 testMode, IArchiveExtractCallback *extractCallback))
 {
@@ -1578,11 +1891,87 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
   RINOK(extractCallback->SetTotal(total))
 
   CZipDecoder myDecoder;
+ #ifndef Z7_ST
+  myDecoder.NumThreads_WasForced = _props._numThreads_WasForced;
+ #endif
   UInt64 cur_Unpacked, cur_Packed;
   
   CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
   lps->Init(extractCallback, false);
 
+ #ifndef Z7_ST
+
+  // (mtJobIndexes[i] >= 0) : item (i) is submitted to CItemDecoderMt
+  CIntVector mtJobIndexes;
+  CMyUniquePtr<CItemDecoderMt> mtDecoder;
+  CArcBaseStreamRestorer arcStreamRestorer(m_Archive);
+
+  if (_useMtItems && _props._numThreads > 1 && !m_Archive.IsMultiVol)
+  {
+    size_t maxInFlightSize = (size_t)1 << (sizeof(size_t) >= 8 ? 30 : 27);
+    if (maxInFlightSize > _props._memUsage_Decompress / 4)
+      maxInFlightSize = (size_t)(_props._memUsage_Decompress / 4);
+    UInt64 maxItemSize = kMtItem_MaxUnpackSize;
+    if (maxItemSize > maxInFlightSize / 2)
+      maxItemSize = maxInFlightSize / 2;
+
+    unsigned numMtJobs = 0;
+    mtJobIndexes.ClearAndReserve(numItems);
+    for (i = 0; i < numItems; i++)
+    {
+      const CItemEx &item = m_Items[allFilesMode ? i : indices[i]];
+      int mtIndex = -1;
+      if (!item.IsDir()
+          && !item.IsEncrypted()
+          && item.Size != 0
+          && item.Size <= maxItemSize
+          && m_Archive.IsLocalOffsetOK(item))
+        mtIndex = (int)numMtJobs++;
+      mtJobIndexes.AddInReserved(mtIndex);
+    }
+
+    if (numMtJobs >= 2)
+    {
+      mtDecoder.Create_if_Empty();
+      CItemDecoderMt &mt = *mtDecoder;
+      #ifdef Z7_EXTERNAL_CODECS
+      mt._externalCodecs = EXTERNAL_CODECS_VARS2;
+      #endif
+      mt.Archive = &m_Archive;
+      mt.InStream.Init(m_Archive.GetBaseStream());
+      mt.MemUsage = _props._memUsage_Decompress;
+      for (i = 0; i < numItems; i++)
+      {
+        if (mtJobIndexes[i] < 0)
+          continue;
+        CMtItemJob &mj = mt.Jobs.AddNew();
+        mj.ItemIndex = allFilesMode ? i : indices[i];
+        mj.UnpackSize = (size_t)m_Items[mj.ItemIndex].Size;
+        mj.PackPos = 0;
+        mj.HeadersError = false;
+        mj.MtMode = false;
+        mj.OutSize = 0;
+        mj.Result = S_OK;
+        mj.OpRes = NExtract::NOperationResult::kDataError;
+        mj.Finished = false;
+      }
+      UInt32 numThreads = _props._numThreads;
+      if (numThreads > numMtJobs)
+        numThreads = numMtJobs;
+      
+      // main thread and worker threads read the same archive stream
+      CMyComPtr2_Create<IInStream, CLockedInStreamReader> mtInStream;
+      mtInStream->Base = &mt.InStream;
+      arcStreamRestorer.Set(mtInStream);
+
+      RINOK(mt.Create(numThreads, maxInFlightSize))
+    }
+    else
+      mtJobIndexes.Clear();
+  }
+  
+ #endif
+
   for (i = 0;; i++,
       lps->OutSize += cur_Unpacked,
       lps->InSize += cur_Packed)
@@ -1592,6 +1981,24 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
       return S_OK;
     const UInt32 index = allFilesMode ? i : indices[i];
     CItemEx item = m_Items[index];
+
+   #ifndef Z7_ST
+    // (mtJob != NULL) : local header was read and item was submitted to worker thread
+    CMtItemJob *mtJob = NULL;
+    CMtJobReleaser mtJobReleaser;
+    if (!mtJobIndexes.IsEmpty())
+    {
+      mtDecoder->SubmitJobs(m_Items);
+      const int mtIndex = mtJobIndexes[i];
+      if (mtIndex >= 0)
+      {
+        mtJobReleaser.Set(mtDecoder.get(), (unsigned)mtIndex);
+        CMtItemJob &mj = mtDecoder->Jobs[(unsigned)mtIndex];
+        if (mj.MtMode)
+          mtJob = &mj;
+      }
+    }
+   #endif
     cur_Unpacked = item.Size;
     cur_Packed = item.PackSize;
 
@@ -1617,6 +2024,14 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     bool headersError = false;
     
+   #ifndef Z7_ST
+    if (mtJob)
+    {
+      item = mtJob->Item;
+      headersError = mtJob->HeadersError;
+    }
+    else
+   #endif
     if (!item.FromLocal)
     {
       bool isAvail = true;
@@ -1653,9 +2068,27 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
 
     RINOK(extractCallback->PrepareOperation(askMode))
 
+   #ifndef Z7_ST
+    if (mtJob)
+    {
+      RINOK(mtDecoder->WaitJob((unsigned)mtJobIndexes[i]))
+      if (mtJob->Result == S_OK)
+      {
+        opRes = mtJob->OpRes;
+        if (realOutStream && mtJob->OutSize != 0)
+        {
+          RINOK(WriteStream(realOutStream, mtJob->Buf, mtJob->OutSize))
+        }
+      }
+    }
+    // if worker thread has failed (for example, the item is larger than its header says),
+    // we decode the item again in main thread
+    if (!mtJob || mtJob->Result != S_OK)
+   #endif
+    {
     const HRESULT hres = myDecoder.Decode(
         EXTERNAL_CODECS_VARS
-        m_Archive, item, realOutStream, extractCallback,
+        m_Archive, item, NULL, realOutStream, extractCallback,
         lps,
         #ifndef Z7_ST
         _props._numThreads, _props._memUsage_Decompress,
@@ -1663,6 +2096,7 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
         opRes);
     
     RINOK(hres)
+    }
     // realOutStream.Release();
     
     if (opRes == NExtract::NOperationResult::kOK && headersError)
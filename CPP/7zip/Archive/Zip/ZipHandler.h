@@ -61,6 +61,9 @@ private:
   bool _force_SeqOutMode; // for creation
   bool _force_OpenSeq;
   bool _forceCodePage;
+ #ifndef Z7_ST
+  bool _useMtItems; // multithreaded extraction of independent items
+ #endif
   UInt32 _specifiedCodePage;
 
   DECL_EXTERNAL_CODECS_VARS
@@ -78,6 +81,9 @@ private:
     _force_SeqOutMode = false;
     _force_OpenSeq = false;
     _forceCodePage = false;
+   #ifndef Z7_ST
+    _useMtItems = true;
+   #endif
     _specifiedCodePage = CP_OEMCP;
   }
 
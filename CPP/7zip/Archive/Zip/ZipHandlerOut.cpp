@@ -580,6 +580,12 @@ Z7_COM7F_IMF(CHandler::SetProperties(const wchar_t * const *names, const PROPVAR
     {
       RINOK(PROPVARIANT_to_bool(prop, _force_OpenSeq))
     }
+    else if (name.IsEqualTo("mtb"))
+    {
+     #ifndef Z7_ST
+      RINOK(PROPVARIANT_to_bool(prop, _useMtItems))
+     #endif
+    }
     else
     {
       if (name.IsEqualTo_Ascii_NoCase("m") && prop.vt == VT_UI4)
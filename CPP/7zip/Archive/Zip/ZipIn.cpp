@@ -257,6 +257,38 @@ HRESULT CInArchive::SeekToVol(int volIndex, UInt64 offset)
 }
 
 
+/* if the archive stream is memory mapped, Set_MemCache() sets
+   the region [offset, offset + size) of stream as cached data without copying.
+   The caller must call it only after SeekToVol(-1, offset) */
+
+HRESULT CInArchive::Set_MemCache(UInt64 offset, UInt64 size)
+{
+  if (IsMultiVol || GetVirtStreamPos() != offset || size > (UInt32)0xFFFFFFFF)
+    return S_OK;
+  CMyComPtr<IStreamGetRangePtr> getRangePtr;
+  Stream->QueryInterface(IID_IStreamGetRangePtr, (void **)&getRangePtr);
+  if (!getRangePtr)
+    return S_OK;
+  const Byte *data;
+  UInt32 avail;
+  if (getRangePtr->GetRangePtr(offset, (UInt32)size, &data, &avail) != S_OK
+      || avail != size)
+    return S_OK;
+  {
+    CMyComPtr<IStreamSetAccessHint> accessHint;
+    Stream->QueryInterface(IID_IStreamSetAccessHint, (void **)&accessHint);
+    if (accessHint && size != 0)
+      accessHint->SetAccessHint(offset, size, NStreamAccessHint::kWillNeed);
+  }
+  // the physical position of stream must be at the end of cached data
+  InitBuf();
+  RINOK(Seek_SavePos(offset + size))
+  _memData = data;
+  _bufCached = (size_t)size;
+  return S_OK;
+}
+
+
 HRESULT CInArchive::AllocateBuffer(size_t size)
 {
   if (size <= Buffer.Size())
@@ -295,7 +327,7 @@ HRESULT CInArchive::ReadFromCache(Byte *data, unsigned size, unsigned &processed
       unsigned cur = size;
       if (cur > avail)
         cur = (unsigned)avail;
-      memcpy(data, (const Byte *)Buffer + _bufPos, cur);
+      memcpy(data, GetBufData() + _bufPos, cur);
 
       data += cur;
       size -= cur;
@@ -715,7 +747,7 @@ HRESULT CInArchive::FindMarker(const UInt64 *searchLimit)
     if (limitPos == 0)
       break;
 
-    const Byte * const pStart = Buffer + _bufPos;
+    const Byte * const pStart = GetBufData() + _bufPos;
     const Byte * p = pStart;
     const Byte * const limit = pStart + limitPos;
    
@@ -795,8 +827,7 @@ HRESULT CInArchive::IncreaseRealPosition(UInt64 offset, bool &isFinished)
     _cnt += avail;
     offset -= avail;
     
-    _bufCached = 0;
-    _bufPos = 0;
+    InitBuf();
     
     if (!_inBufMode)
       break;
@@ -893,10 +924,12 @@ HRESULT CInArchive::LookAhead(size_t minRequired)
     if (minRequired <= avail)
       return S_OK;
     
-    if (_bufPos != 0)
+    if (_bufPos != 0 || _memData)
     {
+      // (avail < minRequired <= Buffer.Size()), so data from _memData fits to Buffer
       if (avail != 0)
-        memmove(Buffer, Buffer + _bufPos, avail);
+        memmove(Buffer, GetBufData() + _bufPos, avail);
+      _memData = NULL;
       _bufPos = 0;
       _bufCached = avail;
     }
@@ -1500,7 +1533,7 @@ HRESULT CInArchive::FindDescriptor(CItemEx &item, unsigned numFiles)
       return S_OK;
     }
 
-    const Byte * const pStart = Buffer + _bufPos;
+    const Byte * const pStart = GetBufData() + _bufPos;
     const Byte * p = pStart;
     const Byte * const limit = pStart + (avail - descriptorSize4);
     
@@ -1889,6 +1922,8 @@ HRESULT CInArchive::TryReadCd(CObjectVector<CItemEx> &items, const CCdInfo &cdIn
   _inBufMode = true;
   _cnt = 0;
 
+  RINOK(Set_MemCache(cdOffset, cdSize))
+
   if (Callback)
   {
     RINOK(Callback->SetTotal(&cdInfo.NumEntries, IsMultiVol ? &Vols.TotalBytesSize : NULL))
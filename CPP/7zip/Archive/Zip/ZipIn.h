@@ -248,6 +248,9 @@ class CInArchive
   CMidBuffer Buffer;
   size_t _bufPos;
   size_t _bufCached;
+  /* if (_memData) is not NULL, the cached data is not in (Buffer),
+     but directly in memory mapped archive stream (IStreamGetRangePtr) */
+  const Byte *_memData;
 
   UInt64 _streamPos;
   UInt64 _cnt;
@@ -257,7 +260,8 @@ class CInArchive
 
   size_t GetAvail() const { return _bufCached - _bufPos; }
 
-  void InitBuf() { _bufPos = 0; _bufCached = 0; }
+  void InitBuf() { _bufPos = 0; _bufCached = 0; _memData = NULL; }
+  const Byte *GetBufData() const { return _memData ? _memData : (const Byte *)Buffer; }
   void DisableBufMode() { InitBuf(); _inBufMode = false; }
 
   void SkipLookahed(size_t skip)
@@ -267,6 +271,7 @@ class CInArchive
   }
 
   HRESULT AllocateBuffer(size_t size);
+  HRESULT Set_MemCache(UInt64 offset, UInt64 size);
 
   UInt64 GetVirtStreamPos() { return _streamPos - _bufCached + _bufPos; }
 
@@ -358,6 +363,7 @@ public:
   bool Disable_FindMarker;
  
   CInArchive():
+      _memData(NULL),
       IsArcOpen(false),
       Stream(NULL),
       StartStream(NULL),
@@ -425,6 +431,15 @@ public:
 
   IInStream *GetBaseStream() { return StreamRef; }
 
+  /* SetBaseStream() replaces the stream of single-volume archive
+     by another stream object that reads the same data.
+     Multithreaded extraction uses it to share the stream with worker threads. */
+  void SetBaseStream(IInStream *stream)
+  {
+    StreamRef = stream;
+    Stream = stream;
+  }
+
   bool CanUpdate() const
   {
     if (AreThereErrors()
@@ -203,7 +203,7 @@ struct CThreadInfo
 {
   DECL_EXTERNAL_CODECS_LOC_VARS_DECL
 
-  NWindows::CThread Thread;
+  NWindows::CPoolThread Thread;
   NWindows::NSynchronization::CAutoResetEvent CompressEvent;
   CMtSem *MtSem;
   unsigned ThreadIndex;
@@ -1148,6 +1148,16 @@ static HRESULT Update2(
       }
       numThreads /= (unsigned)numXzThreads;
     }
+    else if (method == NFileHeader::NCompressionMethod::kZstdWz)
+    {
+      // native zstd encoder can use 2 threads only for multithreaded match finder.
+      // we prefer the threads for zip items, if the number of threads is not forced.
+      const int numZstdThreads = oneMethodMain->Get_NumThreads();
+      if (numZstdThreads < 0)
+        oneMethodMain->AddProp_NumThreads(1);
+      else if (numZstdThreads > 1)
+        numThreads /= 2;
+    }
     /*
     else if (method == NFileHeader::NCompressionMethod::kZstdWz)
     {
@@ -1180,14 +1190,14 @@ static HRESULT Update2(
     else if (method == NFileHeader::NCompressionMethod::kLZMA)
     {
       // we suppose that default LZMA is 2 thread. So we don't change it
-      const UInt32 numLZMAThreads = oneMethodMain->Get_Lzma_NumThreads();
+      const UInt32 numLZMAThreads = oneMethodMain->Get_Lzma_NumThreads(false);
       numThreads /= numLZMAThreads;
 
       if (numThreads > 1
           && options._memUsage_WasSet
           && !options._numThreads_WasForced)
       {
-        const UInt64 methodMemUsage = oneMethodMain->Get_Lzma_MemUsage(true);
+        const UInt64 methodMemUsage = oneMethodMain->Get_Lzma_MemUsage(true, false);
         const UInt64 threadMemUsage = kMemPerThread + methodMemUsage;
         const UInt64 numThreads64 = options._memUsage_Compress / threadMemUsage;
         if (numThreads64 < numThreads)
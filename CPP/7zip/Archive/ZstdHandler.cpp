@@ -3,7 +3,9 @@
 #include "StdAfx.h"
 
 // #define Z7_USE_ZSTD_ORIG_DECODER
-// #define Z7_USE_ZSTD_COMPRESSION
+#ifndef Z7_EXTRACT_ONLY
+#define Z7_USE_ZSTD_COMPRESSION
+#endif
 
 #include "../../Common/ComTry.h"
 
@@ -20,7 +22,6 @@
 
 #ifdef Z7_USE_ZSTD_COMPRESSION
 #include "../Compress/ZstdEncoder.h"
-#include "../Compress/ZstdEncoderProps.h"
 #include "Common/HandlerOut.h"
 #endif
 
@@ -814,6 +815,10 @@ Z7_COM7F_IMF(CHandler::Extract(const UInt32 *indices, UInt32 numItems,
     decoder->FinishMode = true;
 #ifndef Z7_USE_ZSTD_ORIG_DECODER
     decoder->DisableHash = _disableHash;
+#if !defined(Z7_ST) && defined(Z7_USE_ZSTD_COMPRESSION)
+    decoder->_numThreads = _props._numThreads;
+    decoder->_memUsage = _props._memUsage_Decompress;
+#endif
 #endif
     
     // _dataAfterEnd = false;
@@ -1038,36 +1043,11 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
       RINOK(updateCallback->SetTotal(size))
 
       CMethodProps props2 = _props;
-
 #ifndef Z7_ST
-      /*
-      CSingleMethodProps (_props)
-      derives from
-      CMethodProps (props2)
-      So we transfer additional variable (num Threads) to CMethodProps list of properties
-      */
-
-      UInt32 numThreads = _props._numThreads;
-
-      if (numThreads > Z7_ZSTDMT_NBWORKERS_MAX)
-          numThreads = Z7_ZSTDMT_NBWORKERS_MAX;
-
-      if (_props.FindProp(NCoderPropID::kNumThreads) < 0)
-      {
-        if (!_props._numThreads_WasForced
-            && numThreads >= 1
-            && _props._memUsage_WasSet)
-        {
-          NCompress::NZstd::CEncoderProps zstdProps;
-          RINOK(zstdProps.SetFromMethodProps(_props))
-          ZstdEncProps_NormalizeFull(&zstdProps.EncProps);
-          numThreads = ZstdEncProps_GetNumThreads_for_MemUsageLimit(
-              &zstdProps.EncProps, _props._memUsage_Compress, numThreads);
-        }
-        props2.AddProp_NumThreads(numThreads);
-      }
-
-#endif // Z7_ST
+      props2.AddProp_NumThreads(_props._numThreads);
+#endif
+      if (_disableHash)
+        props2.AddProp32(NCoderPropID::kCheckSize, 0);
 
       CMyComPtr2_Create<ICompressProgressInfo, CLocalProgress> lps;
       lps->Init(updateCallback, true);
@@ -1077,18 +1057,11 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
         RINOK(props2.SetCoderProps(encoder.ClsPtr(), size != (UInt64)(Int64)-1 ? &size : NULL))
         // encoderSpec->_props.SmallFileOpt = _smallMode;
         // we must set kExpectedDataSize just before Code().
-        encoder->SrcSizeHint64 = size;
-        /*
-        CMyComPtr<ICompressSetCoderPropertiesOpt> optProps;
-        _compressEncoder->QueryInterface(IID_ICompressSetCoderPropertiesOpt, (void**)&optProps);
-        if (optProps)
         {
-          PROPID propID = NCoderPropID::kExpectedDataSize;
+          const PROPID propID = NCoderPropID::kExpectedDataSize;
           NWindows::NCOM::CPropVariant prop = (UInt64)size;
-          // RINOK(optProps->SetCoderPropertiesOpt(&propID, &prop, 1))
-          RINOK(encoderSpec->SetCoderPropertiesOpt(&propID, &prop, 1))
+          RINOK(encoder->SetCoderPropertiesOpt(&propID, &prop, 1))
         }
-        */
         RINOK(encoder.Interface()->Code(fileInStream, outStream, NULL, NULL, lps))
       }
     }
@@ -1128,20 +1101,11 @@ Z7_COM7F_IMF(CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
 #define CreateArcOut NULL
 #endif
 
-#ifdef Z7_USE_ZSTD_COMPRESSION
-REGISTER_ARC_IO(
-  "zstd2", "zst tzst", "* .tar", 0xe + 1,
-  k_Signature, 0
-  , NArcInfoFlags::kKeepName
-  , 0
-  , NULL)
-#else
 REGISTER_ARC_IO(
   "zstd", "zst tzst", "* .tar", 0xe,
   k_Signature, 0
   , NArcInfoFlags::kKeepName
   , 0
   , NULL)
-#endif
 
 }}
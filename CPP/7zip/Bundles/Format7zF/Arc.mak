@@ -80,6 +80,7 @@ AR_OBJS = \
   $O\HfsHandler.obj \
   $O\IhexHandler.obj \
   $O\LpHandler.obj \
+  $O\Lz4Handler.obj \
   $O\LzhHandler.obj \
   $O\LzipHandler.obj \
   $O\LzmaHandler.obj \
@@ -211,6 +212,9 @@ COMPRESS_OBJS = \
   $O\DeflateRegister.obj \
   $O\DeltaFilter.obj \
   $O\ImplodeDecoder.obj \
+  $O\Lz4Decoder.obj \
+  $O\Lz4Encoder.obj \
+  $O\Lz4Register.obj \
   $O\LzfseDecoder.obj \
   $O\LzhDecoder.obj \
   $O\Lzma2Decoder.obj \
@@ -225,6 +229,9 @@ COMPRESS_OBJS = \
   $O\PpmdDecoder.obj \
   $O\PpmdEncoder.obj \
   $O\PpmdRegister.obj \
+  $O\PpmdMtDecoder.obj \
+  $O\PpmdMtEncoder.obj \
+  $O\PpmdMtRegister.obj \
   $O\PpmdZip.obj \
   $O\QuantumDecoder.obj \
   $O\Rar1Decoder.obj \
@@ -241,6 +248,8 @@ COMPRESS_OBJS = \
   $O\ZlibEncoder.obj \
   $O\ZDecoder.obj \
   $O\ZstdDecoder.obj \
+  $O\ZstdEncoder.obj \
+  $O\ZstdRegister.obj \
 
 CRYPTO_OBJS = \
   $O\7zAes.obj \
@@ -274,6 +283,8 @@ C_OBJS = \
   $O\HuffEnc.obj \
   $O\LzFind.obj \
   $O\LzFindMt.obj \
+  $O\Lz4Dec.obj \
+  $O\Lz4Enc.obj \
   $O\Lzma2Dec.obj \
   $O\Lzma2DecMt.obj \
   $O\Lzma2Enc.obj \
@@ -300,6 +311,8 @@ C_OBJS = \
   $O\XzEnc.obj \
   $O\XzIn.obj \
   $O\ZstdDec.obj \
+  $O\ZstdDecMt.obj \
+  $O\ZstdEnc.obj \
 
 !include "../../Aes.mak"
 !include "../../Crc.mak"
@@ -257,6 +257,9 @@ COMPRESS_OBJS = \
   $O/DeflateRegister.o \
   $O/DeltaFilter.o \
   $O/ImplodeDecoder.o \
+  $O/Lz4Decoder.o \
+  $O/Lz4Encoder.o \
+  $O/Lz4Register.o \
   $O/LzfseDecoder.o \
   $O/LzhDecoder.o \
   $O/Lzma2Decoder.o \
@@ -271,6 +274,9 @@ COMPRESS_OBJS = \
   $O/PpmdDecoder.o \
   $O/PpmdEncoder.o \
   $O/PpmdRegister.o \
+  $O/PpmdMtDecoder.o \
+  $O/PpmdMtEncoder.o \
+  $O/PpmdMtRegister.o \
   $O/PpmdZip.o \
   $O/QuantumDecoder.o \
   $O/ShrinkDecoder.o \
@@ -281,6 +287,8 @@ COMPRESS_OBJS = \
   $O/ZlibEncoder.o \
   $O/ZDecoder.o \
   $O/ZstdDecoder.o \
+  $O/ZstdEncoder.o \
+  $O/ZstdRegister.o \
 
 ifdef DISABLE_RAR
 DISABLE_RAR_COMPRESS=1
@@ -339,6 +347,7 @@ C_OBJS = \
   $O/HuffEnc.o \
   $O/LzFind.o \
   $O/Lz4Dec.o \
+  $O/Lz4Enc.o \
   $O/Lzma2Dec.o \
   $O/Lzma2DecMt.o \
   $O/Lzma2Enc.o \
@@ -371,6 +380,8 @@ C_OBJS = \
   $O/XzCrc64.o \
   $O/XzCrc64Opt.o \
   $O/ZstdDec.o \
+  $O/ZstdDecMt.o \
+  $O/ZstdEnc.o \
 
 ARC_OBJS = \
   $(LZMA_DEC_OPT_OBJS) \
@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <grp.h>
 #include <pwd.h>
+#include <sys/mman.h>
 
 /*
 inclusion of <sys/sysmacros.h> by <sys/types.h> is deprecated since glibc 2.25.
@@ -34,6 +35,8 @@ you should undefine it after including <sys/types.h>
 
 #endif // _WIN32
 
+#include "../../../C/CpuArch.h"
+
 #include "../../Windows/FileFind.h"
 
 #ifdef Z7_DEVICE_FILE
@@ -72,6 +75,17 @@ CInFileStream::CInFileStream():
   Buf(NULL),
   BufSize(0),
  #endif
+ #ifdef Z7_FILE_STREAMS_USE_MMAP
+  _map(NULL),
+  _mapSize(0),
+  _mapPos(0),
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  _sparse(false),
+  _sparse_HolePos(0),
+  _sparse_DataPos(0),
+  _sparse_DataEnd(0),
+ #endif
  #ifndef _WIN32
   _uid(0),
   _gid(0),
@@ -91,6 +105,10 @@ CInFileStream::~CInFileStream()
   MidFree(Buf);
   #endif
 
+  #ifdef Z7_FILE_STREAMS_USE_MMAP
+  Unmap();
+  #endif
+
   if (Callback)
     Callback->InFileStream_On_Destroy(this, CallbackRef);
 }
@@ -208,6 +226,30 @@ Z7_COM7F_IMF(CInFileStream::Read(void *data, UInt32 size, UInt32 *processedSize)
   
   if (processedSize)
     *processedSize = 0;
+
+  #ifdef Z7_FILE_STREAMS_USE_MMAP
+  if (_map)
+  {
+    if (_mapPos >= _mapSize)
+      return S_OK;
+    {
+      const size_t rem = _mapSize - (size_t)_mapPos;
+      if (size > rem)
+        size = (UInt32)rem;
+    }
+    memcpy(data, _map + (size_t)_mapPos, size);
+    _mapPos += size;
+    if (processedSize)
+      *processedSize = size;
+    return S_OK;
+  }
+  #endif
+
+  #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse)
+    return Read_Sparse(data, size, processedSize);
+  #endif
+
   const ssize_t res = File.read_part(data, (size_t)size);
   if (res != -1)
   {
@@ -399,6 +441,25 @@ Z7_COM7F_IMF(CInFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPos
   return hres;
   
   #else
+
+  #ifdef Z7_FILE_STREAMS_USE_MMAP
+  if (_map)
+  {
+    switch (seekOrigin)
+    {
+      case STREAM_SEEK_SET: break;
+      case STREAM_SEEK_CUR: offset += (Int64)_mapPos; break;
+      case STREAM_SEEK_END: offset += (Int64)_mapSize; break;
+      default: return STG_E_INVALIDFUNCTION;
+    }
+    if (offset < 0)
+      return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+    _mapPos = (UInt64)offset;
+    if (newPosition)
+      *newPosition = (UInt64)offset;
+    return S_OK;
+  }
+  #endif
   
   const off_t res = File.seek((off_t)offset, (int)seekOrigin);
   if (res == -1)
@@ -415,6 +476,205 @@ Z7_COM7F_IMF(CInFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPos
   #endif
 }
 
+
+#ifdef Z7_FILE_STREAMS_USE_MMAP
+
+// we don't map big files in 32-bit systems, because address space is limited
+static const UInt64 k_MapSize_Max = (sizeof(size_t) > 4) ?
+    ((UInt64)1 << 42) : ((UInt64)1 << 29);
+
+bool CInFileStream::Map()
+{
+  if (_map)
+    return true;
+  struct stat st;
+  if (File.my_fstat(&st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+  if (st.st_size <= 0 || (UInt64)st.st_size > k_MapSize_Max)
+    return false;
+  const off_t pos = File.seekToCur();
+  if (pos == -1)
+    return false;
+  const size_t size = (size_t)st.st_size;
+  void *p = ::mmap(NULL, size, PROT_READ, MAP_SHARED, File.GetHandle(), 0);
+  if (p == MAP_FAILED)
+    return false;
+  _map = (const Byte *)p;
+  _mapSize = size;
+  _mapPos = (UInt64)pos;
+  return true;
+}
+
+void CInFileStream::Unmap() throw()
+{
+  if (_map)
+  {
+    ::munmap((void *)_map, _mapSize);
+    _map = NULL;
+    _mapSize = 0;
+    _mapPos = 0;
+  }
+}
+
+Z7_COM7F_IMF(CInFileStream::GetRangePtr(UInt64 offset, UInt32 size, const Byte **data, UInt32 *availSize))
+{
+  *data = NULL;
+  *availSize = 0;
+  if (!_map)
+    return S_FALSE;
+  if (offset > _mapSize)
+    offset = _mapSize;
+  {
+    const size_t rem = _mapSize - (size_t)offset;
+    if (size > rem)
+      size = (UInt32)rem;
+  }
+  *data = _map + (size_t)offset;
+  *availSize = size;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CInFileStream::SetAccessHint(UInt64 offset, UInt64 size, UInt32 hint))
+{
+  if (_map)
+  {
+    if (offset >= _mapSize)
+      return S_OK;
+    if (size == 0 || size > _mapSize - offset)
+      size = _mapSize - offset;
+    // madvise() requires page aligned address
+    const size_t pageMask = (size_t)::sysconf(_SC_PAGESIZE) - 1;
+    const size_t start = (size_t)offset & ~pageMask;
+    size += (size_t)offset - start;
+    int advice;
+    switch (hint)
+    {
+      case NStreamAccessHint::kSequential: advice = MADV_SEQUENTIAL; break;
+      case NStreamAccessHint::kRandom:     advice = MADV_RANDOM; break;
+      case NStreamAccessHint::kWillNeed:   advice = MADV_WILLNEED; break;
+      case NStreamAccessHint::kDontNeed:   advice = MADV_DONTNEED; break;
+      default:                             advice = MADV_NORMAL; break;
+    }
+    ::madvise((void *)(_map + start), (size_t)size, advice);
+    return S_OK;
+  }
+ #ifdef POSIX_FADV_NORMAL
+  int advice;
+  switch (hint)
+  {
+    case NStreamAccessHint::kSequential: advice = POSIX_FADV_SEQUENTIAL; break;
+    case NStreamAccessHint::kRandom:     advice = POSIX_FADV_RANDOM; break;
+    case NStreamAccessHint::kWillNeed:   advice = POSIX_FADV_WILLNEED; break;
+    case NStreamAccessHint::kDontNeed:   advice = POSIX_FADV_DONTNEED; break;
+    default:                             advice = POSIX_FADV_NORMAL; break;
+  }
+  ::posix_fadvise(File.GetHandle(), (off_t)offset, (off_t)size, advice);
+ #endif
+  return S_OK;
+}
+
+#else
+
+bool CInFileStream::Map()
+{
+  return false;
+}
+
+#endif
+
+
+#ifdef Z7_FILE_STREAMS_USE_SPARSE
+
+bool CInFileStream::Set_Sparse()
+{
+  _sparse = false;
+  struct stat st;
+  if (File.my_fstat(&st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+    return false;
+  // st_blocks is the number of allocated 512-byte blocks
+  if ((UInt64)st.st_blocks * 512 >= (UInt64)st.st_size)
+    return false;
+  UInt64 dataPos, dataEnd;
+  if (!File.FindDataRange(0, dataPos, dataEnd))
+    return false;
+  _sparse_HolePos = 0;
+  _sparse_DataPos = dataPos;
+  _sparse_DataEnd = dataEnd;
+  _sparse = true;
+  return true;
+}
+
+HRESULT CInFileStream::Read_Sparse(void *data, UInt32 size, UInt32 *processedSize)
+{
+  const off_t pos2 = File.seekToCur();
+  if (pos2 == -1)
+    return GetLastError_HRESULT();
+  const UInt64 pos = (UInt64)pos2;
+  if (pos < _sparse_HolePos || pos >= _sparse_DataEnd)
+  {
+    UInt64 dataPos, dataEnd;
+    if (!File.FindDataRange(pos, dataPos, dataEnd))
+    {
+      // we switch to normal reading, if hole detection doesn't work anymore
+      _sparse = false;
+      return Read(data, size, processedSize);
+    }
+    _sparse_HolePos = pos;
+    _sparse_DataPos = dataPos;
+    _sparse_DataEnd = dataEnd;
+  }
+  if (pos < _sparse_DataPos)
+  {
+    // the hole: we don't read zeros from file
+    const UInt64 rem = _sparse_DataPos - pos;
+    if (size > rem)
+      size = (UInt32)rem;
+    if (File.seek((off_t)(pos + size), SEEK_SET) == -1)
+      return GetLastError_HRESULT();
+    memset(data, 0, size);
+    if (processedSize)
+      *processedSize = size;
+    return S_OK;
+  }
+  if (pos < _sparse_DataEnd)
+  {
+    const UInt64 rem = _sparse_DataEnd - pos;
+    if (size > rem)
+      size = (UInt32)rem;
+  }
+  const ssize_t res = File.read_part(data, (size_t)size);
+  if (res == -1)
+    return GetLastError_HRESULT();
+  if (processedSize)
+    *processedSize = (UInt32)res;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CInFileStream::GetDataRange(UInt64 pos, UInt64 *dataPos, UInt64 *dataEnd))
+{
+  *dataPos = pos;
+  *dataEnd = pos;
+  if (!_sparse)
+    return S_FALSE;
+  if (!File.FindDataRange(pos, *dataPos, *dataEnd))
+  {
+    *dataPos = pos;
+    *dataEnd = pos;
+    return S_FALSE;
+  }
+  return S_OK;
+}
+
+#else
+
+bool CInFileStream::Set_Sparse()
+{
+  return false;
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CInFileStream::GetSize(UInt64 *size))
 {
   return ConvertBoolToHRESULT(File.GetLength(*size));
@@ -794,13 +1054,224 @@ Z7_COM7F_IMF(CInFileStream::ReloadProps())
 //////////////////////////
 // COutFileStream
 
+#ifdef Z7_FILE_ASYNC_IO
+
+COutFileStream::~COutFileStream()
+{
+  Close();
+}
+
+void COutFileStream::Set_Async(NWindows::NFile::NIO::CAsyncOutFiles *async, const FString &path)
+{
+  const off_t pos = File.seekToCur();
+  if (pos == -1)
+    return;
+  _asyncPos = (UInt64)pos;
+  _async = async;
+  _asyncFile = async->Open(File, path);
+}
+
+#endif
+
+
+#ifdef Z7_FILE_STREAMS_USE_SPARSE
+
+// only aligned full blocks of zeros are skipped. It's typical block size of file systems
+static const UInt32 kSparseBlockSize = (UInt32)1 << 12;
+
+static bool IsZeroBlock(const Byte *p, size_t size)
+{
+  // (size) is multiple of 32. The loop without branches in each step can be vectorized by compiler
+  for (size_t i = 0; i < size; i += 32)
+  {
+    const UInt64 v =
+          GetUi64(p + i)
+        | GetUi64(p + i + 8)
+        | GetUi64(p + i + 16)
+        | GetUi64(p + i + 24);
+    if (v != 0)
+      return false;
+  }
+  return true;
+}
+
+bool COutFileStream::Set_Sparse()
+{
+  const off_t pos = File.seekToCur();
+  UInt64 size;
+  if (pos == -1 || !File.GetLength(size))
+    return false;
+  _sparsePos = (UInt64)pos;
+  _sparseAllocEnd = size;
+  _sparseEnd = size;
+  _sparse = true;
+  return true;
+}
+
+bool COutFileStream::PunchHole(UInt64 pos, UInt64 size)
+{
+ #if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+ #ifdef Z7_FILE_ASYNC_IO
+  // queued writes must not overwrite the hole later
+  if (_asyncFile && _async->WaitFile(_asyncFile) != 0)
+    return false;
+ #endif
+  return ::fallocate(File.GetHandle(),
+      FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)pos, (off_t)size) == 0;
+ #else
+  UNUSED_VAR(pos)
+  UNUSED_VAR(size)
+  return false;
+ #endif
+}
+
+HRESULT COutFileStream::Write_Zeros(const Byte *data, UInt32 size)
+{
+  if (_sparsePos < _sparseAllocEnd)
+  {
+    // that region of file can contain old data
+    UInt64 end = _sparsePos + size;
+    if (end > _sparseAllocEnd)
+      end = _sparseAllocEnd;
+    if (!PunchHole(_sparsePos, end - _sparsePos))
+    {
+      UInt32 processed = 0;
+      const HRESULT res = Write_Base(data, size, &processed);
+      _sparsePos += processed;
+      if (_sparseAllocEnd < _sparsePos)
+        _sparseAllocEnd = _sparsePos;
+      if (_sparseEnd < _sparsePos)
+        _sparseEnd = _sparsePos;
+      return res;
+    }
+  }
+  RINOK(Seek((Int64)size, STREAM_SEEK_CUR, NULL))
+  ProcessedSize += size;
+  if (_sparseEnd < _sparsePos)
+    _sparseEnd = _sparsePos;
+  return S_OK;
+}
+
+#else
+
+bool COutFileStream::Set_Sparse()
+{
+  return false;
+}
+
+#endif
+
+
 HRESULT COutFileStream::Close()
 {
-  return ConvertBoolToHRESULT(File.Close());
+  HRESULT res = S_OK;
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse)
+  {
+    _sparse = false;
+    // zero blocks at the end of stream were skipped, so we set the size of file
+    if (_sparseEnd > _sparseAllocEnd)
+      if (!File.SetLength_KeepPosition(_sparseEnd))
+        res = GetLastError_HRESULT();
+  }
+ #endif
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_asyncFile)
+  {
+    const WRes wres = _async->Close(_asyncFile, File);
+    _asyncFile = NULL;
+    if (res == S_OK)
+      res = HRESULT_FROM_WIN32(wres);
+    return res;
+  }
+ #endif
+  const HRESULT res2 = ConvertBoolToHRESULT(File.Close());
+  if (res == S_OK)
+    res = res2;
+  return res;
 }
 
 Z7_COM7F_IMF(COutFileStream::Write(const void *data, UInt32 size, UInt32 *processedSize))
 {
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse)
+  {
+    if (processedSize)
+      *processedSize = 0;
+    const Byte *p = (const Byte *)data;
+    while (size != 0)
+    {
+      /* we look for the run of blocks of same type (zero or non-zero).
+         Only full blocks aligned for file position can be zero blocks. */
+      UInt32 blockSize = kSparseBlockSize - ((UInt32)_sparsePos & (kSparseBlockSize - 1));
+      UInt32 cur = 0;
+      bool isZero = false;
+      for (;;)
+      {
+        if (blockSize > size - cur)
+          blockSize = size - cur;
+        const bool isZeroBlock = (blockSize == kSparseBlockSize && IsZeroBlock(p + cur, blockSize));
+        if (cur == 0)
+          isZero = isZeroBlock;
+        else if (isZero != isZeroBlock)
+          break;
+        cur += blockSize;
+        if (cur == size)
+          break;
+        blockSize = kSparseBlockSize;
+      }
+      if (isZero)
+      {
+        RINOK(Write_Zeros(p, cur))
+      }
+      else
+      {
+        UInt32 processed = 0;
+        const HRESULT res = Write_Base(p, cur, &processed);
+        _sparsePos += processed;
+        if (_sparseAllocEnd < _sparsePos)
+          _sparseAllocEnd = _sparsePos;
+        if (_sparseEnd < _sparsePos)
+          _sparseEnd = _sparsePos;
+        if (processedSize)
+          *processedSize += processed;
+        if (res != S_OK)
+          return res;
+        if (processed != cur)
+          return E_FAIL;
+        p += cur;
+        size -= cur;
+        continue;
+      }
+      if (processedSize)
+        *processedSize += cur;
+      p += cur;
+      size -= cur;
+    }
+    return S_OK;
+  }
+ #endif
+  return Write_Base(data, size, processedSize);
+}
+
+HRESULT COutFileStream::Write_Base(const void *data, UInt32 size, UInt32 *processedSize)
+{
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_asyncFile)
+  {
+    if (processedSize)
+      *processedSize = 0;
+    const WRes wres = _async->Write(_asyncFile, _asyncPos, data, size);
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+    _asyncPos += size;
+    ProcessedSize += size;
+    if (processedSize)
+      *processedSize = size;
+    return S_OK;
+  }
+ #endif
+
   #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
 
   UInt32 realProcessedSize;
@@ -830,7 +1301,54 @@ Z7_COM7F_IMF(COutFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPo
 {
   if (seekOrigin >= 3)
     return STG_E_INVALIDFUNCTION;
-  
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse)
+  {
+    if (seekOrigin == STREAM_SEEK_END)
+    {
+      // the size of file can be smaller than size of stream
+      UInt64 size;
+      RINOK(GetSize(&size))
+      offset += (Int64)size;
+      if (offset < 0)
+        return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+      seekOrigin = STREAM_SEEK_SET;
+    }
+    UInt64 pos = 0;
+    const HRESULT res = Seek_Base(offset, seekOrigin, &pos);
+    if (res == S_OK)
+      _sparsePos = pos;
+    if (newPosition)
+      *newPosition = pos;
+    return res;
+  }
+ #endif
+  return Seek_Base(offset, seekOrigin, newPosition);
+}
+
+HRESULT COutFileStream::Seek_Base(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+{  
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_asyncFile)
+  {
+    // the writes use explicit offsets, so we don't change the position of file handle
+    UInt64 base = 0;
+    if (seekOrigin == STREAM_SEEK_CUR)
+      base = _asyncPos;
+    else if (seekOrigin == STREAM_SEEK_END)
+    {
+      RINOK(GetSize(&base))
+    }
+    offset += (Int64)base;
+    if (offset < 0)
+      return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+    _asyncPos = (UInt64)offset;
+    if (newPosition)
+      *newPosition = _asyncPos;
+    return S_OK;
+  }
+ #endif
+
   #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
 
   UInt64 realNewPosition = 0;
@@ -853,12 +1371,44 @@ Z7_COM7F_IMF(COutFileStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPo
 
 Z7_COM7F_IMF(COutFileStream::SetSize(UInt64 newSize))
 {
-  return ConvertBoolToHRESULT(File.SetLength_KeepPosition(newSize));
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_asyncFile)
+  {
+    const WRes wres = _async->WaitFile(_asyncFile);
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+ #endif
+  if (!File.SetLength_KeepPosition(newSize))
+    return GetLastError_HRESULT();
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse)
+  {
+    _sparseEnd = newSize;
+    if (_sparseAllocEnd > newSize)
+      _sparseAllocEnd = newSize;
+  }
+ #endif
+  return S_OK;
 }
 
 HRESULT COutFileStream::GetSize(UInt64 *size)
 {
-  return ConvertBoolToHRESULT(File.GetLength(*size));
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_asyncFile)
+  {
+    const WRes wres = _async->WaitFile(_asyncFile);
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+ #endif
+  if (!File.GetLength(*size))
+    return GetLastError_HRESULT();
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  if (_sparse && *size < _sparseEnd)
+    *size = _sparseEnd;
+ #endif
+  return S_OK;
 }
 
 #ifdef UNDER_CE
@@ -7,9 +7,35 @@
 #define Z7_FILE_STREAMS_USE_WIN_FILE
 #endif
 
+/*
+Z7_FILE_STREAMS_USE_MMAP : CInFileStream::Map() can map whole regular file
+  to memory (mmap()). Then Read() / Seek() work without system calls,
+  and the data is available for direct access via IStreamGetRangePtr.
+  Note: if the mapped file is truncated by another process,
+  the access to removed pages raises SIGBUS.
+*/
+#if !defined(_WIN32) && !defined(Z7_NO_FILE_STREAMS_MMAP)
+#define Z7_FILE_STREAMS_USE_MMAP
+#endif
+
+/*
+Z7_FILE_STREAMS_USE_SPARSE : COutFileStream::Set_Sparse() enables sparse mode,
+  where aligned blocks of zeros are not written to file. The stream seeks over
+  such blocks (or punches hole, if that region of file contains old data).
+*/
+#if !defined(_WIN32) && !defined(Z7_NO_FILE_STREAMS_SPARSE)
+#define Z7_FILE_STREAMS_USE_SPARSE
+#endif
+/*
+  CInFileStream::Set_Sparse() enables hole detection (SEEK_DATA / SEEK_HOLE) for input file.
+  Then Read() fills holes with zeros without reading, and the data regions
+  are available via IStreamGetDataRange.
+*/
+
 #include "../../Common/MyCom.h"
 #include "../../Common/MyString.h"
 
+#include "../../Windows/FileAsyncIO.h"
 #include "../../Windows/FileIO.h"
 
 #include "../IStream.h"
@@ -28,31 +54,36 @@ DECLARE_INTERFACE(IInFileStream_Callback)
 Z7_PURE_INTERFACES_END
 
 
-/*
-Z7_CLASS_IMP_COM_5(
-  CInFileStream
-  , IInStream
-  , IStreamGetSize
-  , IStreamGetProps
-  , IStreamGetProps2
-  , IStreamGetProp
-)
-*/
 Z7_class_final(CInFileStream) :
   public IInStream,
   public IStreamGetSize,
   public IStreamGetProps,
   public IStreamGetProps2,
   public IStreamGetProp,
+ #ifdef Z7_FILE_STREAMS_USE_MMAP
+  public IStreamGetRangePtr,
+  public IStreamSetAccessHint,
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  public IStreamGetDataRange,
+ #endif
   public CMyUnknownImp
 {
-  Z7_COM_UNKNOWN_IMP_6(
-      IInStream,
-      ISequentialInStream,
-      IStreamGetSize,
-      IStreamGetProps,
-      IStreamGetProps2,
-      IStreamGetProp)
+  Z7_COM_QI_BEGIN2(IInStream)
+  Z7_COM_QI_ENTRY(ISequentialInStream)
+  Z7_COM_QI_ENTRY(IStreamGetSize)
+  Z7_COM_QI_ENTRY(IStreamGetProps)
+  Z7_COM_QI_ENTRY(IStreamGetProps2)
+  Z7_COM_QI_ENTRY(IStreamGetProp)
+ #ifdef Z7_FILE_STREAMS_USE_MMAP
+  Z7_COM_QI_ENTRY(IStreamGetRangePtr)
+  Z7_COM_QI_ENTRY(IStreamSetAccessHint)
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  Z7_COM_QI_ENTRY(IStreamGetDataRange)
+ #endif
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
 
   Z7_IFACE_COM7_IMP(ISequentialInStream)
   Z7_IFACE_COM7_IMP(IInStream)
@@ -63,9 +94,31 @@ private:
 public:
   Z7_IFACE_COM7_IMP(IStreamGetProps2)
   Z7_IFACE_COM7_IMP(IStreamGetProp)
+ #ifdef Z7_FILE_STREAMS_USE_MMAP
+  Z7_IFACE_COM7_IMP(IStreamGetRangePtr)
+  Z7_IFACE_COM7_IMP(IStreamSetAccessHint)
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  Z7_IFACE_COM7_IMP(IStreamGetDataRange)
+ #endif
 
 private:
   NWindows::NFile::NIO::CInFile File;
+
+ #ifdef Z7_FILE_STREAMS_USE_MMAP
+  const Byte *_map;
+  size_t _mapSize;
+  UInt64 _mapPos;
+  void Unmap() throw();
+ #endif
+ #ifdef Z7_FILE_STREAMS_USE_SPARSE
+  bool _sparse;
+  // cached region: [_sparse_HolePos, _sparse_DataPos) is hole, [_sparse_DataPos, _sparse_DataEnd) is data
+  UInt64 _sparse_HolePos;
+  UInt64 _sparse_DataPos;
+  UInt64 _sparse_DataEnd;
+  HRESULT Read_Sparse(void *data, UInt32 size, UInt32 *processedSize);
+ #endif
 public:
 
   #ifdef Z7_FILE_STREAMS_USE_WIN_FILE
@@ -117,14 +170,44 @@ public:
   bool Open(CFSTR fileName)
   {
     _info_WasLoaded = false;
+   #ifdef Z7_FILE_STREAMS_USE_MMAP
+    Unmap();
+   #endif
+   #ifdef Z7_FILE_STREAMS_USE_SPARSE
+    _sparse = false;
+   #endif
     return File.Open(fileName);
   }
   
   bool OpenShared(CFSTR fileName, bool shareForWrite)
   {
     _info_WasLoaded = false;
+   #ifdef Z7_FILE_STREAMS_USE_MMAP
+    Unmap();
+   #endif
+   #ifdef Z7_FILE_STREAMS_USE_SPARSE
+    _sparse = false;
+   #endif
     return File.OpenShared(fileName, shareForWrite);
   }
+
+  /* Map() maps opened regular file to memory.
+     It returns false, if the file can't be mapped (it's not error).
+     The stream works with read() calls in that case. */
+  bool Map();
+  bool IsMapped() const
+  {
+   #ifdef Z7_FILE_STREAMS_USE_MMAP
+    return _map != NULL;
+   #else
+    return false;
+   #endif
+  }
+
+  /* Set_Sparse() enables hole detection, if opened file is regular file
+     that has fewer allocated blocks than its size.
+     It returns false, if the file is not sparse or hole detection is not supported. */
+  bool Set_Sparse();
 };
 
 // bool CreateStdInStream(CMyComPtr<ISequentialInStream> &str);
@@ -141,10 +224,51 @@ Z7_CLASS_IMP_COM_1(
   , IOutStream
 )
   Z7_IFACE_COM7_IMP(ISequentialOutStream)
+#ifdef Z7_FILE_ASYNC_IO
+  NWindows::NFile::NIO::CAsyncOutFiles *_async;
+  NWindows::NFile::NIO::CAsyncOutFiles::CFile *_asyncFile;
+  UInt64 _asyncPos;
+#endif
+#ifdef Z7_FILE_STREAMS_USE_SPARSE
+  bool _sparse;
+  UInt64 _sparsePos;      // current position in stream
+  UInt64 _sparseAllocEnd; // file can contain old data or written data before that position
+  UInt64 _sparseEnd;      // size of stream including skipped zero blocks
+  HRESULT Write_Zeros(const Byte *data, UInt32 size);
+  bool PunchHole(UInt64 pos, UInt64 size);
+#endif
+  HRESULT Write_Base(const void *data, UInt32 size, UInt32 *processedSize);
+  HRESULT Seek_Base(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
 public:
 
   NWindows::NFile::NIO::COutFile File;
 
+  COutFileStream()
+  {
+   #ifdef Z7_FILE_ASYNC_IO
+    _async = NULL;
+    _asyncFile = NULL;
+   #endif
+   #ifdef Z7_FILE_STREAMS_USE_SPARSE
+    _sparse = false;
+   #endif
+  }
+
+#ifdef Z7_FILE_ASYNC_IO
+  ~COutFileStream();
+
+  /* after Set_Async() call, Write() copies data to buffers of (async),
+     and Close() moves the file to finishing thread of (async) */
+  void Set_Async(NWindows::NFile::NIO::CAsyncOutFiles *async, const FString &path);
+  bool IsAsync() const { return _asyncFile != NULL; }
+  void Set_Async_Attrib(DWORD attrib) { _async->SetAttrib(_asyncFile, attrib); }
+  void Set_Async_Owner(uid_t uid, gid_t gid) { _async->SetOwner(_asyncFile, uid, gid); }
+#endif
+
+  /* Set_Sparse() must be called after file opening before first Write().
+     It returns false, if sparse mode is not supported. */
+  bool Set_Sparse();
+
   bool Create_NEW(CFSTR fileName)
   {
     ProcessedSize = 0;
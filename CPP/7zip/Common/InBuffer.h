@@ -95,6 +95,17 @@ public:
     return *_buf++;
   }
   
+  // it returns pointer to (size) bytes in buffer, or NULL, if there are no such bytes in buffer.
+  Z7_FORCE_INLINE
+  const Byte *GetBufPtr(size_t size) const
+  {
+    return (size_t)(_bufLim - _buf) >= size ? _buf : NULL;
+  }
+  
+  // call it only for (size) that was checked by GetBufPtr()
+  Z7_FORCE_INLINE
+  void SkipBufBytes(size_t size) { _buf += size; }
+
   size_t ReadBytesPart(Byte *buf, size_t size);
   size_t ReadBytes(Byte *buf, size_t size);
   const Byte *Lookahead(size_t &rem)
@@ -1,3 +1,59 @@
 // LockedStream.cpp
 
 #include "StdAfx.h"
+
+#ifndef Z7_ST
+
+#include "StreamUtils.h"
+
+#include "LockedStream.h"
+
+Z7_COM7F_IMF(CLockedInStreamReader::Read(void *data, UInt32 size, UInt32 *processedSize))
+{
+  if (processedSize)
+    *processedSize = 0;
+  if (size == 0)
+    return S_OK;
+  NWindows::NSynchronization::CCriticalSectionLock lock(Base->CS);
+  if (_pos != Base->Pos)
+  {
+    Base->Pos = (UInt64)(Int64)-1;
+    RINOK(InStream_SeekSet(Base->Stream, _pos))
+    Base->Pos = _pos;
+  }
+  UInt32 realProcessedSize = 0;
+  const HRESULT res = Base->Stream->Read(data, size, &realProcessedSize);
+  _pos += realProcessedSize;
+  Base->Pos = _pos;
+  if (processedSize)
+    *processedSize = realProcessedSize;
+  return res;
+}
+
+Z7_COM7F_IMF(CLockedInStreamReader::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition))
+{
+  switch (seekOrigin)
+  {
+    case STREAM_SEEK_SET: break;
+    case STREAM_SEEK_CUR: offset += _pos; break;
+    case STREAM_SEEK_END:
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(Base->CS);
+      UInt64 size;
+      Base->Pos = (UInt64)(Int64)-1;
+      RINOK(InStream_GetSize_SeekToEnd(Base->Stream, size))
+      Base->Pos = size;
+      offset += size;
+      break;
+    }
+    default: return STG_E_INVALIDFUNCTION;
+  }
+  if (offset < 0)
+    return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+  _pos = (UInt64)offset;
+  if (newPosition)
+    *newPosition = (UInt64)offset;
+  return S_OK;
+}
+
+#endif
@@ -3,4 +3,43 @@
 #ifndef ZIP7_INC_LOCKED_STREAM_H
 #define ZIP7_INC_LOCKED_STREAM_H
 
+#ifndef Z7_ST
+
+#include "../../Common/MyCom.h"
+#include "../../Windows/Synchronization.h"
+
+#include "../IStream.h"
+
+/*
+  CLockedInStreamReader objects allow parallel reading from different
+  positions of one shared stream from different threads.
+  All readers share one CLockedInStreamBase object.
+  Each reader has its own position, and it calls Seek() + Read()
+  of base stream under lock.
+*/
+
+struct CLockedInStreamBase
+{
+  CMyComPtr<IInStream> Stream;
+  UInt64 Pos; // real position in (Stream), or (UInt64)(Int64)-1, if unknown
+  NWindows::NSynchronization::CCriticalSection CS;
+
+  void Init(IInStream *stream)
+  {
+    Stream = stream;
+    Pos = (UInt64)(Int64)-1;
+  }
+};
+
+Z7_CLASS_IMP_IInStream(
+  CLockedInStreamReader
+)
+  UInt64 _pos;
+public:
+  CLockedInStreamBase *Base;
+  CLockedInStreamReader(): _pos(0), Base(NULL) {}
+};
+
+#endif
+
 #endif
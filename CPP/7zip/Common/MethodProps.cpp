@@ -428,12 +428,13 @@ static const CNameToPropID g_NameToPropID[] =
   { VT_UI8, "memuse" },
   { VT_UI8, "aff" },
   { VT_UI4, "offset" },
-  { VT_UI4, "zhb" }
-  /*
-  , { VT_UI4, "tgn" }, // kNumThreadGroups
-  , { VT_UI4, "tgi" }, // kThreadGroup
-  , { VT_UI8, "tga" }, // kAffinityInGroup
-  */
+  { VT_UI4, "zhb" },
+  // the following thread group properties are not available as method parameters:
+  { VT_UI4, "" }, // "tgn" : kNumThreadGroups
+  { VT_UI4, "" }, // "tgi" : kThreadGroup
+  { VT_UI8, "" }, // "tga" : kAffinityInGroup
+  { VT_UI4, "seed" },
+  { VT_UI4, "sseed" }
   /*
   ,
   // { VT_UI4, "zhc" },
@@ -562,6 +563,8 @@ static bool IsLogSizeProp(PROPID propid)
     case NCoderPropID::kUsedMemorySize:
     case NCoderPropID::kBlockSize:
     case NCoderPropID::kBlockSize2:
+    case NCoderPropID::kBlockPrefixSize:
+    case NCoderPropID::kSharedPrefixSize:
     /*
     case NCoderPropID::kChainSize:
     case NCoderPropID::kLdmWindowSize:
@@ -705,17 +708,24 @@ static UInt64 GetMemoryUsage_LZMA(UInt32 dict, bool isBt, UInt32 numThreads)
   
   if (numThreads > 1 && isBt)
     size1 += (2 << 20) + (4 << 20);
+  if (numThreads > 2 && isBt)
+  {
+    /* partitioned BT mode in LzFindMt.c:
+       owner byte for each position of cyclic buffer,
+       and match buffer (256 KiB) for each of (numThreads - 1) BT threads */
+    size1 += (UInt64)dict + (UInt64)(numThreads - 1) * (1 << 18);
+  }
   return size1;
 }
 
 static const UInt32 kLzmaMaxDictSize = (UInt32)15 << 28;
 
-UInt64 CMethodProps::Get_Lzma_MemUsage(bool addSlidingWindowSize) const
+UInt64 CMethodProps::Get_Lzma_MemUsage(bool addSlidingWindowSize, bool isLzma2) const
 {
   const UInt64 dicSize = Get_Lzma_DicSize();
   const bool isBt = Get_Lzma_MatchFinder_IsBt();
   const UInt32 dict32 = (dicSize >= kLzmaMaxDictSize ? kLzmaMaxDictSize : (UInt32)dicSize);
-  const UInt32 numThreads = Get_Lzma_NumThreads();
+  const UInt32 numThreads = Get_Lzma_NumThreads(isLzma2);
   UInt64 size = GetMemoryUsage_LZMA(dict32, isBt, numThreads);
   
   if (addSlidingWindowSize)
@@ -185,17 +185,32 @@ public:
     return false;
   }
 
-  UInt32 Get_Lzma_NumThreads() const
+  /* it returns the number of threads of one LZMA encoder.
+     (isLzma2) : the "mt" property of LZMA2 is the total number of threads,
+       and each LZMA encoder in LZMA2 uses 1 or 2 threads.
+     LZMA encoder with (numThreads > 2) uses partitioned BT match finder
+     (hash thread and (numThreads - 1) BT threads), if dictionary is 1 MiB or larger. */
+  UInt32 Get_Lzma_NumThreads(bool isLzma2) const
   {
     if (Get_Lzma_Algo() == 0)
       return 1;
     int numThreads = Get_NumThreads();
-    if (numThreads >= 0)
-      return numThreads < 2 ? 1 : 2;
-    return 2;
+    if (numThreads < 0)
+      return 2;
+    if (numThreads < 2)
+      return 1;
+    if (isLzma2
+        || numThreads == 2
+        || !Get_Lzma_MatchFinder_IsBt()
+        || Get_Lzma_DicSize() < ((UInt64)1 << 20))
+      return 2;
+    // kMtBtPartThreadsMax BT threads and hash thread
+    if (numThreads > 64 + 1)
+      numThreads = 64 + 1;
+    return (UInt32)numThreads;
   }
 
-  UInt64 Get_Lzma_MemUsage(bool addSlidingWindowSize) const;
+  UInt64 Get_Lzma_MemUsage(bool addSlidingWindowSize, bool isLzma2) const;
 
   /* returns -1, if numThreads is unknown */
   int Get_Xz_NumThreads(UInt32 &lzmaThreads) const
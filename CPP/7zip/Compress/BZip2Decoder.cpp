@@ -884,6 +884,13 @@ CDecoder::CDecoder():
   MtMode = false;
   NeedWaitScout = false;
   // ScoutRes = S_OK;
+  _numThreads = 1;
+  _memUsage = (UInt64)(sizeof(size_t)) << 28;
+  _mtDec_WasConstructed = false;
+  _mtReadMode = false;
+  _mtResumeBlock = false;
+  _mtReadLim = 0;
+  _mtCoders = NULL;
   #endif
 }
 
@@ -909,6 +916,19 @@ CDecoder::~CDecoder()
 
     // if (ScoutRes != S_OK) throw ScoutRes;
   }
+
+  if (_mtDec_WasConstructed)
+    MtDec_Destruct(&_mtDec);
+  if (_mtCoders)
+  {
+    for (unsigned i = 0; i < MTDEC_THREADS_MAX; i++)
+    {
+      CMtCoder &t = _mtCoders[i];
+      BigFree(t.Counters);
+      MidFree(t.OutBuf);
+    }
+    delete []_mtCoders;
+  }
   
   #endif
 
@@ -926,6 +946,28 @@ HRESULT CDecoder::ReadInput()
   _inProcessed += (size_t)(Base._buf - _inBuf);
   Base._buf = _inBuf;
   Base._lim = _inBuf;
+
+  #ifndef Z7_ST
+  if (_mtReadMode)
+  {
+    // we read the data that was buffered by MtDec before switching to single-thread mode
+    const Byte *data = MtDec_Read(&_mtDec, &_mtReadLim);
+    if (data)
+    {
+      memcpy(_inBuf, data, _mtReadLim);
+      Base._lim = _inBuf + _mtReadLim;
+      return S_OK;
+    }
+    _mtReadMode = false;
+    if (_mtDec.readWasFinished)
+    {
+      _inputFinished = true;
+      _inputRes = _inWrap.Res;
+      return _inputRes;
+    }
+  }
+  #endif
+
   UInt32 size = 0;
   _inputRes = Base.InStream->Read(_inBuf, kInBufSize, &size);
   _inputFinished = (size == 0);
@@ -1021,7 +1063,20 @@ HRESULT CDecoder::DecodeStreams(ICompressProgressInfo *progress)
     #endif
   }
 
-  RINOK(StartRead())
+  UInt32 nextCrc = 0;
+
+  #ifndef Z7_ST
+  if (_mtResumeBlock)
+  {
+    // MT decoding was stopped, and Base was set to the start of block
+    _mtResumeBlock = false;
+    nextCrc = Base.crc;
+  }
+  else
+  #endif
+  {
+    RINOK(StartRead())
+  }
 
   UInt64 inPrev = 0;
   UInt64 outPrev = 0;
@@ -1036,7 +1091,6 @@ HRESULT CDecoder::DecodeStreams(ICompressProgressInfo *progress)
     bool wasFinished = false;
 
     UInt32 crc = 0;
-    UInt32 nextCrc = 0;
     HRESULT nextRes = S_OK;
 
     UInt64 packPos = 0;
@@ -1302,7 +1356,19 @@ Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream
   _outWritten = 0;
   _outPos = 0;
 
-  HRESULT res = DecodeStreams(progress);
+  HRESULT res = S_OK;
+  bool finished = false;
+
+  #ifndef Z7_ST
+  {
+    const unsigned numThreads = GetNumMtDecThreads();
+    if (numThreads > 1)
+      res = DecodeMt(progress, numThreads, finished);
+  }
+  #endif
+
+  if (res == S_OK && !finished)
+    res = DecodeStreams(progress);
 
   Flush();
 
@@ -1505,6 +1571,7 @@ void CDecoder::RunScout()
 Z7_COM7F_IMF(CDecoder::SetNumberOfThreads(UInt32 numThreads))
 {
   MtMode = (numThreads > 1);
+  _numThreads = numThreads;
 
   #ifndef BZIP2_BYTE_MODE
   MtMode = false;
@@ -1514,6 +1581,534 @@ Z7_COM7F_IMF(CDecoder::SetNumberOfThreads(UInt32 numThreads))
   return S_OK;
 }
 
+
+Z7_COM7F_IMF(CDecoder::SetMemLimit(UInt64 memUsage))
+{
+  _memUsage = memUsage;
+  return S_OK;
+}
+
+
+/* ---------- Streaming MT decoding ----------
+MtDec reads the input stream and calls Parse() for each new data in the thread
+that has read permission. Parse() looks for block and stream signatures
+at any bit position and it splits the stream after (block signature + block CRC).
+So each MT-block (except of first) contains one bzip2 block and the stream
+structures that follow that block.
+Code() decodes the block in its own thread to the buffer of MT-block.
+It checks that the block ends exactly at the signature position found by Parse().
+Write() writes the output in the original order.
+If Parse() or Code() sees something unexpected (including false signature
+inside block data), we switch to single-thread decoding from the start
+of first MT-block that was not written. So all error reports are same as
+in single-thread decoding. */
+
+static const UInt64 kSigMask = ((UInt64)1 << 48) - 1;
+static const UInt64 kBlockSig48 = (UInt64)0x314159265359;
+static const UInt64 kEndSig48   = (UInt64)0x177245385090;
+
+// compressed bzip2 block can't be larger than (kBlockSizeMax * kMaxHuffmanLen / 8).
+static const size_t kMtInBlockMax = (size_t)kBlockSizeMax * 3;
+// if block output is larger, then Write() decodes the remaining data
+static const size_t kMtOutBufSize = (size_t)1 << 21;
+
+static const size_t kCountersSize = (256 + kBlockSizeMax) * sizeof(UInt32)
+  #ifdef BZIP2_BYTE_MODE
+    + kBlockSizeMax
+  #endif
+    + 256;
+
+static const UInt64 kMtThreadMemUsage = kCountersSize + kMtOutBufSize + kMtInBlockMax;
+
+enum
+{
+  MT_PARSE_STREAM_SIG,
+  MT_PARSE_SIG,
+  MT_PARSE_CRC,
+  MT_PARSE_BLOCK
+};
+
+
+unsigned CDecoder::GetNumMtDecThreads() const
+{
+  // Parse() doesn't support (outSize) limit and stream finishing after first stream
+  if (!MtMode || !Base.DecodeAllStreams || _outSizeDefined)
+    return 1;
+  UInt32 numThreads = _numThreads;
+  if (numThreads > MTDEC_THREADS_MAX)
+    numThreads = MTDEC_THREADS_MAX;
+  const UInt64 numThreads_Mem = _memUsage / kMtThreadMemUsage;
+  if (numThreads > numThreads_Mem)
+    numThreads = (UInt32)numThreads_Mem;
+  return numThreads;
+}
+
+
+void CDecoder::MtParse(unsigned coderIndex, CMtDecCallbackInfo *cc)
+{
+  CMtCoder &t = _mtCoders[coderIndex];
+  CMtParser &p = _mtParser;
+
+  if (cc->startCall)
+  {
+    t.Start = p.Cur;
+    t.End = p.Cur;
+    t.HasBlock = (p.State == MT_PARSE_BLOCK);
+    t.BlockEndPos = 0;
+    t.InCodePos = 0;
+    t.OutSize = 0;
+    t.CodeRes = SZ_OK;
+    p.BlockSize = 0;
+
+    CBase &b = t.Base;
+    b.InitBitDecoder();
+    if (p.Cur.NumBits != 0)
+    {
+      b._value = p.Cur.Bits << (32 - p.Cur.NumBits);
+      b._numBits = p.Cur.NumBits;
+    }
+    b.state = STATE_BLOCK_START;
+    b.Props.randMode = 1;
+    b.blockSizeMax = p.Cur.BlockSizeMax;
+  }
+
+  cc->state = MTDEC_PARSE_CONTINUE;
+  
+  const Byte *src = cc->src;
+  const size_t size = cc->srcSize;
+  size_t i = 0;
+
+  for (;;)
+  {
+    if (p.State == MT_PARSE_BLOCK)
+    {
+      UInt64 v = p.Val;
+      unsigned k = 8;
+      while (i != size)
+      {
+        v = (v << 8) | src[i++];
+        // the signature can end at any bit of new byte
+        for (k = 0; k < 8; k++)
+        {
+          const UInt64 sig = (v >> k) & kSigMask;
+          if (sig == kBlockSig48 || sig == kEndSig48)
+            break;
+        }
+        if (k != 8)
+        {
+          // the signature must be after the start of block
+          const UInt64 endPos = p.Cur.NumBits + ((p.BlockSize + i) << 3) - k;
+          if (endPos >= 48 + 8)
+            break;
+          k = 8;
+        }
+      }
+      p.Val = v;
+      if (k == 8)
+        break;
+      t.BlockEndPos = p.Cur.NumBits + ((p.BlockSize + i) << 3) - k - 48;
+      p.IsEndSig = (((v >> k) & kSigMask) == kEndSig48);
+      p.Crc = (UInt32)v & (((UInt32)1 << k) - 1);
+      p.NumCrcBits = k;
+      p.State = MT_PARSE_CRC;
+      continue;
+    }
+
+    if (i == size)
+      break;
+    
+    const unsigned b = src[i++];
+
+    if (p.State == MT_PARSE_STREAM_SIG)
+    {
+      if (   (p.Pos == 0 && b != kArSig0)
+          || (p.Pos == 1 && b != kArSig1)
+          || (p.Pos == 2 && b != kArSig2)
+          || (p.Pos == 3 && (b <= kArSig3 || b > kArSig3 + kBlockSizeMultMax)))
+      {
+        cc->state = MTDEC_PARSE_OVERFLOW;
+        return;
+      }
+      if (++p.Pos == 4)
+      {
+        p.Cur.BlockSizeMax = (UInt32)(b - kArSig3) * kBlockSizeStep;
+        p.Cur.CombinedCrc.Init();
+        p.State = MT_PARSE_SIG;
+        p.Pos = 0;
+      }
+      continue;
+    }
+    
+    if (p.State == MT_PARSE_SIG)
+    {
+      p.Val = (p.Val << 8) | b;
+      if (++p.Pos == 6)
+      {
+        const UInt64 sig = p.Val & kSigMask;
+        if (sig != kBlockSig48 && sig != kEndSig48)
+        {
+          cc->state = MTDEC_PARSE_OVERFLOW;
+          return;
+        }
+        p.IsEndSig = (sig == kEndSig48);
+        p.Crc = 0;
+        p.NumCrcBits = 0;
+        p.State = MT_PARSE_CRC;
+      }
+      continue;
+    }
+
+    // (p.State == MT_PARSE_CRC)
+    {
+      unsigned numBits = 32 - p.NumCrcBits;
+      if (numBits > 8)
+        numBits = 8;
+      const unsigned rem = 8 - numBits;
+      p.Crc = (p.Crc << numBits) | (b >> rem);
+      p.NumCrcBits += numBits;
+      if (p.NumCrcBits != 32)
+        continue;
+      
+      const UInt32 remBits = b & (((UInt32)1 << rem) - 1);
+      CMtState &st = p.Cur;
+      if (!st.IsBz)
+        st.NumStreams++;
+      st.IsBz = true;
+
+      if (p.IsEndSig)
+      {
+        if (p.Crc != st.CombinedCrc.GetDigest())
+        {
+          cc->state = MTDEC_PARSE_OVERFLOW;
+          return;
+        }
+        if (remBits != 0)
+          st.MinorError = true;
+        // new stream
+        st.IsBz = false;
+        st.BlockStart = false;
+        p.State = MT_PARSE_STREAM_SIG;
+        p.Pos = 0;
+        continue;
+      }
+      
+      st.NumBlocks++;
+      st.CombinedCrc.Update(p.Crc);
+      st.BlockCrc = p.Crc;
+      st.Bits = remBits;
+      st.NumBits = rem;
+      st.BlockStart = true;
+      st.InPos = p.InPos + i;
+      p.Val = remBits;
+      p.State = MT_PARSE_BLOCK;
+      p.InPos += i;
+      t.End = st;
+      // the data of next block will be decoded in next MT-block
+      cc->srcSize = i;
+      cc->state = MTDEC_PARSE_NEW;
+      t.ParseState = cc->state;
+      return;
+    }
+  }
+
+  p.InPos += size;
+  p.BlockSize += size;
+  
+  if (p.BlockSize > kMtInBlockMax)
+    cc->state = MTDEC_PARSE_OVERFLOW;
+  else if (cc->srcFinished)
+  {
+    // we switch to single-thread decoding for any unexpected end of data
+    if (p.State == MT_PARSE_STREAM_SIG && p.Pos == 0 && p.Cur.NumStreams != 0)
+    {
+      cc->state = MTDEC_PARSE_END;
+      t.End = p.Cur;
+      t.End.InPos = p.InPos;
+    }
+    else
+      cc->state = MTDEC_PARSE_OVERFLOW;
+  }
+  t.ParseState = cc->state;
+}
+
+
+SRes CDecoder::MtPreCode(unsigned coderIndex)
+{
+  CMtCoder &t = _mtCoders[coderIndex];
+  if (!t.HasBlock)
+    return SZ_OK;
+  if (!t.Counters)
+  {
+    t.Counters = (UInt32 *)::BigAlloc(kCountersSize);
+    if (!t.Counters)
+      return SZ_ERROR_MEM;
+  }
+  if (!t.OutBuf)
+  {
+    t.OutBuf = (Byte *)::MidAlloc(kMtOutBufSize);
+    if (!t.OutBuf)
+      return SZ_ERROR_MEM;
+  }
+  t.Base.Counters = t.Counters;
+  return SZ_OK;
+}
+
+
+SRes CDecoder::MtCode(unsigned coderIndex, const Byte *src, size_t srcSize, int srcFinished,
+    UInt64 *inCodePos, UInt64 *outCodePos, int *stop)
+{
+  CMtCoder &t = _mtCoders[coderIndex];
+  CBase &b = t.Base;
+
+  *outCodePos = 0;
+  *stop = True;
+
+  if (!t.HasBlock)
+  {
+    *inCodePos = srcSize;
+    return SZ_OK;
+  }
+
+  // MtDec skips PreCode() for interrupted blocks, but it still calls Code().
+  // So the buffers can be not allocated here.
+  // We don't decode such block, and single-thread mode will decode it again.
+  if (!t.Counters || !t.OutBuf)
+  {
+    *inCodePos = 0;
+    t.CodeRes = SZ_ERROR_DATA;
+    return SZ_OK;
+  }
+
+  b._buf = src;
+  b._lim = src + srcSize;
+  SRes res = b.ReadBlock2();
+  t.InCodePos += (size_t)(b._buf - src);
+  *inCodePos = t.InCodePos;
+
+  if (res == SZ_OK)
+  {
+    if (b.state != STATE_BLOCK_SIGNATURE)
+    {
+      if (!srcFinished)
+      {
+        *stop = False;
+        return SZ_OK;
+      }
+      res = SZ_ERROR_DATA;
+    }
+    // the block must end exactly at the signature found by Parse()
+    else if (t.Start.NumBits + (t.InCodePos << 3) - b._numBits != t.BlockEndPos)
+      res = SZ_ERROR_DATA;
+  }
+  
+  if (res == SZ_OK)
+  {
+    TICKS_START
+    DecodeBlock1(t.Counters, b.Props.blockSize);
+    TICKS_UPDATE(1)
+
+    CSpecState &spec = t.Spec;
+    spec._blockSize = b.Props.blockSize;
+    spec._tt = t.Counters + 256;
+    spec.Init(b.Props.origPtr, b.Props.randMode);
+    
+    t.OutSize = (size_t)(spec.Decode(t.OutBuf, kMtOutBufSize) - t.OutBuf);
+    *outCodePos = t.OutSize;
+    
+    if (spec.Finished() && spec._crc.GetDigest() != t.Start.BlockCrc)
+      res = SZ_ERROR_CRC;
+  }
+  
+  // we will decode this block again in single-thread mode to get correct error status
+  t.CodeRes = res;
+  return res;
+}
+
+
+SRes CDecoder::MtWrite(unsigned coderIndex, BoolInt needWriteToStream,
+    BoolInt *needContinue, BoolInt *canRecode)
+{
+  CMtCoder &t = _mtCoders[coderIndex];
+
+  *needContinue = False;
+  *canRecode = True;
+
+  if (!needWriteToStream || t.CodeRes != SZ_OK)
+    return SZ_OK;
+  
+  *canRecode = False;
+
+  if (t.HasBlock)
+  {
+    HRESULT hres = WriteStream(_outStream, t.OutBuf, t.OutSize);
+    _outWritten += t.OutSize;
+    _outPosTotal += t.OutSize;
+    
+    CSpecState &spec = t.Spec;
+    
+    while (hres == S_OK && !spec.Finished())
+    {
+      const size_t size = (size_t)(spec.Decode(_outBuf, kOutBufSize) - _outBuf);
+      hres = WriteStream(_outStream, _outBuf, size);
+      _outWritten += size;
+      _outPosTotal += size;
+      const SRes res = MtProgress_ProgressAdd(&_mtDec.mtProgress, 0, size);
+      if (res != SZ_OK)
+        return res;
+    }
+    
+    if (hres != S_OK)
+    {
+      _writeRes = hres;
+      return SZ_ERROR_WRITE;
+    }
+    
+    if (spec._crc.GetDigest() != t.Start.BlockCrc)
+    {
+      BlockCrcError = true;
+      return SZ_ERROR_CRC;
+    }
+  }
+
+  _mtState = t.End;
+  *needContinue = (t.ParseState == MTDEC_PARSE_NEW);
+  return SZ_OK;
+}
+
+
+static void BZip2DecMt_Parse(void *p, unsigned coderIndex, CMtDecCallbackInfo *cc)
+{
+  ((CDecoder *)p)->MtParse(coderIndex, cc);
+}
+
+static SRes BZip2DecMt_PreCode(void *p, unsigned coderIndex)
+{
+  return ((CDecoder *)p)->MtPreCode(coderIndex);
+}
+
+static SRes BZip2DecMt_Code(void *p, unsigned coderIndex,
+    const Byte *src, size_t srcSize, int srcFinished,
+    UInt64 *inCodePos, UInt64 *outCodePos, int *stop)
+{
+  return ((CDecoder *)p)->MtCode(coderIndex, src, srcSize, srcFinished, inCodePos, outCodePos, stop);
+}
+
+static SRes BZip2DecMt_Write(void *p, unsigned coderIndex,
+    BoolInt needWriteToStream,
+    const Byte * /* src */, size_t /* srcSize */, BoolInt /* isCross */,
+    BoolInt *needContinue, BoolInt *canRecode)
+{
+  return ((CDecoder *)p)->MtWrite(coderIndex, needWriteToStream, needContinue, canRecode);
+}
+
+
+void CDecoder::InitStateFromMt()
+{
+  const CMtState &st = _mtState;
+  
+  _inProcessed = st.InPos;
+  Base._buf = _inBuf;
+  Base._lim = _inBuf;
+  Base.InitBitDecoder();
+
+  Base.NumStreams = st.NumStreams;
+  Base.NumBlocks = st.NumBlocks;
+  Base.MinorError = st.MinorError;
+  Base.IsBz = st.IsBz;
+  
+  if (!st.BlockStart)
+    return;
+  
+  if (st.NumBits != 0)
+  {
+    Base._value = st.Bits << (32 - st.NumBits);
+    Base._numBits = st.NumBits;
+  }
+  Base.CombinedCrc = st.CombinedCrc;
+  Base.crc = st.BlockCrc;
+  Base.blockSizeMax = st.BlockSizeMax;
+  Base.state = STATE_BLOCK_START;
+  _mtResumeBlock = true;
+}
+
+
+HRESULT CDecoder::DecodeMt(ICompressProgressInfo *progress, unsigned numThreads, bool &finished)
+{
+  finished = false;
+
+  if (!_mtCoders)
+    _mtCoders = new CMtCoder[MTDEC_THREADS_MAX];
+  if (!_mtDec_WasConstructed)
+  {
+    MtDec_Construct(&_mtDec);
+    _mtDec_WasConstructed = true;
+  }
+
+  {
+    CMtParser &p = _mtParser;
+    p.State = MT_PARSE_STREAM_SIG;
+    p.Pos = 0;
+    p.Val = 0;
+    p.InPos = 0;
+    p.BlockSize = 0;
+    p.Cur.InitStreamStart();
+    _mtState = p.Cur;
+  }
+
+  _inWrap.Init(Base.InStream);
+  _progressWrap.Init(progress);
+
+  IMtDecCallback2 vt;
+  vt.Parse = BZip2DecMt_Parse;
+  vt.PreCode = BZip2DecMt_PreCode;
+  vt.Code = BZip2DecMt_Code;
+  vt.Write = BZip2DecMt_Write;
+
+  _mtDec.mtCallback = &vt;
+  _mtDec.mtCallbackObject = this;
+  _mtDec.inStream = &_inWrap.vt;
+  _mtDec.progress = progress ? &_progressWrap.vt : NULL;
+  _mtDec.alloc = &g_MidAlloc;
+  // (inBufSize <= kInBufSize) is required for MtDec_Read() in single-thread mode
+  _mtDec.inBufSize = kInBufSize;
+  _mtDec.numThreadsMax = numThreads;
+
+  const SRes res = MtDec_Code(&_mtDec);
+  
+  if (_writeRes != S_OK)
+    return _writeRes;
+  if (BlockCrcError)
+    return S_FALSE;
+  if (_mtDec.mtProgress.res != SZ_OK)
+  {
+    if (_progressWrap.Res != S_OK)
+      return _progressWrap.Res;
+    return SResToHRESULT(_mtDec.mtProgress.res);
+  }
+  if (res != SZ_OK)
+    return SResToHRESULT(res);
+
+  if (!_mtDec.needContinue && _mtDec.codeRes == SZ_OK)
+  {
+    if (_inWrap.Res != S_OK)
+      return _inWrap.Res;
+    // all streams were decoded. We set same state as single-thread decoding sets.
+    InitStateFromMt();
+    Base.FinishedPackSize = _inProcessed;
+    Base.state = STATE_STREAM_SIGNATURE;
+    Base.state2 = 0;
+    _inputFinished = true;
+    finished = true;
+    return S_OK;
+  }
+
+  PRIN("=== MtDec : ST_MODE")
+  _mtReadLim = 0;
+  _mtReadMode = (MtDec_PrepareRead(&_mtDec) != 0);
+  InitStateFromMt();
+  return S_OK;
+}
+
 #endif
 
 
@@ -9,12 +9,17 @@
 // #define Z7_ST
 
 #ifndef Z7_ST
+#include "../../../C/MtDec.h"
 #include "../../Windows/Synchronization.h"
 #include "../../Windows/Thread.h"
 #endif
 
 #include "../ICoder.h"
 
+#ifndef Z7_ST
+#include "../Common/CWrappers.h"
+#endif
+
 #include "BZip2Const.h"
 #include "BZip2Crc.h"
 #include "HuffmanDecoder.h"
@@ -191,6 +196,78 @@ public:
 };
 
 
+#ifndef Z7_ST
+
+/* The streaming multi-threaded decoder (based on MtDec) splits input stream
+   to MT-blocks at bit positions after (block signature + block CRC).
+   So each MT-block (except of first one) starts with bzip2 block data. */
+
+struct CMtState
+{
+  UInt64 InPos;      // position of first byte of MT-block in input stream
+  UInt64 NumStreams;
+  UInt64 NumBlocks;
+  CBZip2CombinedCrc CombinedCrc;
+  UInt32 BlockCrc;
+  UInt32 BlockSizeMax;
+  UInt32 Bits;       // first bits of block that are stored in last byte of previous MT-block
+  unsigned NumBits;
+  bool IsBz;
+  bool MinorError;
+  bool BlockStart;   // (true), if MT-block starts with bzip2 block data
+
+  void InitStreamStart()
+  {
+    InPos = 0;
+    NumStreams = 0;
+    NumBlocks = 0;
+    CombinedCrc.Init();
+    BlockCrc = 0;
+    BlockSizeMax = 0;
+    Bits = 0;
+    NumBits = 0;
+    IsBz = false;
+    MinorError = false;
+    BlockStart = false;
+  }
+};
+
+struct CMtParser
+{
+  unsigned State;
+  unsigned Pos;
+  UInt64 Val;
+  UInt32 Crc;
+  unsigned NumCrcBits;
+  bool IsEndSig;
+  UInt64 InPos;       // position of current parsed data in input stream
+  UInt64 BlockSize;   // size of current MT-block in bytes
+  CMtState Cur;
+};
+
+struct CMtCoder
+{
+  CBase Base;
+  CSpecState Spec;
+  UInt32 *Counters;
+  Byte *OutBuf;
+  size_t OutSize;
+  UInt64 InCodePos;
+  UInt64 BlockEndPos; // bit position of bzip2 block end in MT-block
+  bool HasBlock;
+  SRes CodeRes;
+  EMtDecParseState ParseState;
+  CMtState Start;
+  CMtState End;
+
+  Byte MtPad[1 << 7]; // It's pad for Multi-Threading. Must be >= Cache_Line_Size.
+
+  CMtCoder(): Counters(NULL), OutBuf(NULL) {}
+};
+
+#endif
+
+
   
  
 class CDecoder:
@@ -205,6 +282,7 @@ class CDecoder:
 #endif
 #ifndef Z7_ST
   public ICompressSetCoderMt,
+  public ICompressSetMemLimit,
 #endif
   public CMyUnknownImp
 {
@@ -219,6 +297,7 @@ class CDecoder:
 #endif
 #ifndef Z7_ST
   Z7_COM_QI_ENTRY(ICompressSetCoderMt)
+  Z7_COM_QI_ENTRY(ICompressSetMemLimit)
 #endif
   Z7_COM_QI_END
   Z7_COM_ADDREF_RELEASE
@@ -235,6 +314,7 @@ class CDecoder:
 public:
 #ifndef Z7_ST
   Z7_IFACE_COM7_IMP(ICompressSetCoderMt)
+  Z7_IFACE_COM7_IMP(ICompressSetMemLimit)
 #endif
 
 private:
@@ -284,7 +364,7 @@ public:
   bool NeedWaitScout;
   bool MtMode;
 
-  NWindows::CThread Thread;
+  NWindows::CPoolThread Thread;
   NWindows::NSynchronization::CAutoResetEvent DecoderEvent;
   NWindows::NSynchronization::CAutoResetEvent ScoutEvent;
   // HRESULT ScoutRes;
@@ -313,6 +393,33 @@ public:
 
   HRESULT CreateThread();
 
+  // ---------- streaming MT decoding (MtDec) ----------
+
+  UInt32 _numThreads;
+  UInt64 _memUsage;
+
+  bool _mtDec_WasConstructed;
+  bool _mtReadMode;
+  bool _mtResumeBlock;
+  size_t _mtReadLim;
+  CMtCoder *_mtCoders;
+  CMtParser _mtParser;
+  CMtState _mtState; // state at the start of first MT-block that was not written
+  CSeqInStreamWrap _inWrap;
+  CCompressProgressWrap _progressWrap;
+  CMtDec _mtDec;
+
+  unsigned GetNumMtDecThreads() const;
+  void InitStateFromMt();
+  HRESULT DecodeMt(ICompressProgressInfo *progress, unsigned numThreads, bool &finished);
+
+  void MtParse(unsigned coderIndex, CMtDecCallbackInfo *cc);
+  SRes MtPreCode(unsigned coderIndex);
+  SRes MtCode(unsigned coderIndex, const Byte *src, size_t srcSize, int srcFinished,
+      UInt64 *inCodePos, UInt64 *outCodePos, int *stop);
+  SRes MtWrite(unsigned coderIndex, BoolInt needWriteToStream,
+      BoolInt *needContinue, BoolInt *canRecode);
+
   #endif
 
   Byte *_inBuf;
@@ -22,11 +22,24 @@ static const unsigned kNumHuffPasses = 4;
 
 bool CThreadInfo::Alloc()
 {
+ #ifndef Z7_ST
+  const UInt32 numSortThreads = Encoder->NumSortThreads;
+ #else
+  const UInt32 numSortThreads = 1;
+ #endif
+  if (m_BlockSorterIndex && m_NumSortThreads != numSortThreads)
+  {
+    ::BigFree(m_BlockSorterIndex);
+    m_BlockSorterIndex = NULL;
+  }
   if (!m_BlockSorterIndex)
   {
-    m_BlockSorterIndex = (UInt32 *)::BigAlloc(BLOCK_SORT_BUF_SIZE(kBlockSizeMax) * sizeof(UInt32));
+    m_BlockSorterIndex = (UInt32 *)::BigAlloc((numSortThreads > 1 ?
+        BLOCK_SORT_MT_BUF_SIZE(kBlockSizeMax, numSortThreads) :
+        BLOCK_SORT_BUF_SIZE(kBlockSizeMax)) * sizeof(UInt32));
     if (!m_BlockSorterIndex)
       return false;
+    m_NumSortThreads = numSortThreads;
   }
 
   if (!m_Block_Base)
@@ -155,11 +168,14 @@ void CEncProps::Normalize(int level)
 CEncoder::CEncoder()
 {
   _props.Normalize(-1);
+  _expectedDataSize = (UInt64)(Int64)-1;
 
   #ifndef Z7_ST
   ThreadsInfo = NULL;
   m_NumThreadsPrev = 0;
+  _numThreads = 1;
   NumThreads = 1;
+  NumSortThreads = 1;
   #endif
 }
 
@@ -430,7 +446,7 @@ void CThreadInfo::EncodeBlock(const Byte *block, UInt32 blockSize)
 {
   // WriteBit2(0); // Randomised = false
   {
-    const UInt32 origPtr = BlockSort(m_BlockSorterIndex, block, blockSize);
+    const UInt32 origPtr = BlockSortMt(m_BlockSorterIndex, block, blockSize, m_NumSortThreads);
     // if (m_BlockSorterIndex[origPtr] != 0) throw 1;
     m_BlockSorterIndex[origPtr] = blockSize;
     WriteBits2(origPtr, kNumOrigBits + 1); // + 1 for additional high bit flag (Randomised = false)
@@ -933,6 +949,22 @@ HRESULT CEncoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *
 {
   NumBlocks = 0;
 #ifndef Z7_ST
+  {
+    /* If the number of blocks is smaller than the number of threads,
+       we use remaining threads for sorting inside each block. */
+    UInt32 numThreads = _numThreads;
+    NumSortThreads = 1;
+    if (numThreads > 1 && _expectedDataSize != (UInt64)(Int64)-1)
+    {
+      const UInt64 numBlocks = _expectedDataSize / (_props.BlockSizeMult * kBlockSizeStep) + 1;
+      if (numBlocks < numThreads)
+      {
+        NumSortThreads = numThreads / (UInt32)numBlocks;
+        numThreads = (UInt32)numBlocks;
+      }
+    }
+    NumThreads = numThreads;
+  }
   Progress = progress;
   ThreadNextGroup_Init(&ThreadNextGroup, _props.NumThreadGroups, 0); // startGroup
   RINOK(Create())
@@ -1108,9 +1140,24 @@ Z7_COM7F_IMF(CEncoder::SetNumberOfThreads(UInt32 numThreads))
   const UInt32 kNumThreadsMax = 64;
   if (numThreads < 1) numThreads = 1;
   if (numThreads > kNumThreadsMax) numThreads = kNumThreadsMax;
-  NumThreads = numThreads;
+  _numThreads = numThreads;
   return S_OK;
 }
 #endif
 
+
+Z7_COM7F_IMF(CEncoder::SetCoderPropertiesOpt(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT &prop = coderProps[i];
+    const PROPID propID = propIDs[i];
+    if (propID == NCoderPropID::kExpectedDataSize)
+      if (prop.vt == VT_UI8)
+        _expectedDataSize = prop.uhVal.QuadPart;
+  }
+  return S_OK;
+}
+
 }}
@@ -122,6 +122,7 @@ private:
   Byte *m_MtfArray;
   Byte *m_TempArray;
   UInt32 *m_BlockSorterIndex;
+  UInt32 m_NumSortThreads; // the number of threads for BlockSortMt() in m_BlockSorterIndex buffer
 
 public:
   bool m_OptimizeNumTables;
@@ -148,7 +149,7 @@ public:
   void EncodeBlock2(const Byte *block, UInt32 blockSize, UInt32 numPasses);
 public:
 #ifndef Z7_ST
-  NWindows::CThread Thread;
+  NWindows::CPoolThread Thread;
 
   NWindows::NSynchronization::CAutoResetEvent StreamWasFinishedEvent;
   NWindows::NSynchronization::CAutoResetEvent WaitingWasStartedEvent;
@@ -163,7 +164,7 @@ public:
   THREAD_FUNC_RET_TYPE ThreadFunc();
 #endif
 
-  CThreadInfo(): m_BlockSorterIndex(NULL), m_Block_Base(NULL) {}
+  CThreadInfo(): m_BlockSorterIndex(NULL), m_NumSortThreads(0), m_Block_Base(NULL) {}
   ~CThreadInfo() { Free(); }
   bool Alloc();
   void Free();
@@ -193,6 +194,7 @@ struct CEncProps
 class CEncoder Z7_final:
   public ICompressCoder,
   public ICompressSetCoderProperties,
+  public ICompressSetCoderPropertiesOpt,
  #ifndef Z7_ST
   public ICompressSetCoderMt,
  #endif
@@ -200,6 +202,7 @@ class CEncoder Z7_final:
 {
   Z7_COM_QI_BEGIN2(ICompressCoder)
   Z7_COM_QI_ENTRY(ICompressSetCoderProperties)
+  Z7_COM_QI_ENTRY(ICompressSetCoderPropertiesOpt)
  #ifndef Z7_ST
   Z7_COM_QI_ENTRY(ICompressSetCoderMt)
  #endif
@@ -208,12 +211,15 @@ class CEncoder Z7_final:
 
   Z7_IFACE_COM7_IMP(ICompressCoder)
   Z7_IFACE_COM7_IMP(ICompressSetCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressSetCoderPropertiesOpt)
  #ifndef Z7_ST
   Z7_IFACE_COM7_IMP(ICompressSetCoderMt)
  #endif
 
+  UInt64 _expectedDataSize;
  #ifndef Z7_ST
   UInt32 m_NumThreadsPrev;
+  UInt32 _numThreads; // the number of threads requested by SetNumberOfThreads()
  #endif
 public:
   CInBuffer m_InStream;
@@ -228,7 +234,8 @@ public:
   CThreadInfo *ThreadsInfo;
   NWindows::NSynchronization::CManualResetEvent CanProcessEvent;
   NWindows::NSynchronization::CCriticalSection CS;
-  UInt32 NumThreads;
+  UInt32 NumThreads;     // the number of threads that encode blocks
+  UInt32 NumSortThreads; // the number of threads for BlockSortMt() in each block
   bool MtMode;
   UInt32 NextBlockIndex;
 
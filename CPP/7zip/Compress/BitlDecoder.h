@@ -9,7 +9,22 @@
 
 namespace NBitl {
 
-const unsigned kNumBigValueBits = 8 * 4;
+/* Z7_BITL_USE_64BIT_VALUE : 64-bit bit buffer.
+   CDecoder refills up to 7 bytes from input buffer with one 64-bit read,
+   if there are enough bytes in input buffer (TInByte::GetBufPtr()). */
+
+#if !defined(Z7_BITL_USE_64BIT_VALUE) && !defined(Z7_BITL_NO_64BIT_VALUE) \
+    && defined(MY_CPU_64BIT)
+  #define Z7_BITL_USE_64BIT_VALUE
+#endif
+
+#ifdef Z7_BITL_USE_64BIT_VALUE
+typedef UInt64 CBitValue;
+#else
+typedef UInt32 CBitValue;
+#endif
+
+const unsigned kNumBigValueBits = 8 * sizeof(CBitValue);
 const unsigned kNumValueBytes = 3;
 const unsigned kNumValueBits = 8 * kNumValueBytes;
 const UInt32 kMask = (1 << kNumValueBits) - 1;
@@ -57,18 +72,40 @@ inline unsigned ReverseBits8(unsigned i)
 }
 
 
+#ifdef Z7_BITL_USE_64BIT_VALUE
+
+Z7_FORCE_INLINE
+UInt64 ReverseBits64(UInt64 x)
+{
+#if defined(MY_CPU_ARM64) && defined(Z7_BITL_USE_REVERSE_BITS_INSTRUCTION)
+  asm ("rbit %0,%0" : "+r" (x));
+  return x;
+#else
+  x = Z7_BSWAP64(x);
+  x = ((x >> 4) & UINT64_CONST(0x0f0f0f0f0f0f0f0f)) | ((x & UINT64_CONST(0x0f0f0f0f0f0f0f0f)) << 4);
+  x = ((x >> 2) & UINT64_CONST(0x3333333333333333)) | ((x & UINT64_CONST(0x3333333333333333)) << 2);
+  x = ((x >> 1) & UINT64_CONST(0x5555555555555555)) | ((x & UINT64_CONST(0x5555555555555555)) << 1);
+  return x;
+#endif
+}
+
+#endif
+
+
 /* TInByte must support "Extra Bytes" (bytes that can be read after the end of stream
    TInByte::ReadByte() returns 0xFF after the end of stream
    TInByte::NumExtraBytes contains the number "Extra Bytes"
+   TInByte::GetBufPtr(size) returns pointer to (size) bytes in buffer or NULL
+   TInByte::SkipBufBytes(size) skips (size) bytes that were checked by GetBufPtr(size)
        
-   Bitl decoder can read up to 4 bytes ahead to internal buffer. */
+   Bitl decoder can read up to (kNumBigValueBits / 8) bytes ahead to internal buffer. */
 
 template<class TInByte>
 class CBaseDecoder
 {
 protected:
   unsigned _bitPos;
-  UInt32 _value;
+  CBitValue _value;
   TInByte _stream;
 public:
   bool Create(UInt32 bufSize) { return _stream.Create(bufSize); }
@@ -82,7 +119,7 @@ public:
   }
 
   // the size of portion data in real stream that was already read from this object.
-  // it doesn't include unused data in BitStream object buffer (up to 4 bytes)
+  // it doesn't include unused data in BitStream object buffer (up to (kNumBigValueBits / 8) bytes)
   // it doesn't include unused data in TInByte buffers
   // it doesn't include virtual Extra bytes after the end of real stream data
   UInt64 GetStreamSize() const
@@ -95,20 +132,23 @@ public:
   // the size of virtual data that was read from this object.
   UInt64 GetProcessedSize() const { return _stream.GetProcessedSize() - ((kNumBigValueBits - _bitPos) >> 3); }
 
+  // the number of bits of virtual data that were read from this object.
+  UInt64 GetProcessedBits() const { return _stream.GetProcessedSize() * 8 - (kNumBigValueBits - _bitPos); }
+
   bool ThereAreDataInBitsBuffer() const { return this->_bitPos != kNumBigValueBits; }
   
   Z7_FORCE_INLINE
   void Normalize()
   {
     for (; _bitPos >= 8; _bitPos -= 8)
-      _value = ((UInt32)_stream.ReadByte() << (kNumBigValueBits - _bitPos)) | _value;
+      _value = ((CBitValue)_stream.ReadByte() << (kNumBigValueBits - _bitPos)) | _value;
   }
   
   Z7_FORCE_INLINE
   UInt32 ReadBits(unsigned numBits)
   {
     Normalize();
-    UInt32 res = _value & ((1 << numBits) - 1);
+    UInt32 res = (UInt32)_value & ((1 << numBits) - 1);
     _bitPos += numBits;
     _value >>= numBits;
     return res;
@@ -116,7 +156,7 @@ public:
 
   bool ExtraBitsWereRead() const
   {
-    return (_stream.NumExtraBytes > 4 || kNumBigValueBits - _bitPos < (_stream.NumExtraBytes << 3));
+    return (_stream.NumExtraBytes > kNumBigValueBits / 8 || kNumBigValueBits - _bitPos < (_stream.NumExtraBytes << 3));
   }
   
   bool ExtraBitsWereRead_Fast() const
@@ -126,7 +166,7 @@ public:
     
     // (_stream.NumExtraBytes > 4) is fast overread detection. It's possible that
     // it doesn't return true, if small number of extra bits were read.
-    return (_stream.NumExtraBytes > 4);
+    return (_stream.NumExtraBytes > kNumBigValueBits / 8);
   }
 
   // it must be fixed !!! with extra bits
@@ -136,7 +176,7 @@ public:
 template<class TInByte>
 class CDecoder: public CBaseDecoder<TInByte>
 {
-  UInt32 _normalValue;
+  CBitValue _normalValue;
 
 public:
   void Init()
@@ -144,6 +184,64 @@ public:
     CBaseDecoder<TInByte>::Init();
     _normalValue = 0;
   }
+
+#ifdef Z7_BITL_USE_64BIT_VALUE
+
+  /* (_normalValue) contains available bits in low bits.
+     (this->_value) contains bit-reversed available bits in high bits.
+     Both values can contain some bits of next bytes after available bits.
+     Such bits are same as bits of real stream data, so we can OR them again.
+     Normalize() provides at least 33 available bits. */
+
+  Z7_FORCE_INLINE
+  void Normalize()
+  {
+    if (this->_bitPos < 32)
+      return;
+    const Byte *p = this->_stream.GetBufPtr(8);
+    if (p)
+    {
+      const UInt64 v = GetUi64(p);
+      const unsigned numAvail = kNumBigValueBits - this->_bitPos;
+      _normalValue |= v << numAvail;
+      this->_value |= ReverseBits64(v) >> numAvail;
+      // we read (numBytes) bytes, so (numAvail) will be in range [56, 63]
+      const unsigned numBytes = (this->_bitPos - 1) >> 3;
+      this->_stream.SkipBufBytes(numBytes);
+      this->_bitPos -= numBytes * 8;
+      return;
+    }
+    for (; this->_bitPos >= 8; this->_bitPos -= 8)
+    {
+      const unsigned b = this->_stream.ReadByte();
+      _normalValue |= (CBitValue)b << (kNumBigValueBits - this->_bitPos);
+      this->_value |= (CBitValue)ReverseBits8(b) << (this->_bitPos - 8);
+    }
+  }
+  
+  Z7_FORCE_INLINE
+  UInt32 GetValue(unsigned numBits)
+  {
+    Normalize();
+    return (UInt32)(this->_value >> (kNumBigValueBits - numBits));
+  }
+
+  Z7_FORCE_INLINE
+  UInt32 GetValue_InHigh32bits()
+  {
+    Normalize();
+    return (UInt32)(this->_value >> 32);
+  }
+  
+  Z7_FORCE_INLINE
+  void MovePos(size_t numBits)
+  {
+    this->_bitPos += (unsigned)numBits;
+    _normalValue >>= numBits;
+    this->_value <<= numBits;
+  }
+
+#else
   
   Z7_FORCE_INLINE
   void Normalize()
@@ -176,30 +274,52 @@ public:
     this->_bitPos += (unsigned)numBits;
     _normalValue >>= numBits;
   }
+
+#endif
   
   Z7_FORCE_INLINE
   UInt32 ReadBits(unsigned numBits)
   {
     Normalize();
-    UInt32 res = _normalValue & ((1 << numBits) - 1);
+    UInt32 res = (UInt32)_normalValue & ((1 << numBits) - 1);
     MovePos(numBits);
     return res;
   }
 
-  void AlignToByte() { MovePos((32 - this->_bitPos) & 7); }
+  void AlignToByte() { MovePos((kNumBigValueBits - this->_bitPos) & 7); }
+
+  /* The data bytes can be read directly from (_stream) only if bits buffer is empty.
+     In 64-bit mode we must clear the bits of next bytes in bits buffer also,
+     because these next bytes will be read directly. */
+  Z7_FORCE_INLINE
+  void ClearEmptyBitsBuffer()
+  {
+   #ifdef Z7_BITL_USE_64BIT_VALUE
+    _normalValue = 0;
+    this->_value = 0;
+   #endif
+  }
   
   Z7_FORCE_INLINE
-  Byte ReadDirectByte() { return this->_stream.ReadByte(); }
+  Byte ReadDirectByte()
+  {
+    ClearEmptyBitsBuffer();
+    return this->_stream.ReadByte();
+  }
 
   Z7_FORCE_INLINE
-  size_t ReadDirectBytesPart(Byte *buf, size_t size) { return this->_stream.ReadBytesPart(buf, size); }
+  size_t ReadDirectBytesPart(Byte *buf, size_t size)
+  {
+    ClearEmptyBitsBuffer();
+    return this->_stream.ReadBytesPart(buf, size);
+  }
   
   Z7_FORCE_INLINE
   Byte ReadAlignedByte()
   {
     if (this->_bitPos == kNumBigValueBits)
-      return this->_stream.ReadByte();
-    Byte b = (Byte)(_normalValue & 0xFF);
+      return ReadDirectByte();
+    const Byte b = (Byte)(_normalValue & 0xFF);
     MovePos(8);
     return b;
   }
@@ -209,11 +329,14 @@ public:
   bool ReadAlignedByte_FromBuf(Byte &b)
   {
     if (this->_stream.NumExtraBytes != 0)
-      if (this->_stream.NumExtraBytes >= 4
+      if (this->_stream.NumExtraBytes >= kNumBigValueBits / 8
           || kNumBigValueBits - this->_bitPos <= (this->_stream.NumExtraBytes << 3))
         return false;
     if (this->_bitPos == kNumBigValueBits)
+    {
+      ClearEmptyBitsBuffer();
       return this->_stream.ReadByte_FromBuf(b);
+    }
     b = (Byte)(_normalValue & 0xFF);
     MovePos(8);
     return true;
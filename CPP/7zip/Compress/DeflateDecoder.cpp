@@ -2,12 +2,26 @@
 
 #include "StdAfx.h"
 
+#include "../../../C/Alloc.h"
+
+#include "../Common/StreamUtils.h"
+
+#ifndef Z7_ST
+#include "../../Windows/Synchronization.h"
+#include "../../Windows/Thread.h"
+#endif
+
 #include "DeflateDecoder.h"
 
 namespace NCompress {
 namespace NDeflate {
 namespace NDecoder {
 
+// for HDD-Windows:
+// (1 << 15) - best for reading only prefetch
+// (1 << 22) - best for real reading / writing
+static const UInt32 kInBufSize = 1 << 20;
+
 CCoder::CCoder(bool deflate64Mode):
     _deflateNSIS(false),
     _deflate64Mode(deflate64Mode),
@@ -15,9 +29,77 @@ CCoder::CCoder(bool deflate64Mode):
     _needFinishInput(false),
     _needInitInStream(true),
     _outSizeDefined(false),
-    _outStartPos(0)
+    _accessPoints(NULL),
+    _outStartPos(0),
+    _inStartPos(0)
+   #ifndef Z7_ST
+    , _numThreads(1)
+    , _mtInStreamSpec(NULL)
+   #endif
     {}
 
+CCoder::~CCoder()
+{
+ #ifndef Z7_ST
+  FreeThreads();
+ #endif
+}
+
+
+void CAccessPoints::Init(UInt64 spacing, unsigned numPointsMax)
+{
+  OutOffset = 0;
+  Spacing = spacing;
+  NumPointsMax = numPointsMax;
+  Points.Clear();
+}
+
+CAccessPoint &CAccessPoints::AddNew()
+{
+  if (Points.Size() >= NumPointsMax)
+  {
+    unsigned i;
+    for (i = Points.Size() & ~(unsigned)1; i != 0;)
+    {
+      i -= 2;
+      Points.Delete(i + 1);
+    }
+    Spacing <<= 1;
+  }
+  return Points.AddNew();
+}
+
+int CAccessPoints::Find(UInt64 outPos) const
+{
+  unsigned left = 0, right = Points.Size();
+  while (left != right)
+  {
+    const unsigned mid = (left + right) / 2;
+    if (outPos < Points[mid].OutPos)
+      right = mid;
+    else
+      left = mid + 1;
+  }
+  return (int)left - 1;
+}
+
+
+void CCoder::AddAccessPoint()
+{
+  UInt64 outPos = GetOutProcessedCur();
+  UInt32 size = _deflate64Mode ? kHistorySize64 : kHistorySize32;
+  if (size > outPos)
+    size = (UInt32)outPos;
+  outPos += _accessPoints->OutOffset;
+  CAccessPoint &point = _accessPoints->AddNew();
+  point.InBitPos = m_InBitStream.GetProcessedBits();
+  point.OutPos = outPos;
+  point.Window.Alloc(size);
+  Byte *dest = point.Window;
+  for (UInt32 i = size; i != 0;)
+    *dest++ = m_OutWindowStream.GetByte(--i);
+}
+
 UInt32 CCoder::ReadBits(unsigned numBits)
 {
   return m_InBitStream.ReadBits(numBits);
@@ -28,13 +110,15 @@ Byte CCoder::ReadAlignedByte()
   return m_InBitStream.ReadAlignedByte();
 }
 
-bool CCoder::DecodeLevels(Byte *levels, unsigned numSymbols)
+template <class TLevelDecoder, class TBitDecoder>
+static bool DecodeLevels(const TLevelDecoder &levelDecoder, TBitDecoder *bitStream,
+    Byte *levels, unsigned numSymbols)
 {
   unsigned i = 0;
   
   do
   {
-    unsigned sym = m_LevelDecoder.Decode(&m_InBitStream);
+    unsigned sym = levelDecoder.Decode(bitStream);
     if (sym < kTableDirectLevels)
       levels[i++] = (Byte)sym;
     else
@@ -63,7 +147,7 @@ bool CCoder::DecodeLevels(Byte *levels, unsigned numSymbols)
         symbol = 0;
       }
       
-      num += i + 3 + ReadBits(numBits);
+      num += i + 3 + bitStream->ReadBits(numBits);
       if (num > numSymbols)
         return false;
       do
@@ -76,6 +160,11 @@ bool CCoder::DecodeLevels(Byte *levels, unsigned numSymbols)
   return true;
 }
 
+bool CCoder::DecodeLevels(Byte *levels, unsigned numSymbols)
+{
+  return NDecoder::DecodeLevels(m_LevelDecoder, &m_InBitStream, levels, numSymbols);
+}
+
 #define RIF(x) { if (!(x)) return false; }
 
 bool CCoder::ReadTables(void)
@@ -142,26 +231,716 @@ bool CCoder::ReadTables(void)
     memcpy(levels.distLevels, tmpLevels + numLitLenLevels, _numDistLevels);
   }
   RIF(m_MainDecoder.Build(levels.litLenLevels))
+#ifdef Z7_DEFLATE_DEC_USE_MULTI_SYM
+  _multiSymTable.Build(&m_MainDecoder, kSymbolEndOfBlock);
+#endif
   return m_DistDecoder.Build(levels.distLevels);
 }
 
 
+#ifndef Z7_ST
+
+/* Multi-thread mode uses speculative decoding in two passes.
+   The input data is read to big buffer that is split to chunks for threads.
+   In first pass each thread searches the start of some dynamic block in its chunk:
+   it checks the block header, and it decodes that block to verify it.
+   In second pass each thread decodes blocks from that start position
+   up to the start position that was found for next chunk.
+   The thread doesn't know the history window before its chunk. So references to data
+   before the start of chunk are written to output as markers (positions in window).
+   Then the main thread checks that each chunk has reached the start of next chunk,
+   and it replaces markers with real bytes from the data of previous chunks.
+   If speculative decoding fails, the remaining data is decoded in single-thread mode. */
+
+static const UInt32 kMtChunkSize = 1 << 20;
+static const UInt32 kMtNumThreadsMax = 64;
+// multi-thread mode is not used for small remaining input data
+static const size_t kMtInSizeMin = (size_t)kMtChunkSize * 2;
+// max number of output symbols in chunk
+static const size_t kMtOutSizeMax = (size_t)1 << 24;
+// output symbol (kMtMarker + i) is reference to byte (i) in window of kHistorySize32 bytes before chunk
+static const unsigned kMtMarker = 0x100;
+
+class CMtInByte
+{
+  const Byte *_buf;
+  const Byte *_bufLim;
+  const Byte *_bufBase;
+public:
+  UInt32 NumExtraBytes;
+
+  void SetBuf(const Byte *buf, size_t size) { _bufBase = buf; _bufLim = buf + size; }
+  void Init() { _buf = _bufBase; NumExtraBytes = 0; }
+  void SkipBytes(size_t size) { _buf += size; }
+  UInt64 GetProcessedSize() const { return (size_t)(_buf - _bufBase) + NumExtraBytes; }
+  
+  Z7_FORCE_INLINE
+  const Byte *GetBufPtr(size_t size) const
+  {
+    return (size_t)(_bufLim - _buf) >= size ? _buf : NULL;
+  }
+  
+  Z7_FORCE_INLINE
+  void SkipBufBytes(size_t size) { _buf += size; }
+  
+  Z7_FORCE_INLINE
+  Byte ReadByte()
+  {
+    if (_buf != _bufLim)
+      return *_buf++;
+    NumExtraBytes++;
+    return 0xFF;
+  }
+};
+
+class CMtBitDecoder: public NBitl::CDecoder<CMtInByte>
+{
+public:
+  void SetBuf(const Byte *buf, size_t size) { _stream.SetBuf(buf, size); }
+  void InitAtBitPos(UInt64 bitPos)
+  {
+    Init();
+    _stream.SkipBytes((size_t)(bitPos >> 3));
+    ReadBits((unsigned)bitPos & 7);
+  }
+};
+
+struct CMtThread
+{
+  CMtBitDecoder BitStream;
+  NHuffman::CDecoder<kNumHuffmanBits, kFixedMainTableSize, kNumTableBits_Main> MainDecoder;
+  NHuffman::CDecoder256<kNumHuffmanBits, kFixedDistTableSize, kNumTableBits_Dist> DistDecoder;
+  NHuffman::CDecoder7b<kLevelTableSize> LevelDecoder;
+
+  UInt16 *Out;
+  size_t OutLim;
+  size_t OutPos;        // number of output symbols before (EndBitPos)
+  
+  const Byte *InBuf;
+  size_t InSize;
+  UInt64 SearchStart;   // all positions are bit positions in (InBuf)
+  UInt64 SearchLim;
+  UInt64 StartBitPos;
+  UInt64 EndBitPos;     // the end of last decoded block
+  UInt64 TargetBitPos;
+
+  UInt32 StoredBlockSize;
+  bool StoredMode;
+  bool FinalBlock;      // the last decoded block is final block
+  bool StartFound;
+  bool TargetReached;
+  bool SearchMode;
+  bool Exit;
+
+  NWindows::CPoolThread Thread;
+  NWindows::NSynchronization::CAutoResetEvent StartEvent;
+  NWindows::NSynchronization::CAutoResetEvent FinishedEvent;
+
+  CMtThread(): Out(NULL), OutLim(0), Exit(false) {}
+  ~CMtThread() { ::MidFree(Out); }
+  HRESULT Create();
+  void SetBuf(const Byte *buf, size_t size)
+  {
+    InBuf = buf;
+    InSize = size;
+    BitStream.SetBuf(buf, size);
+  }
+  bool GrowOut(size_t keepSize, size_t size);
+  bool ReadTables(bool strict);
+  bool DecodeBlock(bool strict);
+  void FindStart();
+  void DecodeChunk();
+  THREAD_FUNC_RET_TYPE ThreadFunc();
+};
+
+static THREAD_FUNC_DECL MtThreadFunc(void *p)
+{
+  return ((CMtThread *)p)->ThreadFunc();
+}
+
+HRESULT CMtThread::Create()
+{
+  if (Thread.IsCreated())
+    return S_OK;
+  WRes             wres = StartEvent.CreateIfNotCreated_Reset();
+  if (wres == 0) { wres = FinishedEvent.CreateIfNotCreated_Reset();
+  if (wres == 0) { wres = Thread.Create(MtThreadFunc, this); }}
+  return HRESULT_FROM_WIN32(wres);
+}
+
+THREAD_FUNC_RET_TYPE CMtThread::ThreadFunc()
+{
+  for (;;)
+  {
+    if (StartEvent.Lock() != 0 || Exit)
+      return 0;
+    if (SearchMode)
+      FindStart();
+    else
+      DecodeChunk();
+    FinishedEvent.Set();
+  }
+}
+
+bool CMtThread::GrowOut(size_t keepSize, size_t size)
+{
+  if (size > kMtOutSizeMax)
+    return false;
+  size_t newLim = (OutLim != 0 ? OutLim : (size_t)1 << 20);
+  while (newLim < size)
+    newLim <<= 1;
+  if (newLim > kMtOutSizeMax)
+    newLim = kMtOutSizeMax;
+  UInt16 *p = (UInt16 *)::MidAlloc(newLim * sizeof(UInt16));
+  if (!p)
+    return false;
+  if (keepSize != 0)
+    memcpy(p, Out, keepSize * sizeof(UInt16));
+  ::MidFree(Out);
+  Out = p;
+  OutLim = newLim;
+  return true;
+}
+
+/* (strict) mode is used for the first block in chunk.
+   It doesn't accept fixed block, and it requires complete Huffman codes in dynamic block. */
+
+bool CMtThread::ReadTables(bool strict)
+{
+  FinalBlock = (BitStream.ReadBits(kFinalBlockFieldSize) == NFinalBlockField::kFinalBlock);
+  const UInt32 blockType = BitStream.ReadBits(kBlockTypeFieldSize);
+  if (blockType > NBlockType::kDynamicHuffman)
+    return false;
+  if (strict && blockType == NBlockType::kFixedHuffman)
+    return false;
+
+  if (blockType == NBlockType::kStored)
+  {
+    StoredMode = true;
+    BitStream.AlignToByte();
+    StoredBlockSize = BitStream.ReadBits(kStoredBlockLengthFieldSize);
+    if (StoredBlockSize != (BitStream.ReadBits(kStoredBlockLengthFieldSize) ^ 0xFFFF))
+      return false;
+    return !BitStream.ExtraBitsWereRead();
+  }
+
+  StoredMode = false;
+
+  CLevels levels;
+  if (blockType == NBlockType::kFixedHuffman)
+    levels.SetFixedLevels();
+  else
+  {
+    const unsigned numLitLenLevels = BitStream.ReadBits(kNumLenCodesFieldSize) + kNumLitLenCodesMin;
+    const unsigned numDistLevels = BitStream.ReadBits(kNumDistCodesFieldSize) + kNumDistCodesMin;
+    const unsigned numLevelCodes = BitStream.ReadBits(kNumLevelCodesFieldSize) + kNumLevelCodesMin;
+
+    if (numDistLevels > kDistTableSize32)
+      return false;
+    if (strict && numLitLenLevels > kMainTableSize)
+      return false;
+
+    Byte levelLevels[kLevelTableSize + 1];
+    memset (levelLevels, 0, sizeof(levelLevels));
+    unsigned i = 0;
+    do
+      levelLevels[kCodeLengthAlphabetOrder[i++]] = (Byte)BitStream.ReadBits(kLevelFieldSize);
+    while (i != numLevelCodes);
+
+    if (!LevelDecoder.Build(levelLevels, strict))
+      return false;
+
+    Byte tmpLevels[kFixedMainTableSize + kFixedDistTableSize];
+    if (!DecodeLevels(LevelDecoder, &BitStream, tmpLevels, numLitLenLevels + numDistLevels))
+      return false;
+
+    levels.SubClear();
+    memcpy(levels.litLenLevels, tmpLevels, numLitLenLevels);
+    memcpy(levels.distLevels, tmpLevels + numLitLenLevels, numDistLevels);
+    if (strict && levels.litLenLevels[kSymbolEndOfBlock] == 0)
+      return false;
+  }
+  if (!MainDecoder.Build(levels.litLenLevels,
+      strict ? NHuffman::k_BuildMode_Full : NHuffman::k_BuildMode_Partial))
+    return false;
+  if (!DistDecoder.Build(levels.distLevels))
+    return false;
+  return !BitStream.ExtraBitsWereRead();
+}
+
+// it returns false, if the block can't be decoded from data in buffer
+
+bool CMtThread::DecodeBlock(bool strict)
+{
+  if (!ReadTables(strict))
+    return false;
+  
+  size_t pos = OutPos;
+
+  if (StoredMode)
+  {
+    const size_t size = StoredBlockSize;
+    const size_t inPos = (size_t)(BitStream.GetProcessedBits() >> 3);
+    if (size > InSize - inPos)
+      return false;
+    if (size > OutLim - pos)
+      if (!GrowOut(pos, pos + size))
+        return false;
+    const Byte *src = InBuf + inPos;
+    UInt16 *dest = Out + pos;
+    for (size_t i = 0; i < size; i++)
+      dest[i] = src[i];
+    OutPos = pos + size;
+    BitStream.InitAtBitPos((UInt64)(inPos + size) << 3);
+    return true;
+  }
+
+  UInt16 *out = Out;
+  size_t lim = OutLim;
+
+  for (;;)
+  {
+    if (lim - pos < kMatchMaxLen32)
+    {
+      if (!GrowOut(pos, pos + kMatchMaxLen32))
+        return false;
+      out = Out;
+      lim = OutLim;
+    }
+    if (BitStream.ExtraBitsWereRead_Fast())
+      return false;
+    unsigned sym;
+    Z7_HUFF_DECODE_CHECK(sym, &MainDecoder, kNumHuffmanBits, kNumTableBits_Main, &BitStream, { return false; })
+    if (sym < 0x100)
+    {
+      out[pos++] = (UInt16)sym;
+      continue;
+    }
+    if (sym == kSymbolEndOfBlock)
+      break;
+    sym -= kSymbolMatch;
+    if (sym >= kNumLenSlots)
+      return false;
+    const UInt32 len = kLenStart32[sym] + kMatchMinLen + BitStream.ReadBits(kLenDirectBits32[sym]);
+    Z7_HUFF_DECODE_CHECK(sym, &DistDecoder, kNumHuffmanBits, kNumTableBits_Dist, &BitStream, { return false; })
+    if (sym >= kDistTableSize32)
+      return false;
+    const size_t dist = (size_t)kDistStart[sym] + BitStream.ReadBits(kDistDirectBits[sym]) + 1;
+    UInt16 *dest = out + pos;
+    UInt32 i = 0;
+    if (dist > pos)
+    {
+      // reference to data before the start of chunk
+      const size_t numMarkers = dist - pos;
+      for (; i < len && i < numMarkers; i++)
+        dest[i] = (UInt16)(kMtMarker + kHistorySize32 - (numMarkers - i));
+      for (; i < len; i++)
+        dest[i] = out[i - numMarkers];
+    }
+    else
+    {
+      const UInt16 *src = dest - dist;
+      do
+        dest[i] = src[i];
+      while (++i != len);
+    }
+    pos += len;
+  }
+
+  if (BitStream.ExtraBitsWereRead())
+    return false;
+  OutPos = pos;
+  return true;
+}
+
+void CMtThread::FindStart()
+{
+  StartFound = false;
+  for (UInt64 pos = SearchStart; pos < SearchLim; pos++)
+  {
+    const size_t i = (size_t)(pos >> 3);
+    if (InSize - i < 4)
+      break;
+    const UInt32 v = GetUi32(InBuf + i) >> ((unsigned)pos & 7);
+    const UInt32 blockType = (v >> 1) & 3;
+    if (blockType == NBlockType::kStored)
+    {
+      // we don't accept final stored block, because BFINAL bit can be ambiguous here.
+      // fast check for (LEN == ~NLEN)
+      if ((v & 1) != 0)
+        continue;
+      const size_t k = (size_t)((pos + 3 + 7) >> 3);
+      if (InSize - k < 4 || (GetUi16(InBuf + k) ^ GetUi16(InBuf + k + 2)) != 0xFFFF)
+        continue;
+    }
+    // fast check for dynamic block header: (HLIT <= 29), (HDIST <= 29)
+    else if (blockType != NBlockType::kDynamicHuffman
+        || ((v >> 3) & 0x1f) > 29 || ((v >> 8) & 0x1f) > 29)
+      continue;
+    BitStream.InitAtBitPos(pos);
+    OutPos = 0;
+    if (!DecodeBlock(true))
+      continue;
+    const UInt64 end = BitStream.GetProcessedBits();
+    if (blockType == NBlockType::kStored && !FinalBlock)
+    {
+      // stored block header is weak signature. So we check the header of next block also.
+      if (!ReadTables(false))
+        continue;
+      FinalBlock = false;
+    }
+    StartFound = true;
+    StartBitPos = pos;
+    EndBitPos = end;
+    return;
+  }
+}
+
+/* The position of stored block header is ambiguous, if there are zero padding bits before alignment.
+   So the search can find the header of stored block at another bit position in same byte. */
+
+static bool MtIsSameStoredBlock(const Byte *buf, size_t size, UInt64 bitPos1, UInt64 bitPos2)
+{
+  if (bitPos1 == bitPos2
+      || ((bitPos1 + 3 + 7) >> 3) != ((bitPos2 + 3 + 7) >> 3)
+      || (bitPos1 >> 3) + 2 > size
+      || (bitPos2 >> 3) + 2 > size)
+    return false;
+  const unsigned v1 = (unsigned)(GetUi16(buf + (size_t)(bitPos1 >> 3)) >> ((unsigned)bitPos1 & 7)) & 7;
+  const unsigned v2 = (unsigned)(GetUi16(buf + (size_t)(bitPos2 >> 3)) >> ((unsigned)bitPos2 & 7)) & 7;
+  return v1 == 0 && v2 == 0;
+}
+
+void CMtThread::DecodeChunk()
+{
+  TargetReached = false;
+  if (!StartFound)
+    return;
+  BitStream.InitAtBitPos(EndBitPos);
+  while (!FinalBlock && EndBitPos < TargetBitPos
+      && !MtIsSameStoredBlock(InBuf, InSize, EndBitPos, TargetBitPos))
+  {
+    if (!DecodeBlock(false))
+    {
+      FinalBlock = false;
+      break;
+    }
+    EndBitPos = BitStream.GetProcessedBits();
+  }
+  TargetReached = (EndBitPos == TargetBitPos
+      || MtIsSameStoredBlock(InBuf, InSize, EndBitPos, TargetBitPos));
+}
+
+
+// it replaces output symbols with bytes in same buffer
+
+static bool MtConvertChunk(UInt16 *data, size_t size, const Byte *window, UInt32 windowSize)
+{
+  Byte *dest = (Byte *)(void *)data;
+  const UInt32 markerMin = kMtMarker + kHistorySize32 - windowSize;
+  for (size_t i = 0; i < size; i++)
+  {
+    UInt32 v = data[i];
+    if (v >= kMtMarker)
+    {
+      if (v < markerMin)
+        return false;
+      v = window[v - kMtMarker];
+    }
+    dest[i] = (Byte)v;
+  }
+  return true;
+}
+
+static void MtUpdateWindow(Byte *window, UInt32 &windowSize, const Byte *data, size_t size)
+{
+  if (size >= kHistorySize32)
+  {
+    memcpy(window, data + size - kHistorySize32, kHistorySize32);
+    windowSize = kHistorySize32;
+    return;
+  }
+  memmove(window, window + size, kHistorySize32 - size);
+  memcpy(window + kHistorySize32 - size, data, size);
+  windowSize += (UInt32)size;
+  if (windowSize > kHistorySize32)
+    windowSize = kHistorySize32;
+}
+
+
+Z7_CLASS_IMP_NOQIB_1(
+  CMtInStream
+  , ISequentialInStream
+)
+  size_t _pos;
+  size_t _size;
+public:
+  CByteBuffer Buf;
+  ISequentialInStream *Stream;
+
+  CMtInStream(): _pos(0), _size(0), Stream(NULL) {}
+  void Init(size_t size) { _pos = 0; _size = size; }
+  size_t GetRem() const { return _size - _pos; }
+  void ReadRem(Byte *dest)
+  {
+    memcpy(dest, Buf + _pos, _size - _pos);
+    _pos = _size;
+  }
+};
+
+Z7_COM7F_IMF(CMtInStream::Read(void *data, UInt32 size, UInt32 *processedSize))
+{
+  const size_t rem = _size - _pos;
+  if (rem == 0)
+    return Stream->Read(data, size, processedSize);
+  if (size > rem)
+    size = (UInt32)rem;
+  memcpy(data, Buf + _pos, size);
+  _pos += size;
+  if (processedSize)
+    *processedSize = size;
+  return S_OK;
+}
+
+
+void CCoder::FreeThreads()
+{
+  FOR_VECTOR (i, _mtThreads)
+  {
+    CMtThread &t = _mtThreads[i];
+    if (t.Thread.IsCreated())
+    {
+      t.Exit = true;
+      t.StartEvent.Set();
+      t.Thread.Wait_Close();
+    }
+  }
+  _mtThreads.Clear();
+}
+
+
+/* MtResume() prepares the state for single-thread decoding from the end of multi-thread decoding.
+   (data) is remaining input data that was read in multi-thread mode.
+   That data and unused data from input buffer are moved to (CMtInStream) object,
+   and then single-thread decoder reads them before the data from original stream. */
+
+void CCoder::MtResume(const Byte *data, size_t size, UInt64 bitPos,
+    const Byte *history, UInt32 historySize, UInt64 outProcessed, bool finalBlock)
+{
+  if (!_mtInStreamSpec)
+  {
+    _mtInStreamSpec = new CMtInStream;
+    _mtInStream = _mtInStreamSpec;
+  }
+  CMtInStream &s = *_mtInStreamSpec;
+  const size_t rem = s.GetRem();
+  CByteBuffer buf(size + kInBufSize + rem);
+  if (size != 0)
+    memcpy(buf, data, size);
+  {
+    // the bit buffer is empty here. So we can read aligned bytes from input buffer
+    const size_t lim = size + kInBufSize;
+    while (size != lim && m_InBitStream.ReadAlignedByte_FromBuf(buf[size]))
+      size++;
+  }
+  s.ReadRem(buf + size);
+  size += rem;
+  s.Buf.CopyFrom(buf, size);
+  s.Init(size);
+  s.Stream = m_InStreamRef;
+
+  m_InBitStream.SetStream(_mtInStream);
+  m_InBitStream.Init();
+  _inStartPos = bitPos >> 3;
+  m_InBitStream.ReadBits((unsigned)bitPos & 7);
+
+  if (historySize != 0)
+    m_OutWindowStream.SetHistory(history, historySize);
+  // GetOutProcessedCur() must include the size of data written in multi-thread mode
+  _outStartPos = m_OutWindowStream.GetProcessedSize() - outProcessed;
+  m_FinalBlock = finalBlock;
+  _remainLen = 0;
+  _needReadTable = true;
+}
+
+
+HRESULT CCoder::CodeMt(ISequentialOutStream *outStream, ICompressProgressInfo *progress, UInt64 inStart)
+{
+  const unsigned numThreads = _numThreads;
+  const size_t bufSize = (size_t)kMtChunkSize * numThreads;
+  _mtInBuf.Alloc(bufSize);
+  _mtHistory.Alloc(kHistorySize32);
+  Byte *buf = _mtInBuf;
+  Byte *window = _mtHistory;
+  UInt32 windowSize = 0;
+
+  const UInt64 inPos = GetInputProcessedSize();
+  UInt64 bufOffset = 0; // offset of (buf) data from (inPos)
+  size_t size = 0;
+  UInt64 pos = 0; // bit position in (buf)
+  UInt64 outProcessed = 0;
+  bool readWasFinished = false;
+  bool finalBlock = false;
+
+  for (;;)
+  {
+    {
+      const size_t shift = (size_t)(pos >> 3);
+      size -= shift;
+      memmove(buf, buf + shift, size);
+      bufOffset += shift;
+      pos &= 7;
+    }
+    while (!readWasFinished && size != bufSize)
+    {
+      const size_t cur = m_InBitStream.ReadDirectBytesPart(buf + size, bufSize - size);
+      readWasFinished = (cur == 0);
+      size += cur;
+    }
+    if (size < kMtInSizeMin)
+      break;
+
+    const unsigned numChunks = (unsigned)(size / kMtChunkSize);
+    unsigned i;
+    while (_mtThreads.Size() < numChunks)
+      _mtThreads.AddNew();
+    for (i = 0; i < numChunks; i++)
+    {
+      CMtThread &t = _mtThreads[i];
+      RINOK(t.Create())
+      t.SetBuf(buf, size);
+      t.SearchStart = (UInt64)i * kMtChunkSize * 8;
+      t.SearchLim = (i + 1 == numChunks ? (UInt64)size : (UInt64)(i + 1) * kMtChunkSize) * 8;
+      t.SearchMode = true;
+    }
+    
+    for (i = 1; i < numChunks; i++)
+      _mtThreads[i].StartEvent.Set();
+    for (i = 1; i < numChunks; i++)
+      _mtThreads[i].FinishedEvent.Lock();
+
+    {
+      CMtThread &t = _mtThreads[0];
+      t.StartFound = true;
+      t.StartBitPos = pos;
+      t.EndBitPos = pos;
+      t.OutPos = 0;
+      t.FinalBlock = false;
+    }
+    {
+      // each chunk must be decoded up to the start position of next found chunk
+      UInt64 target = (UInt64)(Int64)-1;
+      for (i = numChunks; i != 0;)
+      {
+        CMtThread &t = _mtThreads[--i];
+        t.TargetBitPos = target;
+        t.SearchMode = false;
+        if (t.StartFound)
+          target = t.StartBitPos;
+      }
+    }
+
+    for (i = 0; i < numChunks; i++)
+      _mtThreads[i].StartEvent.Set();
+    for (i = 0; i < numChunks; i++)
+      _mtThreads[i].FinishedEvent.Lock();
+
+    const UInt64 posStart = pos;
+    
+    for (i = 0; i < numChunks; i++)
+    {
+      CMtThread &t = _mtThreads[i];
+      if (!t.StartFound)
+        continue;
+      if (t.EndBitPos == pos)
+        break;
+      if (t.StartBitPos != pos && !MtIsSameStoredBlock(buf, size, t.StartBitPos, pos))
+        break;
+      const size_t outSize = t.OutPos;
+      if (_outSizeDefined && outSize > _outSize - outProcessed)
+        break;
+      if (!MtConvertChunk(t.Out, outSize, window, windowSize))
+        break;
+      const Byte *data = (const Byte *)(const void *)t.Out;
+      RINOK(WriteStream(outStream, data, outSize))
+      MtUpdateWindow(window, windowSize, data, outSize);
+      outProcessed += outSize;
+      pos = t.EndBitPos;
+      if (t.FinalBlock)
+      {
+        finalBlock = true;
+        break;
+      }
+      if (!t.TargetReached)
+        break;
+    }
+
+    if (finalBlock || pos == posStart)
+      break;
+
+    if (progress)
+    {
+      const UInt64 inSize = inPos + bufOffset + (pos >> 3) - inStart;
+      RINOK(progress->SetRatioInfo(&inSize, &outProcessed))
+    }
+  }
+
+  const size_t shift = (size_t)(pos >> 3);
+  MtResume(buf + shift, size - shift, ((inPos + bufOffset) << 3) + pos,
+      window + kHistorySize32 - windowSize, windowSize, outProcessed, finalBlock);
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CCoder::SetNumberOfThreads(UInt32 numThreads))
+{
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numThreads > kMtNumThreadsMax)
+    numThreads = kMtNumThreadsMax;
+  _numThreads = numThreads;
+  return S_OK;
+}
+
+#endif
+
+
 HRESULT CCoder::InitInStream(bool needInit)
 {
   if (needInit)
   {
-    // for HDD-Windows:
-    // (1 << 15) - best for reading only prefetch
-    // (1 << 22) - best for real reading / writing
-    if (!m_InBitStream.Create(1 << 20))
+    if (!m_InBitStream.Create(kInBufSize))
       return E_OUTOFMEMORY;
+   #ifndef Z7_ST
+    // the stream could be replaced in multi-thread mode
+    m_InBitStream.SetStream(m_InStreamRef);
+    if (_mtInStreamSpec)
+      _mtInStreamSpec->Init(0);
+   #endif
     m_InBitStream.Init();
+    _inStartPos = 0;
     _needInitInStream = false;
   }
   return S_OK;
 }
 
 
+HRESULT CCoder::InitFromAccessPoint(const CAccessPoint &point)
+{
+  RINOK(InitInStream(true))
+  SetOutStreamSizeResume(NULL);
+  if (!m_OutWindowStream.Create(_deflate64Mode ? kHistorySize64: kHistorySize32))
+    return E_OUTOFMEMORY;
+  m_OutWindowStream.SetHistory(point.Window, (UInt32)point.Window.Size());
+  _outStartPos = m_OutWindowStream.GetProcessedSize();
+  ReadBits((unsigned)point.InBitPos & 7);
+  m_FinalBlock = false;
+  _remainLen = 0;
+  _needReadTable = true;
+  return S_OK;
+}
+
+
 HRESULT CCoder::CodeSpec(UInt32 curSize, bool finishInputStream, UInt32 inputProgressLimit)
 {
   if (_remainLen == kLenIdFinished)
@@ -210,6 +989,11 @@ HRESULT CCoder::CodeSpec(UInt32 curSize, bool finishInputStream, UInt32 inputPro
         if (m_InBitStream.GetProcessedSize() - inputStart >= inputProgressLimit)
           return S_OK;
       
+      if (_accessPoints)
+        if (GetOutProcessedCur() + _accessPoints->OutOffset >= _accessPoints->GetNextPos())
+          AddAccessPoint();
+
+
       if (!ReadTables())
         return S_FALSE;
       if (m_InBitStream.ExtraBitsWereRead())
@@ -265,6 +1049,29 @@ HRESULT CCoder::CodeSpec(UInt32 curSize, bool finishInputStream, UInt32 inputPro
       if (m_InBitStream.ExtraBitsWereRead_Fast())
         return S_FALSE;
       unsigned sym;
+#ifdef Z7_DEFLATE_DEC_USE_MULTI_SYM
+      const UInt32 item = _multiSymTable._items[m_InBitStream.GetValue(kNumTableBits_Main)];
+      if (item >= ((UInt32)1 << 28) && curSize >= NHuffman::kMultiSym_NumSymsMax)
+      {
+        const unsigned num = (unsigned)(item >> 28);
+        m_InBitStream.MovePos((item >> 24) & 0xf);
+        m_OutWindowStream.PutByte((Byte)item);
+        if (num > 1)
+        {
+          m_OutWindowStream.PutByte((Byte)(item >> 8));
+          if (num > 2)
+            m_OutWindowStream.PutByte((Byte)(item >> 16));
+        }
+        curSize -= num;
+        continue;
+      }
+      if (item != 0 && item < ((UInt32)1 << 28))
+      {
+        sym = (unsigned)(item & 0xffff);
+        m_InBitStream.MovePos(item >> 24);
+      }
+      else
+#endif
 #if 0
       sym = m_MainDecoder.Decode(&m_InBitStream);
 #else
@@ -381,7 +1188,20 @@ HRESULT CCoder::CodeReal(ISequentialOutStream *outStream, ICompressProgressInfo
   m_OutWindowStream.SetStream(outStream);
   CCoderReleaser flusher(this);
 
-  const UInt64 inStart = _needInitInStream ? 0 : m_InBitStream.GetProcessedSize();
+  const UInt64 inStart = _needInitInStream ? 0 : GetInputProcessedSize();
+
+ #ifndef Z7_ST
+  if (_numThreads > 1 && _remainLen == kLenIdNeedInit
+      && !_deflate64Mode && !_deflateNSIS && !_keepHistory && !_accessPoints)
+  {
+    // it initializes the streams without decoding
+    RINOK(CodeSpec(0, false))
+    if (!m_InBitStream.ThereAreDataInBitsBuffer())
+    {
+      RINOK(CodeMt(outStream, progress, inStart))
+    }
+  }
+ #endif
 
   for (;;)
   {
@@ -408,7 +1228,7 @@ HRESULT CCoder::CodeReal(ISequentialOutStream *outStream, ICompressProgressInfo
 
     if (progress)
     {
-      const UInt64 inSize = m_InBitStream.GetProcessedSize() - inStart;
+      const UInt64 inSize = GetInputProcessedSize() - inStart;
       const UInt64 nowPos64 = GetOutProcessedCur();
       RINOK(progress->SetRatioInfo(&inSize, &nowPos64))
     }
@@ -450,7 +1270,7 @@ Z7_COM7F_IMF(CCoder::SetFinishMode(UInt32 finishMode))
 
 Z7_COM7F_IMF(CCoder::GetInStreamProcessedSize(UInt64 *value))
 {
-  *value = m_InBitStream.GetStreamSize();
+  *value = GetStreamSize();
   return S_OK;
 }
 
@@ -476,6 +1296,10 @@ Z7_COM7F_IMF(CCoder::SetInStream(ISequentialInStream *inStream))
 {
   m_InStreamRef = inStream;
   m_InBitStream.SetStream(inStream);
+ #ifndef Z7_ST
+  if (_mtInStreamSpec)
+    _mtInStreamSpec->Init(0);
+ #endif
   return S_OK;
 }
 
@@ -484,6 +1308,13 @@ Z7_COM7F_IMF(CCoder::ReleaseInStream())
 {
   m_InStreamRef.Release();
   m_InBitStream.ClearStreamPtr();
+ #ifndef Z7_ST
+  if (_mtInStreamSpec)
+  {
+    _mtInStreamSpec->Init(0);
+    _mtInStreamSpec->Stream = NULL;
+  }
+ #endif
   return S_OK;
 }
 
@@ -510,6 +1341,7 @@ Z7_COM7F_IMF(CCoder::SetOutStreamSize(const UInt64 *outSize))
     But later we will call m_InBitStream.Init() again with real buffer pointers
   */
   m_InBitStream.Init();
+  _inStartPos = 0;
   _needInitInStream = true;
   SetOutStreamSizeResume(outSize);
   return S_OK;
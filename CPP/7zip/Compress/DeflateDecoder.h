@@ -3,7 +3,9 @@
 #ifndef ZIP7_INC_DEFLATE_DECODER_H
 #define ZIP7_INC_DEFLATE_DECODER_H
 
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
 
 #include "../ICoder.h"
 
@@ -24,6 +26,46 @@ const int kLenIdNeedInit = -2;
 const unsigned kNumTableBits_Main = 10;
 const unsigned kNumTableBits_Dist = 6;
 
+/* Z7_DEFLATE_DEC_USE_MULTI_SYM : the decoder uses additional table
+   that allows to decode up to 3 short literals per one table lookup.
+   It's not enabled by default, because the table must be rebuilt for each block,
+   and (kNumTableBits_Main) bits are not enough for 2 literals in typical data.
+   So it's not faster than default code in our tests. */
+
+// #define Z7_DEFLATE_DEC_USE_MULTI_SYM
+
+/* Access point allows to continue decoding from the start of some block
+   in the middle of deflate stream. It stores the history window. */
+
+struct CAccessPoint
+{
+  UInt64 InBitPos;   // position of block header in input stream (in bits)
+  UInt64 OutPos;     // position in output stream
+  CByteBuffer Window; // data before (OutPos) that can be referenced by next blocks
+};
+
+class CAccessPoints
+{
+public:
+  UInt64 OutOffset;  // the caller sets the offset of current deflate stream in output stream
+  UInt64 Spacing;
+  unsigned NumPointsMax;
+  CObjectVector<CAccessPoint> Points;
+
+  CAccessPoints(): OutOffset(0), Spacing((UInt64)1 << 20), NumPointsMax(1 << 10) {}
+  void Init(UInt64 spacing, unsigned numPointsMax);
+  UInt64 GetNextPos() const { return Points.IsEmpty() ? Spacing : Points.Back().OutPos + Spacing; }
+  // if there are too many points, it removes half of points and doubles the spacing
+  CAccessPoint &AddNew();
+  // it returns the index of last point with (OutPos <= outPos), or -1
+  int Find(UInt64 outPos) const;
+};
+
+#ifndef Z7_ST
+struct CMtThread;
+class CMtInStream;
+#endif
+
 class CCoder:
   public ICompressCoder,
   public ICompressSetFinishMode,
@@ -31,6 +73,9 @@ class CCoder:
   public ICompressReadUnusedFromInBuf,
   public ICompressSetInStream,
   public ICompressSetOutStreamSize,
+#ifndef Z7_ST
+  public ICompressSetCoderMt,
+#endif
 #ifndef Z7_NO_READ_FROM_CODER
   public ISequentialInStream,
 #endif
@@ -42,6 +87,9 @@ class CCoder:
   Z7_COM_QI_ENTRY(ICompressReadUnusedFromInBuf)
   Z7_COM_QI_ENTRY(ICompressSetInStream)
   Z7_COM_QI_ENTRY(ICompressSetOutStreamSize)
+#ifndef Z7_ST
+  Z7_COM_QI_ENTRY(ICompressSetCoderMt)
+#endif
 #ifndef Z7_NO_READ_FROM_CODER
   Z7_COM_QI_ENTRY(ISequentialInStream)
 #endif
@@ -54,6 +102,9 @@ class CCoder:
 public:
   Z7_IFACE_COM7_IMP(ICompressReadUnusedFromInBuf)
   Z7_IFACE_COM7_IMP(ICompressSetInStream)
+#ifndef Z7_ST
+  Z7_IFACE_COM7_IMP(ICompressSetCoderMt)
+#endif
 private:
   Z7_IFACE_COM7_IMP(ICompressSetOutStreamSize)
 #ifndef Z7_NO_READ_FROM_CODER
@@ -65,6 +116,9 @@ private:
   NCompress::NHuffman::CDecoder<kNumHuffmanBits, kFixedMainTableSize, kNumTableBits_Main> m_MainDecoder;
   NCompress::NHuffman::CDecoder256<kNumHuffmanBits, kFixedDistTableSize, kNumTableBits_Dist> m_DistDecoder;
   NCompress::NHuffman::CDecoder7b<kLevelTableSize> m_LevelDecoder;
+#ifdef Z7_DEFLATE_DEC_USE_MULTI_SYM
+  NCompress::NHuffman::CMultiSymTable<kNumTableBits_Main> _multiSymTable;
+#endif
 
   UInt32 m_StoredBlockSize;
 
@@ -83,15 +137,26 @@ private:
   UInt32 _rep0;
 
   bool _outSizeDefined;
+  CAccessPoints *_accessPoints;
   CMyComPtr<ISequentialInStream> m_InStreamRef;
   UInt64 _outSize;
   UInt64 _outStartPos;
+  UInt64 _inStartPos; // size of input data that was processed before current (m_InBitStream) initialization
+
+ #ifndef Z7_ST
+  UInt32 _numThreads;
+  CObjectVector<CMtThread> _mtThreads;
+  CByteBuffer _mtInBuf;
+  CByteBuffer _mtHistory;
+  CMtInStream *_mtInStreamSpec;
+  CMyComPtr<ISequentialInStream> _mtInStream;
+ #endif
 
-  void SetOutStreamSizeResume(const UInt64 *outSize);
   UInt64 GetOutProcessedCur() const { return m_OutWindowStream.GetProcessedSize() - _outStartPos; }
 
   UInt32 ReadBits(unsigned numBits);
 
+  void AddAccessPoint();
   bool DecodeLevels(Byte *levels, unsigned numSymbols);
   bool ReadTables();
   
@@ -111,15 +176,24 @@ private:
   friend class CCoderReleaser;
 
   HRESULT CodeSpec(UInt32 curSize, bool finishInputStream, UInt32 inputProgressLimit = 0);
+
+ #ifndef Z7_ST
+  void FreeThreads();
+  void MtResume(const Byte *data, size_t size, UInt64 bitPos,
+      const Byte *history, UInt32 historySize, UInt64 outProcessed, bool finalBlock);
+  HRESULT CodeMt(ISequentialOutStream *outStream, ICompressProgressInfo *progress, UInt64 inStart);
+ #endif
 public:
 
   CCoder(bool deflate64Mode);
-  virtual ~CCoder() {}
+  virtual ~CCoder();
 
   void SetNsisMode(bool nsisMode) { _deflateNSIS = nsisMode; }
 
   void Set_KeepHistory(bool keepHistory) { _keepHistory = keepHistory; }
   void Set_NeedFinishInput(bool needFinishInput) { _needFinishInput = needFinishInput; }
+  // if (accessPoints) is set, the decoder adds access points to it at block boundaries
+  void Set_AccessPoints(CAccessPoints *accessPoints) { _accessPoints = accessPoints; }
 
   bool IsFinished() const { return _remainLen == kLenIdFinished; }
   bool IsFinalBlock() const { return m_FinalBlock; }
@@ -129,6 +203,10 @@ public:
 public:
   HRESULT CodeResume(ISequentialOutStream *outStream, const UInt64 *outSize, ICompressProgressInfo *progress);
   HRESULT InitInStream(bool needInit);
+  void SetOutStreamSizeResume(const UInt64 *outSize);
+  /* InitFromAccessPoint() prepares the decoder to continue decoding from access point.
+     The caller must set input stream to byte position (point.InBitPos >> 3) before. */
+  HRESULT InitFromAccessPoint(const CAccessPoint &point);
 
   void AlignToByte() { m_InBitStream.AlignToByte(); }
   Byte ReadAlignedByte();
@@ -140,10 +218,10 @@ public:
   bool InputEofError() const { return m_InBitStream.ExtraBitsWereRead(); }
 
   // size of used real data from input stream
-  UInt64 GetStreamSize() const { return m_InBitStream.GetStreamSize(); }
+  UInt64 GetStreamSize() const { return _inStartPos + m_InBitStream.GetStreamSize(); }
 
   // size of virtual input stream processed
-  UInt64 GetInputProcessedSize() const { return m_InBitStream.GetProcessedSize(); }
+  UInt64 GetInputProcessedSize() const { return _inStartPos + m_InBitStream.GetProcessedSize(); }
 };
 
 class CCOMCoder     : public CCoder { public: CCOMCoder(): CCoder(false) {} };
@@ -8,6 +8,13 @@
 #include "../../Common/ComTry.h"
 
 #include "../Common/CWrappers.h"
+#include "../Common/StreamObjects.h"
+#include "../Common/StreamUtils.h"
+
+#ifndef Z7_ST
+#include "../../Windows/Synchronization.h"
+#include "../../Windows/Thread.h"
+#endif
 
 #include "DeflateEncoder.h"
 
@@ -113,6 +120,7 @@ void CEncProps::Normalize()
 
 void CCoder::SetProps(const CEncProps *props2)
 {
+  _props = *props2;
   CEncProps props = *props2;
   props.Normalize();
 
@@ -149,6 +157,9 @@ CCoder::CCoder(bool deflate64Mode):
   m_Created(false),
   m_Deflate64Mode(deflate64Mode),
   m_Tables(NULL)
+ #ifndef Z7_ST
+  , _numThreads(1)
+ #endif
 {
   m_MatchMaxLen = deflate64Mode ? kMatchMaxLen64 : kMatchMaxLen32;
   m_NumLenCombinations = deflate64Mode ? kNumLenSymbols64 : kNumLenSymbols32;
@@ -236,7 +247,16 @@ HRESULT CCoder::BaseSetEncoderProperties2(const PROPID *propIDs, const PROPVARIA
       case NCoderPropID::kMatchFinderCycles: props.mc = v; break;
       case NCoderPropID::kAlgorithm: props.algo = (int)v; break;
       case NCoderPropID::kLevel: props.Level = (int)v; break;
-      case NCoderPropID::kNumThreads: break;
+      case NCoderPropID::kNumThreads:
+      {
+       #ifndef Z7_ST
+        const UInt32 kNumThreadsMax = 64;
+        if (v < 1) v = 1;
+        if (v > kNumThreadsMax) v = kNumThreadsMax;
+        _numThreads = v;
+       #endif
+        break;
+      }
       default: return E_INVALIDARG;
     }
   }
@@ -254,6 +274,9 @@ void CCoder::Free()
 
 CCoder::~CCoder()
 {
+ #ifndef Z7_ST
+  FreeThreads();
+ #endif
   Free();
   MatchFinder_Free(&_lzInWindow, &g_AlignedAlloc);
 }
@@ -966,8 +989,8 @@ void CCoder::CodeBlock(unsigned tableIndex, bool finalBlock)
 }
 
 
-HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
-    const UInt64 * /* inSize */ , const UInt64 * /* outSize */ , ICompressProgressInfo *progress)
+HRESULT CCoder::CodeChunk(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    UInt32 dictSize, bool finalChunk, ICompressProgressInfo *progress)
 {
   m_CheckStatic = (m_NumPasses != 1 || m_NumDivPasses != 1);
   m_IsMultiPass = (m_CheckStatic || (m_NumPasses != 1 || m_NumDivPasses != 1));
@@ -990,6 +1013,15 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
   m_OutStream.SetStream(outStream);
   m_OutStream.Init();
 
+  if (dictSize != 0)
+  {
+    // the dictionary prefix is inserted to match finder, but it's not encoded
+    if (_btMode)
+      Bt3Zip_MatchFinder_Skip(&_lzInWindow, dictSize);
+    else
+      Hc3Zip_MatchFinder_Skip(&_lzInWindow, dictSize);
+  }
+
   m_OptimumEndIndex = m_OptimumCurrentIndex = 0;
 
   CTables &t = m_Tables[1];
@@ -1002,7 +1034,7 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
     t.BlockSizeRes = kBlockUncompressedSizeThreshold;
     m_SecondPass = false;
     GetBlockPrice(1, m_NumDivPasses);
-    CodeBlock(1, Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) == 0);
+    CodeBlock(1, finalChunk && Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) == 0);
     nowPos += m_Tables[1].BlockSizeRes;
     if (progress != NULL)
     {
@@ -1011,6 +1043,12 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
     }
   }
   while (Inline_MatchFinder_GetNumAvailableBytes(&_lzInWindow) != 0);
+
+  if (!finalChunk)
+  {
+    // empty stored block aligns the stream to byte boundary, so next chunk can be appended
+    WriteStoreBlock(0, 0, false);
+  }
   
   if (_seqInStream.Res != S_OK)
     return _seqInStream.Res;
@@ -1020,6 +1058,182 @@ HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *ou
   return m_OutStream.Flush();
 }
 
+#ifndef Z7_ST
+
+/* Multi-thread mode splits input stream to chunks that are encoded independently.
+   Each chunk is encoded with the tail of previous chunk as dictionary prefix,
+   and each non-final chunk is finished by empty stored block.
+   So the concatenation of encoded chunks is one deflate stream. */
+
+static const UInt32 kMtChunkSize = 1 << 20;
+
+struct CMtThread
+{
+  CCoder *Encoder;
+  CByteBuffer InBuf;
+  UInt32 DictSize;
+  UInt32 InSize;
+  bool FinalChunk;
+  bool Exit;
+  bool IsBusy;
+  HRESULT Result;
+  CMyComPtr2_Create<ISequentialInStream, CBufInStream> InStream;
+  CMyComPtr2_Create<ISequentialOutStream, CDynBufSeqOutStream> OutStream;
+
+  NWindows::CPoolThread Thread;
+  NWindows::NSynchronization::CAutoResetEvent StartEvent;
+  NWindows::NSynchronization::CAutoResetEvent FinishedEvent;
+
+  CMtThread(): Encoder(NULL), Exit(false), IsBusy(false) {}
+  ~CMtThread() { delete Encoder; }
+  HRESULT Create(CCoder *coder);
+  void Code();
+  THREAD_FUNC_RET_TYPE ThreadFunc();
+};
+
+static THREAD_FUNC_DECL MtThreadFunc(void *p)
+{
+  return ((CMtThread *)p)->ThreadFunc();
+}
+
+HRESULT CMtThread::Create(CCoder *coder)
+{
+  if (!Encoder)
+    Encoder = new CCoder(coder->m_Deflate64Mode);
+  Encoder->SetProps(&coder->_props);
+  InBuf.Alloc((coder->m_Deflate64Mode ? kHistorySize64 : kHistorySize32) + kMtChunkSize);
+  if (Thread.IsCreated())
+    return S_OK;
+  WRes             wres = StartEvent.CreateIfNotCreated_Reset();
+  if (wres == 0) { wres = FinishedEvent.CreateIfNotCreated_Reset();
+  if (wres == 0) { wres = Thread.Create(MtThreadFunc, this); }}
+  return HRESULT_FROM_WIN32(wres);
+}
+
+void CMtThread::Code()
+{
+  InStream->Init(InBuf, (size_t)DictSize + InSize);
+  OutStream->Init();
+  try { Result = Encoder->CodeChunk(InStream, OutStream, DictSize, FinalChunk, NULL); }
+  catch(const COutBufferException &e) { Result = e.ErrorCode; }
+  catch(...) { Result = E_FAIL; }
+}
+
+THREAD_FUNC_RET_TYPE CMtThread::ThreadFunc()
+{
+  for (;;)
+  {
+    if (StartEvent.Lock() != 0 || Exit)
+      return 0;
+    Code();
+    FinishedEvent.Set();
+  }
+}
+
+void CCoder::FreeThreads()
+{
+  FOR_VECTOR (i, _mtThreads)
+  {
+    CMtThread &t = _mtThreads[i];
+    if (t.Thread.IsCreated())
+    {
+      t.Exit = true;
+      t.StartEvent.Set();
+      t.Thread.Wait_Close();
+    }
+  }
+  _mtThreads.Clear();
+}
+
+HRESULT CCoder::CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    ICompressProgressInfo *progress)
+{
+  const unsigned numThreads = _numThreads;
+  while (_mtThreads.Size() < numThreads)
+    _mtThreads.AddNew();
+
+  const UInt32 historySize = m_Deflate64Mode ? kHistorySize64 : kHistorySize32;
+  const Byte *prevData = NULL;
+  size_t prevSize = 0;
+  UInt64 inProcessed = 0;
+  UInt64 outProcessed = 0;
+  HRESULT res = S_OK;
+  bool readWasFinished = false;
+  unsigned numBusy = 0;
+
+  for (unsigned i = 0;; i = (i + 1 == numThreads ? 0 : i + 1))
+  {
+    CMtThread &t = _mtThreads[i];
+    
+    if (t.IsBusy)
+    {
+      // the chunks are written in the order of reading
+      t.FinishedEvent.Lock();
+      t.IsBusy = false;
+      numBusy--;
+      if (res == S_OK)
+        res = t.Result;
+      if (res == S_OK)
+      {
+        const size_t size = t.OutStream->GetSize();
+        res = WriteStream(outStream, t.OutStream->GetBuffer(), size);
+        inProcessed += t.InSize;
+        outProcessed += size;
+      }
+      if (res == S_OK && progress)
+        res = progress->SetRatioInfo(&inProcessed, &outProcessed);
+    }
+
+    if (res != S_OK || readWasFinished)
+    {
+      if (numBusy == 0)
+        break;
+      continue;
+    }
+
+    res = t.Create(this);
+    if (res != S_OK)
+      continue;
+
+    UInt32 dictSize = 0;
+    if (prevSize != 0)
+    {
+      dictSize = (prevSize < historySize) ? (UInt32)prevSize : historySize;
+      memcpy(t.InBuf, prevData + prevSize - dictSize, dictSize);
+    }
+    size_t size = kMtChunkSize;
+    res = ReadStream(inStream, t.InBuf + dictSize, &size);
+    if (res != S_OK)
+      continue;
+    readWasFinished = (size != kMtChunkSize);
+    
+    t.DictSize = dictSize;
+    t.InSize = (UInt32)size;
+    t.FinalChunk = readWasFinished;
+    prevData = t.InBuf;
+    prevSize = dictSize + size;
+
+    t.IsBusy = true;
+    numBusy++;
+    t.StartEvent.Set();
+  }
+
+  return res;
+}
+
+#endif
+
+
+HRESULT CCoder::CodeReal(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */ , const UInt64 * /* outSize */ , ICompressProgressInfo *progress)
+{
+ #ifndef Z7_ST
+  if (_numThreads > 1)
+    return CodeMt(inStream, outStream, progress);
+ #endif
+  return CodeChunk(inStream, outStream, 0, true, progress);
+}
+
 HRESULT CCoder::BaseCode(ISequentialInStream *inStream, ISequentialOutStream *outStream,
     const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress)
 {
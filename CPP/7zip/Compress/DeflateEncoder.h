@@ -6,6 +6,7 @@
 #include "../../../C/LzFind.h"
 
 #include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
 
 #include "../ICoder.h"
 
@@ -36,6 +37,10 @@ const UInt32 kNumOpts = kNumOptsBase + kMatchMaxLen;
 
 class CCoder;
 
+#ifndef Z7_ST
+struct CMtThread;
+#endif
+
 struct CTables: public CLevels
 {
   bool UseSubBlocks;
@@ -129,6 +134,12 @@ public:
 
   UInt32 m_MatchFinderCycles;
 
+  CEncProps _props;
+ #ifndef Z7_ST
+  UInt32 _numThreads;
+  CObjectVector<CMtThread> _mtThreads;
+ #endif
+
   void GetMatches();
   void MovePos(UInt32 num);
   UInt32 Backward(UInt32 &backRes, UInt32 cur);
@@ -162,6 +173,17 @@ public:
   void CodeBlock(unsigned tableIndex, bool finalBlock);
 
   void SetProps(const CEncProps *props2);
+
+  /* CodeChunk() encodes the data after (dictSize) bytes of dictionary prefix.
+     if (!finalChunk), the stream is finished by empty stored block at byte boundary. */
+  HRESULT CodeChunk(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      UInt32 dictSize, bool finalChunk, ICompressProgressInfo *progress);
+ #ifndef Z7_ST
+  friend struct CMtThread;
+  void FreeThreads();
+  HRESULT CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      ICompressProgressInfo *progress);
+ #endif
 public:
   CCoder(bool deflate64Mode = false);
   ~CCoder();
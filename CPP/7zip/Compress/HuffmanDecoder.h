@@ -426,6 +426,66 @@ struct CDecoder256: public CDecoderBase
   <Byte, UInt16, UInt32, kNumBitsMax, m_NumSymbols, kNumTableBits> {};
 
 
+/* CMultiSymTable is additional table for CDecoderBase table.
+   Each item contains up to 3 short symbols (literals with (sym < numSyms))
+   that can be decoded from (kNumTableBits) bits of input stream:
+     bits [ 0..23] : symbols
+     bits [24..27] : number of bits of all symbols
+     bits [28..31] : number of symbols
+   If first symbol is not literal, the item contains only that symbol:
+     bits [ 0..15] : symbol
+     bits [24..27] : number of bits of symbol
+     bits [28..31] : 0
+   If (item == 0), the code is longer than (kNumTableBits),
+   and CDecoderBase code must be used for decoding. */
+
+const unsigned kMultiSym_NumSymsMax = 3;
+
+template <unsigned kNumTableBits>
+struct CMultiSymTable
+{
+  UInt32 _items[1 << kNumTableBits];
+
+  template <class TDecoder>
+  void Build(const TDecoder *huf, unsigned numSyms) throw()
+  {
+    const UInt32 kMask = ((UInt32)1 << kNumTableBits) - 1;
+    for (UInt32 i = 0; i <= kMask; i++)
+    {
+      UInt32 item = 0;
+      unsigned numBits = 0;
+      unsigned k;
+      for (k = 0; k < kMultiSym_NumSymsMax; k++)
+      {
+        // low (numBits) bits of (v1) are unknown here,
+        // so we accept only the symbols with (len <= kNumTableBits - numBits)
+        const UInt32 v1 = (i << numBits) & kMask;
+        const UInt32 v0 = v1 << (32 - kNumTableBits);
+        UNUSED_VAR(v0)
+        if (Z7_HUFF_TABLE_COMPARE(huf, kNumTableBits, v0, v1))
+          break;
+        const unsigned len = huf->_u._lens[v1];
+        const unsigned sym = huf->_symbols[v1];
+        if (len > kNumTableBits - numBits)
+          break;
+        if (sym >= numSyms)
+        {
+          if (k == 0)
+          {
+            item = sym;
+            numBits = len;
+          }
+          break;
+        }
+        item |= (UInt32)sym << (8 * k);
+        numBits += len;
+      }
+      _items[i] = item | ((UInt32)numBits << 24) | ((UInt32)k << 28);
+    }
+  }
+};
+
+
 template <unsigned numSymbols>
 class CDecoder7b
 {
@@ -0,0 +1,273 @@
+// Lz4Decoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/CpuArch.h"
+#include "../../../C/Lz4Dec.h"
+
+#include "../Common/StreamUtils.h"
+
+#include "Lz4Decoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+bool CFrameInfo::Parse(const Byte *p, size_t size)
+{
+  if (size < kMinHeaderSize)
+    return false;
+
+  // Check magic
+  if (GetUi32(p) != kMagic)
+    return false;
+  p += 4;
+
+  const Byte flg = p[0];
+  const Byte bd = p[1];
+  p += 2;
+
+  // Version must be 01
+  if ((flg >> 6) != 1)
+    return false;
+
+  // Reserved bit in FLG must be 0
+  if (flg & 2)
+    return false;
+
+  // Reserved bits in BD must be 0
+  if (bd & 0x8F)
+    return false;
+
+  BlockIndependence = (flg & 0x20) != 0;
+  BlockChecksum = (flg & 0x10) != 0;
+  ContentSizePresent = (flg & 0x08) != 0;
+  ContentChecksum = (flg & 0x04) != 0;
+  DictIdPresent = (flg & 0x01) != 0;
+
+  const unsigned blockMaxSizeCode = (bd >> 4) & 7;
+  if (blockMaxSizeCode < 4)
+    return false; // Reserved values
+  BlockMaxSize = (UInt32)1 << (8 + blockMaxSizeCode * 2);
+
+  ContentSize = 0;
+  DictId = 0;
+
+  unsigned headerSize = kMagicSize + 2;
+
+  if (ContentSizePresent)
+  {
+    headerSize += 8;
+    if (size < headerSize + 1)
+      return false;
+    ContentSize = GetUi64(p);
+    p += 8;
+  }
+
+  if (DictIdPresent)
+  {
+    headerSize += 4;
+    if (size < headerSize + 1)
+      return false;
+    DictId = GetUi32(p);
+    // p += 4;
+  }
+
+  // Header checksum (we don't verify it, just skip)
+  return true;
+}
+
+
+// it returns S_FALSE, if there is not enough data in stream
+static HRESULT ReadData(ISequentialInStream *stream, void *data, size_t size, UInt64 &inProcessed)
+{
+  size_t processed = size;
+  RINOK(ReadStream(stream, data, &processed))
+  inProcessed += processed;
+  return processed == size ? S_OK : S_FALSE;
+}
+
+#define READ_DATA(data, size) \
+  { const HRESULT res = ReadData(inStream, data, size, InProcessed); \
+    if (res != S_OK) { if (res != S_FALSE) return res; NeedMoreInput = true; return S_OK; } }
+
+
+HRESULT CDecoder::Decode(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    ICompressProgressInfo *progress)
+{
+  IsArc = false;
+  NeedMoreInput = false;
+  DataError = false;
+  InProcessed = 0;
+  OutProcessed = 0;
+
+  Byte header[kMaxHeaderSize];
+  {
+    size_t processed = kMinHeaderSize;
+    RINOK(ReadStream(inStream, header, &processed))
+    InProcessed = processed;
+    if (processed != kMinHeaderSize || !FrameInfo.Parse(header, kMinHeaderSize))
+      return S_OK;
+  }
+  IsArc = true;
+  {
+    const unsigned headerSize = FrameInfo.GetHeaderSize();
+    if (headerSize > kMinHeaderSize)
+    {
+      READ_DATA(header + kMinHeaderSize, headerSize - kMinHeaderSize)
+      FrameInfo.Parse(header, headerSize);
+    }
+  }
+
+  const UInt32 blockMaxSize = FrameInfo.BlockMaxSize;
+  if (_inBuf.Size() < blockMaxSize)
+  {
+    _inBuf.Free();
+    _outBuf.Free();
+    _inBuf.Alloc(blockMaxSize);
+    _outBuf.Alloc(blockMaxSize);
+  }
+
+  /* if (inStream) is memory mapped file stream,
+     we decode blocks directly from stream memory without copying to (_inBuf). */
+  CMyComPtr<IStreamGetRangePtr> inRangePtr;
+  CMyComPtr<IInStream> inSeekStream;
+  {
+    inStream->QueryInterface(IID_IStreamGetRangePtr, (void **)&inRangePtr);
+    if (inRangePtr)
+    {
+      inStream->QueryInterface(IID_IInStream, (void **)&inSeekStream);
+      UInt64 pos = 0;
+      const Byte *data;
+      UInt32 avail;
+      if (!inSeekStream
+          || inSeekStream->Seek(0, STREAM_SEEK_CUR, &pos) != S_OK
+          // the stream can support the interface, but the data is not mapped
+          || inRangePtr->GetRangePtr(pos, 0, &data, &avail) != S_OK)
+        inRangePtr.Release();
+      else
+      {
+        CMyComPtr<IStreamSetAccessHint> accessHint;
+        inStream->QueryInterface(IID_IStreamSetAccessHint, (void **)&accessHint);
+        if (accessHint)
+          accessHint->SetAccessHint(pos, 0, NStreamAccessHint::kSequential);
+      }
+    }
+  }
+
+  for (;;)
+  {
+    Byte temp[4];
+    READ_DATA(temp, 4)
+    UInt32 blockSize = GetUi32(temp);
+
+    // End mark
+    if (blockSize == 0)
+    {
+      // Skip content checksum if present
+      if (FrameInfo.ContentChecksum)
+        READ_DATA(temp, 4)
+      return S_OK;
+    }
+
+    const bool uncompressed = (blockSize & 0x80000000) != 0;
+    blockSize &= 0x7FFFFFFF;
+
+    if (blockSize > blockMaxSize)
+    {
+      DataError = true;
+      return S_OK;
+    }
+
+    const Byte *blockData = NULL;
+    if (inRangePtr)
+    {
+      UInt64 pos;
+      RINOK(inSeekStream->Seek(0, STREAM_SEEK_CUR, &pos))
+      const Byte *data;
+      UInt32 avail;
+      if (inRangePtr->GetRangePtr(pos, blockSize, &data, &avail) == S_OK
+          && avail == blockSize)
+      {
+        RINOK(inSeekStream->Seek((Int64)blockSize, STREAM_SEEK_CUR, NULL))
+        InProcessed += blockSize;
+        blockData = data;
+      }
+    }
+    if (!blockData)
+    {
+      READ_DATA(_inBuf, blockSize)
+      blockData = _inBuf;
+    }
+
+    // Skip block checksum if present
+    if (FrameInfo.BlockChecksum)
+      READ_DATA(temp, 4)
+
+    const Byte *outData;
+    SizeT outLen;
+
+    if (uncompressed)
+    {
+      outData = blockData;
+      outLen = blockSize;
+    }
+    else
+    {
+      outLen = blockMaxSize;
+      SizeT srcConsumed;
+      const SRes sres = Lz4Dec_DecodeBlock(blockData, blockSize, _outBuf, &outLen, &srcConsumed);
+      if (sres != SZ_OK)
+      {
+        DataError = true;
+        return S_OK;
+      }
+      outData = _outBuf;
+    }
+
+    if (outLen != 0)
+    {
+      if (outStream)
+      {
+        RINOK(WriteStream(outStream, outData, outLen))
+      }
+      OutProcessed += outLen;
+    }
+
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&InProcessed, &OutProcessed))
+    }
+  }
+}
+
+
+// the properties in 7z archive are not required for decoding
+Z7_COM7F_IMF(CDecoder::SetDecoderProperties2(const Byte * /* prop */, UInt32 /* size */))
+{
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress))
+{
+  try
+  {
+    const HRESULT res = Decode(inStream, outStream, progress);
+    if (res != S_OK)
+      return res;
+    if (!IsArc || NeedMoreInput || DataError)
+      return S_FALSE;
+    return S_OK;
+  }
+  catch(...) { return E_OUTOFMEMORY; }
+}
+
+
+Z7_COM7F_IMF(CDecoder::GetInStreamProcessedSize(UInt64 *value))
+{
+  *value = InProcessed;
+  return S_OK;
+}
+
+}}
@@ -0,0 +1,101 @@
+// Lz4Decoder.h
+
+#ifndef ZIP7_INC_LZ4_DECODER_H
+#define ZIP7_INC_LZ4_DECODER_H
+
+#include "../../Common/MyBuffer.h"
+#include "../../Common/MyCom.h"
+
+#include "../ICoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+/*
+LZ4 Frame format:
+  Magic: 4 bytes (0x184D2204 little-endian)
+  Frame Descriptor:
+    FLG byte:
+      bits 7-6: Version (must be 01)
+      bit 5: Block Independence
+      bit 4: Block Checksum flag
+      bit 3: Content Size flag
+      bit 2: Content Checksum flag
+      bit 1: Reserved (0)
+      bit 0: DictID flag
+    BD byte:
+      bit 7: Reserved (0)
+      bits 6-4: Block Max Size (4=64KB, 5=256KB, 6=1MB, 7=4MB)
+      bits 3-0: Reserved (0)
+    [Content Size: 8 bytes if Content Size flag set]
+    [DictID: 4 bytes if DictID flag set]
+    Header Checksum: 1 byte (XXH32 >> 8)
+  Data Blocks:
+    Block Size: 4 bytes (bit 31: 1=uncompressed, bits 30-0: size)
+    Block Data: size bytes
+    [Block Checksum: 4 bytes if Block Checksum flag set]
+    ... repeat until Block Size == 0
+  End Mark: 4 bytes (0x00000000)
+  [Content Checksum: 4 bytes if Content Checksum flag set]
+*/
+
+const UInt32 kMagic = 0x184D2204;
+const unsigned kMagicSize = 4;
+const unsigned kMinHeaderSize = 7;  // magic + FLG + BD + HC
+const unsigned kMaxHeaderSize = 19; // magic + FLG + BD + content_size(8) + dictid(4) + HC
+
+struct CFrameInfo
+{
+  bool BlockIndependence;
+  bool BlockChecksum;
+  bool ContentSizePresent;
+  bool ContentChecksum;
+  bool DictIdPresent;
+  UInt32 BlockMaxSize;
+  UInt64 ContentSize;
+  UInt32 DictId;
+
+  unsigned GetHeaderSize() const
+  {
+    return kMagicSize + 2 + (ContentSizePresent ? 8 : 0) + (DictIdPresent ? 4 : 0) + 1;
+  }
+
+  bool Parse(const Byte *p, size_t size);
+};
+
+
+class CDecoder Z7_final:
+  public ICompressCoder,
+  public ICompressSetDecoderProperties2,
+  public ICompressGetInStreamProcessedSize,
+  public CMyUnknownImp
+{
+  Z7_COM_UNKNOWN_IMP_3(
+      ICompressCoder,
+      ICompressSetDecoderProperties2,
+      ICompressGetInStreamProcessedSize)
+  Z7_IFACE_COM7_IMP(ICompressCoder)
+  Z7_IFACE_COM7_IMP(ICompressSetDecoderProperties2)
+  Z7_IFACE_COM7_IMP(ICompressGetInStreamProcessedSize)
+
+  CByteBuffer _inBuf;
+  CByteBuffer _outBuf;
+public:
+  CFrameInfo FrameInfo;
+
+  bool IsArc;
+  bool NeedMoreInput;
+  bool DataError;
+
+  UInt64 InProcessed;
+  UInt64 OutProcessed;
+
+  /* Decode() decodes one LZ4 frame.
+     It returns S_OK for data errors. Check the (IsArc), (NeedMoreInput), (DataError) flags. */
+  HRESULT Decode(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      ICompressProgressInfo *progress);
+};
+
+}}
+
+#endif
@@ -0,0 +1,199 @@
+// Lz4Encoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/Alloc.h"
+#include "../../../C/LzmaEnc.h"
+
+#include "../Common/CWrappers.h"
+#include "../Common/StreamUtils.h"
+
+#include "Lz4Encoder.h"
+
+namespace NCompress {
+
+namespace NLzma {
+
+HRESULT SetLzmaProp(PROPID propID, const PROPVARIANT &prop, CLzmaEncProps &ep);
+
+}
+
+namespace NLz4 {
+
+CEncoder::CEncoder()
+{
+  _encoder = NULL;
+  _inputProcessed = 0;
+  Lz4EncProps_Init(&_props);
+  _encoder = Lz4Enc_Create(&g_AlignedAlloc, &g_BigAlloc);
+  if (!_encoder)
+    throw 1;
+}
+
+CEncoder::~CEncoder()
+{
+  if (_encoder)
+    Lz4Enc_Destroy(_encoder);
+}
+
+
+/* we reuse the parser of LZMA properties for
+   match finder (HC levels) properties */
+
+HRESULT SetLz4Prop(PROPID propID, const PROPVARIANT &prop, CLz4EncProps &ep)
+{
+  switch (propID)
+  {
+    case NCoderPropID::kLevel:
+    {
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      const UInt32 v = prop.ulVal;
+      ep.level = (int)(v > LZ4_ENC_LEVEL_MAX ? LZ4_ENC_LEVEL_MAX : v);
+      return S_OK;
+    }
+    case NCoderPropID::kBlockSize:
+    case NCoderPropID::kBlockSize2:
+    {
+      UInt64 v;
+      if (prop.vt == VT_UI4)
+        v = prop.ulVal;
+      else if (prop.vt == VT_UI8)
+        v = prop.uhVal.QuadPart;
+      else
+        return E_INVALIDARG;
+      if (v > LZ4_ENC_GET_BLOCK_SIZE(LZ4_ENC_BLOCK_SIZE_CODE_MAX))
+        return E_INVALIDARG;
+      ep.blockSize = (UInt32)v;
+      return S_OK;
+    }
+    case NCoderPropID::kCheckSize:
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      if (prop.ulVal != 0 && prop.ulVal != 4)
+        return E_INVALIDARG;
+      ep.contentChecksum = (prop.ulVal != 0);
+      return S_OK;
+    case NCoderPropID::kNumThreads:
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      ep.numTotalThreads = (int)prop.ulVal;
+      return S_OK;
+    case NCoderPropID::kNumThreadGroups:
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      ep.numThreadGroups = (unsigned)prop.ulVal;
+      return S_OK;
+    case NCoderPropID::kReduceSize:
+      if (prop.vt != VT_UI8)
+        return E_INVALIDARG;
+      ep.reduceSize = prop.uhVal.QuadPart;
+      return S_OK;
+    default:
+      break;
+  }
+
+  CLzmaEncProps lp;
+  LzmaEncProps_Init(&lp);
+  lp.btMode = ep.btMode;
+  lp.mc = ep.mc;
+  lp.fb = ep.fb;
+
+  switch (propID)
+  {
+    case NCoderPropID::kMatchFinder:
+    case NCoderPropID::kMatchFinderCycles:
+    case NCoderPropID::kNumFastBytes:
+      RINOK(NLzma::SetLzmaProp(propID, prop, lp))
+      break;
+    default:
+      // we ignore properties of other methods (lc, lp, pb, ...)
+      return S_OK;
+  }
+
+  ep.btMode = lp.btMode;
+  ep.mc = lp.mc;
+  ep.fb = lp.fb;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CEncoder::SetCoderProperties(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  CLz4EncProps props;
+  Lz4EncProps_Init(&props);
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    RINOK(SetLz4Prop(propIDs[i], coderProps[i], props))
+  }
+  RINOK(SResToHRESULT(Lz4Enc_SetProps(_encoder, &props)))
+  _props = props;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CEncoder::SetCoderPropertiesOpt(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT &prop = coderProps[i];
+    const PROPID propID = propIDs[i];
+    if (propID == NCoderPropID::kExpectedDataSize)
+      if (prop.vt == VT_UI8)
+        Lz4Enc_SetDataSize(_encoder, prop.uhVal.QuadPart);
+  }
+  return S_OK;
+}
+
+
+/* coder properties for 7z archive (5 bytes) in the format of lz4 plugins:
+     Byte[0] : major version of lz4 library
+     Byte[1] : minor version of lz4 library
+     Byte[2] : level
+     Byte[3], Byte[4] : reserved (zeros)
+   the decoder doesn't need these properties. */
+
+Z7_COM7F_IMF(CEncoder::WriteCoderProperties(ISequentialOutStream *outStream))
+{
+  CLz4EncProps props = _props;
+  Lz4EncProps_Normalize(&props);
+  Byte p[5];
+  p[0] = 1;
+  p[1] = 9;
+  p[2] = (Byte)props.level;
+  p[3] = 0;
+  p[4] = 0;
+  return WriteStream(outStream, p, sizeof(p));
+}
+
+
+#define RET_IF_WRAP_ERROR(wrapRes, sRes, sResErrorCode) \
+  if (wrapRes != S_OK /* && (sRes == SZ_OK || sRes == sResErrorCode) */) return wrapRes;
+
+Z7_COM7F_IMF(CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress))
+{
+  CSeqInStreamWrap inWrap;
+  CSeqOutStreamWrap outWrap;
+  CCompressProgressWrap progressWrap;
+
+  inWrap.Init(inStream);
+  outWrap.Init(outStream);
+  progressWrap.Init(progress);
+
+  const SRes res = Lz4Enc_Encode(_encoder, &outWrap.vt, &inWrap.vt,
+      progress ? &progressWrap.vt : NULL);
+
+  _inputProcessed = inWrap.Processed;
+
+  RET_IF_WRAP_ERROR(inWrap.Res, res, SZ_ERROR_READ)
+  RET_IF_WRAP_ERROR(outWrap.Res, res, SZ_ERROR_WRITE)
+  RET_IF_WRAP_ERROR(progressWrap.Res, res, SZ_ERROR_PROGRESS)
+
+  return SResToHRESULT(res);
+}
+
+}}
@@ -0,0 +1,47 @@
+// Lz4Encoder.h
+
+#ifndef ZIP7_INC_LZ4_ENCODER_H
+#define ZIP7_INC_LZ4_ENCODER_H
+
+#include "../../../C/Lz4Enc.h"
+
+#include "../../Common/MyCom.h"
+
+#include "../ICoder.h"
+
+namespace NCompress {
+namespace NLz4 {
+
+class CEncoder Z7_final:
+  public ICompressCoder,
+  public ICompressSetCoderProperties,
+  public ICompressWriteCoderProperties,
+  public ICompressSetCoderPropertiesOpt,
+  public CMyUnknownImp
+{
+  Z7_COM_UNKNOWN_IMP_4(
+      ICompressCoder,
+      ICompressSetCoderProperties,
+      ICompressWriteCoderProperties,
+      ICompressSetCoderPropertiesOpt)
+  Z7_IFACE_COM7_IMP(ICompressCoder)
+public:
+  Z7_IFACE_COM7_IMP(ICompressSetCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressWriteCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressSetCoderPropertiesOpt)
+
+  CLz4EncHandle _encoder;
+  CLz4EncProps _props;
+  UInt64 _inputProcessed;
+
+  CEncoder();
+  ~CEncoder();
+
+  UInt64 GetInputProcessedSize() const { return _inputProcessed; }
+};
+
+HRESULT SetLz4Prop(PROPID propID, const PROPVARIANT &prop, CLz4EncProps &ep);
+
+}}
+
+#endif
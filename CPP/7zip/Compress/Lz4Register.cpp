@@ -0,0 +1,22 @@
+// Lz4Register.cpp
+
+#include "StdAfx.h"
+
+#include "../Common/RegisterCodec.h"
+
+#include "Lz4Decoder.h"
+
+#ifndef Z7_EXTRACT_ONLY
+#include "Lz4Encoder.h"
+#endif
+
+namespace NCompress {
+namespace NLz4 {
+
+REGISTER_CODEC_E(LZ4,
+    CDecoder(),
+    CEncoder(),
+    0x4F71104,
+    "LZ4")
+
+}}
@@ -12,3 +12,16 @@ void CLzOutWindow::Init(bool solid) throw()
   ErrorCode = S_OK;
   #endif
 }
+
+void CLzOutWindow::SetHistory(const Byte *data, UInt32 size) throw()
+{
+  COutBuffer::Init();
+  memcpy(_buf, data, size);
+  _pos = size;
+  if (size == _bufSize)
+  {
+    _pos = 0;
+    _overDict = true;
+  }
+  _streamPos = _pos;
+}
@@ -13,6 +13,8 @@ class CLzOutWindow: public COutBuffer
 {
 public:
   void Init(bool solid = false) throw();
+  // it sets (data) as history data that was written before. (size <= _bufSize)
+  void SetHistory(const Byte *data, UInt32 size) throw();
   
   // distance >= 0, len > 0,
   bool CopyBlock(UInt32 distance, UInt32 len)
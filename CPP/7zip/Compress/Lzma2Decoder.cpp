@@ -18,6 +18,7 @@ CDecoder::CDecoder():
       _dec(NULL)
     , _inProcessed(0)
     , _prop(0xFF)
+    , _needPresetDict(false)
     , _finishMode(false)
     , _inBufSize(1 << 20)
     , _outStep(1 << 20)
@@ -37,13 +38,48 @@ CDecoder::~CDecoder()
 Z7_COM7F_IMF(CDecoder::SetInBufSize(UInt32 , UInt32 size)) { _inBufSize = size; return S_OK; }
 Z7_COM7F_IMF(CDecoder::SetOutBufSize(UInt32 , UInt32 size)) { _outStep = size; return S_OK; }
 
+/* LZMA2 properties with preset dictionary contain additional byte of flags */
+static const Byte kPropsFlag_PresetDict = 1 << 0;
+
 Z7_COM7F_IMF(CDecoder::SetDecoderProperties2(const Byte *prop, UInt32 size))
 {
-  if (size != 1)
+  if (size != 1 && size != 2)
     return E_NOTIMPL;
   if (prop[0] > 40)
     return E_NOTIMPL;
+  bool needPresetDict = false;
+  if (size == 2)
+  {
+    if ((prop[1] & ~kPropsFlag_PresetDict) != 0)
+      return E_NOTIMPL;
+    needPresetDict = ((prop[1] & kPropsFlag_PresetDict) != 0);
+  }
   _prop = prop[0];
+  _needPresetDict = needPresetDict;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CDecoder::SetPresetDictionary(const Byte *data, UInt32 size))
+{
+  if (size == 0)
+    _presetDict.Free();
+  else
+    _presetDict.CopyFrom(data, size);
+  return S_OK;
+}
+
+
+HRESULT CDecoder::SetPresetDictToDecoder()
+{
+  if (!_needPresetDict)
+  {
+    Lzma2DecMt_SetPresetDict(_dec, NULL, 0);
+    return S_OK;
+  }
+  if (_presetDict.Size() == 0)
+    return E_NOTIMPL;
+  Lzma2DecMt_SetPresetDict(_dec, _presetDict, _presetDict.Size());
   return S_OK;
 }
 
@@ -96,6 +132,8 @@ Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream
       return E_OUTOFMEMORY;
   }
 
+  RINOK(SetPresetDictToDecoder())
+
   CLzma2DecMtProps props;
   Lzma2DecMtProps_Init(&props);
 
@@ -107,7 +145,8 @@ Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream
     props.numThreads = 1;
     UInt32 numThreads = _numThreads;
 
-    if (_tryMt && numThreads >= 1)
+    // the stream with preset dictionary is decoded in single thread
+    if (_tryMt && numThreads >= 1 && !_needPresetDict)
     {
       const UInt64 useLimit = _memUsage;
       const UInt32 dictSize = LZMA2_DIC_SIZE_FROM_PROP_FULL(_prop);
@@ -230,6 +269,8 @@ Z7_COM7F_IMF(CDecoder::SetOutStreamSize(const UInt64 *outSize))
 
   _inWrap.Init(_inStream);
 
+  RINOK(SetPresetDictToDecoder())
+
   const SRes res = Lzma2DecMt_Init(_dec, _prop, &props, outSize, _finishMode, &_inWrap.vt);
 
   if (res != SZ_OK)
@@ -5,6 +5,8 @@
 
 #include "../../../C/Lzma2DecMt.h"
 
+#include "../../Common/MyBuffer.h"
+
 #include "../Common/CWrappers.h"
 
 namespace NCompress {
@@ -16,6 +18,7 @@ class CDecoder Z7_final:
   public ICompressSetFinishMode,
   public ICompressGetInStreamProcessedSize,
   public ICompressSetBufSize,
+  public ICompressSetPresetDictionary,
  #ifndef Z7_NO_READ_FROM_CODER
   public ICompressSetInStream,
   public ICompressSetOutStreamSize,
@@ -32,6 +35,7 @@ class CDecoder Z7_final:
   Z7_COM_QI_ENTRY(ICompressSetFinishMode)
   Z7_COM_QI_ENTRY(ICompressGetInStreamProcessedSize)
   Z7_COM_QI_ENTRY(ICompressSetBufSize)
+  Z7_COM_QI_ENTRY(ICompressSetPresetDictionary)
  #ifndef Z7_NO_READ_FROM_CODER
   Z7_COM_QI_ENTRY(ICompressSetInStream)
   Z7_COM_QI_ENTRY(ICompressSetOutStreamSize)
@@ -49,6 +53,7 @@ class CDecoder Z7_final:
   Z7_IFACE_COM7_IMP(ICompressSetFinishMode)
   Z7_IFACE_COM7_IMP(ICompressGetInStreamProcessedSize)
   Z7_IFACE_COM7_IMP(ICompressSetBufSize)
+  Z7_IFACE_COM7_IMP(ICompressSetPresetDictionary)
  #ifndef Z7_NO_READ_FROM_CODER
   Z7_IFACE_COM7_IMP(ICompressSetOutStreamSize)
   Z7_IFACE_COM7_IMP(ICompressSetInStream)
@@ -62,9 +67,13 @@ class CDecoder Z7_final:
   CLzma2DecMtHandle _dec;
   UInt64 _inProcessed;
   Byte _prop;
+  bool _needPresetDict;
   int _finishMode;
   UInt32 _inBufSize;
   UInt32 _outStep;
+  CByteBuffer _presetDict;
+
+  HRESULT SetPresetDictToDecoder();
 
  #ifndef Z7_ST
   int _tryMt;
@@ -49,6 +49,17 @@ HRESULT SetLzma2Prop(PROPID propID, const PROPVARIANT &prop, CLzma2EncProps &lzm
         return E_INVALIDARG;
       break;
     }
+    case NCoderPropID::kBlockPrefixSize:
+    {
+      if (prop.vt == VT_UI4)
+        lzma2Props.blockPrefixSize = prop.ulVal;
+      else if (prop.vt == VT_UI8)
+        lzma2Props.blockPrefixSize = (prop.uhVal.QuadPart < ((UInt32)1 << 31) ?
+            (UInt32)prop.uhVal.QuadPart : ((UInt32)1 << 31));
+      else
+        return E_INVALIDARG;
+      break;
+    }
     case NCoderPropID::kNumThreads:
       if (prop.vt != VT_UI4)
         return E_INVALIDARG;
@@ -98,10 +109,26 @@ Z7_COM7F_IMF(CEncoder::SetCoderPropertiesOpt(const PROPID *propIDs,
 }
 
 
+/* LZMA2 properties with preset dictionary contain additional byte of flags */
+static const Byte kPropsFlag_PresetDict = 1 << 0;
+
+Z7_COM7F_IMF(CEncoder::SetPresetDictionary(const Byte *data, UInt32 size))
+{
+  if (size == 0)
+    _presetDict.Free();
+  else
+    _presetDict.CopyFrom(data, size);
+  return SResToHRESULT(Lzma2Enc_SetPresetDict(_encoder,
+      size == 0 ? NULL : (const Byte *)_presetDict, size));
+}
+
+
 Z7_COM7F_IMF(CEncoder::WriteCoderProperties(ISequentialOutStream *outStream))
 {
-  const Byte prop = Lzma2Enc_WriteProperties(_encoder);
-  return WriteStream(outStream, &prop, 1);
+  Byte props[2];
+  props[0] = Lzma2Enc_WriteProperties(_encoder);
+  props[1] = kPropsFlag_PresetDict;
+  return WriteStream(outStream, props, _presetDict.Size() != 0 ? 2 : 1);
 }
 
 
@@ -5,6 +5,7 @@
 
 #include "../../../C/Lzma2Enc.h"
 
+#include "../../Common/MyBuffer.h"
 #include "../../Common/MyCom.h"
 
 #include "../ICoder.h"
@@ -12,14 +13,16 @@
 namespace NCompress {
 namespace NLzma2 {
 
-Z7_CLASS_IMP_COM_4(
+Z7_CLASS_IMP_COM_5(
   CEncoder
   , ICompressCoder
   , ICompressSetCoderProperties
   , ICompressWriteCoderProperties
   , ICompressSetCoderPropertiesOpt
+  , ICompressSetPresetDictionary
 )
   CLzma2EncHandle _encoder;
+  CByteBuffer _presetDict;
 public:
   CEncoder();
   ~CEncoder();
@@ -29,6 +29,8 @@ struct CEncProps
   void Normalize(int level);
 };
 
+HRESULT SetPpmdProp(PROPID propID, const PROPVARIANT &prop, CEncProps &props, int &level);
+
 Z7_CLASS_IMP_COM_3(
   CEncoder
   , ICompressCoder
@@ -0,0 +1,49 @@
+// Compress/PpmdMtConst.h
+
+#ifndef ZIP7_INC_COMPRESS_PPMD_MT_CONST_H
+#define ZIP7_INC_COMPRESS_PPMD_MT_CONST_H
+
+/*
+PPMD-MT : block-parallel variant of PPMD (Ppmd7z) method.
+
+Coder properties (13 or 14 bytes):
+  Byte    Order
+  UInt32  MemSize
+  UInt32  BlockSize   : maximum unpacked size of block
+  UInt32  PrefixSize  : the size of data that primes the model of each block
+  Byte    Flags       : optional. If it's not present, (Flags == 0).
+                        The encoder writes it only if (Flags != 0).
+
+Stream:
+  Block[]
+  EndMarker : (UnpackSize == 0, PackSize == 0)
+
+Block:
+  UInt32  UnpackSize  : (0 < UnpackSize <= BlockSize)
+  UInt32  PackSize
+  Byte    Data[PackSize] : Ppmd7z stream without end mark
+
+Each block is coded with new model, that is initialized with (Order, MemSize).
+If (PrefixSize != 0) and (kFlag_SharedPrefix) is not set, the model is
+updated with last (PrefixSize) bytes of preceding data before the coding of block.
+If (kFlag_SharedPrefix) is set, the model of each block except of first block
+is updated with first (PrefixSize) bytes of stream (shared model).
+All blocks except of last block contain (BlockSize) bytes.
+So the blocks can be decoded in parallel, if (PrefixSize == 0) or (kFlag_SharedPrefix) is set.
+All numbers are little-endian.
+*/
+
+namespace NCompress {
+namespace NPpmdMt {
+
+const unsigned kPropsSize = 13;
+const unsigned kPropsSize_WithFlags = kPropsSize + 1;
+const unsigned kFlag_SharedPrefix = 1 << 0;
+const unsigned kBlockHeaderSize = 8;
+
+const UInt32 kBlockSizeMin = (UInt32)1 << 16;
+const UInt32 kBlockSizeMax = (UInt32)1 << 30;
+
+}}
+
+#endif
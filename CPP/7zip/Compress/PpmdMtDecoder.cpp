@@ -0,0 +1,763 @@
+// PpmdMtDecoder.cpp
+
+#include "StdAfx.h"
+
+#include <string.h>
+
+#include "../../../C/Alloc.h"
+#include "../../../C/CpuArch.h"
+
+#include "../../Common/Defs.h"
+
+#include "../Common/StreamUtils.h"
+
+#include "PpmdMtDecoder.h"
+
+namespace NCompress {
+namespace NPpmdMt {
+
+static const UInt32 kBufSize = (UInt32)1 << 16;
+static const UInt32 kInBufSize = (UInt32)1 << 20;
+
+CDecoder::CDecoder():
+    _order(PPMD7_MIN_ORDER),
+    _finishMode(false),
+    _outSizeDefined(false),
+    _sharedPrefix(false),
+    _memSize(0),
+    _blockSize(0),
+    _prefixSize(0),
+    _outSize(0),
+    _outProcessed(0),
+    _inProcessed(0),
+    _outStream(NULL),
+    _outBuf(NULL),
+    _prefixBuf(NULL),
+    _prefixBufSize(0)
+   #ifndef Z7_ST
+    , _numThreads(1)
+    , _memUsage((UInt64)(sizeof(size_t)) << 28)
+    , _mtDec_WasConstructed(false)
+    , _mtBlocks(NULL)
+    , _sharedRes(SZ_OK)
+    , _sharedSignaled(false)
+   #endif
+{
+  Ppmd7_Construct(&_ppmd);
+}
+
+CDecoder::~CDecoder()
+{
+ #ifndef Z7_ST
+  if (_mtDec_WasConstructed)
+    MtDec_Destruct(&_mtDec);
+  delete []_mtBlocks;
+ #endif
+  ::MidFree(_outBuf);
+  ::MidFree(_prefixBuf);
+  Ppmd7_Free(&_ppmd, &g_BigAlloc);
+}
+
+
+Z7_COM7F_IMF(CDecoder::SetDecoderProperties2(const Byte *props, UInt32 size))
+{
+  if (size < kPropsSize)
+    return E_INVALIDARG;
+  if (size > kPropsSize_WithFlags)
+    return E_NOTIMPL;
+  const unsigned order = props[0];
+  const UInt32 memSize = GetUi32(props + 1);
+  const UInt32 blockSize = GetUi32(props + 5);
+  const UInt32 prefixSize = GetUi32(props + 9);
+  const unsigned flags = (size == kPropsSize_WithFlags) ? props[kPropsSize] : 0;
+  if ((flags & ~(unsigned)kFlag_SharedPrefix) != 0)
+    return E_NOTIMPL;
+  if (order < PPMD7_MIN_ORDER ||
+      order > PPMD7_MAX_ORDER ||
+      memSize < PPMD7_MIN_MEM_SIZE ||
+      memSize > PPMD7_MAX_MEM_SIZE ||
+      blockSize < kBlockSizeMin ||
+      blockSize > kBlockSizeMax ||
+      prefixSize > blockSize)
+    return E_NOTIMPL;
+  _order = (Byte)order;
+  _memSize = memSize;
+  _blockSize = blockSize;
+  _prefixSize = prefixSize;
+  _sharedPrefix = ((flags & kFlag_SharedPrefix) != 0 && prefixSize != 0);
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CDecoder::SetFinishMode(UInt32 finishMode))
+{
+  _finishMode = (finishMode != 0);
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CDecoder::GetInStreamProcessedSize(UInt64 *value))
+{
+  *value = _inProcessed;
+  return S_OK;
+}
+
+
+HRESULT CDecoder::WriteData(const Byte *data, size_t size)
+{
+  bool overflow = false;
+  if (_outSizeDefined)
+  {
+    const UInt64 rem = _outSize - _outProcessed;
+    if (size > rem)
+    {
+      size = (size_t)rem;
+      overflow = true;
+    }
+  }
+  _outProcessed += size;
+  RINOK(WriteStream(_outStream, data, size))
+  return overflow ? S_FALSE : S_OK;
+}
+
+
+// it keeps the last (prefixSize) bytes of decoded data at the end of (prefix) buffer
+static void UpdatePrefix(Byte *prefix, size_t prefixSize, const Byte *data, size_t size)
+{
+  if (size >= prefixSize)
+    memcpy(prefix, data + size - prefixSize, prefixSize);
+  else
+  {
+    memmove(prefix, prefix + size, prefixSize - size);
+    memcpy(prefix + prefixSize - size, data, size);
+  }
+}
+
+
+#define CHECK_EXTRA_ERROR \
+    if (_inStream.Extra) \
+      return (_inStream.Res != S_OK ? _inStream.Res : S_FALSE);
+
+HRESULT CDecoder::CodeSt(ISequentialInStream *inStream, ICompressProgressInfo *progress)
+{
+  if (!_outBuf)
+  {
+    _outBuf = (Byte *)::MidAlloc(kBufSize);
+    if (!_outBuf)
+      return E_OUTOFMEMORY;
+  }
+  if (_prefixBufSize != _prefixSize)
+  {
+    ::MidFree(_prefixBuf);
+    _prefixBufSize = 0;
+    _prefixBuf = NULL;
+    if (_prefixSize != 0)
+    {
+      _prefixBuf = (Byte *)::MidAlloc(_prefixSize);
+      if (!_prefixBuf)
+        return E_OUTOFMEMORY;
+    }
+    _prefixBufSize = _prefixSize;
+  }
+  if (!_inStream.Alloc(kInBufSize))
+    return E_OUTOFMEMORY;
+  if (!Ppmd7_Alloc(&_ppmd, _memSize, &g_BigAlloc))
+    return E_OUTOFMEMORY;
+
+  _inStream.Stream = inStream;
+  _inStream.Init();
+
+  UInt32 prefixLen = 0;
+  // in shared mode (_prefixBuf) collects first data of stream for shared model
+  bool useShared = false;
+
+  for (;;)
+  {
+    Byte header[kBlockHeaderSize];
+    for (unsigned i = 0; i < kBlockHeaderSize; i++)
+      header[i] = _inStream.ReadByte();
+    CHECK_EXTRA_ERROR
+    const UInt32 unpackSize = GetUi32(header);
+    const UInt32 packSize = GetUi32(header + 4);
+    if (unpackSize == 0)
+      return (packSize == 0) ? S_OK : S_FALSE;
+    if (unpackSize > _blockSize)
+      return S_FALSE;
+
+    const UInt64 packStart = _inStream.GetProcessed();
+
+    if (useShared)
+      _shared.InitModel(&_ppmd);
+    else
+    {
+      Ppmd7_Init(&_ppmd, _order);
+      if (prefixLen != 0 && !_sharedPrefix)
+        Ppmd7z_UpdateWithSymbols(&_ppmd, _prefixBuf + _prefixSize - prefixLen, _prefixBuf + _prefixSize);
+    }
+    _ppmd.rc.dec.Stream = &_inStream.vt;
+    if (!Ppmd7z_RangeDec_Init(&_ppmd.rc.dec))
+      return S_FALSE;
+    CHECK_EXTRA_ERROR
+
+    UInt32 rem = unpackSize;
+    do
+    {
+      UInt32 size = kBufSize;
+      if (size > rem)
+        size = rem;
+      UInt32 i;
+      for (i = 0; i < size; i++)
+      {
+        const int sym = Ppmd7z_DecodeSymbol(&_ppmd);
+        if (_inStream.Extra || sym < 0)
+          break;
+        _outBuf[i] = (Byte)sym;
+      }
+      RINOK(WriteData(_outBuf, i))
+      CHECK_EXTRA_ERROR
+      if (i != size)
+        return S_FALSE;
+      if (_sharedPrefix)
+      {
+        if (!useShared && prefixLen != _prefixSize)
+        {
+          UInt32 cur = _prefixSize - prefixLen;
+          if (cur > size)
+            cur = size;
+          memcpy(_prefixBuf + prefixLen, _outBuf, cur);
+          prefixLen += cur;
+        }
+      }
+      else if (_prefixSize != 0)
+      {
+        UpdatePrefix(_prefixBuf, _prefixSize, _outBuf, size);
+        prefixLen += size;
+        if (prefixLen > _prefixSize)
+          prefixLen = _prefixSize;
+      }
+      rem -= size;
+      if (progress)
+      {
+        const UInt64 inProcessed = _inStream.GetProcessed();
+        RINOK(progress->SetRatioInfo(&inProcessed, &_outProcessed))
+      }
+    }
+    while (rem != 0);
+
+    if (!Ppmd7z_RangeDec_IsFinishedOK(&_ppmd.rc.dec)
+        || _inStream.GetProcessed() - packStart != packSize)
+      return S_FALSE;
+
+    if (_sharedPrefix && !useShared)
+    {
+      RINOK(SResToHRESULT(_shared.Train(_prefixBuf, prefixLen, _memSize, _order)))
+      useShared = true;
+    }
+  }
+}
+
+
+
+#ifndef Z7_ST
+
+/* ---------- MT decoding ----------
+If (PrefixSize == 0), each block is independent.
+Parse() splits the stream at block boundaries using block headers,
+and each MT-block contains one PPMD block (header and packed data).
+Code() collects packed data of block and decodes it to the buffer of thread.
+In shared mode the thread of first block trains the shared model
+after decoding of first (PrefixSize) bytes, and the threads of
+another blocks wait for that model in Code().
+Write() of first block signals the error, if Code() didn't train the model.
+*/
+
+CMtBlock::~CMtBlock()
+{
+  ::MidFree(PackBuf);
+  ::MidFree(OutBuf);
+  Ppmd7_Free(&Ppmd, &g_BigAlloc);
+}
+
+
+Z7_COM7F_IMF(CDecoder::SetNumberOfThreads(UInt32 numThreads))
+{
+  _numThreads = numThreads;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CDecoder::SetMemLimit(UInt64 memUsage))
+{
+  _memUsage = memUsage;
+  return S_OK;
+}
+
+
+unsigned CDecoder::GetNumMtDecThreads() const
+{
+  // the blocks depend on preceding data
+  if (_prefixSize != 0 && !_sharedPrefix)
+    return 1;
+  // there is only one block
+  if (_outSizeDefined && _outSize <= _blockSize)
+    return 1;
+  UInt32 numThreads = _numThreads;
+  if (numThreads > MTDEC_THREADS_MAX)
+    numThreads = MTDEC_THREADS_MAX;
+  // model + output buffer + packed data + input buffers of MtDec
+  const UInt64 threadMemUsage = (UInt64)_memSize
+      + _blockSize + (_blockSize >> 1)
+      + ((UInt64)kBufSize << 2);
+  UInt64 memUsage = _memUsage;
+  if (_sharedPrefix)
+  {
+    if (memUsage <= _memSize)
+      return 1;
+    memUsage -= _memSize;
+  }
+  const UInt64 numThreads_Mem = memUsage / threadMemUsage;
+  if (numThreads > numThreads_Mem)
+    numThreads = (UInt32)numThreads_Mem;
+  return numThreads;
+}
+
+
+void CDecoder::MtParse(unsigned coderIndex, CMtDecCallbackInfo *cc)
+{
+  CMtBlock &t = _mtBlocks[coderIndex];
+  CMtParser &p = _mtParser;
+
+  if (cc->startCall)
+  {
+    t.HasBlock = false;
+    t.EndMarker = false;
+    t.ParseError = false;
+    t.NeedMoreInput = false;
+    t.CodeRes = SZ_OK;
+    t.UnpackSize = 0;
+    t.PackSize = 0;
+    t.PackPos = 0;
+    t.BlockIndex = p.NumBlocks++;
+    t.HeaderSkip = kBlockHeaderSize;
+    p.HeaderPos = 0;
+    p.PackRem = 0;
+  }
+
+  cc->state = MTDEC_PARSE_CONTINUE;
+
+  const Byte *src = cc->src;
+  const size_t size = cc->srcSize;
+  size_t i = 0;
+
+  while (i != size)
+  {
+    if (p.HeaderPos != kBlockHeaderSize)
+    {
+      p.Header[p.HeaderPos++] = src[i++];
+      if (p.HeaderPos != kBlockHeaderSize)
+        continue;
+      const UInt32 unpackSize = GetUi32(p.Header);
+      const UInt32 packSize = GetUi32(p.Header + 4);
+      if (unpackSize == 0)
+      {
+        if (packSize == 0)
+          t.EndMarker = true;
+        else
+          t.ParseError = true;
+        // the data after end marker is not included to MT-block
+        cc->srcSize = i;
+        cc->state = MTDEC_PARSE_END;
+        return;
+      }
+      if (unpackSize > _blockSize)
+      {
+        t.ParseError = true;
+        cc->srcSize = i;
+        cc->state = MTDEC_PARSE_END;
+        return;
+      }
+      t.HasBlock = true;
+      t.UnpackSize = unpackSize;
+      t.PackSize = packSize;
+      p.PackRem = packSize;
+      if (packSize == 0)
+        break;
+      continue;
+    }
+    size_t rem = size - i;
+    if (rem > p.PackRem)
+      rem = p.PackRem;
+    i += rem;
+    p.PackRem -= (UInt32)rem;
+    if (p.PackRem == 0)
+      break;
+  }
+
+  if (p.HeaderPos == kBlockHeaderSize && p.PackRem == 0)
+  {
+    cc->srcSize = i;
+    cc->state = MTDEC_PARSE_NEW;
+    return;
+  }
+
+  if (cc->srcFinished)
+  {
+    t.NeedMoreInput = true;
+    cc->state = MTDEC_PARSE_END;
+  }
+}
+
+
+SRes CDecoder::MtPreCode(unsigned coderIndex)
+{
+  CMtBlock &t = _mtBlocks[coderIndex];
+  if (!t.HasBlock)
+    return SZ_OK;
+  if (t.PackBufSize < t.PackSize)
+  {
+    ::MidFree(t.PackBuf);
+    t.PackBufSize = 0;
+    t.PackBuf = (Byte *)::MidAlloc(t.PackSize);
+    if (!t.PackBuf)
+      return SZ_ERROR_MEM;
+    t.PackBufSize = t.PackSize;
+  }
+  if (t.OutBufSize < _blockSize)
+  {
+    ::MidFree(t.OutBuf);
+    t.OutBufSize = 0;
+    t.OutBuf = (Byte *)::MidAlloc(_blockSize);
+    if (!t.OutBuf)
+      return SZ_ERROR_MEM;
+    t.OutBufSize = _blockSize;
+  }
+  if (!Ppmd7_Alloc(&t.Ppmd, _memSize, &g_BigAlloc))
+    return SZ_ERROR_MEM;
+  return SZ_OK;
+}
+
+
+struct CByteInMem
+{
+  IByteIn vt;
+  const Byte *Cur;
+  const Byte *Lim;
+  bool Extra;
+};
+
+static Byte ByteInMem_Read(IByteInPtr pp)
+{
+  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(CByteInMem)
+  if (p->Cur != p->Lim)
+    return *p->Cur++;
+  p->Extra = true;
+  return 0;
+}
+
+static SRes DecodeSymbols(CPpmd7 *ppmd, const CByteInMem &s, Byte *dest, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    const int sym = Ppmd7z_DecodeSymbol(ppmd);
+    if (s.Extra || sym < 0)
+      return SZ_ERROR_DATA;
+    dest[i] = (Byte)sym;
+  }
+  return SZ_OK;
+}
+
+
+void CDecoder::SetSharedModelResult(SRes res)
+{
+  _sharedRes = res;
+  _sharedSignaled = true;
+  _sharedEvent.Set();
+}
+
+
+// it initializes the model of block from shared model or from scratch, and it decodes the block
+SRes CDecoder::DecodeBlock(CMtBlock &t)
+{
+  CPpmd7 *ppmd = &t.Ppmd;
+  CByteInMem s;
+  s.vt.Read = ByteInMem_Read;
+  s.Cur = t.PackBuf;
+  s.Lim = t.PackBuf + t.PackSize;
+  s.Extra = false;
+
+  size_t pos = 0;
+
+  if (_sharedPrefix && t.BlockIndex != 0)
+  {
+    if (_sharedEvent.Lock() != 0)
+      return SZ_ERROR_THREAD;
+    if (_sharedRes != SZ_OK)
+      return _sharedRes == SZ_ERROR_MEM ? SZ_ERROR_MEM : SZ_ERROR_DATA;
+    _shared.InitModel(ppmd);
+  }
+  else
+    Ppmd7_Init(ppmd, _order);
+
+  ppmd->rc.dec.Stream = &s.vt;
+  if (!Ppmd7z_RangeDec_Init(&ppmd->rc.dec))
+    return SZ_ERROR_DATA;
+
+  if (_sharedPrefix && t.BlockIndex == 0)
+  {
+    // we train the shared model as soon as possible to unlock other threads
+    pos = MyMin(t.UnpackSize, _prefixSize);
+    RINOK(DecodeSymbols(ppmd, s, t.OutBuf, pos))
+    const SRes res = _shared.Train(t.OutBuf, pos, _memSize, _order);
+    SetSharedModelResult(res);
+    RINOK(res)
+  }
+
+  RINOK(DecodeSymbols(ppmd, s, t.OutBuf + pos, t.UnpackSize - pos))
+  if (s.Extra
+      || s.Cur != s.Lim
+      || !Ppmd7z_RangeDec_IsFinishedOK(&ppmd->rc.dec))
+    return SZ_ERROR_DATA;
+  return SZ_OK;
+}
+
+
+SRes CDecoder::MtCode(unsigned coderIndex, const Byte *src, size_t srcSize, int srcFinished,
+    UInt64 *inCodePos, UInt64 *outCodePos, int *stop)
+{
+  CMtBlock &t = _mtBlocks[coderIndex];
+
+  *outCodePos = 0;
+  *stop = True;
+
+  if (!t.HasBlock || t.ParseError)
+  {
+    *inCodePos = srcSize;
+    return SZ_OK;
+  }
+
+  {
+    size_t skip = t.HeaderSkip;
+    if (skip > srcSize)
+      skip = srcSize;
+    src += skip;
+    srcSize -= skip;
+    t.HeaderSkip -= (unsigned)skip;
+  }
+  {
+    const size_t rem = t.PackSize - t.PackPos;
+    if (srcSize > rem)
+      srcSize = rem;
+  }
+  if (srcSize != 0)
+    memcpy(t.PackBuf + t.PackPos, src, srcSize);
+  t.PackPos += (UInt32)srcSize;
+  *inCodePos = kBlockHeaderSize - t.HeaderSkip + t.PackPos;
+
+  if (!srcFinished)
+  {
+    *stop = False;
+    return SZ_OK;
+  }
+  // the block was truncated. Write() will report the error
+  if (t.NeedMoreInput)
+    return SZ_OK;
+
+  SRes res = SZ_ERROR_DATA;
+  if (t.PackPos == t.PackSize)
+    res = DecodeBlock(t);
+  if (res == SZ_OK)
+    *outCodePos = t.UnpackSize;
+  t.CodeRes = res;
+  return res;
+}
+
+
+SRes CDecoder::MtWrite(unsigned coderIndex, BoolInt needWriteToStream,
+    BoolInt *needContinue, BoolInt *canRecode)
+{
+  CMtBlock &t = _mtBlocks[coderIndex];
+
+  // we don't support the recoding of block in single-thread mode
+  *canRecode = False;
+
+  // the threads of another blocks can wait for shared model
+  if (_sharedPrefix && t.BlockIndex == 0 && !_sharedSignaled)
+    SetSharedModelResult(SZ_ERROR_DATA);
+
+  if (!needWriteToStream)
+  {
+    *needContinue = False;
+    return SZ_OK;
+  }
+  if (t.CodeRes != SZ_OK || t.ParseError)
+  {
+    _dataError = true;
+    *needContinue = False;
+    return SZ_OK;
+  }
+  if (t.NeedMoreInput)
+  {
+    _needMoreInput = true;
+    *needContinue = False;
+    return SZ_OK;
+  }
+
+  if (t.HasBlock)
+  {
+    const HRESULT res = WriteData(t.OutBuf, t.UnpackSize);
+    if (res != S_OK)
+    {
+      if (res == S_FALSE)
+        _dataError = true;
+      else
+        _writeRes = res;
+      *needContinue = False;
+      return SZ_ERROR_WRITE;
+    }
+    _inProcessed += kBlockHeaderSize + t.PackSize;
+  }
+
+  if (t.EndMarker)
+  {
+    _inProcessed += kBlockHeaderSize;
+    *needContinue = False;
+  }
+  return SZ_OK;
+}
+
+
+static void PpmdMtDec_Parse(void *p, unsigned coderIndex, CMtDecCallbackInfo *cc)
+{
+  ((CDecoder *)p)->MtParse(coderIndex, cc);
+}
+
+static SRes PpmdMtDec_PreCode(void *p, unsigned coderIndex)
+{
+  return ((CDecoder *)p)->MtPreCode(coderIndex);
+}
+
+static SRes PpmdMtDec_Code(void *p, unsigned coderIndex,
+    const Byte *src, size_t srcSize, int srcFinished,
+    UInt64 *inCodePos, UInt64 *outCodePos, int *stop)
+{
+  return ((CDecoder *)p)->MtCode(coderIndex, src, srcSize, srcFinished, inCodePos, outCodePos, stop);
+}
+
+static SRes PpmdMtDec_Write(void *p, unsigned coderIndex,
+    BoolInt needWriteToStream,
+    const Byte * /* src */, size_t /* srcSize */, BoolInt /* isCross */,
+    BoolInt *needContinue, BoolInt *canRecode)
+{
+  return ((CDecoder *)p)->MtWrite(coderIndex, needWriteToStream, needContinue, canRecode);
+}
+
+
+HRESULT CDecoder::CodeMt(ISequentialInStream *inStream, ICompressProgressInfo *progress, unsigned numThreads)
+{
+  if (!_mtBlocks)
+    _mtBlocks = new CMtBlock[MTDEC_THREADS_MAX];
+  if (!_mtDec_WasConstructed)
+  {
+    MtDec_Construct(&_mtDec);
+    _mtDec_WasConstructed = true;
+  }
+
+  _writeRes = S_OK;
+  _dataError = false;
+  _needMoreInput = false;
+  _mtParser.NumBlocks = 0;
+  _mtParser.HeaderPos = 0;
+  _mtParser.PackRem = 0;
+
+  _inWrap.Init(inStream);
+  _progressWrap.Init(progress);
+
+  _sharedRes = SZ_ERROR_FAIL;
+  _sharedSignaled = false;
+  if (_sharedPrefix)
+  {
+    const WRes wres = _sharedEvent.CreateIfNotCreated_Reset();
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+
+  IMtDecCallback2 vt;
+  vt.Parse = PpmdMtDec_Parse;
+  vt.PreCode = PpmdMtDec_PreCode;
+  vt.Code = PpmdMtDec_Code;
+  vt.Write = PpmdMtDec_Write;
+
+  _mtDec.mtCallback = &vt;
+  _mtDec.mtCallbackObject = this;
+  _mtDec.inStream = &_inWrap.vt;
+  _mtDec.progress = progress ? &_progressWrap.vt : NULL;
+  _mtDec.alloc = &g_MidAlloc;
+  _mtDec.inBufSize = kInBufSize;
+  _mtDec.numThreadsMax = numThreads;
+
+  const SRes res = MtDec_Code(&_mtDec);
+
+  if (_writeRes != S_OK)
+    return _writeRes;
+  if (_mtDec.mtProgress.res != SZ_OK)
+  {
+    if (_progressWrap.Res != S_OK)
+      return _progressWrap.Res;
+    return SResToHRESULT(_mtDec.mtProgress.res);
+  }
+  if (_mtDec.readRes != SZ_OK)
+  {
+    if (_inWrap.Res != S_OK)
+      return _inWrap.Res;
+    return SResToHRESULT(_mtDec.readRes);
+  }
+  if (res != SZ_OK)
+    return SResToHRESULT(res);
+  if (_mtDec.isAllocError)
+    return E_OUTOFMEMORY;
+  if (_mtDec.threadingErrorSRes != SZ_OK)
+    return SResToHRESULT(_mtDec.threadingErrorSRes);
+  if (_mtDec.codeRes == SZ_ERROR_MEM)
+    return E_OUTOFMEMORY;
+  if (_mtDec.codeRes != SZ_OK || _dataError || _needMoreInput)
+    return S_FALSE;
+  return S_OK;
+}
+
+#endif
+
+
+Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress))
+{
+  if (_memSize == 0)
+    return E_FAIL;
+
+  _outSizeDefined = (outSize != NULL);
+  _outSize = 0;
+  if (_outSizeDefined)
+    _outSize = *outSize;
+  _outProcessed = 0;
+  _inProcessed = 0;
+  _outStream = outStream;
+
+  HRESULT res;
+ #ifndef Z7_ST
+  const unsigned numThreads = GetNumMtDecThreads();
+  if (numThreads > 1)
+    res = CodeMt(inStream, progress, numThreads);
+  else
+ #endif
+  {
+    res = CodeSt(inStream, progress);
+    _inProcessed = _inStream.GetProcessed();
+  }
+
+  _outStream = NULL;
+  RINOK(res)
+
+  if (_outSizeDefined && _outProcessed != _outSize)
+    return S_FALSE;
+  if (_finishMode && inSize && *inSize != _inProcessed)
+    return S_FALSE;
+  return S_OK;
+}
+
+}}
@@ -0,0 +1,152 @@
+// PpmdMtDecoder.h
+
+#ifndef ZIP7_INC_COMPRESS_PPMD_MT_DECODER_H
+#define ZIP7_INC_COMPRESS_PPMD_MT_DECODER_H
+
+#include "../../../C/Ppmd7.h"
+
+#ifndef Z7_ST
+#include "../../../C/MtDec.h"
+#include "../../Windows/Synchronization.h"
+#endif
+
+#include "../../Common/MyCom.h"
+
+#include "../ICoder.h"
+
+#include "../Common/CWrappers.h"
+
+#include "PpmdMtConst.h"
+#include "PpmdMtModel.h"
+
+namespace NCompress {
+namespace NPpmdMt {
+
+#ifndef Z7_ST
+
+struct CMtBlock
+{
+  CPpmd7 Ppmd;
+  Byte *PackBuf;
+  Byte *OutBuf;
+  UInt32 PackBufSize;
+  UInt32 OutBufSize;
+  UInt32 UnpackSize;
+  UInt32 PackSize;
+  UInt32 PackPos;
+  UInt64 BlockIndex;
+  unsigned HeaderSkip;  // the number of header bytes that must be skipped in Code()
+  bool HasBlock;
+  bool EndMarker;
+  bool ParseError;
+  bool NeedMoreInput;
+  SRes CodeRes;
+
+  Byte MtPad[1 << 7]; // It's pad for Multi-Threading. Must be >= Cache_Line_Size.
+
+  CMtBlock(): PackBuf(NULL), OutBuf(NULL), PackBufSize(0), OutBufSize(0)
+    { Ppmd7_Construct(&Ppmd); }
+  ~CMtBlock();
+};
+
+struct CMtParser
+{
+  UInt64 NumBlocks;
+  unsigned HeaderPos;
+  UInt32 PackRem;
+  Byte Header[kBlockHeaderSize];
+};
+
+#endif
+
+class CDecoder Z7_final:
+  public ICompressCoder,
+  public ICompressSetDecoderProperties2,
+  public ICompressSetFinishMode,
+  public ICompressGetInStreamProcessedSize,
+ #ifndef Z7_ST
+  public ICompressSetCoderMt,
+  public ICompressSetMemLimit,
+ #endif
+  public CMyUnknownImp
+{
+  Z7_COM_QI_BEGIN2(ICompressCoder)
+  Z7_COM_QI_ENTRY(ICompressSetDecoderProperties2)
+  Z7_COM_QI_ENTRY(ICompressSetFinishMode)
+  Z7_COM_QI_ENTRY(ICompressGetInStreamProcessedSize)
+ #ifndef Z7_ST
+  Z7_COM_QI_ENTRY(ICompressSetCoderMt)
+  Z7_COM_QI_ENTRY(ICompressSetMemLimit)
+ #endif
+  Z7_COM_QI_END
+  Z7_COM_ADDREF_RELEASE
+
+  Z7_IFACE_COM7_IMP(ICompressCoder)
+  Z7_IFACE_COM7_IMP(ICompressSetDecoderProperties2)
+  Z7_IFACE_COM7_IMP(ICompressSetFinishMode)
+  Z7_IFACE_COM7_IMP(ICompressGetInStreamProcessedSize)
+ #ifndef Z7_ST
+  Z7_IFACE_COM7_IMP(ICompressSetCoderMt)
+  Z7_IFACE_COM7_IMP(ICompressSetMemLimit)
+ #endif
+
+  Byte _order;
+  bool _finishMode;
+  bool _outSizeDefined;
+  bool _sharedPrefix;
+  UInt32 _memSize;
+  UInt32 _blockSize;
+  UInt32 _prefixSize;
+  UInt64 _outSize;
+  UInt64 _outProcessed;
+  UInt64 _inProcessed;
+  ISequentialOutStream *_outStream;
+
+  // single-thread decoding
+  Byte *_outBuf;
+  Byte *_prefixBuf;
+  UInt32 _prefixBufSize;
+  CByteInBufWrap _inStream;
+  CPpmd7 _ppmd;
+  CSharedModel _shared;
+
+  HRESULT WriteData(const Byte *data, size_t size);
+  HRESULT CodeSt(ISequentialInStream *inStream, ICompressProgressInfo *progress);
+
+ #ifndef Z7_ST
+  UInt32 _numThreads;
+  UInt64 _memUsage;
+  bool _mtDec_WasConstructed;
+  HRESULT _writeRes;
+  bool _dataError;
+  bool _needMoreInput;
+  CMtBlock *_mtBlocks;
+  CMtParser _mtParser;
+  CSeqInStreamWrap _inWrap;
+  CCompressProgressWrap _progressWrap;
+  CMtDec _mtDec;
+  NWindows::NSynchronization::CManualResetEvent _sharedEvent;
+  SRes _sharedRes;
+  bool _sharedSignaled;
+
+  void SetSharedModelResult(SRes res);
+  SRes DecodeBlock(CMtBlock &t);
+  unsigned GetNumMtDecThreads() const;
+  HRESULT CodeMt(ISequentialInStream *inStream, ICompressProgressInfo *progress, unsigned numThreads);
+public:
+  void MtParse(unsigned coderIndex, CMtDecCallbackInfo *cc);
+  SRes MtPreCode(unsigned coderIndex);
+  SRes MtCode(unsigned coderIndex, const Byte *src, size_t srcSize, int srcFinished,
+      UInt64 *inCodePos, UInt64 *outCodePos, int *stop);
+  SRes MtWrite(unsigned coderIndex, BoolInt needWriteToStream,
+      BoolInt *needContinue, BoolInt *canRecode);
+ #endif
+
+public:
+  CDecoder();
+  ~CDecoder();
+};
+
+}}
+
+#endif
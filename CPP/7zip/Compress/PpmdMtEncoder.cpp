@@ -0,0 +1,462 @@
+// PpmdMtEncoder.cpp
+
+#include "StdAfx.h"
+
+#include <string.h>
+
+#include "../../../C/Alloc.h"
+#include "../../../C/CpuArch.h"
+
+#include "../../Common/Defs.h"
+
+#include "../Common/StreamUtils.h"
+
+#include "PpmdMtEncoder.h"
+
+namespace NCompress {
+namespace NPpmdMt {
+
+void CEncProps::Normalize(int level)
+{
+  Ppmd.Normalize(level);
+  if (NumThreads == 0)
+    NumThreads = 1;
+  if (BlockSize == 0)
+  {
+    // the model of PPMd is filled after (MemSize * 2) bytes of typical text data
+    const UInt32 kBlockSize_Default_Min = (UInt32)1 << 20;
+    const UInt32 kBlockSize_Default_Max = (UInt32)1 << 28;
+    UInt64 v = (UInt64)Ppmd.MemSize * 2;
+    if (v > kBlockSize_Default_Max) v = kBlockSize_Default_Max;
+    // we reduce block size, if there are not enough blocks for all threads
+    if (NumThreads > 1)
+    {
+      const UInt64 v2 = ReduceSize / NumThreads + 1;
+      if (v > v2)
+        v = v2;
+    }
+    if (v < kBlockSize_Default_Min) v = kBlockSize_Default_Min;
+    BlockSize = (UInt32)v;
+  }
+  if (BlockSize < kBlockSizeMin) BlockSize = kBlockSizeMin;
+  if (BlockSize > kBlockSizeMax) BlockSize = kBlockSizeMax;
+  if (PrefixSize > BlockSize)
+    PrefixSize = BlockSize;
+  if (PrefixSize == 0)
+    SharedPrefix = false;
+}
+
+
+static void OutBlock_Write(IByteOutPtr pp, Byte b)
+{
+  Z7_CONTAINER_FROM_VTBL_TO_DECL_VAR_pp_vt_p(COutBlock)
+  if (p->Pos == p->Size)
+  {
+    p->Grow();
+    if (p->Pos == p->Size)
+      return;
+  }
+  p->Buf[p->Pos++] = b;
+}
+
+COutBlock::COutBlock():
+    Buf(NULL),
+    Pos(0),
+    Size(0),
+    AllocError(false)
+{
+  vt.Write = OutBlock_Write;
+}
+
+COutBlock::~COutBlock()
+{
+  ::MidFree(Buf);
+}
+
+bool COutBlock::Init(size_t size)
+{
+  Pos = 0;
+  AllocError = false;
+  if (Size < size)
+  {
+    ::MidFree(Buf);
+    Size = 0;
+    Buf = (Byte *)::MidAlloc(size);
+    if (!Buf)
+      return false;
+    Size = size;
+  }
+  return true;
+}
+
+void COutBlock::Grow()
+{
+  if (AllocError)
+    return;
+  const size_t newSize = Size + (Size >> 1) + ((size_t)1 << 16);
+  Byte *buf = (Byte *)::MidAlloc(newSize);
+  if (!buf)
+  {
+    AllocError = true;
+    return;
+  }
+  memcpy(buf, Buf, Pos);
+  ::MidFree(Buf);
+  Buf = buf;
+  Size = newSize;
+}
+
+
+CBlockCoder::~CBlockCoder()
+{
+  Ppmd7_Free(&Ppmd, &g_BigAlloc);
+}
+
+
+CEncoder::CEncoder():
+    _outStream(NULL),
+    _writeRes(S_OK),
+    _inBuf(NULL),
+    _inBufSize(0),
+    _sharedRes(SZ_OK)
+   #ifndef Z7_ST
+    , _mtCoder_WasConstructed(false)
+   #endif
+{
+  _props.Normalize(-1);
+}
+
+CEncoder::~CEncoder()
+{
+ #ifndef Z7_ST
+  if (_mtCoder_WasConstructed)
+    MtCoder_Destruct(&_mtCoder);
+ #endif
+  ::MidFree(_inBuf);
+}
+
+
+Z7_COM7F_IMF(CEncoder::SetCoderProperties(const PROPID *propIDs, const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  int level = -1;
+  CEncProps props;
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT &prop = coderProps[i];
+    const PROPID propID = propIDs[i];
+    switch (propID)
+    {
+      case NCoderPropID::kBlockSize:
+      case NCoderPropID::kBlockPrefixSize:
+      case NCoderPropID::kSharedPrefixSize:
+      {
+        UInt64 v;
+        if (prop.vt == VT_UI4)
+          v = prop.ulVal;
+        else if (prop.vt == VT_UI8)
+          v = prop.uhVal.QuadPart;
+        else
+          return E_INVALIDARG;
+        if (v > kBlockSizeMax)
+          v = kBlockSizeMax;
+        if (propID == NCoderPropID::kBlockSize)
+          props.BlockSize = (UInt32)v;
+        else
+        {
+          props.PrefixSize = (UInt32)v;
+          props.SharedPrefix = (propID == NCoderPropID::kSharedPrefixSize);
+        }
+        break;
+      }
+      case NCoderPropID::kNumThreads:
+        if (prop.vt != VT_UI4)
+          return E_INVALIDARG;
+        props.NumThreads = prop.ulVal;
+       #ifndef Z7_ST
+        if (props.NumThreads > MTCODER_THREADS_MAX)
+          props.NumThreads = MTCODER_THREADS_MAX;
+       #endif
+        break;
+      case NCoderPropID::kReduceSize:
+        if (prop.vt == VT_UI8)
+          props.ReduceSize = prop.uhVal.QuadPart;
+        // we also set NPpmd::CEncProps::ReduceSize that is used to reduce MemSize
+        RINOK(NPpmd::SetPpmdProp(propID, prop, props.Ppmd, level))
+        break;
+      default:
+        RINOK(NPpmd::SetPpmdProp(propID, prop, props.Ppmd, level))
+    }
+  }
+  props.Normalize(level);
+  _props = props;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CEncoder::WriteCoderProperties(ISequentialOutStream *outStream))
+{
+  Byte props[kPropsSize_WithFlags];
+  props[0] = (Byte)_props.Ppmd.Order;
+  SetUi32(props + 1, _props.Ppmd.MemSize)
+  SetUi32(props + 5, _props.BlockSize)
+  SetUi32(props + 9, _props.PrefixSize)
+  unsigned size = kPropsSize;
+  // (Flags) byte is written only if it's required
+  if (_props.SharedPrefix)
+    props[size++] = (Byte)kFlag_SharedPrefix;
+  return WriteStream(outStream, props, size);
+}
+
+
+SRes CEncoder::EncodeBlock(unsigned coderIndex, const Byte *src, size_t srcSize,
+    size_t prefixSize, bool useShared, COutBlock &out)
+{
+  CPpmd7 *ppmd = &_coders[coderIndex].Ppmd;
+  if (!Ppmd7_Alloc(ppmd, _props.Ppmd.MemSize, &g_BigAlloc))
+    return SZ_ERROR_MEM;
+  // the buffer will be increased in OutBlock_Write(), if data is not compressible.
+  if (!out.Init(kBlockHeaderSize + (srcSize >> 1) + ((size_t)1 << 12)))
+    return SZ_ERROR_MEM;
+  out.Pos = kBlockHeaderSize;
+
+  if (useShared)
+    _shared.InitModel(ppmd);
+  else
+  {
+    Ppmd7_Init(ppmd, (unsigned)_props.Ppmd.Order);
+    if (prefixSize != 0)
+      Ppmd7z_UpdateWithSymbols(ppmd, src - prefixSize, src);
+  }
+
+  ppmd->rc.enc.Stream = &out.vt;
+  Ppmd7z_Init_RangeEnc(ppmd);
+  Ppmd7z_EncodeSymbols(ppmd, src, src + srcSize);
+  Ppmd7z_Flush_RangeEnc(ppmd);
+
+  if (out.AllocError)
+    return SZ_ERROR_MEM;
+  SetUi32(out.Buf, (UInt32)srcSize)
+  SetUi32(out.Buf + 4, (UInt32)(out.Pos - kBlockHeaderSize))
+  return SZ_OK;
+}
+
+
+HRESULT CEncoder::WriteBlock(const COutBlock &out)
+{
+  const HRESULT res = WriteStream(_outStream, out.Buf, out.Pos);
+  if (res != S_OK && _writeRes == S_OK)
+    _writeRes = res;
+  return res;
+}
+
+
+HRESULT CEncoder::CodeSt(ISequentialInStream *inStream, ICompressProgressInfo *progress)
+{
+  const bool shared = _props.SharedPrefix;
+  const size_t prefixMax = shared ? 0 : _props.PrefixSize;
+  const size_t blockSize = _props.BlockSize;
+  {
+    const size_t size = prefixMax + blockSize;
+    if (!_inBuf || _inBufSize != size)
+    {
+      ::MidFree(_inBuf);
+      _inBufSize = 0;
+      _inBuf = (Byte *)::MidAlloc(size);
+      if (!_inBuf)
+        return E_OUTOFMEMORY;
+      _inBufSize = size;
+    }
+  }
+
+  COutBlock &out = _outBlocks[0];
+  size_t prefixSize = 0;
+  UInt64 inProcessed = 0;
+  UInt64 outProcessed = 0;
+  bool useShared = false;
+
+  for (;;)
+  {
+    Byte *buf = _inBuf + prefixMax;
+    size_t size = blockSize;
+    RINOK(ReadStream(inStream, buf, &size))
+    if (size == 0)
+      return S_OK;
+    RINOK(SResToHRESULT(EncodeBlock(0, buf, size, prefixSize, useShared, out)))
+    RINOK(WriteBlock(out))
+    if (shared && !useShared)
+    {
+      // the first block trains the shared model for all another blocks
+      RINOK(SResToHRESULT(_shared.Train(buf, MyMin(size, (size_t)_props.PrefixSize),
+          _props.Ppmd.MemSize, (unsigned)_props.Ppmd.Order)))
+      useShared = true;
+    }
+    inProcessed += size;
+    outProcessed += out.Pos;
+    if (progress)
+    {
+      RINOK(progress->SetRatioInfo(&inProcessed, &outProcessed))
+    }
+    if (size != blockSize)
+      return S_OK;
+    if (prefixMax != 0)
+    {
+      // (blockSize >= prefixMax) here
+      memmove(_inBuf, buf + size - prefixMax, prefixMax);
+      prefixSize = prefixMax;
+    }
+  }
+}
+
+
+#ifndef Z7_ST
+
+SRes CEncoder::MtCallback_Code(unsigned coderIndex, unsigned outBufIndex,
+    const Byte *src, size_t srcSize, int /* finished */)
+{
+  COutBlock &out = _outBlocks[outBufIndex];
+  out.Pos = 0;
+  const bool isFirst = (_mtCoder.threads[coderIndex].inPos == 0);
+
+  if (_props.SharedPrefix)
+  {
+    if (isFirst)
+    {
+      // the first block trains the shared model, and other threads wait for it
+      _sharedRes = _shared.Train(src, MyMin(srcSize, (size_t)_props.PrefixSize),
+          _props.Ppmd.MemSize, (unsigned)_props.Ppmd.Order);
+      if (_sharedEvent.Set() != 0)
+        return SZ_ERROR_THREAD;
+    }
+    else
+    {
+      if (_sharedEvent.Lock() != 0)
+        return SZ_ERROR_THREAD;
+      RINOK(_sharedRes)
+    }
+  }
+
+  // we don't write empty blocks
+  if (srcSize == 0)
+    return SZ_OK;
+
+  size_t prefixSize = 0;
+  if (_props.PrefixSize != 0 && !_props.SharedPrefix)
+  {
+    prefixSize = _mtCoder.threads[coderIndex].inPrefixSize;
+    if (prefixSize > _props.PrefixSize)
+      prefixSize = _props.PrefixSize;
+  }
+
+  RINOK(EncodeBlock(coderIndex, src, srcSize, prefixSize, _props.SharedPrefix && !isFirst, out))
+
+  CMtProgressThunk progressThunk;
+  MtProgressThunk_CreateVTable(&progressThunk);
+  progressThunk.mtProgress = &_mtCoder.mtProgress;
+  MtProgressThunk_INIT(&progressThunk)
+  return ICompressProgress_Progress(&progressThunk.vt, srcSize, out.Pos);
+}
+
+
+SRes CEncoder::MtCallback_Write(unsigned outBufIndex)
+{
+  const COutBlock &out = _outBlocks[outBufIndex];
+  if (out.Pos == 0)
+    return SZ_OK;
+  return WriteBlock(out) == S_OK ? SZ_OK : SZ_ERROR_WRITE;
+}
+
+
+static SRes PpmdMtEnc_Code(void *p, unsigned coderIndex, unsigned outBufIndex,
+    const Byte *src, size_t srcSize, int finished)
+{
+  return ((CEncoder *)p)->MtCallback_Code(coderIndex, outBufIndex, src, srcSize, finished);
+}
+
+static SRes PpmdMtEnc_Write(void *p, unsigned outBufIndex)
+{
+  return ((CEncoder *)p)->MtCallback_Write(outBufIndex);
+}
+
+
+#define RET_IF_WRAP_ERROR(wrapRes, sRes, sResErrorCode) \
+  if (wrapRes != S_OK /* && (sRes == SZ_OK || sRes == sResErrorCode) */) return wrapRes;
+
+HRESULT CEncoder::CodeMt(ISequentialInStream *inStream, ICompressProgressInfo *progress)
+{
+  if (!_mtCoder_WasConstructed)
+  {
+    _mtCoder_WasConstructed = true;
+    MtCoder_Construct(&_mtCoder);
+  }
+
+  _inWrap.Init(inStream);
+  _progressWrap.Init(progress);
+
+  if (_props.SharedPrefix)
+  {
+    _sharedRes = SZ_ERROR_FAIL;
+    const WRes wres = _sharedEvent.CreateIfNotCreated_Reset();
+    if (wres != 0)
+      return HRESULT_FROM_WIN32(wres);
+  }
+
+  IMtCoderCallback2 vt;
+  vt.Code = PpmdMtEnc_Code;
+  vt.Write = PpmdMtEnc_Write;
+
+  _mtCoder.allocBig = &g_BigAlloc;
+  _mtCoder.progress = progress ? &_progressWrap.vt : NULL;
+  _mtCoder.inStream = &_inWrap.vt;
+  _mtCoder.inData = NULL;
+  _mtCoder.inDataSize = 0;
+  _mtCoder.mtCallback = &vt;
+  _mtCoder.mtCallbackObject = this;
+  _mtCoder.blockSize = _props.BlockSize;
+  _mtCoder.blockPrefixSize = _props.SharedPrefix ? 0 : _props.PrefixSize;
+  _mtCoder.numThreadsMax = _props.NumThreads;
+  _mtCoder.expectedDataSize = _props.ReduceSize;
+
+  const SRes res = MtCoder_Code(&_mtCoder);
+
+  RET_IF_WRAP_ERROR(_inWrap.Res, res, SZ_ERROR_READ)
+  RET_IF_WRAP_ERROR(_writeRes, res, SZ_ERROR_WRITE)
+  RET_IF_WRAP_ERROR(_progressWrap.Res, res, SZ_ERROR_PROGRESS)
+
+  return SResToHRESULT(res);
+}
+
+#endif
+
+
+Z7_COM7F_IMF(CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress))
+{
+  unsigned numCoders = 1;
+ #ifndef Z7_ST
+  if (_props.NumThreads > 1)
+    numCoders = _props.NumThreads;
+ #endif
+  while (_coders.Size() < numCoders)
+    _coders.AddNew();
+
+  _outStream = outStream;
+  _writeRes = S_OK;
+
+  HRESULT res;
+ #ifndef Z7_ST
+  if (_props.NumThreads > 1)
+    res = CodeMt(inStream, progress);
+  else
+ #endif
+    res = CodeSt(inStream, progress);
+
+  _outStream = NULL;
+  RINOK(res)
+
+  // end marker
+  Byte buf[kBlockHeaderSize];
+  memset(buf, 0, kBlockHeaderSize);
+  return WriteStream(outStream, buf, kBlockHeaderSize);
+}
+
+}}
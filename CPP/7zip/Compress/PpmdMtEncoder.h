@@ -0,0 +1,122 @@
+// PpmdMtEncoder.h
+
+#ifndef ZIP7_INC_COMPRESS_PPMD_MT_ENCODER_H
+#define ZIP7_INC_COMPRESS_PPMD_MT_ENCODER_H
+
+#include "../../../C/Ppmd7.h"
+
+#ifndef Z7_ST
+#include "../../../C/MtCoder.h"
+#include "../../Windows/Synchronization.h"
+#endif
+
+#include "../../Common/MyCom.h"
+#include "../../Common/MyVector.h"
+
+#include "../ICoder.h"
+
+#include "../Common/CWrappers.h"
+
+#include "PpmdEncoder.h"
+#include "PpmdMtConst.h"
+#include "PpmdMtModel.h"
+
+namespace NCompress {
+namespace NPpmdMt {
+
+struct CEncProps
+{
+  NPpmd::CEncProps Ppmd;
+  UInt32 BlockSize;
+  UInt32 PrefixSize;
+  UInt32 NumThreads;
+  UInt64 ReduceSize;
+  bool SharedPrefix;  // (PrefixSize) bytes at start of stream train one shared model for all blocks
+
+  CEncProps():
+      BlockSize(0),
+      PrefixSize(0),
+      NumThreads(1),
+      ReduceSize((UInt64)(Int64)-1),
+      SharedPrefix(false)
+      {}
+  void Normalize(int level);
+};
+
+// it's growable output buffer for one block
+struct COutBlock
+{
+  IByteOut vt;
+  Byte *Buf;
+  size_t Pos;
+  size_t Size;
+  bool AllocError;
+
+  COutBlock();
+  ~COutBlock();
+  bool Init(size_t size);
+  void Grow();
+};
+
+struct CBlockCoder
+{
+  CPpmd7 Ppmd;
+
+  CBlockCoder() { Ppmd7_Construct(&Ppmd); }
+  ~CBlockCoder();
+};
+
+class CEncoder Z7_final:
+  public ICompressCoder,
+  public ICompressSetCoderProperties,
+  public ICompressWriteCoderProperties,
+  public CMyUnknownImp
+{
+  Z7_COM_UNKNOWN_IMP_3(
+      ICompressCoder,
+      ICompressSetCoderProperties,
+      ICompressWriteCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressCoder)
+  Z7_IFACE_COM7_IMP(ICompressSetCoderProperties)
+  Z7_IFACE_COM7_IMP(ICompressWriteCoderProperties)
+
+  CEncProps _props;
+  CObjectVector<CBlockCoder> _coders;
+  ISequentialOutStream *_outStream;
+  HRESULT _writeRes;
+  Byte *_inBuf;
+  size_t _inBufSize;
+  CSharedModel _shared;
+  SRes _sharedRes;
+
+ #ifndef Z7_ST
+  bool _mtCoder_WasConstructed;
+  CSeqInStreamWrap _inWrap;
+  CCompressProgressWrap _progressWrap;
+  COutBlock _outBlocks[MTCODER_BLOCKS_MAX];
+  CMtCoder _mtCoder;
+  NWindows::NSynchronization::CManualResetEvent _sharedEvent;
+ #else
+  COutBlock _outBlocks[1];
+ #endif
+
+  SRes EncodeBlock(unsigned coderIndex, const Byte *src, size_t srcSize,
+      size_t prefixSize, bool useShared, COutBlock &out);
+  HRESULT WriteBlock(const COutBlock &out);
+  HRESULT CodeSt(ISequentialInStream *inStream, ICompressProgressInfo *progress);
+ #ifndef Z7_ST
+  HRESULT CodeMt(ISequentialInStream *inStream, ICompressProgressInfo *progress);
+public:
+  SRes MtCallback_Code(unsigned coderIndex, unsigned outBufIndex,
+      const Byte *src, size_t srcSize, int finished);
+  SRes MtCallback_Write(unsigned outBufIndex);
+ #endif
+
+public:
+  CEncoder();
+  ~CEncoder();
+};
+
+}}
+
+#endif
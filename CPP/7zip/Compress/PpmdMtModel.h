@@ -0,0 +1,97 @@
+// PpmdMtModel.h
+
+#ifndef ZIP7_INC_COMPRESS_PPMD_MT_MODEL_H
+#define ZIP7_INC_COMPRESS_PPMD_MT_MODEL_H
+
+#include <string.h>
+
+#include "../../../C/Alloc.h"
+#include "../../../C/Ppmd7.h"
+
+namespace NCompress {
+namespace NPpmdMt {
+
+/*
+CSharedModel is the model that was updated with first bytes of stream.
+The encoder and decoder train it once, and then they copy
+the snapshot of that model to the model of each block.
+If model copying is not supported (PPMD_32BIT mode),
+we keep the data, and each block model is updated with that data again.
+*/
+
+class CSharedModel
+{
+#ifdef PPMD7_COPY_MODEL_SUPPORTED
+  CPpmd7 _ppmd;
+#else
+  Byte *_data;
+  size_t _dataSize;
+  size_t _dataAlloc;
+  unsigned _order;
+#endif
+
+  Z7_CLASS_NO_COPY(CSharedModel)
+public:
+  CSharedModel()
+    #ifndef PPMD7_COPY_MODEL_SUPPORTED
+    : _data(NULL),
+      _dataSize(0),
+      _dataAlloc(0),
+      _order(PPMD7_MIN_ORDER)
+    #endif
+  {
+   #ifdef PPMD7_COPY_MODEL_SUPPORTED
+    Ppmd7_Construct(&_ppmd);
+   #endif
+  }
+
+  ~CSharedModel()
+  {
+   #ifdef PPMD7_COPY_MODEL_SUPPORTED
+    Ppmd7_Free(&_ppmd, &g_BigAlloc);
+   #else
+    ::MidFree(_data);
+   #endif
+  }
+
+  SRes Train(const Byte *data, size_t size, UInt32 memSize, unsigned order)
+  {
+   #ifdef PPMD7_COPY_MODEL_SUPPORTED
+    if (!Ppmd7_Alloc(&_ppmd, memSize, &g_BigAlloc))
+      return SZ_ERROR_MEM;
+    Ppmd7_Init(&_ppmd, order);
+    Ppmd7z_UpdateWithSymbols(&_ppmd, data, data + size);
+   #else
+    UNUSED_VAR(memSize)
+    _order = order;
+    if (_dataAlloc < size)
+    {
+      ::MidFree(_data);
+      _dataAlloc = 0;
+      _data = (Byte *)::MidAlloc(size);
+      if (!_data)
+        return SZ_ERROR_MEM;
+      _dataAlloc = size;
+    }
+    if (size != 0)
+      memcpy(_data, data, size);
+    _dataSize = size;
+   #endif
+    return SZ_OK;
+  }
+
+  // (p) must be allocated with same (memSize)
+  void InitModel(CPpmd7 *p) const
+  {
+   #ifdef PPMD7_COPY_MODEL_SUPPORTED
+    Ppmd7_CopyModel(p, &_ppmd);
+   #else
+    Ppmd7_Init(p, _order);
+    Ppmd7z_UpdateWithSymbols(p, _data, _data + _dataSize);
+   #endif
+  }
+};
+
+}}
+
+#endif
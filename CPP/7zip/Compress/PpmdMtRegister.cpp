@@ -0,0 +1,22 @@
+// PpmdMtRegister.cpp
+
+#include "StdAfx.h"
+
+#include "../Common/RegisterCodec.h"
+
+#include "PpmdMtDecoder.h"
+
+#ifndef Z7_EXTRACT_ONLY
+#include "PpmdMtEncoder.h"
+#endif
+
+namespace NCompress {
+namespace NPpmdMt {
+
+REGISTER_CODEC_E(PPMD_MT,
+    CDecoder(),
+    CEncoder(),
+    0x30402,
+    "PPMD-MT")
+
+}}
@@ -25,9 +25,18 @@ static const size_t k_Zstd_BlockSizeMax = 1 << 17;
 CDecoder::CDecoder():
     _outStepMask(k_Zstd_BlockSizeMax - 1) // must be = (1 << x) - 1
     , _dec(NULL)
+    , _dictWasSet(false)
     , _inProcessed(0)
+   #ifndef Z7_ST
+    , _numThreads(1)
+    , _memUsage((UInt64)(sizeof(size_t)) << 28)
+   #endif
     , _inBufSize(1u << 19) // larger value will reduce the number of memcpy() calls in CZstdDec code
     , _inBuf(NULL)
+   #ifndef Z7_ST
+    , _decMt(NULL)
+    , _mtReadMode(false)
+   #endif
     , FinishMode(false)
     , DisableHash(False)
     // , DisableHash(True) // for debug : fast decoding without hash calculation
@@ -39,6 +48,10 @@ CDecoder::~CDecoder()
 {
   if (_dec)
     ZstdDec_Destroy(_dec);
+ #ifndef Z7_ST
+  if (_decMt)
+    ZstdDecMt_Destroy(_decMt);
+ #endif
   MidFree(_inBuf);
 }
 
@@ -65,6 +78,33 @@ Z7_COM7F_IMF(CDecoder::SetDecoderProperties2(const Byte * /* prop */, UInt32 /*
 }
 
 
+HRESULT CDecoder::CreateDec()
+{
+  if (!_dec)
+  {
+    _dec = ZstdDec_Create(&g_AlignedAlloc, &g_BigAlloc);
+    if (!_dec)
+      return E_OUTOFMEMORY;
+  }
+  return S_OK;
+}
+
+
+/* the decoder keeps digested dictionaries in cache.
+   So the caller can set same dictionary for each stream without big overhead */
+Z7_COM7F_IMF(CDecoder::SetPresetDictionary(const Byte *data, UInt32 size))
+{
+  RINOK(CreateDec())
+  _dictWasSet = false;
+  const SRes sres = ZstdDec_SetDict(_dec, data, size);
+  if (sres == SZ_ERROR_DATA)
+    return E_INVALIDARG;
+  RINOK(SResToHRESULT(sres))
+  _dictWasSet = (size != 0);
+  return S_OK;
+}
+
+
 Z7_COM7F_IMF(CDecoder::SetFinishMode(UInt32 finishMode))
 {
   FinishMode = (finishMode != 0);
@@ -110,12 +150,7 @@ HRESULT CDecoder::Prepare(const UInt64 *outSize)
     _state.outSize = *outSize;
     // _state.outSize = 0; // for debug
   }
-  if (!_dec)
-  {
-    _dec = ZstdDec_Create(&g_AlignedAlloc, &g_BigAlloc);
-    if (!_dec)
-      return E_OUTOFMEMORY;
-  }
+  RINOK(CreateDec())
   if (!_inBuf || _inBufSize != _inBufSize_Allocated)
   {
     MidFree(_inBuf);
@@ -132,6 +167,71 @@ HRESULT CDecoder::Prepare(const UInt64 *outSize)
 }
 
 
+#ifndef Z7_ST
+
+#define RET_IF_WRAP_ERROR(wrapRes, sRes, sResErrorCode) \
+  if (wrapRes != S_OK /* && (sRes == SZ_OK || sRes == sResErrorCode) */) return wrapRes;
+
+/*
+  CodeMt() decodes independent frames in multi-thread mode.
+  If there is some data that was not decoded in multi-thread mode,
+  Code() continues single-thread decoding from that point,
+  and it reads buffered input data from CZstdDecMt before reading from (inStream).
+*/
+
+HRESULT CDecoder::CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 *outSize, ICompressProgressInfo *progress,
+    CZstdDecMtRes &mtRes, HRESULT &hres_Read)
+{
+  if (!_decMt)
+  {
+    _decMt = ZstdDecMt_Create(&g_AlignedAlloc, &g_BigAlloc, &g_MidAlloc);
+    if (!_decMt)
+      return E_OUTOFMEMORY;
+  }
+
+  CZstdDecMtProps props;
+  ZstdDecMtProps_Init(&props);
+  props.numThreads = _numThreads;
+  props.disableHash = DisableHash;
+  {
+    // each thread can hold input data and output data of one block
+    const UInt64 limit = _memUsage / _numThreads / 2;
+    if (props.outBlockMax > limit)
+      props.outBlockMax = (size_t)limit;
+  }
+
+  CSeqInStreamWrap inWrap;
+  CSeqOutStreamWrap outWrap;
+  CCompressProgressWrap progressWrap;
+
+  inWrap.Init(inStream);
+  outWrap.Init(outStream);
+  progressWrap.Init(progress);
+
+  const SRes res = ZstdDecMt_Decode(_decMt, &props,
+      &outWrap.vt, outSize,
+      &inWrap.vt,
+      &mtRes,
+      progress ? &progressWrap.vt : NULL);
+
+  if (mtRes.readRes != SZ_OK)
+  {
+    hres_Read = inWrap.Res;
+    if (hres_Read == S_OK)
+      hres_Read = SResToHRESULT(mtRes.readRes);
+  }
+
+  RET_IF_WRAP_ERROR(progressWrap.Res, res, SZ_ERROR_PROGRESS)
+  RET_IF_WRAP_ERROR(outWrap.Res, res, SZ_ERROR_WRITE)
+
+  _mtReadMode = (res == SZ_OK);
+  return SResToHRESULT(res);
+}
+
+#endif
+
+
 Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
     const UInt64 *inSize, const UInt64 *outSize, ICompressProgressInfo *progress))
 {
@@ -144,19 +244,120 @@ Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream
   SRes sres = SZ_OK;
   HRESULT hres = S_OK;
   HRESULT hres_Read = S_OK;
+
+ #ifndef Z7_ST
+  bool mtReadWasFinished = false;
+  _mtReadMode = false;
+  /* frames without Dictionary_ID can use the dictionary,
+     but multi-thread decoder doesn't support dictionaries */
+  if (_numThreads > 1 && !_dictWasSet)
+  {
+    CZstdDecMtRes mtRes;
+    RINOK(CodeMt(inStream, outStream, outSize, progress, mtRes, hres_Read))
+    _inProcessed = mtRes.inProcessed;
+    _state.outProcessed = mtRes.outProcessed;
+    _state.info = mtRes.info;
+    writtenSize = mtRes.outProcessed;
+    inPrev = _inProcessed;
+    outPrev = writtenSize;
+    if (mtRes.outSize_Reached)
+    {
+      // it's same result as in single-thread decoding after (outSize) was reached
+      ResInfo.is_NonFinishedFrame = True;
+      return FinishMode ? S_FALSE : S_OK;
+    }
+    mtReadWasFinished = (mtRes.readWasFinished != 0);
+    if (!_mtReadMode)
+      readWasFinished = mtReadWasFinished;
+  }
+ #endif
+
+  /* if (inStream) is memory mapped file stream,
+     we decode directly from stream memory without copying to (_inBuf). */
+  CMyComPtr<IStreamGetRangePtr> inRangePtr;
+  CMyComPtr<IInStream> inSeekStream;
+  UInt64 inMapPos = 0;
+  if (!readWasFinished
+     #ifndef Z7_ST
+      && !_mtReadMode
+     #endif
+      )
+  {
+    inStream->QueryInterface(IID_IStreamGetRangePtr, (void **)&inRangePtr);
+    if (inRangePtr)
+    {
+      inStream->QueryInterface(IID_IInStream, (void **)&inSeekStream);
+      const Byte *data;
+      UInt32 avail;
+      if (!inSeekStream
+          || inSeekStream->Seek(0, STREAM_SEEK_CUR, &inMapPos) != S_OK
+          // the stream can support the interface, but the data is not mapped
+          || inRangePtr->GetRangePtr(inMapPos, 0, &data, &avail) != S_OK)
+      {
+        inRangePtr.Release();
+        inSeekStream.Release();
+      }
+      else
+      {
+        CMyComPtr<IStreamSetAccessHint> accessHint;
+        inStream->QueryInterface(IID_IStreamSetAccessHint, (void **)&accessHint);
+        if (accessHint)
+          accessHint->SetAccessHint(inMapPos, 0, NStreamAccessHint::kSequential);
+      }
+    }
+  }
   
   for (;;)
   {
     if (_state.inPos == _state.inLim && !readWasFinished)
     {
-      _state.inPos = 0;
-      _state.inLim = _inBufSize;
-      hres_Read = ReadStream(inStream, _inBuf, &_state.inLim);
-      // _state.inLim -= 5; readWasFinished = True; // for debug
-      if (_state.inLim != _inBufSize || hres_Read != S_OK)
+     #ifndef Z7_ST
+      if (_mtReadMode)
       {
-        // hres_Read = 99; // for debug
-        readWasFinished = True;
+        size_t lim;
+        const Byte *data = ZstdDecMt_Read(_decMt, &lim);
+        if (data)
+        {
+          _state.inBuf = data;
+          _state.inPos = 0;
+          _state.inLim = lim;
+        }
+        else
+        {
+          _mtReadMode = false;
+          _state.inBuf = _inBuf;
+          _state.inPos = 0;
+          _state.inLim = 0;
+          readWasFinished = mtReadWasFinished;
+        }
+      }
+      if (!_mtReadMode && !readWasFinished)
+     #endif
+      {
+        _state.inPos = 0;
+        if (inRangePtr)
+        {
+          const Byte *data = NULL;
+          UInt32 avail = 0;
+          hres_Read = inRangePtr->GetRangePtr(inMapPos, _inBufSize, &data, &avail);
+          if (hres_Read != S_OK)
+            avail = 0;
+          else if (avail != 0)
+            _state.inBuf = data;
+          _state.inLim = avail;
+          inMapPos += avail;
+        }
+        else
+        {
+          _state.inLim = _inBufSize;
+          hres_Read = ReadStream(inStream, _inBuf, &_state.inLim);
+        }
+        // _state.inLim -= 5; readWasFinished = True; // for debug
+        if (_state.inLim != _inBufSize || hres_Read != S_OK)
+        {
+          // hres_Read = 99; // for debug
+          readWasFinished = True;
+        }
       }
     }
     {
@@ -225,6 +426,14 @@ Z7_COM7F_IMF(CDecoder::Code(ISequentialInStream *inStream, ISequentialOutStream
     }
   }
 
+  if (inSeekStream)
+  {
+    // we set stream position after data that was used, as ReadStream() does
+    const HRESULT hres2 = inSeekStream->Seek((Int64)inMapPos, STREAM_SEEK_SET, NULL);
+    if (hres == S_OK)
+      hres = hres2;
+  }
+
   if (hres == S_OK)
   {
     ZstdDec_GetResInfo(_dec, &_state, sres, &ResInfo);
@@ -273,6 +482,23 @@ Z7_COM7F_IMF(CDecoder::GetInStreamProcessedSize(UInt64 *value))
 }
 
 
+#ifndef Z7_ST
+
+Z7_COM7F_IMF(CDecoder::SetNumberOfThreads(UInt32 numThreads))
+{
+  _numThreads = numThreads;
+  return S_OK;
+}
+
+Z7_COM7F_IMF(CDecoder::SetMemLimit(UInt64 memUsage))
+{
+  _memUsage = memUsage;
+  return S_OK;
+}
+
+#endif
+
+
 #ifndef Z7_NO_READ_FROM_CODER_ZSTD
 
 Z7_COM7F_IMF(CDecoder::SetOutStreamSize(const UInt64 *outSize))
@@ -4,6 +4,7 @@
 #define ZIP7_INC_ZSTD_DECODER_H
 
 #include "../../../C/ZstdDec.h"
+#include "../../../C/ZstdDecMt.h"
 
 #include "../../Common/MyCom.h"
 #include "../ICoder.h"
@@ -26,10 +27,15 @@ class CDecoder Z7_final:
   public ICompressGetInStreamProcessedSize,
   public ICompressReadUnusedFromInBuf,
   public ICompressSetBufSize,
+  public ICompressSetPresetDictionary,
  #ifndef Z7_NO_READ_FROM_CODER_ZSTD
   public ICompressSetInStream,
   public ICompressSetOutStreamSize,
   public ISequentialInStream,
+ #endif
+ #ifndef Z7_ST
+  public ICompressSetCoderMt,
+  public ICompressSetMemLimit,
  #endif
   public CMyUnknownImp
 {
@@ -39,10 +45,15 @@ class CDecoder Z7_final:
   Z7_COM_QI_ENTRY(ICompressGetInStreamProcessedSize)
   Z7_COM_QI_ENTRY(ICompressReadUnusedFromInBuf)
   Z7_COM_QI_ENTRY(ICompressSetBufSize)
+  Z7_COM_QI_ENTRY(ICompressSetPresetDictionary)
  #ifndef Z7_NO_READ_FROM_CODER_ZSTD
   Z7_COM_QI_ENTRY(ICompressSetInStream)
   Z7_COM_QI_ENTRY(ICompressSetOutStreamSize)
   Z7_COM_QI_ENTRY(ISequentialInStream)
+ #endif
+ #ifndef Z7_ST
+  Z7_COM_QI_ENTRY(ICompressSetCoderMt)
+  Z7_COM_QI_ENTRY(ICompressSetMemLimit)
  #endif
   Z7_COM_QI_END
   Z7_COM_ADDREF_RELEASE
@@ -53,19 +64,35 @@ class CDecoder Z7_final:
   Z7_IFACE_COM7_IMP(ICompressGetInStreamProcessedSize)
   Z7_IFACE_COM7_IMP(ICompressReadUnusedFromInBuf)
   Z7_IFACE_COM7_IMP(ICompressSetBufSize)
+  Z7_IFACE_COM7_IMP(ICompressSetPresetDictionary)
  #ifndef Z7_NO_READ_FROM_CODER_ZSTD
   Z7_IFACE_COM7_IMP(ICompressSetOutStreamSize)
   Z7_IFACE_COM7_IMP(ICompressSetInStream)
   Z7_IFACE_COM7_IMP(ISequentialInStream)
  #endif
+ #ifndef Z7_ST
+  Z7_IFACE_COM7_IMP(ICompressSetCoderMt)
+  Z7_IFACE_COM7_IMP(ICompressSetMemLimit)
+ #endif
 
+  HRESULT CreateDec();
   HRESULT Prepare(const UInt64 *outSize);
+ #ifndef Z7_ST
+  HRESULT CodeMt(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+      const UInt64 *outSize, ICompressProgressInfo *progress,
+      CZstdDecMtRes &mtRes, HRESULT &hres_Read);
+ #endif
 
   UInt32 _outStepMask;
   CZstdDecHandle _dec;
+  bool _dictWasSet;
 public:
   UInt64 _inProcessed;
   CZstdDecState _state;
+ #ifndef Z7_ST
+  UInt32 _numThreads;
+  UInt64 _memUsage;
+ #endif
 
 private:
   UInt32 _inBufSize;
@@ -73,6 +100,11 @@ private:
   Byte *_inBuf;
   size_t _afterDecoding_tempPos;
 
+ #ifndef Z7_ST
+  CZstdDecMtHandle _decMt;
+  bool _mtReadMode;
+ #endif
+
  #ifndef Z7_NO_READ_FROM_CODER_ZSTD
   CMyComPtr<ISequentialInStream> _inStream;
   HRESULT _hres_Read;
@@ -0,0 +1,206 @@
+// ZstdEncoder.cpp
+
+#include "StdAfx.h"
+
+#include "../../../C/Alloc.h"
+#include "../../../C/LzmaEnc.h"
+
+#include "../Common/CWrappers.h"
+#include "../Common/StreamUtils.h"
+
+#include "ZstdEncoder.h"
+
+namespace NCompress {
+
+namespace NLzma {
+
+HRESULT SetLzmaProp(PROPID propID, const PROPVARIANT &prop, CLzmaEncProps &ep);
+
+}
+
+namespace NZstd {
+
+CEncoder::CEncoder()
+{
+  _encoder = NULL;
+  _inputProcessed = 0;
+  ZstdEncProps_Init(&_props);
+  _encoder = ZstdEnc_Create(&g_AlignedAlloc, &g_BigAlloc);
+  if (!_encoder)
+    throw 1;
+}
+
+CEncoder::~CEncoder()
+{
+  if (_encoder)
+    ZstdEnc_Destroy(_encoder);
+}
+
+
+/* we reuse the parser of LZMA properties for match finder,
+   affinity and some other common properties */
+
+HRESULT SetZstdProp(PROPID propID, const PROPVARIANT &prop, CZstdEncProps &ep)
+{
+  switch (propID)
+  {
+    case NCoderPropID::kDefaultProp:
+    case NCoderPropID::kLevel:
+    {
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      const UInt32 v = prop.ulVal;
+      if (propID == NCoderPropID::kDefaultProp)
+      {
+        // (-m0=zstd:25) means (1 << 25) window size, as for other methods
+        if (v < ZSTD_ENC_WINDOW_LOG_MIN || v > ZSTD_ENC_WINDOW_LOG_MAX)
+          return E_INVALIDARG;
+        ep.windowSize = (UInt32)1 << (unsigned)v;
+        return S_OK;
+      }
+      ep.level = (int)(v > ZSTD_ENC_LEVEL_MAX ? ZSTD_ENC_LEVEL_MAX : v);
+      return S_OK;
+    }
+    case NCoderPropID::kCheckSize:
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      if (prop.ulVal != 0 && prop.ulVal != 4)
+        return E_INVALIDARG;
+      ep.checksum = (prop.ulVal != 0);
+      return S_OK;
+    case NCoderPropID::kNumThreads:
+      if (prop.vt != VT_UI4)
+        return E_INVALIDARG;
+      ep.numThreads = (int)(prop.ulVal > 2 ? 2 : prop.ulVal);
+      return S_OK;
+    default:
+      break;
+  }
+
+  CLzmaEncProps lp;
+  LzmaEncProps_Init(&lp);
+  lp.dictSize = ep.windowSize;
+  lp.btMode = ep.btMode;
+  lp.numHashBytes = ep.numHashBytes;
+  lp.mc = ep.mc;
+  lp.fb = ep.fb;
+  lp.algo = ep.algo;
+  lp.reduceSize = ep.reduceSize;
+  lp.affinity = ep.affinity;
+  lp.affinityInGroup = ep.affinityInGroup;
+  lp.affinityGroup = ep.affinityGroup;
+
+  switch (propID)
+  {
+    case NCoderPropID::kDictionarySize:
+    case NCoderPropID::kMatchFinder:
+    case NCoderPropID::kMatchFinderCycles:
+    case NCoderPropID::kNumFastBytes:
+    case NCoderPropID::kAlgorithm:
+    case NCoderPropID::kReduceSize:
+    case NCoderPropID::kAffinity:
+    case NCoderPropID::kAffinityInGroup:
+    case NCoderPropID::kThreadGroup:
+      RINOK(NLzma::SetLzmaProp(propID, prop, lp))
+      break;
+    default:
+      // we ignore properties of other methods (lc, lp, pb, ...)
+      return S_OK;
+  }
+
+  if (propID == NCoderPropID::kDictionarySize
+      && lp.dictSize > ((UInt32)1 << ZSTD_ENC_WINDOW_LOG_MAX))
+    return E_INVALIDARG;
+  ep.windowSize = lp.dictSize;
+  ep.btMode = lp.btMode;
+  ep.numHashBytes = lp.numHashBytes;
+  ep.mc = lp.mc;
+  ep.fb = lp.fb;
+  ep.algo = lp.algo;
+  ep.reduceSize = lp.reduceSize;
+  ep.affinity = lp.affinity;
+  ep.affinityInGroup = lp.affinityInGroup;
+  ep.affinityGroup = lp.affinityGroup;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CEncoder::SetCoderProperties(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  CZstdEncProps props;
+  ZstdEncProps_Init(&props);
+
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    RINOK(SetZstdProp(propIDs[i], coderProps[i], props))
+  }
+  RINOK(SResToHRESULT(ZstdEnc_SetProps(_encoder, &props)))
+  _props = props;
+  return S_OK;
+}
+
+
+Z7_COM7F_IMF(CEncoder::SetCoderPropertiesOpt(const PROPID *propIDs,
+    const PROPVARIANT *coderProps, UInt32 numProps))
+{
+  for (UInt32 i = 0; i < numProps; i++)
+  {
+    const PROPVARIANT &prop = coderProps[i];
+    const PROPID propID = propIDs[i];
+    if (propID == NCoderPropID::kExpectedDataSize)
+      if (prop.vt == VT_UI8)
+        ZstdEnc_SetDataSize(_encoder, prop.uhVal.QuadPart);
+  }
+  return S_OK;
+}
+
+
+/* coder properties for 7z archive (5 bytes) in the format of zstd plugins:
+     Byte[0] : major version of zstd format
+     Byte[1] : minor version of zstd format
+     Byte[2] : level
+     Byte[3], Byte[4] : reserved (zeros)
+   the decoder doesn't need these properties. */
+
+Z7_COM7F_IMF(CEncoder::WriteCoderProperties(ISequentialOutStream *outStream))
+{
+  CZstdEncProps props = _props;
+  ZstdEncProps_Normalize(&props);
+  Byte p[5];
+  p[0] = 1;
+  p[1] = 5;
+  p[2] = (Byte)props.level;
+  p[3] = 0;
+  p[4] = 0;
+  return WriteStream(outStream, p, sizeof(p));
+}
+
+
+#define RET_IF_WRAP_ERROR(wrapRes, sRes, sResErrorCode) \
+  if (wrapRes != S_OK /* && (sRes == SZ_OK || sRes == sResErrorCode) */) return wrapRes;
+
+Z7_COM7F_IMF(CEncoder::Code(ISequentialInStream *inStream, ISequentialOutStream *outStream,
+    const UInt64 * /* inSize */, const UInt64 * /* outSize */, ICompressProgressInfo *progress))
+{
+  CSeqInStreamWrap inWrap;
+  CSeqOutStreamWrap outWrap;
+  CCompressProgressWrap progressWrap;
+
+  inWrap.Init(inStream);
+  outWrap.Init(outStream);
+  progressWrap.Init(progress);
+
+  const SRes res = ZstdEnc_Encode(_encoder, &outWrap.vt, &inWrap.vt,
+      progress ? &progressWrap.vt : NULL);
+
+  _inputProcessed = inWrap.Processed;
+
+  RET_IF_WRAP_ERROR(inWrap.Res, res, SZ_ERROR_READ)
+  RET_IF_WRAP_ERROR(outWrap.Res, res, SZ_ERROR_WRITE)
+  RET_IF_WRAP_ERROR(progressWrap.Res, res, SZ_ERROR_PROGRESS)
+
+  return SResToHRESULT(res);
+}
+
+}}
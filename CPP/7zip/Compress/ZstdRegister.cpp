@@ -0,0 +1,22 @@
+// ZstdRegister.cpp
+
+#include "StdAfx.h"
+
+#include "../Common/RegisterCodec.h"
+
+#include "ZstdDecoder.h"
+
+#ifndef Z7_EXTRACT_ONLY
+#include "ZstdEncoder.h"
+#endif
+
+namespace NCompress {
+namespace NZstd {
+
+REGISTER_CODEC_E(ZSTD,
+    CDecoder(),
+    CEncoder(),
+    0x4F71101,
+    "ZSTD")
+
+}}
@@ -139,6 +139,8 @@ namespace NCoderPropID
     kNumThreadGroups,   // VT_UI4
     kThreadGroup,       // VT_UI4
     kAffinityInGroup,   // VT_UI8
+    kBlockPrefixSize,   // VT_UI4 or VT_UI8 : LZMA2, PPMD-MT: the size of preceding data that seeds each block encoder
+    kSharedPrefixSize,  // VT_UI4 or VT_UI8 : PPMD-MT: the size of data at start of stream that trains shared model for all blocks
     /*
     // kHash3Bits,          // VT_UI4
     // kHash2Bits,          // VT_UI4
@@ -237,6 +239,30 @@ Z7_IFACE_CONSTR_CODER(ICompressSetMemLimit, 0x28)
 Z7_IFACE_CONSTR_CODER(ICompressReadUnusedFromInBuf, 0x29)
 
 
+/*
+  ICompressSetPresetDictionary is supported by LZMA2 coders and by Zstd decoder.
+  Preset dictionary is the data that precedes the data of stream.
+  The coder can use that data as dictionary, but that data is not encoded.
+  The coder keeps a copy of data. (size == 0) disables preset dictionary.
+  Encoder:
+    call SetPresetDictionary() before ICompressCoder::Code().
+    The encoder writes the flag of preset dictionary to coder properties.
+  Decoder:
+    call SetPresetDictionary() before ICompressCoder::Code().
+    The decoder uses preset dictionary only if coder properties require it.
+    If coder properties require preset dictionary, and it was not set,
+    the decoder returns E_NOTIMPL.
+  Zstd decoder:
+    the data can be raw content or formatted zstd dictionary (E_INVALIDARG, if it's incorrect).
+    The dictionary is used for frames without Dictionary_ID and for frames with same
+    Dictionary_ID. The frames with Dictionary_ID can use also the dictionaries
+    that were set before and that were kept in cache of decoder.
+*/
+#define Z7_IFACEM_ICompressSetPresetDictionary(x) \
+  x(SetPresetDictionary(const Byte *data, UInt32 size))
+Z7_IFACE_CONSTR_CODER(ICompressSetPresetDictionary, 0x2A)
+
+
 #define Z7_IFACEM_ICompressGetSubStreamSize(x) \
   x(GetSubStreamSize(UInt64 subStream, UInt64 *value))
 Z7_IFACE_CONSTR_CODER(ICompressGetSubStreamSize, 0x30)
@@ -206,5 +206,79 @@ inputs:
 
 Z7_IFACE_CONSTR_STREAM(IStreamSetRestriction, 0x10)
 
+
+/*
+IStreamGetRangePtr::GetRangePtr(UInt64 offset, UInt32 size, const Byte **data, UInt32 *availSize)
+
+  It's optional interface for input streams that have direct access
+  to stream data in memory (for example, memory mapped file).
+  The caller can decode the data directly from returned buffer
+  without copying it through Read().
+
+  It doesn't change current seek position of stream.
+
+  returns:
+    S_OK    : (*data) points to data at (offset) position.
+              (*availSize) is the number of bytes available in (*data).
+              (*availSize) can be smaller than (size), if (offset + size)
+              is larger than stream size.
+              (*data) is valid until the stream object is released.
+    S_FALSE : the data is not available for direct access.
+              The caller must use Read() then.
+*/
+
+#define Z7_IFACEM_IStreamGetRangePtr(x) \
+  x(GetRangePtr(UInt64 offset, UInt32 size, const Byte **data, UInt32 *availSize)) \
+
+Z7_IFACE_CONSTR_STREAM(IStreamGetRangePtr, 0x11)
+
+
+/*
+IStreamSetAccessHint::SetAccessHint(UInt64 offset, UInt64 size, UInt32 hint)
+
+  The caller informs the input stream about expected access pattern
+  for region [offset, offset + size). (size == 0) means the region up to the end of stream.
+  The callee can use it for read-ahead tuning (madvise() / posix_fadvise()).
+  The hint is advisory only: it doesn't change the data or seek position.
+*/
+
+namespace NStreamAccessHint
+{
+  enum
+  {
+    kNormal,
+    kSequential,
+    kRandom,
+    kWillNeed,
+    kDontNeed
+  };
+}
+
+#define Z7_IFACEM_IStreamSetAccessHint(x) \
+  x(SetAccessHint(UInt64 offset, UInt64 size, UInt32 hint)) \
+
+Z7_IFACE_CONSTR_STREAM(IStreamSetAccessHint, 0x12)
+
+
+/*
+IStreamGetDataRange::GetDataRange(UInt64 pos, UInt64 *dataPos, UInt64 *dataEnd)
+
+  It's supported by input streams of sparse files.
+  It finds first data region [*dataPos, *dataEnd) at (pos) or after (pos).
+  The bytes in holes (the regions without data) are zeros.
+  It doesn't change current seek position of stream.
+
+  returns:
+    S_OK    : the region was found.
+              (*dataPos == *dataEnd == streamSize), if there is no data after (pos).
+    S_FALSE : the stream is not sparse, or hole detection is not supported.
+              The caller must consider all stream as data.
+*/
+
+#define Z7_IFACEM_IStreamGetDataRange(x) \
+  x(GetDataRange(UInt64 pos, UInt64 *dataPos, UInt64 *dataEnd)) \
+
+Z7_IFACE_CONSTR_STREAM(IStreamGetDataRange, 0x13)
+
 Z7_PURE_INTERFACES_END
 #endif
@@ -15,7 +15,7 @@
 
 #include <stdio.h>
 
-#ifdef Z7_LARGE_PAGES
+#if defined(Z7_LARGE_PAGES) || defined(Z7_HUGE_PAGES)
 #include "../../../../C/Alloc.h"
 #endif
 
@@ -42,6 +42,7 @@
 
 extern bool g_CaseSensitive;
 extern bool g_PathTrailReplaceMode;
+extern bool g_MapArcFiles;
 
 #ifdef Z7_LARGE_PAGES
 extern
@@ -171,6 +172,7 @@ enum Enum
   kStdOut,
 
   kLargePages,
+  kMapArcFiles,
   kListfileCharSet,
   kConsoleCharSet,
   kTechMode,
@@ -201,6 +203,7 @@ enum Enum
   kAltStreams,
   kReplaceColonForAltStream,
   kWriteToAltStreamIfColon,
+  kSparseFiles,
 
   kNameTrailReplace,
 
@@ -322,6 +325,7 @@ static const CSwitchForm kSwitchForms[] =
   { "so", SWFRM_SIMPLE },
 
   { "slp", SWFRM_STRING },
+  { "smm", SWFRM_MINUS },
   { "scs", SWFRM_STRING },
   { "scc", SWFRM_STRING },
   { "slt", SWFRM_SIMPLE },
@@ -352,6 +356,7 @@ static const CSwitchForm kSwitchForms[] =
   { "sns", SWFRM_MINUS },
   { "snr", SWFRM_SIMPLE },
   { "snc", SWFRM_SIMPLE },
+  { "snp", SWFRM_MINUS },
   
   { "snt", SWFRM_MINUS },
   
@@ -1109,6 +1114,9 @@ void CArcCmdLineParser::Parse1(const UStringVector &commandStrings,
   NSecurity::EnablePrivilege_SymLink();
   #endif
   
+  if (parser[NKey::kMapArcFiles].ThereIs)
+    g_MapArcFiles = !parser[NKey::kMapArcFiles].WithMinus;
+
   // options.LargePages = false;
 
   if (parser[NKey::kLargePages].ThereIs)
@@ -1144,6 +1152,10 @@ void CArcCmdLineParser::Parse1(const UStringVector &commandStrings,
       #endif
     }
     #endif
+    #ifdef Z7_HUGE_PAGES
+    if (slp > 0)
+      SetHugePageSize();
+    #endif
   }
 
 
@@ -1479,6 +1491,8 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
   
   SetBoolPair(parser, NKey::kStoreOwnerId, options.StoreOwnerId);
   SetBoolPair(parser, NKey::kStoreOwnerName, options.StoreOwnerName);
+
+  SetBoolPair(parser, NKey::kSparseFiles, options.SparseFiles);
   /*
   bool supportSymLink = options.SymLinks.Val;
   if (!options.SymLinks.Def)
@@ -1533,6 +1547,7 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
       nt.WriteToAltStreamIfColon = parser[NKey::kWriteToAltStreamIfColon].ThereIs;
 
       nt.ExtractOwner = options.StoreOwnerId.Val; // StoreOwnerName
+      nt.SparseOutFile = options.SparseFiles.Val;
 
       if (parser[NKey::kPreserveATime].ThereIs)
         nt.PreserveATime = true;
@@ -1680,6 +1695,7 @@ void CArcCmdLineParser::Parse2(CArcCmdLineOptions &options)
     
     updateOptions.StoreOwnerId = options.StoreOwnerId;
     updateOptions.StoreOwnerName = options.StoreOwnerName;
+    updateOptions.SparseFiles = options.SparseFiles.Val;
 
     updateOptions.EMailMode = parser[NKey::kEmail].ThereIs;
     if (updateOptions.EMailMode)
@@ -77,6 +77,8 @@ struct CArcCmdLineOptions
   CBoolPair StoreOwnerId;
   CBoolPair StoreOwnerName;
 
+  CBoolPair SparseFiles;
+
   AString ListFields;
 
   int ConsoleCodePage;
@@ -302,6 +302,9 @@ CArchiveExtractCallback::CArchiveExtractCallback():
     Is_elimPrefix_Mode(false),
     _arc(NULL),
     _multiArchives(false)
+  #ifdef Z7_FILE_ASYNC_IO
+    , _asyncFiles_WasTried(false)
+  #endif
 {
   #ifdef Z7_USE_SECURITY_CODE
   _saclEnabled = InitLocalPrivileges();
@@ -1189,6 +1192,12 @@ HRESULT CArchiveExtractCallback::CheckExistFile(FString &fullProcessedPath, bool
 
   if (fileInfo.Find(fullProcessedPath))
   {
+   #ifdef Z7_FILE_ASYNC_IO
+    // the file could be extracted from this archive already, and
+    // it can still have pending writes, or its times and attributes are not set still.
+    _asyncFiles.WaitAll();
+   #endif
+
     if (_overwriteMode == NExtract::NOverwriteMode::kSkip)
       return S_OK;
     
@@ -1460,6 +1469,11 @@ HRESULT CArchiveExtractCallback::GetExtractStream(CMyComPtr<ISequentialOutStream
 
   // ---------- CREATE WRITE FILE -----
 
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_isSplit)
+    _asyncFiles.WaitAll();
+ #endif
+
   _outFileStreamSpec = new COutFileStream;
   CMyComPtr<IOutStream> outFileStream_Loc(_outFileStreamSpec);
   
@@ -1536,6 +1550,20 @@ HRESULT CArchiveExtractCallback::GetExtractStream(CMyComPtr<ISequentialOutStream
         RINOK(SendMessageError_with_LastError("Cannot seek to begin of file", fullProcessedPath))
       }
     } // PreAllocateOutFile
+
+    if (_ntOptions.SparseOutFile)
+      _outFileStreamSpec->Set_Sparse();
+
+   #ifdef Z7_FILE_ASYNC_IO
+    if (!_asyncFiles_WasTried)
+    {
+      _asyncFiles_WasTried = true;
+      // if io_uring is not available, we use synchronous writing
+      _asyncFiles.Create();
+    }
+    if (_asyncFiles.IsCreated())
+      _outFileStreamSpec->Set_Async(&_asyncFiles, fullProcessedPath);
+   #endif
     
     #ifdef SUPPORT_ALT_STREAMS
     if (_isRenamed && !_item.IsAltStream)
@@ -1599,6 +1627,10 @@ Z7_COM7F_IMF(CArchiveExtractCallback::GetStream(UInt32 index, ISequentialOutStre
   _outFileStream.Release();
   _bufPtrSeqOutStream.Release();
 
+ #ifdef Z7_FILE_ASYNC_IO
+  RINOK(SendAsyncErrors())
+ #endif
+
   _encrypted = false;
   _isSplit = false;
   _curSize_Defined = false;
@@ -1982,6 +2014,22 @@ HRESULT CArchiveExtractCallback::CloseFile()
         t.MTime_Defined ? &t.MTime : NULL);
   // #endif
 
+ #ifdef Z7_FILE_ASYNC_IO
+  if (_outFileStreamSpec->IsAsync())
+  {
+    // the finishing thread of (_asyncFiles) sets owner and attributes after closing of file
+    if (_needSetAttrib && CanSetAttrib())
+    {
+      if (_fi.Owner.Id_Defined &&
+          _fi.Group.Id_Defined)
+        _outFileStreamSpec->Set_Async_Owner(_fi.Owner.Id, _fi.Group.Id);
+      if (_fi.Attrib_Defined)
+        _outFileStreamSpec->Set_Async_Attrib(_fi.Attrib);
+    }
+    _needSetAttrib = false;
+  }
+ #endif
+
   RINOK(_outFileStreamSpec->Close())
   _outFileStream.Release();
 
@@ -2621,23 +2669,49 @@ static void SetAttrib_Base(const FString &path, const CProcessedFileInfo &fi,
   }
 }
 
-void CArchiveExtractCallback::SetAttrib() const
+bool CArchiveExtractCallback::CanSetAttrib() const
 {
 #ifndef _WIN32
   // Linux now doesn't support permissions for symlinks
   if (_isSymLinkCreated)
-    return;
+    return false;
 #endif
 
-  if (_itemFailure
-      || _diskFilePath.IsEmpty()
-      || _stdOutMode
-      || !_extractMode)
-    return;
+  return !_itemFailure
+      && !_diskFilePath.IsEmpty()
+      && !_stdOutMode
+      && _extractMode;
+}
+
+void CArchiveExtractCallback::SetAttrib() const
+{
+  if (CanSetAttrib())
+    SetAttrib_Base(_diskFilePath, _fi, *this);
+}
 
-  SetAttrib_Base(_diskFilePath, _fi, *this);
+
+#ifdef Z7_FILE_ASYNC_IO
+
+HRESULT CArchiveExtractCallback::SendAsyncErrors()
+{
+  NWindows::NFile::NIO::CAsyncOutFiles::CError e;
+  while (_asyncFiles.GetError(e))
+  {
+    const char *s;
+    switch (e.Type)
+    {
+      case NWindows::NFile::NIO::CAsyncOutFiles::k_Write:  s = "Cannot write output file"; break;
+      case NWindows::NFile::NIO::CAsyncOutFiles::k_Close:  s = "Cannot close output file"; break;
+      case NWindows::NFile::NIO::CAsyncOutFiles::k_Owner:  s = "Cannot set owner"; break;
+      default:                                             s = "Cannot set file attribute"; break;
+    }
+    RINOK(SendMessageError_with_Error(HRESULT_FROM_WIN32(e.Error), s, e.Path))
+  }
+  return S_OK;
 }
 
+#endif
+
 
 #ifdef Z7_USE_SECURITY_CODE
 HRESULT CArchiveExtractCallback::SetSecurityInfo(UInt32 indexInArc, const FString &path) const
@@ -3060,6 +3134,15 @@ HRESULT CArchiveExtractCallback::CloseArc()
 {
   // we call CloseReparseAndFile() here because we can have non-closed file in some cases?
   HRESULT res = CloseReparseAndFile();
+ #ifdef Z7_FILE_ASYNC_IO
+  // we wait for closing of files before setting of directory times and links
+  _asyncFiles.WaitAll();
+  {
+    const HRESULT res2 = SendAsyncErrors();
+    if (res == S_OK)
+      res = res2;
+  }
+ #endif
 #ifdef SUPPORT_LINKS
   {
     const HRESULT res2 = SetPostLinks();
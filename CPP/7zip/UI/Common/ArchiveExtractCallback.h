@@ -60,6 +60,8 @@ struct CExtractNtOptions
   bool ExtractOwner;
 
   bool PreAllocateOutFile;
+  // zero blocks are not written to output files (the files will be sparse)
+  bool SparseOutFile;
 
   // used for hash arcs only, when we open external files
   bool PreserveATime;
@@ -73,6 +75,7 @@ struct CExtractNtOptions
       ReplaceColonForAltStream(false),
       WriteToAltStreamIfColon(false),
       ExtractOwner(false),
+      SparseOutFile(false),
       PreserveATime(false),
       OpenShareForWrite(false),
       SymLinks_DangerousLevel(5),
@@ -435,6 +438,12 @@ private:
 #endif
 // #endif
 
+#ifdef Z7_FILE_ASYNC_IO
+  // it's declared before (_outFileStream), because (_outFileStream) can use it in destructor
+  NWindows::NFile::NIO::CAsyncOutFiles _asyncFiles;
+  bool _asyncFiles_WasTried;
+#endif
+
   COutFileStream *_outFileStreamSpec;
   CMyComPtr<ISequentialOutStream> _outFileStream;
 
@@ -470,6 +479,7 @@ private:
 
   FString Hash_GetFullFilePath();
 
+  bool CanSetAttrib() const;
   void SetAttrib() const;
 
 public:
@@ -603,6 +613,9 @@ private:
 
   HRESULT CloseFile();
   HRESULT CloseReparseAndFile();
+#ifdef Z7_FILE_ASYNC_IO
+  HRESULT SendAsyncErrors();
+#endif
   HRESULT SetDirsTimes();
   HRESULT SetSecurityInfo(UInt32 indexInArc, const FString &path) const;
 };
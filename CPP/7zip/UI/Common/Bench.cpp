@@ -18,6 +18,10 @@
 #endif
 #endif // USE_POSIX_TIME
 
+#if !defined(USE_POSIX_TIME) && !defined(Z7_EXTERNAL_CODECS)
+#include <time.h>
+#endif
+
 #ifdef _WIN32
 #define USE_ALLOCA
 #endif
@@ -32,8 +36,13 @@
 #endif
 
 #include "../../../../C/7zCrc.h"
+#include "../../../../C/Alloc.h"
+#include "../../../../C/LzFind.h"
 #include "../../../../C/RotateDefs.h"
 #include "../../../../C/CpuArch.h"
+#ifndef Z7_EXTERNAL_CODECS
+#include "../../../../C/Lzma2Enc.h"
+#endif
 
 #ifndef Z7_ST
 #include "../../../Windows/Synchronization.h"
@@ -1850,11 +1859,11 @@ static HRESULT MethodBench(
     {
       if (numThreads == 1 && method.Get_NumThreads() < 0)
         method.AddProp_NumThreads(1);
-      const UInt32 numLzmaThreads = method.Get_Lzma_NumThreads();
+      const UInt32 numLzmaThreads = method.Get_Lzma_NumThreads(false);
       if (numThreads > 1 && numLzmaThreads > 1)
       {
-        numEncoderThreads = (numThreads + 1) / 2; // 20.03
-        numSubDecoderThreads = 2;
+        numEncoderThreads = (numThreads + numLzmaThreads - 1) / numLzmaThreads; // 20.03
+        numSubDecoderThreads = numLzmaThreads;
       }
     }
 
@@ -2715,6 +2724,8 @@ static const CBenchMethod g_Bench[] =
   { 80, 24, 1220,  145,   20, "LZMA:x5:mt2" },
 
   { 10, 16,  124,   40,   14, "Deflate:x1" },
+  // (mc1) gives literal-heavy stream that shows the speed of Huffman decoding
+  { 10, 16,  340,   40,   14, "Deflate:mc1" },
   { 20, 16,  376,   40,   14, "Deflate:x5" },
   { 10, 16, 1082,   40,   14, "Deflate:x7" },
   { 10, 17,  422,   40,   14, "Deflate64:x5" },
@@ -2724,6 +2735,10 @@ static const CBenchMethod g_Bench[] =
   { 10, 19,  815,  122,  122, "BZip2:x5:mt2" },
   { 10, 19, 2530,  122,  122, "BZip2:x7" },
 
+  { 10, 19,  170,   10,    2, "ZSTD:x1" },
+  { 20, 21,  630,   14,    3, "ZSTD:x5" },
+  { 10, 23,  700,   16,    3, "ZSTD:x9:mt2" },
+
   // { 10, 18, 1010,    0, 1150, "PPMDZip:x1" },
   { 10, 18, 1010,    0, 1150, "PPMD:x1" },
   // { 10, 22, 1655,    0, 1830, "PPMDZip:x5" },
@@ -3080,6 +3095,27 @@ void Add_LargePages_String(AString &s)
 #endif
 
 
+#ifdef Z7_HUGE_PAGES
+
+extern "C"
+{
+  extern SIZE_T g_HugePageSize;
+}
+
+// transparent huge pages
+static void Add_HugePages_String(AString &s)
+{
+  if (g_HugePageSize != 0)
+  {
+    s.Add_OptSpaced("(THP-");
+    s.Add_UInt64(g_HugePageSize >> 20);
+    s += "M)";
+  }
+}
+
+#endif
+
+
 
 static void PrintRequirements(IBenchPrintCallback &f, const char *sizeString,
     bool size_Defined, UInt64 size, const char *threadsString, UInt32 numThreads)
@@ -3099,6 +3135,14 @@ static void PrintRequirements(IBenchPrintCallback &f, const char *sizeString,
     f.Print(s);
   }
   #endif
+
+  #ifdef Z7_HUGE_PAGES
+  {
+    AString s;
+    Add_HugePages_String(s);
+    f.Print(s);
+  }
+  #endif
   
   f.Print(",  # ");
   f.Print(threadsString);
@@ -3752,6 +3796,220 @@ static void Bench_BW_Print_Usage_Speed(IBenchPrintCallback &f,
 }
 
 
+
+/*
+  LzFind_Bench() measures the speed of match finder from LzFind.c without LZMA encoder.
+  It calls GetMatches() and then Skip(len - 1) for longest match,
+  like fast mode of LZMA encoder.
+  "b -mm=LzFind" : it tests hc4, hc5, bt4, bt5
+  "b -mm=LzFind -mmf=bt4" : it tests only specified match finder
+*/
+
+static const char * const k_LzFind_MatchFinders[] = { "hc4", "hc5", "bt4", "bt5" };
+
+static HRESULT LzFind_Bench(IBenchPrintCallback &f,
+    const COneMethodInfo &method, UInt32 numIterations,
+    UInt64 dict, const Byte *data, size_t size)
+{
+  const unsigned kMatchMaxLen = 273;
+  UInt32 distances[kMatchMaxLen * 2 + 8];
+
+  AString mfName;
+  {
+    const int i = method.FindProp(NCoderPropID::kMatchFinder);
+    if (i >= 0)
+    {
+      const NWindows::NCOM::CPropVariant &val = method.Props[(unsigned)i].Value;
+      if (val.vt != VT_BSTR)
+        return E_INVALIDARG;
+      mfName.SetFromWStr_if_Ascii(val.bstrVal);
+      mfName.MakeLower_Ascii();
+    }
+  }
+
+  LzFindPrepare();
+
+  f.NewLine();
+  f.Print("LzFind  size:");
+  PrintNumber(f, size >> 10, 0);
+  f.Print(" KiB  dict:");
+  PrintNumber(f, dict >> 10, 0);
+  f.Print(" KiB");
+  f.NewLine();
+  f.NewLine();
+  PrintLeft(f, "MF", 8);
+  PrintRight(f, "MB/s", 8);
+  PrintRight(f, "Matches", 12);
+  f.NewLine();
+
+  bool wasTested = false;
+
+  for (unsigned k = 0; k < Z7_ARRAY_SIZE(k_LzFind_MatchFinders); k++)
+  {
+    const char *name = k_LzFind_MatchFinders[k];
+    if (!mfName.IsEmpty() && !mfName.IsEqualTo(name))
+      continue;
+    wasTested = true;
+
+    UInt64 bestTime = 0;
+    UInt64 numMatches = 0;
+
+    for (UInt32 iter = 0; iter < numIterations; iter++)
+    {
+      CMatchFinder mf;
+      IMatchFinder2 vt;
+      MatchFinder_Construct(&mf);
+      mf.btMode = (Byte)(name[0] == 'b' ? 1 : 0);
+      mf.numHashBytes = (UInt32)(name[2] - '0');
+      mf.expectedDataSize = size;
+      MatchFinder_SET_DIRECT_INPUT_BUF(&mf, data, size)
+      if (!MatchFinder_Create(&mf, (UInt32)dict, 0, kMatchMaxLen, 0, &g_BigAlloc))
+      {
+        MatchFinder_Free(&mf, &g_BigAlloc);
+        return E_OUTOFMEMORY;
+      }
+      MatchFinder_CreateVTable(&mf, &vt);
+
+      const UInt64 startTime = ::GetTimeCount();
+      vt.Init(&mf);
+      numMatches = 0;
+      while (vt.GetNumAvailableBytes(&mf) != 0)
+      {
+        const UInt32 numPairs = (UInt32)(vt.GetMatches(&mf, distances) - distances);
+        if (numPairs != 0)
+        {
+          numMatches++;
+          const UInt32 len = distances[(size_t)numPairs - 2];
+          if (len > 1)
+            vt.Skip(&mf, len - 1);
+        }
+      }
+      const UInt64 delta = ::GetTimeCount() - startTime;
+      MatchFinder_Free(&mf, &g_BigAlloc);
+
+      if (iter == 0 || bestTime > delta)
+        bestTime = delta;
+    }
+
+    if (bestTime == 0)
+      bestTime = 1;
+    PrintLeft(f, name, 8);
+    PrintNumber(f, MyMultDiv64(size, GetFreq(), bestTime) / 1000000, 7);
+    PrintNumber(f, numMatches, 11);
+    f.NewLine();
+  }
+
+  return wasTested ? S_OK : E_INVALIDARG;
+}
+
+
+#ifndef Z7_EXTERNAL_CODECS
+
+/*
+  LzmaPrices_Bench() shows the counters of price table updates in LZMA encoder.
+  It uses LZMA2 encoder in single thread mode, so the chunks of LZMA2
+  can reuse the price tables of previous chunk.
+  "b -mm=LzmaPrices" : it tests levels 1, 5, 7, 9
+  "b -mm=LzmaPrices -mx7" : it tests only specified level
+  Prices% is the share of price updates in encoding time (measured with clock()).
+*/
+
+static const unsigned k_LzmaPrices_Levels[] = { 1, 5, 7, 9 };
+
+static HRESULT LzmaPrices_Bench(IBenchPrintCallback &f,
+    const COneMethodInfo &method, UInt32 numIterations,
+    UInt64 dict, const Byte *data, size_t size)
+{
+  const bool levelIsDefined = (method.FindProp(NCoderPropID::kLevel) >= 0);
+
+  CMidBuffer outBuf;
+  const size_t outSize = size + (size >> 10) + (1 << 16);
+  ALLOC_WITH_HRESULT(&outBuf, outSize)
+
+  f.NewLine();
+  f.Print("LzmaPrices  size:");
+  PrintNumber(f, size >> 10, 0);
+  f.Print(" KiB  dict:");
+  PrintNumber(f, dict >> 10, 0);
+  f.Print(" KiB");
+  f.NewLine();
+  f.NewLine();
+  PrintLeft(f, "Level", 6);
+  PrintRight(f, "MB/s", 7);
+  PrintRight(f, "Ratio%", 8);
+  PrintRight(f, "Full", 8);
+  PrintRight(f, "Refresh", 10);
+  PrintRight(f, "RepLen", 10);
+  PrintRight(f, "Reused", 8);
+  PrintRight(f, "Prices%", 9);
+  f.NewLine();
+
+  for (unsigned k = 0; k < Z7_ARRAY_SIZE(k_LzmaPrices_Levels); k++)
+  {
+    const unsigned level = levelIsDefined ? method.GetLevel() : k_LzmaPrices_Levels[k];
+
+    CLzma2EncProps props;
+    Lzma2EncProps_Init(&props);
+    props.lzmaProps.level = (int)level;
+    props.lzmaProps.dictSize = (UInt32)dict;
+    props.lzmaProps.reduceSize = size;
+    props.lzmaProps.numThreads = 1;
+    props.numBlockThreads_Reduced = 1;
+    props.numBlockThreads_Max = 1;
+    props.numTotalThreads = 1;
+
+    UInt64 bestTime = 0;
+    size_t packSize = 0;
+    CLzmaEncPriceStat stat;
+    clock_t totalClocks = 0;
+
+    // the last iteration measures the time of price updates with clock() calls
+    for (UInt32 iter = 0; iter <= numIterations; iter++)
+    {
+      const bool timeMode = (iter == numIterations);
+      CLzma2EncHandle enc = Lzma2Enc_Create(&g_Alloc, &g_BigAlloc);
+      if (!enc)
+        return E_OUTOFMEMORY;
+      SRes res = Lzma2Enc_SetProps(enc, &props);
+      Lzma2Enc_SetPriceStatTimeMode(enc, timeMode ? True : False);
+      packSize = outSize;
+      const UInt64 startTime = ::GetTimeCount();
+      const clock_t startClock = timeMode ? clock() : 0;
+      if (res == SZ_OK)
+        res = Lzma2Enc_Encode2(enc, NULL, outBuf, &packSize, NULL, data, size, NULL);
+      if (timeMode)
+        totalClocks = clock() - startClock;
+      const UInt64 delta = ::GetTimeCount() - startTime;
+      Lzma2Enc_GetPriceStat(enc, &stat);
+      Lzma2Enc_Destroy(enc);
+      if (res != SZ_OK)
+        return res == SZ_ERROR_MEM ? E_OUTOFMEMORY : E_FAIL;
+      if (!timeMode && (iter == 0 || bestTime > delta))
+        bestTime = delta;
+    }
+
+    if (bestTime == 0)
+      bestTime = 1;
+    PrintNumber(f, level, 5);
+    PrintNumber(f, MyMultDiv64(size, GetFreq(), bestTime) / 1000000, 6);
+    PrintPercents(f, packSize, size, 7);
+    PrintNumber(f, stat.NumFull, 7);
+    PrintNumber(f, stat.NumRefresh, 9);
+    PrintNumber(f, stat.NumRepLen, 9);
+    PrintNumber(f, stat.NumReused, 7);
+    PrintPercents(f, stat.Time, (UInt64)totalClocks, 8);
+    f.NewLine();
+
+    if (levelIsDefined)
+      break;
+  }
+
+  return S_OK;
+}
+
+#endif
+
+
 HRESULT Bench(
     DECL_EXTERNAL_CODECS_LOC_VARS
     IBenchPrintCallback *printCallback,
@@ -4255,6 +4513,52 @@ HRESULT Bench(
         kOldLzmaDictBits, printCallback, benchCallback, &benchProps);
   }
 
+  if (methodName.IsEqualTo_Ascii_NoCase("LzFind"))
+  {
+    if (!printCallback)
+      return S_FALSE;
+    if (use_fileData)
+    {
+      if (!dictIsDefined || dict > fileDataBuffer.Size())
+        dict = fileDataBuffer.Size();
+      return LzFind_Bench(*printCallback, method, numIterations,
+          dict, (const Byte *)fileDataBuffer, fileDataBuffer.Size());
+    }
+    if (!dictIsDefined)
+      dict = (UInt64)1 << 22;
+    if (dict < ((UInt64)1 << 16) || dict > ((UInt64)1 << 30))
+      return E_INVALIDARG;
+    CBenchRandomGenerator rg;
+    ALLOC_WITH_HRESULT(&rg, (size_t)dict)
+    rg.GenerateLz((unsigned)GetLogSize(dict - 1), 0);
+    return LzFind_Bench(*printCallback, method, numIterations,
+        dict, (const Byte *)rg, (size_t)dict);
+  }
+
+  #ifndef Z7_EXTERNAL_CODECS
+  if (methodName.IsEqualTo_Ascii_NoCase("LzmaPrices"))
+  {
+    if (!printCallback)
+      return S_FALSE;
+    if (use_fileData)
+    {
+      if (!dictIsDefined || dict > fileDataBuffer.Size())
+        dict = fileDataBuffer.Size();
+      return LzmaPrices_Bench(*printCallback, method, numIterations,
+          dict, (const Byte *)fileDataBuffer, fileDataBuffer.Size());
+    }
+    if (!dictIsDefined)
+      dict = (UInt64)1 << 24;
+    if (dict < ((UInt64)1 << 16) || dict > ((UInt64)1 << 30))
+      return E_INVALIDARG;
+    CBenchRandomGenerator rg;
+    ALLOC_WITH_HRESULT(&rg, (size_t)dict)
+    rg.GenerateLz((unsigned)GetLogSize(dict - 1), 0);
+    return LzmaPrices_Bench(*printCallback, method, numIterations,
+        dict, (const Byte *)rg, (size_t)dict);
+  }
+  #endif
+
   if (methodName.IsEqualTo_Ascii_NoCase("CRC"))
     methodName = "crc32";
 
@@ -296,6 +296,12 @@ struct CDirItem: public NWindows::NFile::NFind::CFileInfoBase
 
 
 
+#if !defined(_WIN32) && !defined(Z7_ST)
+// CDirScanner reads directories in worker threads in advance (see EnumDirItems.cpp)
+#define Z7_DIR_ITEMS_SCAN_MT
+class CDirScanner;
+#endif
+
 class CDirItems
 {
   UStringVector Prefixes;
@@ -353,6 +359,10 @@ public:
 
   IDirItemsCallback *Callback;
 
+ #ifdef Z7_DIR_ITEMS_SCAN_MT
+  CDirScanner *Scanner;
+ #endif
+
   CDirItems();
 
   void AddDirFileInfo(int phyParent, int logParent, int secureIndex,
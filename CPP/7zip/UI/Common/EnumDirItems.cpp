@@ -25,6 +25,14 @@
 #include "EnumDirItems.h"
 #include "SortUtils.h"
 
+#ifdef Z7_DIR_ITEMS_SCAN_MT
+#include "../../../Common/Defs.h"
+
+#include "../../../Windows/Synchronization.h"
+#include "../../../Windows/System.h"
+#include "../../../Windows/Thread.h"
+#endif
+
 using namespace NWindows;
 using namespace NFile;
 using namespace NName;
@@ -190,6 +198,9 @@ CDirItems::CDirItems():
     , StoreOwnerName(false)
    #endif
     , Callback(NULL)
+   #ifdef Z7_DIR_ITEMS_SCAN_MT
+    , Scanner(NULL)
+   #endif
 {
   #ifdef Z7_USE_SECURITY_CODE
   _saclEnabled = InitLocalPrivileges();
@@ -256,15 +267,445 @@ HRESULT CDirItems::AddSecurityItem(const FString &path, int &secureIndex)
 #endif // Z7_USE_SECURITY_CODE
 
 
+#ifndef _WIN32
+
+struct CDirListingError
+{
+  FString Name;
+  DWORD Error;
+};
+
+struct CDirListing
+{
+  CObjectVector<NFind::CFileInfo> Files;
+  CObjectVector<CDirListingError> Errors; // the errors of items
+  DWORD DirError;                         // the error of directory reading
+  bool DirError_Defined;
+
+  CDirListing(): DirError(0), DirError_Defined(false) {}
+};
+
+/* ReadDirListing() reads directory items and their stat() info.
+   It doesn't use CDirItems, so it can be called from any thread. */
+
+static void ReadDirListing(const FString &phyPrefix, bool followLink, CDirListing &listing)
+{
+  NFind::CEnumerator enumerator;
+  enumerator.SetDirPrefix(phyPrefix);
+  
+  CObjectVector<NFind::CDirEntry> entries;
+
+  for (;;)
+  {
+    bool found;
+    NFind::CDirEntry de;
+    if (!enumerator.Next(de, found))
+    {
+      listing.DirError = ::GetLastError();
+      listing.DirError_Defined = true;
+      return;
+    }
+    if (!found)
+      break;
+    entries.Add(de);
+  }
+
+  listing.Files.ClearAndReserve(entries.Size());
+  FOR_VECTOR (i, entries)
+  {
+    const NFind::CDirEntry &de = entries[i];
+    NFind::CFileInfo fi;
+    // Fill_FileInfo() calls fstatat() relative to directory handle
+    if (!enumerator.Fill_FileInfo(de, fi, followLink))
+    {
+      CDirListingError &e = listing.Errors.AddNew();
+      e.Error = ::GetLastError();
+      e.Name = de.Name;
+      continue;
+    }
+    listing.Files.AddInReserved(fi);
+  }
+}
+
+#endif // _WIN32
+
+
+#ifdef Z7_DIR_ITEMS_SCAN_MT
+
+/*
+CDirScanner reads the directories in worker threads in advance.
+The main thread walks the tree recursively as before, and it gets the listing
+of each directory from CDirScanner::GetListing() in same order.
+So the order of items in CDirItems doesn't depend from the number of threads.
+
+Each job (directory) has (Key) : the vector of indexes of subdirectories
+in listings of parent directories from root job. The main thread walks
+the tree in pre-order, so it requests the jobs in increasing order of keys:
+  - the workers read the queued job with smallest key at first.
+  - the jobs with keys smaller than key of requested job will not be requested,
+    (they are excluded by censor rules), and we delete such jobs.
+The worker adds the jobs for subdirectories after reading of directory.
+The number of jobs is limited by kNumScanJobsMax. The consumed jobs of
+parent directories of current directory are kept in (_stack):
+  - to add the jobs for remaining subdirectories later,
+  - to calculate the key for directory that was not read in advance.
+Note: fstatat() relative to directory handle is used instead of lstat() for full path.
+*/
+
+static const unsigned kNumScanThreadsMax = 16;
+static const unsigned kNumScanJobsMax = 256;
+
+enum EDirScanJobState
+{
+  k_DirScanJob_Queued,
+  k_DirScanJob_Running,
+  k_DirScanJob_Done
+};
+
+struct CDirScanJob: public CDirListing
+{
+  FString Path;
+  CUIntVector Key;
+  EDirScanJobState State;
+  bool Cancelled;
+  unsigned NumExpanded; // the number of items in (Files) that were checked for subdirectory jobs
+  unsigned SearchPos;
+
+  CDirScanJob(): State(k_DirScanJob_Queued), Cancelled(false), NumExpanded(0), SearchPos(0) {}
+
+  int FindItem(const FString &name)
+  {
+    // the main thread enters to subdirectories in order of (Files), so we start from previous position
+    const unsigned num = Files.Size();
+    for (unsigned k = 0; k < num; k++)
+    {
+      unsigned i = SearchPos + k;
+      if (i >= num)
+        i -= num;
+      if (Files[i].Name == name)
+      {
+        SearchPos = i + 1;
+        return (int)i;
+      }
+    }
+    return -1;
+  }
+};
+
+
+static int CompareKeys(const CUIntVector &a, const CUIntVector &b)
+{
+  const unsigned num = MyMin(a.Size(), b.Size());
+  for (unsigned i = 0; i < num; i++)
+    if (a[i] != b[i])
+      return a[i] < b[i] ? -1 : 1;
+  return MyCompare(a.Size(), b.Size());
+}
+
+
+class CDirScanner  MY_UNCOPYABLE
+{
+  CDirItems &_dirItems;
+  bool _followLink;
+  bool _exit;
+  UInt32 _numRoots;
+  CRecordVector<CDirScanJob *> _jobs;  // sorted by (Key)
+  CRecordVector<CDirScanJob *> _stack; // consumed jobs of parent directories
+
+  CObjectVector<NWindows::CThread> _threads;
+  NWindows::NSynchronization::CCriticalSection _cs;
+  NWindows::NSynchronization::CSemaphore _jobSemaphore;
+  NWindows::NSynchronization::CAutoResetEvent _doneEvent;
+
+  void AddJob(CDirScanJob *job);
+  void AddSubDirJobs(CDirScanJob &job);
+  void DeleteJobs_Before(const CUIntVector &key);
+  bool Create(unsigned numThreads);
+public:
+  void ThreadFunc();
+  // the returned listing is valid until next GetListing() call
+  const CDirListing &GetListing(const FString &phyPrefix);
+
+  CDirScanner(CDirItems &dirItems);
+  ~CDirScanner();
+};
+
+
+static THREAD_FUNC_DECL DirScannerThread(void *p)
+{
+  ((CDirScanner *)p)->ThreadFunc();
+  return 0;
+}
+
+
+CDirScanner::CDirScanner(CDirItems &dirItems):
+    _dirItems(dirItems),
+    _followLink(!dirItems.SymLinks),
+    _exit(false),
+    _numRoots(0)
+{
+  UInt32 numThreads = NWindows::NSystem::GetNumberOfProcessors();
+  if (numThreads > kNumScanThreadsMax)
+    numThreads = kNumScanThreadsMax;
+  // we don't use scanner in single core system
+  if (numThreads > 1 && Create(numThreads))
+    dirItems.Scanner = this;
+}
+
+
+bool CDirScanner::Create(unsigned numThreads)
+{
+  if (_jobSemaphore.Create(0, (UInt32)1 << 30) != 0)
+    return false;
+  if (_doneEvent.CreateIfNotCreated_Reset() != 0)
+    return false;
+  for (unsigned i = 0; i < numThreads; i++)
+  {
+    NWindows::CThread &thread = _threads.AddNew();
+    if (thread.Create(DirScannerThread, this) != 0)
+    {
+      _threads.DeleteBack();
+      break;
+    }
+  }
+  return !_threads.IsEmpty();
+}
+
+
+CDirScanner::~CDirScanner()
+{
+  if (_dirItems.Scanner == this)
+    _dirItems.Scanner = NULL;
+  if (!_threads.IsEmpty())
+  {
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      _exit = true;
+    }
+    _jobSemaphore.Release(_threads.Size());
+    FOR_VECTOR (i, _threads)
+      _threads[i].Wait_Close();
+  }
+  // the cancelled jobs were deleted by threads
+  FOR_VECTOR (i, _jobs)
+    delete _jobs[i];
+  FOR_VECTOR (i, _stack)
+    delete _stack[i];
+}
+
+
+void CDirScanner::AddJob(CDirScanJob *job)
+{
+  unsigned left = 0, right = _jobs.Size();
+  while (left != right)
+  {
+    const unsigned mid = (left + right) / 2;
+    if (CompareKeys(job->Key, _jobs[mid]->Key) < 0)
+      right = mid;
+    else
+      left = mid + 1;
+  }
+  _jobs.Insert(left, job);
+}
+
+
+// it's called inside critical section
+void CDirScanner::AddSubDirJobs(CDirScanJob &job)
+{
+  unsigned numNewJobs = 0;
+  for (; job.NumExpanded < job.Files.Size(); job.NumExpanded++)
+  {
+    const unsigned i = job.NumExpanded;
+    const NFind::CFileInfo &fi = job.Files[i];
+    // the main thread doesn't enter to posix links
+    if (!fi.IsDir() || fi.IsPosixLink())
+      continue;
+    // the remaining subdirectories will be added later from (_stack)
+    if (_jobs.Size() >= kNumScanJobsMax)
+      break;
+    CDirScanJob *job2 = new CDirScanJob;
+    job2->Path = job.Path;
+    job2->Path += fi.Name;
+    job2->Path.Add_PathSepar();
+    job2->Key = job.Key;
+    job2->Key.Add(i);
+    AddJob(job2);
+    numNewJobs++;
+  }
+  if (numNewJobs != 0)
+    _jobSemaphore.Release(numNewJobs);
+}
+
+
+// it's called inside critical section
+void CDirScanner::DeleteJobs_Before(const CUIntVector &key)
+{
+  unsigned i;
+  for (i = 0; i < _jobs.Size(); i++)
+  {
+    CDirScanJob *job = _jobs[i];
+    if (CompareKeys(job->Key, key) >= 0)
+      break;
+    if (job->State == k_DirScanJob_Running)
+      job->Cancelled = true; // the thread will delete it
+    else
+      delete job;
+  }
+  _jobs.DeleteFrontal(i);
+}
+
+
+void CDirScanner::ThreadFunc()
+{
+  for (;;)
+  {
+    _jobSemaphore.Lock();
+    CDirScanJob *job = NULL;
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      if (_exit)
+        return;
+      FOR_VECTOR (i, _jobs)
+      {
+        CDirScanJob *job2 = _jobs[i];
+        if (job2->State == k_DirScanJob_Queued)
+        {
+          job2->State = k_DirScanJob_Running;
+          job = job2;
+          break;
+        }
+      }
+    }
+    // the job could be deleted or taken by main thread
+    if (!job)
+      continue;
+    ReadDirListing(job->Path, _followLink, *job);
+    {
+      NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+      if (job->Cancelled)
+      {
+        delete job;
+        continue;
+      }
+      job->State = k_DirScanJob_Done;
+      AddSubDirJobs(*job);
+    }
+    _doneEvent.Set();
+  }
+}
+
+
+const CDirListing &CDirScanner::GetListing(const FString &phyPrefix)
+{
+  CDirScanJob *job = NULL;
+  bool needRead = false;
+  {
+    NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+
+    // we remove the directories that are not parents of (phyPrefix)
+    while (!_stack.IsEmpty())
+    {
+      const FString &path = _stack.Back()->Path;
+      if (path.Len() < phyPrefix.Len() && IsString1PrefixedByString2(phyPrefix, path))
+        break;
+      delete _stack.Back();
+      _stack.DeleteBack();
+    }
+
+    FOR_VECTOR (i, _jobs)
+      if (_jobs[i]->Path == phyPrefix)
+      {
+        job = _jobs[i];
+        _jobs.Delete(i);
+        break;
+      }
+    
+    if (job)
+    {
+      if (job->State == k_DirScanJob_Queued)
+      {
+        job->State = k_DirScanJob_Running;
+        needRead = true;
+      }
+    }
+    else
+    {
+      // the directory was not queued. So we calculate the key from parent directory.
+      job = new CDirScanJob;
+      job->State = k_DirScanJob_Running;
+      job->Path = phyPrefix;
+      needRead = true;
+      bool keyIsDefined = false;
+      if (!_stack.IsEmpty())
+      {
+        CDirScanJob &parent = *_stack.Back();
+        FString name (phyPrefix.Ptr(parent.Path.Len()));
+        if (!name.IsEmpty() && IS_PATH_SEPAR(name.Back()))
+        {
+          name.DeleteBack();
+          const int index = parent.FindItem(name);
+          if (index >= 0)
+          {
+            job->Key = parent.Key;
+            job->Key.Add((unsigned)index);
+            keyIsDefined = true;
+            // we don't want to add the job for that directory later
+            if (parent.NumExpanded <= (unsigned)index)
+              parent.NumExpanded = (unsigned)index + 1;
+          }
+        }
+      }
+      if (!keyIsDefined)
+      {
+        // it's new root directory
+        FOR_VECTOR (i, _stack)
+          delete _stack[i];
+        _stack.Clear();
+        job->Key.Add(_numRoots++);
+      }
+    }
+    DeleteJobs_Before(job->Key);
+  }
+
+  if (needRead)
+    ReadDirListing(phyPrefix, _followLink, *job);
+  else
+  {
+    for (;;)
+    {
+      {
+        NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+        if (job->State == k_DirScanJob_Done)
+          break;
+      }
+      _doneEvent.Lock();
+    }
+  }
+
+  {
+    NWindows::NSynchronization::CCriticalSectionLock lock(_cs);
+    job->State = k_DirScanJob_Done;
+    _stack.Add(job);
+    /* we add the jobs for subdirectories of current directory,
+       and then for next subdirectories of parent directories */
+    for (unsigned i = _stack.Size(); i != 0 && _jobs.Size() < kNumScanJobsMax;)
+      AddSubDirJobs(*_stack[--i]);
+  }
+  return *job;
+}
+
+#endif // Z7_DIR_ITEMS_SCAN_MT
+
+
 HRESULT CDirItems::EnumerateOneDir(const FString &phyPrefix, CObjectVector<NFind::CFileInfo> &files)
 {
+  #ifdef _WIN32
+
   NFind::CEnumerator enumerator;
   // printf("\n  enumerator.SetDirPrefix(phyPrefix) \n");
 
   enumerator.SetDirPrefix(phyPrefix);
 
-  #ifdef _WIN32
-
   NFind::CFileInfo fi;
 
   for (unsigned ttt = 0; ; ttt++)
@@ -283,37 +724,31 @@ HRESULT CDirItems::EnumerateOneDir(const FString &phyPrefix, CObjectVector<NFind
 
   #else // _WIN32
 
-  // enumerator.SolveLinks = !SymLinks;
-  
-  CObjectVector<NFind::CDirEntry> entries;
+  CDirListing listing2;
+  const CDirListing *listingPtr = &listing2;
+ #ifdef Z7_DIR_ITEMS_SCAN_MT
+  if (Scanner)
+    listingPtr = &Scanner->GetListing(phyPrefix);
+  else
+ #endif
+    ReadDirListing(phyPrefix, !SymLinks, listing2);
+  const CDirListing &listing = *listingPtr;
 
-  for (;;)
+  if (listing.DirError_Defined)
+    return AddError(phyPrefix, listing.DirError);
+
+  /* the errors for items are reported before items, as in old code,
+     where we reported them in loop of Fill_FileInfo() calls */
+  FOR_VECTOR (i, listing.Errors)
   {
-    bool found;
-    NFind::CDirEntry de;
-    if (!enumerator.Next(de, found))
-      return AddError(phyPrefix);
-    if (!found)
-      break;
-    entries.Add(de);
+    const CDirListingError &e = listing.Errors[i];
+    RINOK(AddError(phyPrefix + e.Name, e.Error))
   }
 
-  FOR_VECTOR(i, entries)
+  files.ClearAndReserve(listing.Files.Size());
+  FOR_VECTOR (i, listing.Files)
   {
-    const NFind::CDirEntry &de = entries[i];
-    NFind::CFileInfo fi;
-    if (!enumerator.Fill_FileInfo(de, fi, !SymLinks))
-    // if (!fi.Find_AfterEnumerator(path))
-    {
-      const FString path = phyPrefix + de.Name;
-      {
-        RINOK(AddError(path))
-        continue;
-      }
-    }
-
-    files.Add(fi);
-
+    files.AddInReserved(listing.Files[i]);
     if (Callback && (i & kScanProgressStepMask) == kScanProgressStepMask)
     {
       RINOK(ScanProgress(phyPrefix))
@@ -407,6 +842,9 @@ HRESULT CDirItems::EnumerateItems2(
     const FStringVector &filePaths,
     FStringVector *requestedPaths)
 {
+ #ifdef Z7_DIR_ITEMS_SCAN_MT
+  CDirScanner scanner(*this);
+ #endif
   const int phyParent = phyPrefix.IsEmpty() ? -1 : (int)AddPrefix(-1, -1, fs2us(phyPrefix));
   const int logParent = logPrefix.IsEmpty() ? -1 : (int)AddPrefix(-1, -1, logPrefix);
 
@@ -1167,6 +1605,9 @@ HRESULT EnumerateItems(
     const UString &addPathPrefix, // prefix that will be added to Logical Path
     CDirItems &dirItems)
 {
+ #ifdef Z7_DIR_ITEMS_SCAN_MT
+  CDirScanner scanner(dirItems);
+ #endif
   FOR_VECTOR (i, censor.Pairs)
   {
     const NWildcard::CPair &pair = censor.Pairs[i];
@@ -508,6 +508,13 @@ extern "C"
 }
 #endif
 
+#ifdef Z7_HUGE_PAGES
+extern "C"
+{
+  extern SIZE_T g_HugePageSize;
+}
+#endif
+
 
 void CCodecs::AddLastError(const FString &path)
 {
@@ -644,6 +651,15 @@ HRESULT CCodecs::LoadDll(const FString &dllPath, bool needCheckDll, bool *loaded
     }
     #endif
 
+    #ifdef Z7_HUGE_PAGES
+    if (g_HugePageSize != 0)
+    {
+      MY_GET_FUNC_LOC (setLargePageMode, Func_SetLargePageMode, lib.Lib, "SetLargePageMode")
+      if (setLargePageMode)
+        setLargePageMode();
+    }
+    #endif
+
     if (CaseSensitive_Change)
     {
       MY_GET_FUNC_LOC (setCaseSensitive, Func_SetCaseSensitive, lib.Lib, "SetCaseSensitive")
@@ -44,6 +44,12 @@
 // increase it, if you need to support larger SFX stubs
 static const UInt64 kMaxCheckStartPosition = 1 << 23;
 
+/* (g_MapArcFiles == true) : archive files are mapped to memory (-smm switch),
+   if CInFileStream supports mapping. */
+extern
+bool g_MapArcFiles;
+bool g_MapArcFiles = false;
+
 /*
 Open:
   - formatIndex >= 0 (exact Format)
@@ -3101,6 +3107,11 @@ HRESULT CArc::OpenStreamOrFile(COpenOptions &op)
     Path = filePath;
     if (!fileStreamSpec->Open(us2fs(Path)))
       return GetLastError_noZero_HRESULT();
+    /* the mapping is used only if it was requested (-smm), because
+       the process gets SIGBUS, if another process truncates mapped file.
+       If mapping is not possible, the stream uses read() calls. */
+    if (g_MapArcFiles)
+      fileStreamSpec->Map();
     op.stream = fileStream;
     #ifdef Z7_SFX
     IgnoreSplit = true;
@@ -3152,6 +3163,7 @@ HRESULT CArc::OpenStreamOrFile(COpenOptions &op)
         {
           if (fileStreamSpec->Open(us2fs(Path)))
           {
+            fileStreamSpec->Map();
             op.stream = fileStream;
             NonOpen_ErrorInfo.ClearErrors_Full();
             if (OpenStream(op) == S_OK)
@@ -3525,6 +3537,7 @@ HRESULT CArchiveLink::ReOpen(COpenOptions &op)
   CMyComPtr<IInStream> stream(fileStreamSpec);
   if (!fileStreamSpec->Open(us2fs(op.filePath)))
     return GetLastError_noZero_HRESULT();
+  fileStreamSpec->Map();
   op.stream = stream;
 
   CArc &arc = Arcs[0];
@@ -624,6 +624,7 @@ static HRESULT Compress(
   updateCallbackSpec->ShareForWrite = options.OpenShareForWrite;
   updateCallbackSpec->StopAfterOpenError = options.StopAfterOpenError;
   updateCallbackSpec->StdInMode = options.StdInMode;
+  updateCallbackSpec->SparseFiles = options.SparseFiles;
   updateCallbackSpec->Callback = callback;
 
   if (arc)
@@ -85,6 +85,7 @@ struct CUpdateOptions
   bool PreserveATime;
   bool OpenShareForWrite;
   bool StopAfterOpenError;
+  bool SparseFiles;
 
   bool StdInMode;
   bool StdOutMode;
@@ -131,6 +132,7 @@ struct CUpdateOptions
     PreserveATime(false),
     OpenShareForWrite(false),
     StopAfterOpenError(false),
+    SparseFiles(false),
 
     StdInMode(false),
     StdOutMode(false),
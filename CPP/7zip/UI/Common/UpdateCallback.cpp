@@ -61,6 +61,7 @@ CArchiveUpdateCallback::CArchiveUpdateCallback():
     ShareForWrite(false),
     StopAfterOpenError(false),
     StdInMode(false),
+    SparseFiles(false),
     
     KeepOriginalItemNames(false),
     StoreNtSecurity(false),
@@ -741,6 +742,9 @@ Z7_COM7F_IMF(CArchiveUpdateCallback::GetStream2(UInt32 index, ISequentialInStrea
       }
     }
 
+    if (SparseFiles)
+      inStreamSpec->Set_Sparse();
+
     /*
     {
       // for debug:
@@ -121,6 +121,7 @@ public:
   bool ShareForWrite;
   bool StopAfterOpenError;
   bool StdInMode;
+  bool SparseFiles;
 
   bool KeepOriginalItemNames;
   bool StoreNtSecurity;
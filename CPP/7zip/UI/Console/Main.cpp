@@ -40,6 +40,9 @@ typedef PROCESS_MEMORY_COUNTERS *PPROCESS_MEMORY_COUNTERS;
 #endif // _WIN32
 
 #include "../../../../C/CpuArch.h"
+#ifndef Z7_ST
+#include "../../../../C/Threads.h"
+#endif
 
 #include "../../../Common/MyInitGuid.h"
 
@@ -65,6 +68,7 @@ typedef PROCESS_MEMORY_COUNTERS *PPROCESS_MEMORY_COUNTERS;
 #include "../Common/LoadCodecs.h"
 #endif
 
+#include "../../Common/MethodProps.h"
 #include "../../Common/RegisterCodec.h"
 
 #include "BenchCon.h"
@@ -182,10 +186,12 @@ static const char * const kHelpString =
     "  -si[{name}] : read data from stdin\n"
     "  -slp : set Large Pages mode\n"
     "  -slt : show technical information for l (List) command\n"
+    "  -smm[-] : map archive files to memory for reading\n"
     "  -snh : store hard links as links\n"
     "  -snl : store symbolic links as links\n"
     "  -sni : store NT security information\n"
     "  -sns[-] : store NTFS alternate streams\n"
+    "  -snp[-] : sparse files: skip holes in archiving, create holes in extraction\n"
     "  -so : write data to stdout\n"
     "  -spd : disable wildcard matching for file names\n"
     "  -spe : eliminate duplication of root folder for extract command\n"
@@ -788,6 +794,32 @@ static void PrintStat(const UInt64 startTime)
 #endif // ! _WIN32
 
 
+#ifndef Z7_ST
+
+/* the number of threads from -mmt switch is the limit for the number of
+   running threads in thread pool. Without -mmt switch the pool uses
+   the number of CPUs in process affinity mask that can be changed by -stm switch. */
+
+static void Set_ThreadPool_MaxRunning(const CObjectVector<CProperty> &props)
+{
+  UInt32 numThreads = 0;
+  FOR_VECTOR (i, props)
+  {
+    const CProperty &prop = props[i];
+    if (!prop.Name.IsPrefixedBy_Ascii_NoCase("mt"))
+      continue;
+    NCOM::CPropVariant propVariant;
+    if (!prop.Value.IsEmpty())
+      propVariant = prop.Value;
+    UInt32 v = 0;
+    bool force;
+    if (ParseMtProp2(prop.Name.Ptr(2), propVariant, v, force) == S_OK && force)
+      numThreads = v;
+  }
+  ThreadPool_SetMaxRunning(numThreads);
+}
+
+#endif
 
 
 
@@ -918,6 +950,10 @@ int Main2(
 
   parser.Parse2(options);
 
+  #ifndef Z7_ST
+  Set_ThreadPool_MaxRunning(options.Properties);
+  #endif
+
   {
     int cp = options.ConsoleCodePage;
     
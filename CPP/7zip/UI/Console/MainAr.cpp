@@ -6,6 +6,9 @@
 #include "../../../../C/DllSecur.h"
 #endif
 #include "../../../../C/CpuArch.h"
+#ifndef Z7_ST
+#include "../../../../C/Threads.h"
+#endif
 
 #include "../../../Common/MyException.h"
 #include "../../../Common/StdOutStream.h"
@@ -100,6 +103,13 @@ static inline bool CheckIsa()
   */
 }
 
+#ifndef Z7_ST
+struct CThreadPool_Free_at_Exit
+{
+  ~CThreadPool_Free_at_Exit() { ThreadPool_Free(); }
+};
+#endif
+
 int Z7_CDECL main
 (
   #ifndef _WIN32
@@ -120,6 +130,11 @@ int Z7_CDECL main
 
   NT_CHECK
 
+  #ifndef Z7_ST
+  // it stops idle workers of thread pool at exit from main()
+  CThreadPool_Free_at_Exit threadPool_Free_at_Exit;
+  #endif
+
   NConsoleClose::CCtrlHandlerSetter ctrlHandlerSetter;
   int res = 0;
   
@@ -2608,7 +2608,7 @@ void CCompressDialog::SetNumThreads2()
     numAlgoThreadsMax = 256 * 2;
   else switch (methodID)
   {
-    case kLZMA: numAlgoThreadsMax = 2; break;
+    case kLZMA: numAlgoThreadsMax = 64 + 1; break; // hash thread and up to 64 BT threads
     case kLZMA2: numAlgoThreadsMax = 256; break;
     case kBZip2: numAlgoThreadsMax = 64; break;
     // case kZSTD: numAlgoThreadsMax = num_ZSTD_threads_MAX; break;
@@ -2964,6 +2964,15 @@ UInt64 CCompressDialog::GetMemoryUsage_Threads_Dict_DecompMem(UInt32 numThreads,
       {
         size1 += (2 << 20) + (4 << 20);
         numThreads1 = 2;
+        if (methodId == kLZMA && !IsZipFormat()
+            && numThreads > 2 && dict >= ((UInt32)1 << 20))
+        {
+          // partitioned BT match finder: hash thread and (numThreads - 1) BT threads
+          numThreads1 = numThreads;
+          if (numThreads1 > 64 + 1)
+            numThreads1 = 64 + 1;
+          size1 += (UInt64)dict + (UInt64)(numThreads1 - 1) * (1 << 18);
+        }
       }
       
       UInt32 numBlockThreads = numThreads / numThreads1;
@@ -0,0 +1,595 @@
+// Windows/FileAsyncIO.cpp
+
+#include "StdAfx.h"
+
+#include "FileAsyncIO.h"
+
+#ifdef Z7_FILE_ASYNC_IO
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+#include "../../C/Alloc.h"
+
+#include "FileDir.h"
+
+namespace NWindows {
+namespace NFile {
+namespace NIO {
+
+WRes CUring::Create(unsigned numEntries)
+{
+  Close();
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  const int fd = (int)syscall(__NR_io_uring_setup, numEntries, &p);
+  if (fd < 0)
+    return errno;
+  _fd = fd;
+  _numToSubmit = 0;
+  _sqMap = MAP_FAILED;
+  _cqMap = MAP_FAILED;
+  _sqes = MAP_FAILED;
+
+  _sqMapSize = p.sq_off.array + p.sq_entries * sizeof(UInt32);
+  _cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  const bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap)
+  {
+    if (_sqMapSize < _cqMapSize)
+      _sqMapSize = _cqMapSize;
+    _cqMapSize = _sqMapSize;
+  }
+
+  _sqMap = mmap(NULL, _sqMapSize, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (_sqMap == MAP_FAILED)
+  {
+    const WRes wres = errno;
+    Close();
+    return wres;
+  }
+  if (singleMap)
+    _cqMap = _sqMap;
+  else
+  {
+    _cqMap = mmap(NULL, _cqMapSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (_cqMap == MAP_FAILED)
+    {
+      const WRes wres = errno;
+      Close();
+      return wres;
+    }
+  }
+  _sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  _sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (_sqes == MAP_FAILED)
+  {
+    const WRes wres = errno;
+    Close();
+    return wres;
+  }
+
+  Byte *sq = (Byte *)_sqMap;
+  Byte *cq = (Byte *)_cqMap;
+  _sqHead  = (UInt32 *)(void *)(sq + p.sq_off.head);
+  _sqTail  = (UInt32 *)(void *)(sq + p.sq_off.tail);
+  _sqArray = (UInt32 *)(void *)(sq + p.sq_off.array);
+  _sqMask  = *(const UInt32 *)(const void *)(sq + p.sq_off.ring_mask);
+  _sqEntries = p.sq_entries;
+  _cqHead  = (UInt32 *)(void *)(cq + p.cq_off.head);
+  _cqTail  = (UInt32 *)(void *)(cq + p.cq_off.tail);
+  _cqMask  = *(const UInt32 *)(const void *)(cq + p.cq_off.ring_mask);
+  _cqes = cq + p.cq_off.cqes;
+  return 0;
+}
+
+
+void CUring::Close()
+{
+  if (_fd == -1)
+    return;
+  if (_sqes != MAP_FAILED)
+    munmap(_sqes, _sqesSize);
+  if (_cqMap != MAP_FAILED && _cqMap != _sqMap)
+    munmap(_cqMap, _cqMapSize);
+  if (_sqMap != MAP_FAILED)
+    munmap(_sqMap, _sqMapSize);
+  close(_fd);
+  _fd = -1;
+}
+
+
+bool CUring::Add_WriteV(int fd, const struct iovec *iov, UInt64 offset, UInt64 userData) throw()
+{
+  // we are the only producer for submission queue
+  const UInt32 tail = *_sqTail;
+  if (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) >= _sqEntries)
+    return false;
+  const UInt32 index = tail & _sqMask;
+  struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = (UInt64)(UINT_PTR)iov;
+  sqe->len = 1;
+  sqe->user_data = userData;
+  _sqArray[index] = index;
+  __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+  _numToSubmit++;
+  return true;
+}
+
+
+WRes CUring::Submit(unsigned minComplete) throw()
+{
+  for (;;)
+  {
+    const int res = (int)syscall(__NR_io_uring_enter, _fd, _numToSubmit, minComplete,
+        minComplete != 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (res >= 0)
+    {
+      _numToSubmit -= (unsigned)res;
+      return 0;
+    }
+    const WRes wres = errno;
+    if (wres != EINTR)
+      return wres;
+  }
+}
+
+
+bool CUring::GetCompletion(UInt64 &userData, Int32 &res) throw()
+{
+  const UInt32 head = *_cqHead;
+  if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+    return false;
+  const struct io_uring_cqe *cqe = (const struct io_uring_cqe *)_cqes + (head & _cqMask);
+  userData = cqe->user_data;
+  res = cqe->res;
+  __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+
+
+static const size_t kBufSize = (size_t)1 << 17;
+static const unsigned kNumBufsMax = 64;
+static const unsigned kNumRingEntries = kNumBufsMax; // each buffer uses no more than one entry
+static const unsigned kSubmitBatch = 8;
+
+struct CAsyncOutFiles::CBuf
+{
+  Byte *Data;
+  size_t Size;
+  size_t Done;
+  UInt64 Offset;
+  CFile *File;
+  struct iovec Iov;
+};
+
+struct CAsyncOutFiles::CFile
+{
+  COutFile File;  // it owns the handle after Close()
+  FString Path;
+  int Handle;
+  unsigned NumPending;  // the number of buffers queued to ring
+  CBuf *Buf;            // current buffer that is not queued yet
+  WRes Error;
+  bool ErrorReported;
+  bool CloseRequested;
+  bool Attrib_Defined;
+  bool Owner_Defined;
+  DWORD Attrib;
+  uid_t Uid;
+  gid_t Gid;
+
+  CFile():
+      Handle(-1),
+      NumPending(0),
+      Buf(NULL),
+      Error(0),
+      ErrorReported(false),
+      CloseRequested(false),
+      Attrib_Defined(false),
+      Owner_Defined(false)
+      {}
+};
+
+
+static THREAD_FUNC_DECL FinisherThread(void *p)
+{
+  ((CAsyncOutFiles *)p)->ThreadFunc();
+  return 0;
+}
+
+
+CAsyncOutFiles::CAsyncOutFiles():
+    _numBufs(0),
+    _numInFlight(0),
+    _numJobs(0),
+    _numJobs_Finished(0),
+    _exit(false)
+    {}
+
+CAsyncOutFiles::~CAsyncOutFiles()
+{
+  if (_thread.IsCreated())
+  {
+    WaitAll();
+    {
+      NSynchronization::CCriticalSectionLock lock(_cs);
+      _exit = true;
+    }
+    _jobEvent.Set();
+    _thread.Wait_Close();
+  }
+  // the kernel doesn't use the buffers after closing of ring
+  _ring.Close();
+  FOR_VECTOR (i, _files)
+  {
+    CFile *f = _files[i];
+    if (f->Buf)
+      _freeBufs.Add(f->Buf);
+    delete f;
+  }
+  FOR_VECTOR (i, _freeBufs)
+  {
+    CBuf *b = _freeBufs[i];
+    MidFree(b->Data);
+    delete b;
+  }
+}
+
+
+WRes CAsyncOutFiles::Create()
+{
+  if (IsCreated())
+    return 0;
+  WRes wres = _jobEvent.CreateIfNotCreated_Reset();
+  if (wres == 0)
+    wres = _doneEvent.CreateIfNotCreated_Reset();
+  if (wres == 0)
+    wres = _ring.Create(kNumRingEntries);
+  if (wres == 0 && !_thread.IsCreated())
+  {
+    wres = _thread.Create(FinisherThread, this);
+    if (wres != 0)
+      _ring.Close();
+  }
+  return wres;
+}
+
+
+CAsyncOutFiles::CBuf *CAsyncOutFiles::GetFreeBuf()
+{
+  for (;;)
+  {
+    if (!_freeBufs.IsEmpty())
+    {
+      CBuf *b = _freeBufs.Back();
+      _freeBufs.DeleteBack();
+      return b;
+    }
+    if (_numBufs < kNumBufsMax || _numInFlight == 0)
+    {
+      Byte *data = (Byte *)MidAlloc(kBufSize);
+      if (data)
+      {
+        CBuf *b = new CBuf;
+        b->Data = data;
+        _numBufs++;
+        return b;
+      }
+      if (_numInFlight == 0)
+        return NULL;
+    }
+    if (WaitCompletions() != 0)
+      return NULL;
+  }
+}
+
+
+void CAsyncOutFiles::FinishBuf(CBuf *b, WRes wres)
+{
+  CFile *f = b->File;
+  if (wres != 0 && f->Error == 0)
+    f->Error = wres;
+  _freeBufs.Add(b);
+  _numInFlight--;
+  f->NumPending--;
+  if (f->NumPending == 0 && f->CloseRequested)
+    MoveToFinisher(f);
+}
+
+
+void CAsyncOutFiles::QueueBuf(CBuf *b)
+{
+  b->Iov.iov_base = b->Data + b->Done;
+  b->Iov.iov_len = b->Size - b->Done;
+  const UInt64 userData = (UInt64)(UINT_PTR)b;
+  if (!_ring.Add_WriteV(b->File->Handle, &b->Iov, b->Offset + b->Done, userData))
+  {
+    const WRes wres = _ring.Submit(0);
+    if (wres != 0 || !_ring.Add_WriteV(b->File->Handle, &b->Iov, b->Offset + b->Done, userData))
+    {
+      FinishBuf(b, wres != 0 ? wres : EBUSY);
+      return;
+    }
+  }
+  if (_ring.GetNumToSubmit() >= kSubmitBatch)
+    _ring.Submit(0); // the error will be returned by next Submit() call in WaitCompletions()
+}
+
+
+void CAsyncOutFiles::QueueFileBuf(CFile *f)
+{
+  CBuf *b = f->Buf;
+  if (!b)
+    return;
+  f->Buf = NULL;
+  if (b->Size == 0)
+  {
+    _freeBufs.Add(b);
+    return;
+  }
+  b->Done = 0;
+  f->NumPending++;
+  _numInFlight++;
+  QueueBuf(b);
+}
+
+
+void CAsyncOutFiles::ProcessCompletion(CBuf *b, Int32 res)
+{
+  if (res > 0)
+  {
+    b->Done += (size_t)(UInt32)res;
+    if (b->Done < b->Size)
+      QueueBuf(b); // short write
+    else
+      FinishBuf(b, 0);
+  }
+  else if (res == -EINTR || res == -EAGAIN)
+    QueueBuf(b);
+  else
+    FinishBuf(b, res == 0 ? EIO : (WRes)-res);
+}
+
+
+bool CAsyncOutFiles::ProcessCompletions()
+{
+  bool wasProcessed = false;
+  UInt64 userData;
+  Int32 res;
+  while (_ring.GetCompletion(userData, res))
+  {
+    ProcessCompletion((CBuf *)(void *)(UINT_PTR)userData, res);
+    wasProcessed = true;
+  }
+  return wasProcessed;
+}
+
+
+WRes CAsyncOutFiles::WaitCompletions()
+{
+  if (ProcessCompletions())
+    return 0;
+  const WRes wres = _ring.Submit(1);
+  if (wres != 0)
+    return wres;
+  ProcessCompletions();
+  return 0;
+}
+
+
+void CAsyncOutFiles::MoveToFinisher(CFile *f)
+{
+  FOR_VECTOR (i, _files)
+    if (_files[i] == f)
+    {
+      _files.Delete(i);
+      break;
+    }
+  {
+    NSynchronization::CCriticalSectionLock lock(_cs);
+    _jobs.Add(f);
+    _numJobs++;
+  }
+  _jobEvent.Set();
+}
+
+
+CAsyncOutFiles::CFile *CAsyncOutFiles::Open(const COutFile &file, const FString &path)
+{
+  CFile *f = new CFile;
+  f->Path = path;
+  f->Handle = file.GetHandle();
+  _files.Add(f);
+  return f;
+}
+
+
+void CAsyncOutFiles::SetAttrib(CFile *f, DWORD attrib)
+{
+  f->Attrib = attrib;
+  f->Attrib_Defined = true;
+}
+
+void CAsyncOutFiles::SetOwner(CFile *f, uid_t uid, gid_t gid)
+{
+  f->Uid = uid;
+  f->Gid = gid;
+  f->Owner_Defined = true;
+}
+
+
+WRes CAsyncOutFiles::Write(CFile *f, UInt64 offset, const void *data, size_t size)
+{
+  ProcessCompletions();
+  if (f->Error != 0)
+    return f->Error;
+  while (size != 0)
+  {
+    CBuf *b = f->Buf;
+    if (b && (b->Size == kBufSize || b->Offset + b->Size != offset))
+    {
+      QueueFileBuf(f);
+      b = NULL;
+    }
+    if (!b)
+    {
+      b = GetFreeBuf();
+      if (!b)
+        return ENOMEM;
+      b->File = f;
+      b->Offset = offset;
+      b->Size = 0;
+      f->Buf = b;
+    }
+    size_t cur = kBufSize - b->Size;
+    if (cur > size)
+      cur = size;
+    memcpy(b->Data + b->Size, data, cur);
+    b->Size += cur;
+    offset += cur;
+    data = (const void *)((const Byte *)data + cur);
+    size -= cur;
+  }
+  return 0;
+}
+
+
+WRes CAsyncOutFiles::WaitFile(CFile *f)
+{
+  QueueFileBuf(f);
+  while (f->NumPending != 0)
+  {
+    const WRes wres = WaitCompletions();
+    if (wres != 0)
+      return wres;
+  }
+  return f->Error;
+}
+
+
+WRes CAsyncOutFiles::Close(CFile *f, COutFile &file)
+{
+  QueueFileBuf(f);
+  file.MoveTo(f->File);
+  f->CloseRequested = true;
+  const WRes wres = f->Error;
+  if (wres != 0)
+    f->ErrorReported = true;
+  if (f->NumPending == 0)
+    MoveToFinisher(f);
+  return wres;
+}
+
+
+void CAsyncOutFiles::WaitAll()
+{
+  if (!IsCreated())
+    return;
+  FOR_VECTOR (i, _files)
+    QueueFileBuf(_files[i]);
+  while (_numInFlight != 0)
+    if (WaitCompletions() != 0)
+      break;
+  for (;;)
+  {
+    {
+      NSynchronization::CCriticalSectionLock lock(_cs);
+      if (_numJobs_Finished == _numJobs)
+        break;
+    }
+    _doneEvent.Lock();
+  }
+}
+
+
+bool CAsyncOutFiles::GetError(CError &error)
+{
+  NSynchronization::CCriticalSectionLock lock(_cs);
+  if (_errors.IsEmpty())
+    return false;
+  error = _errors.Front();
+  _errors.Delete(0);
+  return true;
+}
+
+
+void CAsyncOutFiles::AddError(const FString &path, WRes error, EErrorType type)
+{
+  if (error == 0)
+    error = EIO;
+  NSynchronization::CCriticalSectionLock lock(_cs);
+  CError &e = _errors.AddNew();
+  e.Path = path;
+  e.Error = error;
+  e.Type = type;
+}
+
+
+void CAsyncOutFiles::FinishFile(CFile *f)
+{
+  if (f->Error != 0 && !f->ErrorReported)
+    AddError(f->Path, f->Error, k_Write);
+  // COutFile::Close() sets timestamps after closing
+  if (!f->File.Close())
+    AddError(f->Path, errno, k_Close);
+  else
+  {
+    if (f->Owner_Defined)
+      if (NDir::my_chown(f->Path, f->Uid, f->Gid) != 0)
+        AddError(f->Path, errno, k_Owner);
+    if (f->Attrib_Defined)
+      if (!NDir::SetFileAttrib_PosixHighDetect(f->Path, f->Attrib))
+        AddError(f->Path, errno, k_Attrib);
+  }
+  delete f;
+}
+
+
+void CAsyncOutFiles::ThreadFunc()
+{
+  CRecordVector<CFile *> jobs;
+  for (;;)
+  {
+    bool exit;
+    {
+      NSynchronization::CCriticalSectionLock lock(_cs);
+      jobs = _jobs;
+      _jobs.Clear();
+      exit = _exit;
+    }
+    if (jobs.IsEmpty())
+    {
+      if (exit)
+        return;
+      _jobEvent.Lock();
+      continue;
+    }
+    FOR_VECTOR (i, jobs)
+      FinishFile(jobs[i]);
+    {
+      NSynchronization::CCriticalSectionLock lock(_cs);
+      _numJobs_Finished += jobs.Size();
+    }
+    jobs.Clear();
+    _doneEvent.Set();
+  }
+}
+
+}}}
+
+#endif // Z7_FILE_ASYNC_IO
@@ -0,0 +1,152 @@
+// Windows/FileAsyncIO.h
+
+#ifndef ZIP7_INC_WINDOWS_FILE_ASYNC_IO_H
+#define ZIP7_INC_WINDOWS_FILE_ASYNC_IO_H
+
+#include "FileIO.h"
+
+/*
+Z7_FILE_ASYNC_IO : asynchronous writing of output files with io_uring in Linux.
+  Files are created and opened in caller thread.
+  Write requests are queued to io_uring submission queue (batched),
+  and closing of file, setting of timestamps, owner and attributes
+  are done in separate finishing thread after all writes of file were completed.
+  If io_uring can't be created (old kernel or io_uring is disabled),
+  caller must use synchronous writing.
+*/
+
+#if !defined(_WIN32) && defined(__linux__) && !defined(Z7_ST) && !defined(Z7_NO_FILE_ASYNC_IO)
+  #if defined __has_include
+  #if __has_include (<linux/io_uring.h>)
+    #define Z7_FILE_ASYNC_IO
+  #endif
+  #endif
+#endif
+
+#ifdef Z7_FILE_ASYNC_IO
+
+#include <sys/uio.h>
+
+#include "../Common/MyVector.h"
+
+#include "Synchronization.h"
+#include "Thread.h"
+
+namespace NWindows {
+namespace NFile {
+namespace NIO {
+
+// it's minimal io_uring wrapper over raw system calls (we don't use liburing)
+
+class CUring  MY_UNCOPYABLE
+{
+  int _fd;
+  unsigned _numToSubmit;
+  void *_sqMap;
+  void *_cqMap;
+  void *_sqes;
+  size_t _sqMapSize;
+  size_t _cqMapSize;
+  size_t _sqesSize;
+  UInt32 *_sqHead;
+  UInt32 *_sqTail;
+  UInt32 *_sqArray;
+  UInt32 *_cqHead;
+  UInt32 *_cqTail;
+  const void *_cqes;
+  UInt32 _sqMask;
+  UInt32 _sqEntries;
+  UInt32 _cqMask;
+public:
+  CUring(): _fd(-1), _numToSubmit(0) {}
+  ~CUring() { Close(); }
+  bool IsCreated() const { return _fd != -1; }
+  unsigned GetNumToSubmit() const { return _numToSubmit; }
+  WRes Create(unsigned numEntries);
+  void Close();
+  // it returns false, if submission queue is full
+  bool Add_WriteV(int fd, const struct iovec *iov, UInt64 offset, UInt64 userData) throw();
+  // it submits queued requests and waits for (minComplete) completions
+  WRes Submit(unsigned minComplete) throw();
+  bool GetCompletion(UInt64 &userData, Int32 &res) throw();
+};
+
+
+class CAsyncOutFiles  MY_UNCOPYABLE
+{
+public:
+  struct CBuf;
+  struct CFile;
+
+  enum EErrorType
+  {
+    k_Write,
+    k_Close,
+    k_Owner,
+    k_Attrib
+  };
+
+  struct CError
+  {
+    FString Path;
+    WRes Error;
+    EErrorType Type;
+  };
+
+private:
+  CUring _ring;
+  unsigned _numBufs;      // the number of allocated buffers
+  unsigned _numInFlight;  // the number of buffers queued to ring
+  CRecordVector<CBuf *> _freeBufs;
+  CRecordVector<CFile *> _files; // opened files and closed files with pending writes
+
+  // the data for finishing thread:
+  NWindows::CThread _thread;
+  NSynchronization::CCriticalSection _cs;
+  NSynchronization::CAutoResetEvent _jobEvent;
+  NSynchronization::CAutoResetEvent _doneEvent;
+  CRecordVector<CFile *> _jobs;
+  CObjectVector<CError> _errors;
+  UInt64 _numJobs;
+  UInt64 _numJobs_Finished;
+  bool _exit;
+
+  CBuf *GetFreeBuf();
+  void FinishBuf(CBuf *b, WRes wres);
+  void QueueBuf(CBuf *b);
+  void QueueFileBuf(CFile *f);
+  void ProcessCompletion(CBuf *b, Int32 res);
+  bool ProcessCompletions();
+  WRes WaitCompletions();
+  void MoveToFinisher(CFile *f);
+  void FinishFile(CFile *f);
+  void AddError(const FString &path, WRes error, EErrorType type);
+public:
+  void ThreadFunc();
+
+  CAsyncOutFiles();
+  ~CAsyncOutFiles();
+  bool IsCreated() const { return _ring.IsCreated(); }
+  WRes Create();
+
+  // (file) must be opened already. It doesn't change the owner of file handle.
+  CFile *Open(const COutFile &file, const FString &path);
+  void SetAttrib(CFile *f, DWORD attrib);
+  void SetOwner(CFile *f, uid_t uid, gid_t gid);
+  // Write() copies data to internal buffers. It returns previous error of file.
+  WRes Write(CFile *f, UInt64 offset, const void *data, size_t size);
+  // it waits for completion of all writes of file and returns the write error
+  WRes WaitFile(CFile *f);
+  // it moves the handle of (file) to finishing thread and returns known write error.
+  // (f) can't be used after Close().
+  WRes Close(CFile *f, COutFile &file);
+  // it waits for completion of all writes and for finishing of all closed files
+  void WaitAll();
+  bool GetError(CError &error);
+};
+
+}}}
+
+#endif // Z7_FILE_ASYNC_IO
+
+#endif
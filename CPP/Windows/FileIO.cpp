@@ -625,6 +625,7 @@ bool COutFile::SetLength_KeepPosition(UInt64 length) throw()
 
 // POSIX
 
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -785,6 +786,47 @@ ssize_t CInFile::read_part(void *data, size_t size) throw()
   return ::read(_handle, data, size);
 }
 
+bool CInFile::FindDataRange(UInt64 pos, UInt64 &dataPos, UInt64 &dataEnd) const throw()
+{
+  dataPos = pos;
+  dataEnd = pos;
+ #if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  const off_t cur = seekToCur();
+  if (cur == -1)
+    return false;
+  bool res = false;
+  off_t start = ::lseek(_handle, (off_t)pos, SEEK_DATA);
+  if (start == -1)
+  {
+    // ENXIO : (pos) is in the hole at the end of file, or (pos) is beyond the end of file
+    UInt64 size;
+    if (errno == ENXIO && GetLength(size))
+    {
+      if (size < pos)
+        size = pos;
+      dataPos = size;
+      dataEnd = size;
+      res = true;
+    }
+  }
+  else
+  {
+    const off_t end = ::lseek(_handle, start, SEEK_HOLE);
+    if (end != -1 && end >= start)
+    {
+      dataPos = (UInt64)start;
+      dataEnd = (UInt64)end;
+      res = true;
+    }
+  }
+  if (seek(cur, SEEK_SET) != cur)
+    return false;
+  return res;
+ #else
+  return false;
+ #endif
+}
+
 bool CInFile::ReadFull(void *data, size_t size, size_t &processed) throw()
 {
   processed = 0;
@@ -948,6 +990,23 @@ bool COutFile::SetMTime(const CFiTime *mTime) throw()
   return true;
 }
 
+void COutFile::MoveTo(COutFile &dest)
+{
+  dest.Close();
+  dest._handle = _handle;
+  _handle = -1;
+  dest.Path = Path;
+  dest.CTime_defined = CTime_defined;
+  dest.ATime_defined = ATime_defined;
+  dest.MTime_defined = MTime_defined;
+  dest.CTime = CTime;
+  dest.ATime = ATime;
+  dest.MTime = MTime;
+  CTime_defined = false;
+  ATime_defined = false;
+  MTime_defined = false;
+}
+
 }}}
 
 
@@ -373,6 +373,7 @@ public:
   {}
   ~CFileBase() { Close(); }
   // void Detach() { _handle = -1; }
+  int GetHandle() const { return _handle; }
   bool Close();
   bool GetLength(UInt64 &length) const;
   off_t seek(off_t distanceToMove, int moveMethod) const;
@@ -404,6 +405,11 @@ public:
   ssize_t read_part(void *data, size_t size) throw();
   // ssize_t read_full(void *data, size_t size, size_t &processed);
   bool ReadFull(void *data, size_t size, size_t &processedSize) throw();
+  /* FindDataRange() finds first data region [dataPos, dataEnd) at (pos) or after (pos)
+     with lseek(SEEK_DATA / SEEK_HOLE). It doesn't change the position of file.
+     (dataPos == dataEnd == fileSize), if there is no data after (pos).
+     it returns false, if SEEK_DATA is not supported by system or file system. */
+  bool FindDataRange(UInt64 pos, UInt64 &dataPos, UInt64 &dataEnd) const throw();
 };
 
 class COutFile: public CFileBase
@@ -455,6 +461,8 @@ public:
   }
   bool SetTime(const CFiTime *cTime, const CFiTime *aTime, const CFiTime *mTime) throw();
   bool SetMTime(const CFiTime *mTime) throw();
+  // it moves handle, path and times to (dest). So (dest.Close()) will close file and set times.
+  void MoveTo(COutFile &dest);
 };
 
 }
@@ -41,6 +41,31 @@ public:
 #endif
 };
 
+// CPoolThread runs thread function in worker thread from shared process-wide pool.
+// Create_With_*() functions with affinity or group create dedicated (non-pooled) thread.
+
+class CPoolThread  MY_UNCOPYABLE
+{
+  ::CPoolThread thread;
+public:
+  CPoolThread() { PoolThread_CONSTRUCT(&thread) }
+  ~CPoolThread() { Close(); }
+  bool IsCreated() { return PoolThread_WasCreated(&thread) != 0; }
+  WRes Close()  { return PoolThread_Close(&thread); }
+  WRes Wait_Close() { return PoolThread_Wait_Close(&thread); }
+
+  WRes Create(THREAD_FUNC_TYPE startAddress, LPVOID param)
+    { return PoolThread_Create(&thread, startAddress, param); }
+  WRes Create_With_Affinity(THREAD_FUNC_TYPE startAddress, LPVOID param, CAffinityMask affinity)
+    { return Thread_Create_With_Affinity(PoolThread_GetThread(&thread), startAddress, param, affinity); }
+  WRes Create_With_CpuSet(THREAD_FUNC_TYPE startAddress, LPVOID param, const CCpuSet *cpuSet)
+    { return Thread_Create_With_CpuSet(PoolThread_GetThread(&thread), startAddress, param, cpuSet); }
+#ifdef _WIN32
+  WRes Create_With_Group(THREAD_FUNC_TYPE startAddress, LPVOID param, unsigned group, CAffinityMask affinity = 0)
+    { return Thread_Create_With_Group(PoolThread_GetThread(&thread), startAddress, param, group, affinity); }
+#endif
+};
+
 }
 
 #endif